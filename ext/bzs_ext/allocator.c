@@ -0,0 +1,97 @@
+// Ruby bindings for bzip2 library.
+// Copyright (c) 2022 AUTHORS, MIT License.
+
+#include "bzs_ext/allocator.h"
+
+#include <stddef.h>
+
+#include "bzs_ext/governor.h"
+
+// Each block starts with header, it keeps block size.
+
+typedef union
+{
+  size_t      size;
+  max_align_t align;
+} block_header_t;
+
+static inline block_header_t* get_header(void* block)
+{
+  return (block_header_t*) block - 1;
+}
+
+static void* allocate(void* data, int items_count, int item_size)
+{
+  bzs_ext_allocator_t* allocator_ptr = data;
+  size_t               size          = (size_t) items_count * (size_t) item_size;
+
+  for (size_t index = 0; index < allocator_ptr->blocks_count; index++) {
+    void* block = allocator_ptr->blocks[index];
+    if (get_header(block)->size != size) {
+      continue;
+    }
+
+    allocator_ptr->blocks_count--;
+    allocator_ptr->blocks[index] = allocator_ptr->blocks[allocator_ptr->blocks_count];
+
+    return block;
+  }
+
+  block_header_t* header = malloc(sizeof(block_header_t) + size);
+  if (header == NULL) {
+    return NULL;
+  }
+
+  header->size = size;
+
+  allocator_ptr->size += size;
+  if (allocator_ptr->max_size < allocator_ptr->size) {
+    allocator_ptr->max_size = allocator_ptr->size;
+  }
+
+  bzs_ext_governor_add_size(size);
+
+  return header + 1;
+}
+
+static void release(void* data, void* block)
+{
+  bzs_ext_allocator_t* allocator_ptr = data;
+
+  if (allocator_ptr->blocks_count == BZS_ALLOCATOR_CACHE_CAPACITY) {
+    block_header_t* header = get_header(block);
+    allocator_ptr->size -= header->size;
+    bzs_ext_governor_remove_size(header->size);
+    free(header);
+    return;
+  }
+
+  allocator_ptr->blocks[allocator_ptr->blocks_count] = block;
+  allocator_ptr->blocks_count++;
+}
+
+void bzs_ext_init_allocator(bzs_ext_allocator_t* allocator_ptr)
+{
+  allocator_ptr->blocks_count = 0;
+  allocator_ptr->size         = 0;
+  allocator_ptr->max_size     = 0;
+}
+
+void bzs_ext_use_allocator(bz_stream* stream_ptr, bzs_ext_allocator_t* allocator_ptr)
+{
+  stream_ptr->bzalloc = allocate;
+  stream_ptr->bzfree  = release;
+  stream_ptr->opaque  = allocator_ptr;
+}
+
+void bzs_ext_release_allocator(bzs_ext_allocator_t* allocator_ptr)
+{
+  for (size_t index = 0; index < allocator_ptr->blocks_count; index++) {
+    block_header_t* header = get_header(allocator_ptr->blocks[index]);
+    allocator_ptr->size -= header->size;
+    bzs_ext_governor_remove_size(header->size);
+    free(header);
+  }
+
+  allocator_ptr->blocks_count = 0;
+}
@@ -0,0 +1,33 @@
+// Ruby bindings for bzip2 library.
+// Copyright (c) 2022 AUTHORS, MIT License.
+
+#if !defined(BZS_EXT_ALLOCATOR_H)
+#define BZS_EXT_ALLOCATOR_H
+
+#include <bzlib.h>
+#include <stdlib.h>
+
+// Bzip2 library doesn't provide stream reset, restart means end and init.
+// Allocator keeps memory released by stream end and provides it for next init with same sizes.
+// Compressor uses 4 allocations, decompressor uses up to 3 allocations.
+// Allocator accounts size of memory it holds, including cached blocks, governor receives same size.
+
+#define BZS_ALLOCATOR_CACHE_CAPACITY 4
+
+typedef struct
+{
+  void*  blocks[BZS_ALLOCATOR_CACHE_CAPACITY];
+  size_t blocks_count;
+  size_t size;
+  size_t max_size;
+} bzs_ext_allocator_t;
+
+void bzs_ext_init_allocator(bzs_ext_allocator_t* allocator_ptr);
+
+// Stream should not be initialized.
+void bzs_ext_use_allocator(bz_stream* stream_ptr, bzs_ext_allocator_t* allocator_ptr);
+
+// Stream should be ended before allocator release.
+void bzs_ext_release_allocator(bzs_ext_allocator_t* allocator_ptr);
+
+#endif // BZS_EXT_ALLOCATOR_H
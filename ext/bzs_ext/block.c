@@ -0,0 +1,334 @@
+// Ruby bindings for bzip2 library.
+// Copyright (c) 2022 AUTHORS, MIT License.
+
+#include "bzs_ext/block.h"
+
+#include <string.h>
+
+#include "bzs_ext/crc.h"
+#include "bzs_ext/error.h"
+
+#define BZS_STREAM_HEADER_MAGIC "BZh"
+
+// -- bit writer --
+
+bzs_ext_result_t bzs_ext_init_bit_writer(
+  bzs_ext_bit_writer_t*         writer_ptr,
+  size_t                        buffer_length,
+  bzs_ext_bit_writer_function_t function,
+  void*                         data)
+{
+  bzs_ext_byte_t* buffer = malloc(buffer_length);
+  if (buffer == NULL) {
+    return BZS_EXT_ERROR_ALLOCATE_FAILED;
+  }
+
+  writer_ptr->buffer         = buffer;
+  writer_ptr->buffer_length  = buffer_length;
+  writer_ptr->length         = 0;
+  writer_ptr->written_length = 0;
+  writer_ptr->bits           = 0;
+  writer_ptr->bits_count     = 0;
+  writer_ptr->function       = function;
+  writer_ptr->data           = data;
+
+  return 0;
+}
+
+bzs_ext_result_t bzs_ext_bit_writer_flush(bzs_ext_bit_writer_t* writer_ptr)
+{
+  if (writer_ptr->length == 0) {
+    return 0;
+  }
+
+  bzs_ext_result_t ext_result = writer_ptr->function(writer_ptr->data, writer_ptr->buffer, writer_ptr->length);
+  if (ext_result != 0) {
+    return ext_result;
+  }
+
+  writer_ptr->written_length += writer_ptr->length;
+  writer_ptr->length = 0;
+
+  return 0;
+}
+
+bzs_ext_result_t bzs_ext_bit_writer_write_bits(bzs_ext_bit_writer_t* writer_ptr, uint64_t bits, size_t bits_count)
+{
+  for (size_t index = bits_count; index > 0; index--) {
+    bzs_ext_result_t ext_result = bzs_ext_bit_writer_write_bit(writer_ptr, (uint32_t) (bits >> (index - 1)) & 1);
+    if (ext_result != 0) {
+      return ext_result;
+    }
+  }
+
+  return 0;
+}
+
+bzs_ext_result_t bzs_ext_bit_writer_finish(bzs_ext_bit_writer_t* writer_ptr)
+{
+  if (writer_ptr->bits_count != 0) {
+    bzs_ext_result_t ext_result = bzs_ext_bit_writer_write_bits(writer_ptr, 0, 8 - writer_ptr->bits_count);
+    if (ext_result != 0) {
+      return ext_result;
+    }
+  }
+
+  return bzs_ext_bit_writer_flush(writer_ptr);
+}
+
+bzs_ext_result_t bzs_ext_bit_writer_finish_stream(bzs_ext_bit_writer_t* writer_ptr, uint32_t stream_crc)
+{
+  bzs_ext_result_t ext_result = bzs_ext_bit_writer_write_bits(writer_ptr, BZS_END_MAGIC, BZS_MAGIC_BITS);
+  if (ext_result != 0) {
+    return ext_result;
+  }
+
+  ext_result = bzs_ext_bit_writer_write_bits(writer_ptr, stream_crc, BZS_CRC_BITS);
+  if (ext_result != 0) {
+    return ext_result;
+  }
+
+  return bzs_ext_bit_writer_finish(writer_ptr);
+}
+
+void bzs_ext_free_bit_writer(bzs_ext_bit_writer_t* writer_ptr)
+{
+  free(writer_ptr->buffer);
+}
+
+// -- scanner --
+
+static inline void reset_stream(bzs_ext_block_scanner_t* scanner_ptr)
+{
+  scanner_ptr->is_header_expected = true;
+  scanner_ptr->header_length      = 0;
+  scanner_ptr->magic_bits         = 0;
+  scanner_ptr->crc_bits           = 0;
+  scanner_ptr->window_bits_count  = 0;
+  scanner_ptr->stream_crc         = 0;
+}
+
+// Magic can be found in window after any bit of next byte, so magic is shifted by 0 - 7 bits.
+// Filter contains bytes of shifted magics at positions 16 - 23 and 24 - 31 bits.
+
+static inline void add_magic_to_filters(bzs_ext_block_scanner_t* scanner_ptr, uint64_t magic)
+{
+  for (size_t shift = 0; shift < 8; shift++) {
+    for (size_t index = 0; index < 2; index++) {
+      bzs_ext_byte_t byte = (bzs_ext_byte_t) (magic << shift >> (16 + index * 8));
+      scanner_ptr->magic_filters[index][byte >> 6] |= (uint64_t) 1 << (byte & 63);
+    }
+  }
+}
+
+static inline bool is_byte_in_filter(const uint64_t* magic_filter, bzs_ext_byte_t byte)
+{
+  return (magic_filter[byte >> 6] >> (byte & 63)) & 1;
+}
+
+void bzs_ext_init_block_scanner(
+  bzs_ext_block_scanner_t* scanner_ptr,
+  bzs_ext_block_function_t function,
+  void*                    data,
+  bzs_ext_bit_writer_t*    writer_ptr)
+{
+  scanner_ptr->function   = function;
+  scanner_ptr->data       = data;
+  scanner_ptr->writer_ptr = writer_ptr;
+
+  memset(scanner_ptr->magic_filters, 0, sizeof(scanner_ptr->magic_filters));
+  add_magic_to_filters(scanner_ptr, BZS_BLOCK_MAGIC);
+  add_magic_to_filters(scanner_ptr, BZS_END_MAGIC);
+
+  reset_stream(scanner_ptr);
+}
+
+static inline bzs_ext_result_t append_header_byte(bzs_ext_block_scanner_t* scanner_ptr, bzs_ext_byte_t byte)
+{
+  scanner_ptr->header[scanner_ptr->header_length++] = byte;
+
+  if (scanner_ptr->header_length != BZS_STREAM_HEADER_LENGTH) {
+    return 0;
+  }
+
+  bzs_ext_byte_t block_size = scanner_ptr->header[3];
+
+  if (
+    memcmp(scanner_ptr->header, BZS_STREAM_HEADER_MAGIC, sizeof(BZS_STREAM_HEADER_MAGIC) - 1) != 0 ||
+    block_size < '1' || block_size > '9') {
+    return BZS_EXT_ERROR_DECOMPRESSOR_CORRUPTED_SOURCE;
+  }
+
+  scanner_ptr->is_header_expected = false;
+
+  return scanner_ptr->function(scanner_ptr->data, BZS_BLOCK_STREAM_EVENT, block_size - '0');
+}
+
+// Returns true in is_stream_finished_ptr when end of stream marker is found, remaining bits of byte are padding.
+static inline bzs_ext_result_t
+  append_bit(bzs_ext_block_scanner_t* scanner_ptr, uint32_t bit, bool* is_stream_finished_ptr)
+{
+  bzs_ext_result_t ext_result;
+
+  // Window contains last magic and CRC bits, bit leaving full window belongs to current block.
+  if (scanner_ptr->window_bits_count == BZS_MAGIC_WITH_CRC_BITS) {
+    if (scanner_ptr->writer_ptr != NULL) {
+      uint32_t block_bit = (uint32_t) (scanner_ptr->magic_bits >> (BZS_MAGIC_BITS - 1));
+
+      ext_result = bzs_ext_bit_writer_write_bit(scanner_ptr->writer_ptr, block_bit);
+      if (ext_result != 0) {
+        return ext_result;
+      }
+    }
+  } else {
+    scanner_ptr->window_bits_count++;
+  }
+
+  uint32_t crc_bit = scanner_ptr->crc_bits >> (BZS_CRC_BITS - 1);
+
+  scanner_ptr->magic_bits = ((scanner_ptr->magic_bits << 1) | crc_bit) & BZS_MAGIC_MASK;
+  scanner_ptr->crc_bits   = (scanner_ptr->crc_bits << 1) | bit;
+
+  if (scanner_ptr->window_bits_count != BZS_MAGIC_WITH_CRC_BITS) {
+    return 0;
+  }
+
+  if (scanner_ptr->magic_bits == BZS_BLOCK_MAGIC) {
+    scanner_ptr->stream_crc = bzs_ext_combine_crc(scanner_ptr->stream_crc, scanner_ptr->crc_bits);
+
+    return scanner_ptr->function(scanner_ptr->data, BZS_BLOCK_BLOCK_EVENT, scanner_ptr->crc_bits);
+  }
+
+  if (scanner_ptr->magic_bits == BZS_END_MAGIC) {
+    if (scanner_ptr->crc_bits != scanner_ptr->stream_crc) {
+      return BZS_EXT_ERROR_DECOMPRESSOR_CORRUPTED_SOURCE;
+    }
+
+    ext_result = scanner_ptr->function(scanner_ptr->data, BZS_BLOCK_END_EVENT, scanner_ptr->crc_bits);
+    if (ext_result != 0) {
+      return ext_result;
+    }
+
+    reset_stream(scanner_ptr);
+
+    *is_stream_finished_ptr = true;
+  }
+
+  return 0;
+}
+
+// Bits contain magic bits of current window followed by bits of next 8 windows.
+static inline bool is_magic_in_bits(uint64_t magic_filters[2][4], uint64_t bits)
+{
+  if (
+    !is_byte_in_filter(magic_filters[0], (bzs_ext_byte_t) (bits >> 16)) ||
+    !is_byte_in_filter(magic_filters[1], (bzs_ext_byte_t) (bits >> 24))) {
+    return false;
+  }
+
+  bool result = false;
+
+  for (size_t shift = 0; shift < 8; shift++) {
+    uint64_t magic_bits = (bits >> shift) & BZS_MAGIC_MASK;
+    result |= (magic_bits == BZS_BLOCK_MAGIC) | (magic_bits == BZS_END_MAGIC);
+  }
+
+  return result;
+}
+
+// Full window moves by whole bytes until magic can be found in next byte.
+static inline bzs_ext_result_t append_bytes(
+  bzs_ext_block_scanner_t* scanner_ptr,
+  const bzs_ext_byte_t*    source,
+  size_t                   source_length,
+  size_t*                  appended_length_ptr)
+{
+  bzs_ext_bit_writer_t* writer_ptr = scanner_ptr->writer_ptr;
+  uint64_t              magic_bits = scanner_ptr->magic_bits;
+  uint32_t              crc_bits   = scanner_ptr->crc_bits;
+  bzs_ext_result_t      ext_result = 0;
+  size_t                index;
+
+  // Writer can't change local filters, so they are not reloaded after each write.
+  uint64_t magic_filters[2][4];
+  memcpy(magic_filters, scanner_ptr->magic_filters, sizeof(magic_filters));
+
+  for (index = 0; index < source_length; index++) {
+    uint64_t bits = (magic_bits << 8) | (crc_bits >> (BZS_CRC_BITS - 8));
+    if (is_magic_in_bits(magic_filters, bits)) {
+      break;
+    }
+
+    // Byte leaving window belongs to current block.
+    if (writer_ptr != NULL) {
+      ext_result = bzs_ext_bit_writer_write_byte(writer_ptr, (bzs_ext_byte_t) (bits >> BZS_MAGIC_BITS));
+      if (ext_result != 0) {
+        break;
+      }
+    }
+
+    magic_bits = bits & BZS_MAGIC_MASK;
+    crc_bits   = (crc_bits << 8) | source[index];
+  }
+
+  scanner_ptr->magic_bits = magic_bits;
+  scanner_ptr->crc_bits   = crc_bits;
+  *appended_length_ptr    = index;
+
+  return ext_result;
+}
+
+bzs_ext_result_t bzs_ext_block_scanner_append(
+  bzs_ext_block_scanner_t* scanner_ptr,
+  const bzs_ext_byte_t*    source,
+  size_t                   source_length)
+{
+  bzs_ext_result_t ext_result;
+
+  for (size_t index = 0; index < source_length; index++) {
+    if (scanner_ptr->window_bits_count == BZS_MAGIC_WITH_CRC_BITS) {
+      size_t appended_length;
+
+      ext_result = append_bytes(scanner_ptr, source + index, source_length - index, &appended_length);
+      if (ext_result != 0) {
+        return ext_result;
+      }
+
+      index += appended_length;
+      if (index == source_length) {
+        break;
+      }
+    }
+
+    bzs_ext_byte_t byte = source[index];
+
+    if (scanner_ptr->is_header_expected) {
+      ext_result = append_header_byte(scanner_ptr, byte);
+      if (ext_result != 0) {
+        return ext_result;
+      }
+
+      continue;
+    }
+
+    bool is_stream_finished = false;
+
+    for (int bit_index = 7; bit_index >= 0 && !is_stream_finished; bit_index--) {
+      ext_result = append_bit(scanner_ptr, (byte >> bit_index) & 1, &is_stream_finished);
+      if (ext_result != 0) {
+        return ext_result;
+      }
+    }
+  }
+
+  return 0;
+}
+
+bzs_ext_result_t bzs_ext_block_scanner_finish(const bzs_ext_block_scanner_t* scanner_ptr)
+{
+  if (!scanner_ptr->is_header_expected || scanner_ptr->header_length != 0) {
+    return BZS_EXT_ERROR_DECOMPRESSOR_CORRUPTED_SOURCE;
+  }
+
+  return 0;
+}
@@ -0,0 +1,153 @@
+// Ruby bindings for bzip2 library.
+// Copyright (c) 2022 AUTHORS, MIT License.
+
+#if !defined(BZS_EXT_BLOCK_H)
+#define BZS_EXT_BLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "bzs_ext/common.h"
+
+// Each stream starts from new byte with header: "BZh" and block size digit.
+// Blocks are not aligned to bytes, each block starts with magic (48 bits) followed by block CRC (32 bits).
+// Stream ends with end of stream magic (48 bits) followed by stream CRC (32 bits) and padding to byte boundary.
+
+#define BZS_STREAM_HEADER_LENGTH 4
+#define BZS_BLOCK_MAGIC          0x314159265359
+#define BZS_END_MAGIC            0x177245385090
+#define BZS_MAGIC_MASK           0xffffffffffff
+#define BZS_MAGIC_BITS           48
+#define BZS_CRC_BITS             32
+#define BZS_MAGIC_WITH_CRC_BITS  (BZS_MAGIC_BITS + BZS_CRC_BITS)
+
+// -- bit writer --
+
+// Bit writer writes bits in bzip2 order: most significant bit of each byte first.
+// Buffer is provided to function when it is full and when writer is finished.
+
+typedef bzs_ext_result_t (*bzs_ext_bit_writer_function_t)(void* data, const bzs_ext_byte_t* buffer, size_t length);
+
+typedef struct
+{
+  bzs_ext_byte_t*               buffer;
+  size_t                        buffer_length;
+  size_t                        length;
+  size_t                        written_length;
+  uint32_t                      bits;
+  size_t                        bits_count;
+  bzs_ext_bit_writer_function_t function;
+  void*                         data;
+} bzs_ext_bit_writer_t;
+
+bzs_ext_result_t bzs_ext_init_bit_writer(
+  bzs_ext_bit_writer_t*         writer_ptr,
+  size_t                        buffer_length,
+  bzs_ext_bit_writer_function_t function,
+  void*                         data);
+
+bzs_ext_result_t bzs_ext_bit_writer_flush(bzs_ext_bit_writer_t* writer_ptr);
+
+static inline bzs_ext_result_t bzs_ext_bit_writer_write_bit(bzs_ext_bit_writer_t* writer_ptr, uint32_t bit)
+{
+  writer_ptr->bits = (writer_ptr->bits << 1) | bit;
+
+  if (++writer_ptr->bits_count != 8) {
+    return 0;
+  }
+
+  writer_ptr->buffer[writer_ptr->length++] = (bzs_ext_byte_t) writer_ptr->bits;
+  writer_ptr->bits                         = 0;
+  writer_ptr->bits_count                   = 0;
+
+  if (writer_ptr->length != writer_ptr->buffer_length) {
+    return 0;
+  }
+
+  return bzs_ext_bit_writer_flush(writer_ptr);
+}
+
+static inline bzs_ext_result_t bzs_ext_bit_writer_write_byte(bzs_ext_bit_writer_t* writer_ptr, bzs_ext_byte_t byte)
+{
+  uint32_t bits = (writer_ptr->bits << 8) | byte;
+
+  writer_ptr->buffer[writer_ptr->length++] = (bzs_ext_byte_t) (bits >> writer_ptr->bits_count);
+  writer_ptr->bits                         = bits & ((1 << writer_ptr->bits_count) - 1);
+
+  if (writer_ptr->length != writer_ptr->buffer_length) {
+    return 0;
+  }
+
+  return bzs_ext_bit_writer_flush(writer_ptr);
+}
+
+// Writes lowest bits count of bits, most significant bit first.
+bzs_ext_result_t bzs_ext_bit_writer_write_bits(bzs_ext_bit_writer_t* writer_ptr, uint64_t bits, size_t bits_count);
+
+// Pads last byte with zero bits and provides remaining buffer to function.
+bzs_ext_result_t bzs_ext_bit_writer_finish(bzs_ext_bit_writer_t* writer_ptr);
+
+// Writes end of stream marker with stream CRC and finishes writer.
+bzs_ext_result_t bzs_ext_bit_writer_finish_stream(bzs_ext_bit_writer_t* writer_ptr, uint32_t stream_crc);
+
+// Returns length of written bytes including buffered bytes.
+static inline uint64_t bzs_ext_bit_writer_get_length(const bzs_ext_bit_writer_t* writer_ptr)
+{
+  return writer_ptr->written_length + writer_ptr->length;
+}
+
+void bzs_ext_free_bit_writer(bzs_ext_bit_writer_t* writer_ptr);
+
+// -- scanner --
+
+// Scanner finds stream headers, blocks and end of stream markers in compressed source without decompression.
+// Bits of blocks (including block magics) are provided to optional bit writer, headers and end markers are dropped.
+// Previous block is completely written when next block or end of stream is reported.
+
+// Magic can appear inside compressed data, so stream CRC is compared with combined CRC of found blocks.
+// False block or end of stream will be reported as corrupted source.
+
+typedef enum
+{
+  BZS_BLOCK_STREAM_EVENT, // value is block size from stream header
+  BZS_BLOCK_BLOCK_EVENT,  // value is block CRC
+  BZS_BLOCK_END_EVENT     // value is verified stream CRC
+} bzs_ext_block_event_t;
+
+typedef bzs_ext_result_t (*bzs_ext_block_function_t)(void* data, bzs_ext_block_event_t event, uint32_t value);
+
+typedef struct
+{
+  bzs_ext_block_function_t function;
+  void*                    data;
+  bzs_ext_bit_writer_t*    writer_ptr;
+
+  bool           is_header_expected;
+  bzs_ext_byte_t header[BZS_STREAM_HEADER_LENGTH];
+  size_t         header_length;
+
+  uint64_t magic_bits;
+  uint32_t crc_bits;
+  size_t   window_bits_count;
+  uint32_t stream_crc;
+
+  // Sets of bytes (256 bits each) which can be found inside shifted magics at 2 byte positions.
+  uint64_t magic_filters[2][4];
+} bzs_ext_block_scanner_t;
+
+void bzs_ext_init_block_scanner(
+  bzs_ext_block_scanner_t* scanner_ptr,
+  bzs_ext_block_function_t function,
+  void*                    data,
+  bzs_ext_bit_writer_t*    writer_ptr);
+
+bzs_ext_result_t bzs_ext_block_scanner_append(
+  bzs_ext_block_scanner_t* scanner_ptr,
+  const bzs_ext_byte_t*    source,
+  size_t                   source_length);
+
+// Source should end after end of stream marker.
+bzs_ext_result_t bzs_ext_block_scanner_finish(const bzs_ext_block_scanner_t* scanner_ptr);
+
+#endif // BZS_EXT_BLOCK_H
@@ -0,0 +1,153 @@
+// Ruby bindings for bzip2 library.
+// Copyright (c) 2022 AUTHORS, MIT License.
+
+// Glibc declares fallocate and sync_file_range as gnu extensions.
+#if (defined(HAVE_FALLOCATE) || defined(HAVE_SYNC_FILE_RANGE)) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE 1
+#endif
+
+#include "bzs_ext/cache.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bzs_ext/error.h"
+
+// Pages are released after each window, so window should be much larger than buffer.
+#define WINDOW_LENGTH (1 << 23) // 8 MB
+
+void bzs_ext_init_cache(
+  bzs_ext_cache_t* cache_ptr, int fd, bool is_destination, bool drop_cache, size_t preallocate_length)
+{
+  cache_ptr->fd                  = -1;
+  cache_ptr->is_destination      = is_destination;
+  cache_ptr->drop_cache          = drop_cache;
+  cache_ptr->offset              = 0;
+  cache_ptr->written_offset      = 0;
+  cache_ptr->released_offset     = 0;
+  cache_ptr->preallocated_offset = -1;
+
+  if (fd < 0 || (!drop_cache && preallocate_length == 0)) {
+    return;
+  }
+
+  off_t offset = lseek(fd, 0, SEEK_CUR);
+  if (offset < 0) {
+    return;
+  }
+
+  cache_ptr->fd              = fd;
+  cache_ptr->offset          = offset;
+  cache_ptr->written_offset  = offset;
+  cache_ptr->released_offset = offset;
+
+#if defined(HAVE_FALLOCATE)
+  if (!is_destination || preallocate_length == 0) {
+    return;
+  }
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode)) {
+    return;
+  }
+
+  // Destination should be at the end of file, so truncate won't remove existing data.
+  if (file_stat.st_size <= offset && fallocate(fd, 0, offset, (off_t) preallocate_length) == 0) {
+    cache_ptr->preallocated_offset = offset + (off_t) preallocate_length;
+  }
+#endif
+}
+
+static inline void release_pages(bzs_ext_cache_t* cache_ptr, off_t offset)
+{
+  if (offset == cache_ptr->released_offset) {
+    return;
+  }
+
+#if defined(HAVE_POSIX_FADVISE)
+  posix_fadvise(cache_ptr->fd, cache_ptr->released_offset, offset - cache_ptr->released_offset, POSIX_FADV_DONTNEED);
+#endif
+
+  cache_ptr->released_offset = offset;
+}
+
+static inline void write_pages(bzs_ext_cache_t* cache_ptr, bool needs_wait)
+{
+  // Dirty pages can't be released, so only previous window is released until finish.
+  off_t released_offset = needs_wait ? cache_ptr->offset : cache_ptr->written_offset;
+
+#if defined(HAVE_SYNC_FILE_RANGE)
+  // Writeback of new window is started without waiting.
+  if (cache_ptr->offset != cache_ptr->written_offset) {
+    sync_file_range(
+      cache_ptr->fd,
+      cache_ptr->written_offset,
+      cache_ptr->offset - cache_ptr->written_offset,
+      SYNC_FILE_RANGE_WRITE);
+  }
+
+  if (released_offset != cache_ptr->released_offset) {
+    sync_file_range(
+      cache_ptr->fd,
+      cache_ptr->released_offset,
+      released_offset - cache_ptr->released_offset,
+      SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+  }
+#endif
+
+  release_pages(cache_ptr, released_offset);
+
+  cache_ptr->written_offset = cache_ptr->offset;
+}
+
+void bzs_ext_cache_add(bzs_ext_cache_t* cache_ptr, size_t length)
+{
+  if (cache_ptr->fd < 0) {
+    return;
+  }
+
+  cache_ptr->offset += (off_t) length;
+
+  if (!cache_ptr->drop_cache) {
+    return;
+  }
+
+  if (!cache_ptr->is_destination) {
+    if (cache_ptr->offset - cache_ptr->released_offset >= WINDOW_LENGTH) {
+      release_pages(cache_ptr, cache_ptr->offset);
+    }
+
+    return;
+  }
+
+  if (cache_ptr->offset - cache_ptr->written_offset >= WINDOW_LENGTH) {
+    write_pages(cache_ptr, false);
+  }
+}
+
+bzs_ext_result_t bzs_ext_finish_cache(bzs_ext_cache_t* cache_ptr)
+{
+  int fd = cache_ptr->fd;
+  if (fd < 0) {
+    return 0;
+  }
+
+  if (cache_ptr->drop_cache) {
+    if (cache_ptr->is_destination) {
+      write_pages(cache_ptr, true);
+    } else {
+      release_pages(cache_ptr, cache_ptr->offset);
+    }
+  }
+
+  // Cache can be finished only once.
+  cache_ptr->fd = -1;
+
+  // Zeros of preallocated space can't be kept after destination.
+  if (cache_ptr->preallocated_offset > cache_ptr->offset && ftruncate(fd, cache_ptr->offset) != 0) {
+    return BZS_EXT_ERROR_WRITE_IO;
+  }
+
+  return 0;
+}
@@ -0,0 +1,43 @@
+// Ruby bindings for bzip2 library.
+// Copyright (c) 2022 AUTHORS, MIT License.
+
+#if !defined(BZS_EXT_CACHE_H)
+#define BZS_EXT_CACHE_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <sys/types.h>
+
+#include "bzs_ext/common.h"
+
+// Cache keeps page cache of large files small, so other files won't be evicted.
+// Source pages are released behind read position.
+// Destination writeback is started for each written window, previous window is waited and its pages are released.
+
+// Destination can be preallocated at once to avoid fragmentation.
+// Preallocated space above written destination is truncated when cache is finished.
+
+// Cache is disabled for descriptor which is not seekable.
+// Advice and preallocation errors are ignored, destination will be processed without them.
+
+typedef struct
+{
+  int   fd;
+  bool  is_destination;
+  bool  drop_cache;
+  off_t offset;
+  off_t written_offset;
+  off_t released_offset;
+  off_t preallocated_offset;
+} bzs_ext_cache_t;
+
+void bzs_ext_init_cache(
+  bzs_ext_cache_t* cache_ptr, int fd, bool is_destination, bool drop_cache, size_t preallocate_length);
+
+// Destination can wait for writeback of previous window.
+void bzs_ext_cache_add(bzs_ext_cache_t* cache_ptr, size_t length);
+
+// Waits for writeback of remaining destination and truncates preallocated space.
+bzs_ext_result_t bzs_ext_finish_cache(bzs_ext_cache_t* cache_ptr);
+
+#endif // BZS_EXT_CACHE_H
@@ -0,0 +1,28 @@
+// Ruby bindings for bzip2 library.
+// Copyright (c) 2022 AUTHORS, MIT License.
+
+#if !defined(BZS_EXT_CRC_H)
+#define BZS_EXT_CRC_H
+
+#include <stdint.h>
+
+#include "bzs_ext/common.h"
+
+// Bzip2 uses big endian CRC32 with 0x04c11db7 polynomial for each block.
+// Stream CRC combines CRCs of all blocks.
+
+#define BZS_CRC_INIT 0xffffffff
+
+extern const uint32_t bzs_ext_crc_table[256];
+
+static inline uint32_t bzs_ext_update_crc(uint32_t crc, bzs_ext_byte_t byte)
+{
+  return (crc << 8) ^ bzs_ext_crc_table[(crc >> 24) ^ byte];
+}
+
+static inline uint32_t bzs_ext_combine_crc(uint32_t stream_crc, uint32_t block_crc)
+{
+  return ((stream_crc << 1) | (stream_crc >> 31)) ^ block_crc;
+}
+
+#endif // BZS_EXT_CRC_H
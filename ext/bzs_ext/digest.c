@@ -0,0 +1,360 @@
+// Ruby bindings for bzip2 library.
+// Copyright (c) 2022 AUTHORS, MIT License.
+
+#include "bzs_ext/digest.h"
+
+#include <string.h>
+
+#include "bzs_ext/error.h"
+
+// -- sha256 --
+
+static const uint32_t sha256_constants[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static const uint32_t sha256_initial_state[8] = {
+  0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+#define SHA256_BLOCK_LENGTH  64
+#define SHA256_RESULT_LENGTH 32
+
+static inline uint32_t rotr32(uint32_t value, unsigned int shift)
+{
+  return (value >> shift) | (value << (32 - shift));
+}
+
+static inline uint32_t read_uint32_be(const bzs_ext_byte_t* data)
+{
+  return ((uint32_t) data[0] << 24) | ((uint32_t) data[1] << 16) | ((uint32_t) data[2] << 8) | (uint32_t) data[3];
+}
+
+static inline void write_uint32_be(bzs_ext_byte_t* data, uint32_t value)
+{
+  data[0] = (bzs_ext_byte_t) (value >> 24);
+  data[1] = (bzs_ext_byte_t) (value >> 16);
+  data[2] = (bzs_ext_byte_t) (value >> 8);
+  data[3] = (bzs_ext_byte_t) value;
+}
+
+static inline void process_sha256_block(uint32_t* state, const bzs_ext_byte_t* block)
+{
+  uint32_t words[64];
+
+  for (size_t index = 0; index < 16; index++) {
+    words[index] = read_uint32_be(block + index * 4);
+  }
+
+  for (size_t index = 16; index < 64; index++) {
+    uint32_t word_1 = words[index - 15];
+    uint32_t word_2 = words[index - 2];
+
+    uint32_t sigma_0 = rotr32(word_1, 7) ^ rotr32(word_1, 18) ^ (word_1 >> 3);
+    uint32_t sigma_1 = rotr32(word_2, 17) ^ rotr32(word_2, 19) ^ (word_2 >> 10);
+
+    words[index] = words[index - 16] + sigma_0 + words[index - 7] + sigma_1;
+  }
+
+  uint32_t a = state[0];
+  uint32_t b = state[1];
+  uint32_t c = state[2];
+  uint32_t d = state[3];
+  uint32_t e = state[4];
+  uint32_t f = state[5];
+  uint32_t g = state[6];
+  uint32_t h = state[7];
+
+  for (size_t index = 0; index < 64; index++) {
+    uint32_t sum_1  = rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25);
+    uint32_t choice = (e & f) ^ (~e & g);
+    uint32_t temp_1 = h + sum_1 + choice + sha256_constants[index] + words[index];
+    uint32_t sum_0  = rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22);
+    uint32_t major  = (a & b) ^ (a & c) ^ (b & c);
+    uint32_t temp_2 = sum_0 + major;
+
+    h = g;
+    g = f;
+    f = e;
+    e = d + temp_1;
+    d = c;
+    c = b;
+    b = a;
+    a = temp_1 + temp_2;
+  }
+
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+  state[4] += e;
+  state[5] += f;
+  state[6] += g;
+  state[7] += h;
+}
+
+static inline size_t get_sha256_result(bzs_ext_digest_t* digest_ptr, bzs_ext_byte_t* result)
+{
+  uint64_t bits_length = digest_ptr->length * 8;
+
+  // Padding is a single bit followed by zeros and big endian length in bits.
+  bzs_ext_byte_t padding[SHA256_BLOCK_LENGTH * 2] = {0x80};
+  size_t         padding_length                   = SHA256_BLOCK_LENGTH - digest_ptr->block_length;
+  if (padding_length < 9) {
+    padding_length += SHA256_BLOCK_LENGTH;
+  }
+
+  write_uint32_be(padding + padding_length - 8, (uint32_t) (bits_length >> 32));
+  write_uint32_be(padding + padding_length - 4, (uint32_t) bits_length);
+
+  bzs_ext_digest_update(digest_ptr, padding, padding_length);
+
+  for (size_t index = 0; index < 8; index++) {
+    write_uint32_be(result + index * 4, digest_ptr->sha256_state[index]);
+  }
+
+  return SHA256_RESULT_LENGTH;
+}
+
+// -- xxh64 --
+
+#define XXH64_PRIME_1 0x9e3779b185ebca87ULL
+#define XXH64_PRIME_2 0xc2b2ae3d27d4eb4fULL
+#define XXH64_PRIME_3 0x165667b19e3779f9ULL
+#define XXH64_PRIME_4 0x85ebca77c2b2ae63ULL
+#define XXH64_PRIME_5 0x27d4eb2f165667c5ULL
+
+#define XXH64_STRIPE_LENGTH 32
+#define XXH64_RESULT_LENGTH 8
+
+static inline uint64_t rotl64(uint64_t value, unsigned int shift)
+{
+  return (value << shift) | (value >> (64 - shift));
+}
+
+static inline uint64_t read_uint64_le(const bzs_ext_byte_t* data)
+{
+  uint64_t value = 0;
+
+  for (size_t index = 0; index < 8; index++) {
+    value |= (uint64_t) data[index] << (index * 8);
+  }
+
+  return value;
+}
+
+static inline uint32_t read_uint32_le(const bzs_ext_byte_t* data)
+{
+  return (uint32_t) data[0] | ((uint32_t) data[1] << 8) | ((uint32_t) data[2] << 16) | ((uint32_t) data[3] << 24);
+}
+
+static inline uint64_t xxh64_round(uint64_t accumulator, uint64_t input)
+{
+  accumulator += input * XXH64_PRIME_2;
+  accumulator = rotl64(accumulator, 31);
+
+  return accumulator * XXH64_PRIME_1;
+}
+
+static inline uint64_t xxh64_merge_round(uint64_t accumulator, uint64_t value)
+{
+  accumulator ^= xxh64_round(0, value);
+
+  return accumulator * XXH64_PRIME_1 + XXH64_PRIME_4;
+}
+
+static inline void process_xxh64_stripe(uint64_t* state, const bzs_ext_byte_t* stripe)
+{
+  for (size_t index = 0; index < 4; index++) {
+    state[index] = xxh64_round(state[index], read_uint64_le(stripe + index * 8));
+  }
+}
+
+static inline size_t get_xxh64_result(const bzs_ext_digest_t* digest_ptr, bzs_ext_byte_t* result)
+{
+  const uint64_t* state = digest_ptr->xxh64_state;
+  uint64_t        hash;
+
+  if (digest_ptr->length >= XXH64_STRIPE_LENGTH) {
+    hash = rotl64(state[0], 1) + rotl64(state[1], 7) + rotl64(state[2], 12) + rotl64(state[3], 18);
+
+    for (size_t index = 0; index < 4; index++) {
+      hash = xxh64_merge_round(hash, state[index]);
+    }
+  } else {
+    hash = XXH64_PRIME_5;
+  }
+
+  hash += digest_ptr->length;
+
+  const bzs_ext_byte_t* data        = digest_ptr->block;
+  size_t                data_length = digest_ptr->block_length;
+
+  for (; data_length >= 8; data += 8, data_length -= 8) {
+    hash ^= xxh64_round(0, read_uint64_le(data));
+    hash = rotl64(hash, 27) * XXH64_PRIME_1 + XXH64_PRIME_4;
+  }
+
+  if (data_length >= 4) {
+    hash ^= (uint64_t) read_uint32_le(data) * XXH64_PRIME_1;
+    hash = rotl64(hash, 23) * XXH64_PRIME_2 + XXH64_PRIME_3;
+
+    data += 4;
+    data_length -= 4;
+  }
+
+  for (; data_length != 0; data++, data_length--) {
+    hash ^= *data * XXH64_PRIME_5;
+    hash = rotl64(hash, 11) * XXH64_PRIME_1;
+  }
+
+  hash ^= hash >> 33;
+  hash *= XXH64_PRIME_2;
+  hash ^= hash >> 29;
+  hash *= XXH64_PRIME_3;
+  hash ^= hash >> 32;
+
+  // Canonical representation is big endian.
+  write_uint32_be(result, (uint32_t) (hash >> 32));
+  write_uint32_be(result + 4, (uint32_t) hash);
+
+  return XXH64_RESULT_LENGTH;
+}
+
+// -- digest --
+
+void bzs_ext_init_digest(bzs_ext_digest_t* digest_ptr, bzs_ext_digest_type_t type)
+{
+  digest_ptr->type         = type;
+  digest_ptr->length       = 0;
+  digest_ptr->block_length = 0;
+
+  memcpy(digest_ptr->sha256_state, sha256_initial_state, sizeof(sha256_initial_state));
+
+  digest_ptr->xxh64_state[0] = XXH64_PRIME_1 + XXH64_PRIME_2;
+  digest_ptr->xxh64_state[1] = XXH64_PRIME_2;
+  digest_ptr->xxh64_state[2] = 0;
+  digest_ptr->xxh64_state[3] = 0 - XXH64_PRIME_1;
+}
+
+static inline size_t get_block_length(const bzs_ext_digest_t* digest_ptr)
+{
+  return digest_ptr->type == BZS_DIGEST_SHA256 ? SHA256_BLOCK_LENGTH : XXH64_STRIPE_LENGTH;
+}
+
+static inline void process_block(bzs_ext_digest_t* digest_ptr, const bzs_ext_byte_t* block)
+{
+  if (digest_ptr->type == BZS_DIGEST_SHA256) {
+    process_sha256_block(digest_ptr->sha256_state, block);
+  } else {
+    process_xxh64_stripe(digest_ptr->xxh64_state, block);
+  }
+}
+
+void bzs_ext_digest_update(bzs_ext_digest_t* digest_ptr, const bzs_ext_byte_t* data, size_t data_length)
+{
+  if (digest_ptr->type == BZS_DIGEST_NONE) {
+    return;
+  }
+
+  size_t block_length = get_block_length(digest_ptr);
+
+  digest_ptr->length += data_length;
+
+  // Incomplete block should be filled before processing data directly.
+  if (digest_ptr->block_length != 0) {
+    size_t length = block_length - digest_ptr->block_length;
+    if (length > data_length) {
+      length = data_length;
+    }
+
+    memcpy(digest_ptr->block + digest_ptr->block_length, data, length);
+    digest_ptr->block_length += length;
+    data += length;
+    data_length -= length;
+
+    if (digest_ptr->block_length != block_length) {
+      return;
+    }
+
+    process_block(digest_ptr, digest_ptr->block);
+    digest_ptr->block_length = 0;
+  }
+
+  for (; data_length >= block_length; data += block_length, data_length -= block_length) {
+    process_block(digest_ptr, data);
+  }
+
+  memcpy(digest_ptr->block, data, data_length);
+  digest_ptr->block_length = data_length;
+}
+
+size_t bzs_ext_digest_get_result(const bzs_ext_digest_t* digest_ptr, bzs_ext_byte_t* result)
+{
+  switch (digest_ptr->type) {
+    case BZS_DIGEST_SHA256: {
+      // Padding changes state, so original digest can be updated later.
+      bzs_ext_digest_t digest = *digest_ptr;
+      return get_sha256_result(&digest, result);
+    }
+    case BZS_DIGEST_XXH64:
+      return get_xxh64_result(digest_ptr, result);
+    default:
+      return 0;
+  }
+}
+
+// -- values --
+
+bzs_ext_digest_type_t bzs_ext_resolve_digest_option_value(VALUE options, const char* name)
+{
+  VALUE raw_value = rb_funcall(options, rb_intern("[]"), 1, ID2SYM(rb_intern(name)));
+  if (raw_value == Qnil) {
+    return BZS_DIGEST_NONE;
+  }
+
+  Check_Type(raw_value, T_SYMBOL);
+
+  ID raw_id = SYM2ID(raw_value);
+
+  if (raw_id == rb_intern("sha256")) {
+    return BZS_DIGEST_SHA256;
+  } else if (raw_id == rb_intern("xxh64")) {
+    return BZS_DIGEST_XXH64;
+  }
+
+  bzs_ext_raise_error(BZS_EXT_ERROR_VALIDATE_FAILED);
+}
+
+static inline VALUE get_digest_value(const bzs_ext_digest_t* digest_ptr)
+{
+  static const char hex_digits[] = "0123456789abcdef";
+
+  bzs_ext_byte_t result[BZS_DIGEST_MAX_RESULT_LENGTH];
+  char           hex_result[BZS_DIGEST_MAX_RESULT_LENGTH * 2];
+
+  size_t result_length = bzs_ext_digest_get_result(digest_ptr, result);
+
+  for (size_t index = 0; index < result_length; index++) {
+    hex_result[index * 2]     = hex_digits[result[index] >> 4];
+    hex_result[index * 2 + 1] = hex_digits[result[index] & 0xf];
+  }
+
+  return rb_str_new(hex_result, result_length * 2);
+}
+
+VALUE bzs_ext_get_digests_value(
+  const bzs_ext_digest_t* source_digest_ptr, const bzs_ext_digest_t* destination_digest_ptr)
+{
+  VALUE digests = rb_hash_new();
+
+  rb_hash_aset(digests, ID2SYM(rb_intern("source")), get_digest_value(source_digest_ptr));
+  rb_hash_aset(digests, ID2SYM(rb_intern("destination")), get_digest_value(destination_digest_ptr));
+
+  return digests;
+}
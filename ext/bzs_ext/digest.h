@@ -0,0 +1,55 @@
+// Ruby bindings for bzip2 library.
+// Copyright (c) 2022 AUTHORS, MIT License.
+
+#if !defined(BZS_EXT_DIGEST_H)
+#define BZS_EXT_DIGEST_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "bzs_ext/common.h"
+#include "ruby.h"
+
+// Digest is updated by source and destination while they are passing through algorithm.
+// So digest of large file doesn't require another read of this file.
+
+#define BZS_DIGEST_NONE   0
+#define BZS_DIGEST_SHA256 1
+#define BZS_DIGEST_XXH64  2
+
+#define BZS_DIGEST_BLOCK_LENGTH      64
+#define BZS_DIGEST_MAX_RESULT_LENGTH 32
+
+typedef uint_fast8_t bzs_ext_digest_type_t;
+
+typedef struct
+{
+  bzs_ext_digest_type_t type;
+  uint64_t              length;
+  bzs_ext_byte_t        block[BZS_DIGEST_BLOCK_LENGTH];
+  size_t                block_length;
+  uint32_t              sha256_state[8];
+  uint64_t              xxh64_state[4];
+} bzs_ext_digest_t;
+
+void bzs_ext_init_digest(bzs_ext_digest_t* digest_ptr, bzs_ext_digest_type_t type);
+
+// Digest without type ignores data.
+void bzs_ext_digest_update(bzs_ext_digest_t* digest_ptr, const bzs_ext_byte_t* data, size_t data_length);
+
+// Digest can be updated after receiving result.
+size_t bzs_ext_digest_get_result(const bzs_ext_digest_t* digest_ptr, bzs_ext_byte_t* result);
+
+// -- values --
+
+// Option is a symbol (sha256 or xxh64), nil means none.
+bzs_ext_digest_type_t bzs_ext_resolve_digest_option_value(VALUE options, const char* name);
+
+#define BZS_EXT_RESOLVE_DIGEST_OPTION(options, name) \
+  bzs_ext_digest_type_t name = bzs_ext_resolve_digest_option_value(options, #name);
+
+// Returns hash with hex digests of source and destination.
+VALUE bzs_ext_get_digests_value(
+  const bzs_ext_digest_t* source_digest_ptr, const bzs_ext_digest_t* destination_digest_ptr);
+
+#endif // BZS_EXT_DIGEST_H
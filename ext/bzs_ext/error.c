@@ -21,42 +21,52 @@ bzs_ext_result_t bzs_ext_get_error(bzs_result_t error_code)
   }
 }
 
-static inline NORETURN(void raise_error(const char* name, const char* description))
+static inline VALUE new_error(const char* name, const char* description)
 {
-  VALUE module = rb_define_module(BZS_EXT_MODULE_NAME);
+  // Module is read without definition, so error can be created in any ractor.
+  VALUE module = rb_const_get(rb_cObject, rb_intern(BZS_EXT_MODULE_NAME));
   VALUE error  = rb_const_get(module, rb_intern(name));
-  rb_raise(error, "%s", description);
+  return rb_exc_new_cstr(error, description);
 }
 
-void bzs_ext_raise_error(bzs_ext_result_t ext_result)
+VALUE bzs_ext_new_error(bzs_ext_result_t ext_result)
 {
   switch (ext_result) {
     case BZS_EXT_ERROR_ALLOCATE_FAILED:
-      raise_error("AllocateError", "allocate error");
+      return new_error("AllocateError", "allocate error");
+    case BZS_EXT_ERROR_MEMORY_BUDGET_EXCEEDED:
+      return new_error("MemoryBudgetError", "memory budget exceeded");
     case BZS_EXT_ERROR_VALIDATE_FAILED:
-      raise_error("ValidateError", "validate error");
+      return new_error("ValidateError", "validate error");
 
     case BZS_EXT_ERROR_USED_AFTER_CLOSE:
-      raise_error("UsedAfterCloseError", "used after closed");
+      return new_error("UsedAfterCloseError", "used after closed");
     case BZS_EXT_ERROR_NOT_ENOUGH_SOURCE_BUFFER:
-      raise_error("NotEnoughSourceBufferError", "not enough source buffer");
+      return new_error("NotEnoughSourceBufferError", "not enough source buffer");
     case BZS_EXT_ERROR_NOT_ENOUGH_DESTINATION_BUFFER:
-      raise_error("NotEnoughDestinationBufferError", "not enough destination buffer");
+      return new_error("NotEnoughDestinationBufferError", "not enough destination buffer");
     case BZS_EXT_ERROR_DECOMPRESSOR_CORRUPTED_SOURCE:
-      raise_error("DecompressorCorruptedSourceError", "decompressor received corrupted source");
+      return new_error("DecompressorCorruptedSourceError", "decompressor received corrupted source");
+    case BZS_EXT_ERROR_DECOMPRESSOR_OUTPUT_LIMIT_EXCEEDED:
+      return new_error("DecompressorOutputLimitError", "decompressor output exceeded limit");
 
     case BZS_EXT_ERROR_ACCESS_IO:
-      raise_error("AccessIOError", "failed to access IO");
+      return new_error("AccessIOError", "failed to access IO");
     case BZS_EXT_ERROR_READ_IO:
-      raise_error("ReadIOError", "failed to read IO");
+      return new_error("ReadIOError", "failed to read IO");
     case BZS_EXT_ERROR_WRITE_IO:
-      raise_error("WriteIOError", "failed to write IO");
+      return new_error("WriteIOError", "failed to write IO");
 
     case BZS_EXT_ERROR_NOT_IMPLEMENTED:
-      raise_error("NotImplementedError", "not implemented error");
+      return new_error("NotImplementedError", "not implemented error");
 
     default:
       // BZS_EXT_ERROR_UNEXPECTED
-      raise_error("UnexpectedError", "unexpected error");
+      return new_error("UnexpectedError", "unexpected error");
   }
 }
+
+void bzs_ext_raise_error(bzs_ext_result_t ext_result)
+{
+  rb_exc_raise(bzs_ext_new_error(ext_result));
+}
@@ -12,12 +12,14 @@
 enum
 {
   BZS_EXT_ERROR_ALLOCATE_FAILED = 1,
+  BZS_EXT_ERROR_MEMORY_BUDGET_EXCEEDED,
   BZS_EXT_ERROR_VALIDATE_FAILED,
 
   BZS_EXT_ERROR_USED_AFTER_CLOSE,
   BZS_EXT_ERROR_NOT_ENOUGH_SOURCE_BUFFER,
   BZS_EXT_ERROR_NOT_ENOUGH_DESTINATION_BUFFER,
   BZS_EXT_ERROR_DECOMPRESSOR_CORRUPTED_SOURCE,
+  BZS_EXT_ERROR_DECOMPRESSOR_OUTPUT_LIMIT_EXCEEDED,
 
   BZS_EXT_ERROR_ACCESS_IO,
   BZS_EXT_ERROR_READ_IO,
@@ -29,6 +31,9 @@ enum
 
 bzs_ext_result_t bzs_ext_get_error(bzs_result_t error_code);
 
+// Creates error without raising it, it can be returned as result of independent operation.
+VALUE bzs_ext_new_error(bzs_ext_result_t ext_result);
+
 NORETURN(void bzs_ext_raise_error(bzs_ext_result_t ext_result));
 
 #endif // BZS_EXT_ERROR_H
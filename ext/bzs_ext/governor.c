@@ -0,0 +1,403 @@
+// Ruby bindings for bzip2 library.
+// Copyright (c) 2022 AUTHORS, MIT License.
+
+#include "bzs_ext/governor.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+
+#include "bzs_ext/error.h"
+#include "bzs_ext/gvl.h"
+#include "bzs_ext/macro.h"
+
+// Compressor uses 400 KB and 8 bytes for each byte of block.
+// Decompressor uses 100 KB and 4 bytes for each byte of block, 2.5 bytes in small mode.
+// Decompressor doesn't know block size before reading stream header, so max block size is used.
+#define COMPRESSOR_BASE_MEMORY   400000
+#define DECOMPRESSOR_BASE_MEMORY 100000
+
+typedef struct
+{
+  size_t id;
+  size_t streams_count;
+} holder_t;
+
+typedef struct
+{
+  size_t          budget;
+  int             policy;
+  size_t          size;
+  size_t          max_size;
+  size_t          reserved_size;
+  size_t          streams_count;
+  holder_t*       holders;
+  size_t          holders_count;
+  size_t          holders_capacity;
+  pthread_mutex_t mutex;
+  pthread_cond_t  released_condition;
+} governor_t;
+
+static governor_t governor = {
+  .budget             = BZS_DEFAULT_MEMORY_BUDGET,
+  .policy             = BZS_DEFAULT_MEMORY_POLICY,
+  .size               = 0,
+  .max_size           = 0,
+  .reserved_size      = 0,
+  .streams_count      = 0,
+  .holders            = NULL,
+  .holders_count      = 0,
+  .holders_capacity   = 0,
+  .mutex              = PTHREAD_MUTEX_INITIALIZER,
+  .released_condition = PTHREAD_COND_INITIALIZER};
+
+// -- memory --
+
+size_t bzs_ext_get_compressor_memory(bzs_ext_option_t block_size)
+{
+  return COMPRESSOR_BASE_MEMORY + (size_t) block_size * BZS_BLOCK_SIZE_UNIT * 8;
+}
+
+size_t bzs_ext_get_decompressor_memory(bzs_ext_option_t small)
+{
+  size_t block_length = (size_t) BZS_MAX_BLOCK_SIZE * BZS_BLOCK_SIZE_UNIT;
+
+  return DECOMPRESSOR_BASE_MEMORY + (small ? block_length * 5 / 2 : block_length * 4);
+}
+
+// -- size --
+
+void bzs_ext_governor_add_size(size_t size)
+{
+  pthread_mutex_lock(&governor.mutex);
+
+  governor.size += size;
+  if (governor.max_size < governor.size) {
+    governor.max_size = governor.size;
+  }
+
+  pthread_mutex_unlock(&governor.mutex);
+}
+
+void bzs_ext_governor_remove_size(size_t size)
+{
+  pthread_mutex_lock(&governor.mutex);
+  governor.size -= size;
+  pthread_mutex_unlock(&governor.mutex);
+}
+
+// -- holders --
+
+// Holders are used only to find thread which waits for itself, so holder which can't be added is ignored.
+// Object id is used as holder id, it is never reused unlike address of thread.
+
+static inline size_t get_current_holder(void)
+{
+  return NUM2SIZET(rb_obj_id(rb_thread_current()));
+}
+
+// Mutex should be locked.
+static inline holder_t* find_holder(size_t id)
+{
+  for (size_t index = 0; index < governor.holders_count; index++) {
+    if (governor.holders[index].id == id) {
+      return &governor.holders[index];
+    }
+  }
+
+  return NULL;
+}
+
+// Mutex should be locked.
+static inline void add_holder_stream(size_t id)
+{
+  holder_t* holder_ptr = find_holder(id);
+  if (holder_ptr != NULL) {
+    holder_ptr->streams_count++;
+    return;
+  }
+
+  if (governor.holders_count == governor.holders_capacity) {
+    size_t    holders_capacity = governor.holders_capacity != 0 ? governor.holders_capacity * 2 : 4;
+    holder_t* holders          = realloc(governor.holders, holders_capacity * sizeof(holder_t));
+    if (holders == NULL) {
+      return;
+    }
+
+    governor.holders          = holders;
+    governor.holders_capacity = holders_capacity;
+  }
+
+  governor.holders[governor.holders_count++] = (holder_t) {.id = id, .streams_count = 1};
+}
+
+// Mutex should be locked.
+static inline void remove_holder_stream(size_t id)
+{
+  holder_t* holder_ptr = find_holder(id);
+  if (holder_ptr == NULL) {
+    return;
+  }
+
+  if (--holder_ptr->streams_count == 0) {
+    *holder_ptr = governor.holders[--governor.holders_count];
+  }
+}
+
+// Mutex should be locked.
+static inline bool is_single_holder(size_t id)
+{
+  const holder_t* holder_ptr = find_holder(id);
+
+  return holder_ptr != NULL && holder_ptr->streams_count == governor.streams_count;
+}
+
+// -- reservation --
+
+typedef struct
+{
+  size_t size;
+  size_t downgraded_size;
+  size_t holder;
+  size_t reserved_size;
+  bool   is_interrupted;
+  bool   is_single_holder;
+} reserve_args_t;
+
+static inline bool is_fit(size_t size)
+{
+  return governor.budget == 0 || governor.streams_count == 0 || governor.reserved_size + size <= governor.budget;
+}
+
+// Mutex should be locked.
+static inline bool try_reserve(reserve_args_t* args)
+{
+  size_t size;
+
+  if (is_fit(args->size)) {
+    size = args->size;
+  } else if (
+    governor.policy == BZS_GOVERNOR_POLICY_DOWNGRADE && args->downgraded_size != 0 && is_fit(args->downgraded_size)) {
+    size = args->downgraded_size;
+  } else {
+    return false;
+  }
+
+  governor.reserved_size += size;
+  governor.streams_count++;
+  add_holder_stream(args->holder);
+
+  args->reserved_size = size;
+
+  return true;
+}
+
+#if defined(HAVE_RB_THREAD_CALL_WITHOUT_GVL)
+
+static void* wait_reservation(void* data)
+{
+  reserve_args_t* args = data;
+
+  pthread_mutex_lock(&governor.mutex);
+
+  while (!args->is_interrupted && !try_reserve(args)) {
+    // Only current thread can release memory, so waiting will never end.
+    if (is_single_holder(args->holder)) {
+      args->is_single_holder = true;
+      break;
+    }
+
+    pthread_cond_wait(&governor.released_condition, &governor.mutex);
+  }
+
+  pthread_mutex_unlock(&governor.mutex);
+
+  return NULL;
+}
+
+static void interrupt_reservation(void* data)
+{
+  reserve_args_t* args = data;
+
+  pthread_mutex_lock(&governor.mutex);
+  args->is_interrupted = true;
+  pthread_cond_broadcast(&governor.released_condition);
+  pthread_mutex_unlock(&governor.mutex);
+}
+
+#endif // HAVE_RB_THREAD_CALL_WITHOUT_GVL
+
+bzs_ext_result_t
+  bzs_ext_governor_reserve(size_t size, size_t downgraded_size, bzs_ext_reservation_t* reservation_ptr)
+{
+  reserve_args_t args = {
+    .size             = size,
+    .downgraded_size  = downgraded_size,
+    .holder           = get_current_holder(),
+    .reserved_size    = 0,
+    .is_interrupted   = false,
+    .is_single_holder = false};
+
+  pthread_mutex_lock(&governor.mutex);
+  bool is_reserved = try_reserve(&args);
+  int  policy      = governor.policy;
+  pthread_mutex_unlock(&governor.mutex);
+
+  if (!is_reserved && policy == BZS_GOVERNOR_POLICY_RAISE) {
+    return BZS_EXT_ERROR_MEMORY_BUDGET_EXCEEDED;
+  }
+
+  while (!is_reserved) {
+#if defined(HAVE_RB_THREAD_CALL_WITHOUT_GVL)
+    // Waiting thread can be interrupted by ruby, pending interrupt will be raised.
+    args.is_interrupted = false;
+    rb_thread_call_without_gvl(wait_reservation, &args, interrupt_reservation, &args);
+    rb_thread_check_ints();
+
+    if (args.is_single_holder) {
+      return BZS_EXT_ERROR_MEMORY_BUDGET_EXCEEDED;
+    }
+#else
+    // Other threads can't release memory while current thread holds GVL.
+    return BZS_EXT_ERROR_MEMORY_BUDGET_EXCEEDED;
+#endif
+
+    is_reserved = args.reserved_size != 0;
+  }
+
+  *reservation_ptr = (bzs_ext_reservation_t) {.size = args.reserved_size, .holder = args.holder};
+
+  return 0;
+}
+
+void bzs_ext_governor_release(bzs_ext_reservation_t reservation)
+{
+  if (reservation.size == 0) {
+    return;
+  }
+
+  pthread_mutex_lock(&governor.mutex);
+
+  governor.reserved_size -= reservation.size;
+  governor.streams_count--;
+  remove_holder_stream(reservation.holder);
+
+  pthread_cond_broadcast(&governor.released_condition);
+  pthread_mutex_unlock(&governor.mutex);
+}
+
+bzs_ext_result_t bzs_ext_governor_reserve_compressors(
+  bzs_ext_option_t block_size, size_t count, bzs_ext_reservation_t* reservation_ptr)
+{
+  // Memory depends on block size, so it should be validated before init.
+  if (block_size < BZS_MIN_BLOCK_SIZE || block_size > BZS_MAX_BLOCK_SIZE) {
+    return BZS_EXT_ERROR_VALIDATE_FAILED;
+  }
+
+  if (count == 0) {
+    *reservation_ptr = BZS_EXT_EMPTY_RESERVATION;
+    return 0;
+  }
+
+  return bzs_ext_governor_reserve(count * bzs_ext_get_compressor_memory(block_size), 0, reservation_ptr);
+}
+
+bzs_ext_result_t bzs_ext_governor_reserve_decompressors(
+  size_t count, bzs_ext_option_t* small_ptr, bzs_ext_reservation_t* reservation_ptr)
+{
+  if (count == 0) {
+    *reservation_ptr = BZS_EXT_EMPTY_RESERVATION;
+    return 0;
+  }
+
+  bzs_ext_option_t small           = *small_ptr;
+  size_t           size            = count * bzs_ext_get_decompressor_memory(small);
+  size_t           downgraded_size = small ? 0 : count * bzs_ext_get_decompressor_memory(true);
+
+  bzs_ext_result_t ext_result = bzs_ext_governor_reserve(size, downgraded_size, reservation_ptr);
+  if (ext_result != 0) {
+    return ext_result;
+  }
+
+  if (reservation_ptr->size != size) {
+    *small_ptr = true;
+  }
+
+  return 0;
+}
+
+// -- ruby --
+
+static inline int get_policy(VALUE policy)
+{
+  if (policy == Qnil) {
+    return BZS_DEFAULT_MEMORY_POLICY;
+  }
+
+  Check_Type(policy, T_SYMBOL);
+
+  ID policy_id = SYM2ID(policy);
+  if (policy_id == rb_intern("wait")) {
+    return BZS_GOVERNOR_POLICY_WAIT;
+  } else if (policy_id == rb_intern("downgrade")) {
+    return BZS_GOVERNOR_POLICY_DOWNGRADE;
+  } else if (policy_id == rb_intern("raise")) {
+    return BZS_GOVERNOR_POLICY_RAISE;
+  }
+
+  bzs_ext_raise_error(BZS_EXT_ERROR_VALIDATE_FAILED);
+}
+
+static inline VALUE get_policy_value(int policy)
+{
+  switch (policy) {
+    case BZS_GOVERNOR_POLICY_DOWNGRADE:
+      return ID2SYM(rb_intern("downgrade"));
+    case BZS_GOVERNOR_POLICY_RAISE:
+      return ID2SYM(rb_intern("raise"));
+    default:
+      return ID2SYM(rb_intern("wait"));
+  }
+}
+
+VALUE bzs_ext_configure_memory(VALUE BZS_EXT_UNUSED(self), VALUE options)
+{
+  Check_Type(options, T_HASH);
+  BZS_EXT_RESOLVE_SIZE_OPTION(options, budget, BZS_DEFAULT_MEMORY_BUDGET);
+
+  int policy = get_policy(rb_hash_aref(options, ID2SYM(rb_intern("policy"))));
+
+  pthread_mutex_lock(&governor.mutex);
+
+  governor.budget = budget;
+  governor.policy = policy;
+
+  // Waiting streams may fit into new budget.
+  pthread_cond_broadcast(&governor.released_condition);
+  pthread_mutex_unlock(&governor.mutex);
+
+  return Qnil;
+}
+
+VALUE bzs_ext_get_memory_usage(VALUE BZS_EXT_UNUSED(self))
+{
+  pthread_mutex_lock(&governor.mutex);
+  governor_t usage = governor;
+  pthread_mutex_unlock(&governor.mutex);
+
+  VALUE result = rb_hash_new();
+
+  rb_hash_aset(result, ID2SYM(rb_intern("budget")), SIZET2NUM(usage.budget));
+  rb_hash_aset(result, ID2SYM(rb_intern("policy")), get_policy_value(usage.policy));
+  rb_hash_aset(result, ID2SYM(rb_intern("size")), SIZET2NUM(usage.size));
+  rb_hash_aset(result, ID2SYM(rb_intern("max_size")), SIZET2NUM(usage.max_size));
+  rb_hash_aset(result, ID2SYM(rb_intern("reserved_size")), SIZET2NUM(usage.reserved_size));
+  rb_hash_aset(result, ID2SYM(rb_intern("streams_count")), SIZET2NUM(usage.streams_count));
+
+  return result;
+}
+
+void bzs_ext_governor_exports(VALUE root_module)
+{
+  rb_define_module_function(root_module, "_native_configure_memory", RUBY_METHOD_FUNC(bzs_ext_configure_memory), 1);
+  rb_define_module_function(root_module, "_native_memory_usage", RUBY_METHOD_FUNC(bzs_ext_get_memory_usage), 0);
+}
@@ -0,0 +1,66 @@
+// Ruby bindings for bzip2 library.
+// Copyright (c) 2022 AUTHORS, MIT License.
+
+#if !defined(BZS_EXT_GOVERNOR_H)
+#define BZS_EXT_GOVERNOR_H
+
+#include <stdlib.h>
+
+#include "bzs_ext/common.h"
+#include "bzs_ext/option.h"
+#include "ruby.h"
+
+// Governor limits memory of bzip2 streams in whole process.
+// Bzip2 decompressor allocates memory after reading stream header, so actual memory can't be checked before init.
+// Stream reserves estimated memory before init and releases it after end.
+// Allocator reports memory it really holds, so actual usage can be compared with reservations.
+// Single stream is always allowed, so budget smaller than one stream can't block forever.
+// Reservation is held by thread which made it, thread holding all reservations can't wait for itself.
+
+enum
+{
+  BZS_GOVERNOR_POLICY_WAIT = 0,
+  BZS_GOVERNOR_POLICY_DOWNGRADE,
+  BZS_GOVERNOR_POLICY_RAISE
+};
+
+// Zero budget means unlimited memory.
+#define BZS_DEFAULT_MEMORY_BUDGET 0
+#define BZS_DEFAULT_MEMORY_POLICY BZS_GOVERNOR_POLICY_WAIT
+
+// Bzip2 documentation provides memory usage for each block size.
+size_t bzs_ext_get_compressor_memory(bzs_ext_option_t block_size);
+size_t bzs_ext_get_decompressor_memory(bzs_ext_option_t small);
+
+void bzs_ext_governor_add_size(size_t size);
+void bzs_ext_governor_remove_size(size_t size);
+
+// Holder is a unique id of ruby thread, zero size means empty reservation.
+typedef struct
+{
+  size_t size;
+  size_t holder;
+} bzs_ext_reservation_t;
+
+#define BZS_EXT_EMPTY_RESERVATION ((bzs_ext_reservation_t) {.size = 0, .holder = 0})
+
+// Reservation requires GVL, it waits for released memory without GVL.
+// Downgraded size will be reserved instead of size for downgrade policy, zero means downgrade is not possible.
+// Budget exceeded error will be returned instead of waiting when current thread holds all reservations.
+bzs_ext_result_t
+     bzs_ext_governor_reserve(size_t size, size_t downgraded_size, bzs_ext_reservation_t* reservation_ptr);
+void bzs_ext_governor_release(bzs_ext_reservation_t reservation);
+
+// Count means streams which can be used at the same time by workers, zero count reserves nothing.
+// Decompressors will be downgraded into small mode when only downgraded memory can be reserved.
+bzs_ext_result_t bzs_ext_governor_reserve_compressors(
+  bzs_ext_option_t block_size, size_t count, bzs_ext_reservation_t* reservation_ptr);
+bzs_ext_result_t bzs_ext_governor_reserve_decompressors(
+  size_t count, bzs_ext_option_t* small_ptr, bzs_ext_reservation_t* reservation_ptr);
+
+VALUE bzs_ext_configure_memory(VALUE self, VALUE options);
+VALUE bzs_ext_get_memory_usage(VALUE self);
+
+void bzs_ext_governor_exports(VALUE root_module);
+
+#endif // BZS_EXT_GOVERNOR_H
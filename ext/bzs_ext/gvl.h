@@ -15,9 +15,20 @@
     rb_thread_call_without_gvl(function, (void*) data, RUBY_UBF_IO, NULL); \
   }
 
+// Wait on condition can't be unblocked by signal, interrupt function should wake waiting function.
+// Waiting function returns after interrupt, pending interrupt will be raised.
+#define BZS_EXT_GVL_WRAP_INTERRUPTIBLE(gvl, function, interrupt_function, data)           \
+  if (gvl) {                                                                              \
+    function((void*) data);                                                               \
+  } else {                                                                                \
+    rb_thread_call_without_gvl(function, (void*) data, interrupt_function, (void*) data); \
+    rb_thread_check_ints();                                                               \
+  }
+
 #else
 
 #define BZS_EXT_GVL_WRAP(_gvl, function, data) function((void*) data);
+#define BZS_EXT_GVL_WRAP_INTERRUPTIBLE(_gvl, function, _interrupt_function, data) function((void*) data);
 
 #endif // HAVE_RB_THREAD_CALL_WITHOUT_GVL
 
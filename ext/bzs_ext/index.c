@@ -0,0 +1,377 @@
+// Ruby bindings for bzip2 library.
+// Copyright (c) 2022 AUTHORS, MIT License.
+
+#include "bzs_ext/index.h"
+
+#include <bzlib.h>
+#include <string.h>
+
+#include "bzs_ext/block.h"
+#include "bzs_ext/crc.h"
+#include "bzs_ext/error.h"
+
+#define BZS_BLOCK_LENGTH_RESERVE     19
+#define BZS_MAX_RUN_LENGTH           255
+#define BZS_NO_RUN_BYTE              256
+#define BZS_INITIAL_EVENTS_CAPACITY  16
+#define BZS_INITIAL_RECORDS_CAPACITY (BZS_INDEX_RECORD_LENGTH * 64)
+
+// -- initialization --
+
+static inline void reset_stream(bzs_ext_index_t* index_ptr)
+{
+  index_ptr->block_length        = 0;
+  index_ptr->run_byte            = BZS_NO_RUN_BYTE;
+  index_ptr->run_length          = 0;
+  index_ptr->block_crc           = BZS_CRC_INIT;
+  index_ptr->stream_crc          = 0;
+  index_ptr->block_source_offset = index_ptr->source_offset;
+  index_ptr->is_stream_finished  = false;
+}
+
+bzs_ext_result_t bzs_ext_create_index(bzs_ext_index_t** index_ptr_ptr, bzs_ext_option_t block_size)
+{
+  bzs_ext_index_t* index_ptr = calloc(1, sizeof(bzs_ext_index_t));
+  if (index_ptr == NULL) {
+    return BZS_EXT_ERROR_ALLOCATE_FAILED;
+  }
+
+  // Compressor reserves space for last run in each block.
+  index_ptr->max_block_length   = (size_t) block_size * BZS_BLOCK_SIZE_UNIT - BZS_BLOCK_LENGTH_RESERVE;
+  index_ptr->is_stream_expected = true;
+
+  reset_stream(index_ptr);
+
+  *index_ptr_ptr = index_ptr;
+
+  return 0;
+}
+
+// -- events --
+
+static inline bzs_ext_result_t push_event(bzs_ext_index_t* index_ptr, char type, uint64_t source_offset, uint32_t crc)
+{
+  size_t last_event_index = index_ptr->first_event_index + index_ptr->events_count;
+
+  if (last_event_index == index_ptr->events_capacity) {
+    if (index_ptr->first_event_index != 0) {
+      memmove(
+        index_ptr->events,
+        index_ptr->events + index_ptr->first_event_index,
+        index_ptr->events_count * sizeof(bzs_ext_index_event_t));
+
+      index_ptr->first_event_index = 0;
+    } else {
+      size_t events_capacity =
+        index_ptr->events_capacity == 0 ? BZS_INITIAL_EVENTS_CAPACITY : index_ptr->events_capacity * 2;
+
+      bzs_ext_index_event_t* events = realloc(index_ptr->events, events_capacity * sizeof(bzs_ext_index_event_t));
+      if (events == NULL) {
+        return BZS_EXT_ERROR_ALLOCATE_FAILED;
+      }
+
+      index_ptr->events          = events;
+      index_ptr->events_capacity = events_capacity;
+    }
+
+    last_event_index = index_ptr->first_event_index + index_ptr->events_count;
+  }
+
+  bzs_ext_index_event_t* event_ptr = &index_ptr->events[last_event_index];
+  event_ptr->type                  = type;
+  event_ptr->source_offset         = source_offset;
+  event_ptr->crc                   = crc;
+
+  index_ptr->events_count++;
+
+  return 0;
+}
+
+static inline void shift_event(bzs_ext_index_t* index_ptr)
+{
+  index_ptr->first_event_index++;
+  index_ptr->events_count--;
+
+  if (index_ptr->events_count == 0) {
+    index_ptr->first_event_index = 0;
+  }
+}
+
+// -- source --
+
+// Source processing repeats bzip2 initial run length encoding, it defines block boundaries.
+
+static inline void add_run_to_block(bzs_ext_index_t* index_ptr)
+{
+  bzs_ext_byte_t byte = (bzs_ext_byte_t) index_ptr->run_byte;
+
+  for (uint32_t index = 0; index < index_ptr->run_length; index++) {
+    index_ptr->block_crc = bzs_ext_update_crc(index_ptr->block_crc, byte);
+  }
+
+  // Run with 4 or more bytes is stored as 4 bytes and length byte.
+  index_ptr->block_length += index_ptr->run_length < 4 ? index_ptr->run_length : 5;
+}
+
+static inline void add_byte(bzs_ext_index_t* index_ptr, bzs_ext_byte_t byte)
+{
+  if (byte != index_ptr->run_byte && index_ptr->run_length == 1) {
+    index_ptr->block_crc = bzs_ext_update_crc(index_ptr->block_crc, (bzs_ext_byte_t) index_ptr->run_byte);
+    index_ptr->block_length++;
+    index_ptr->run_byte = byte;
+  } else if (byte != index_ptr->run_byte || index_ptr->run_length == BZS_MAX_RUN_LENGTH) {
+    if (index_ptr->run_byte != BZS_NO_RUN_BYTE) {
+      add_run_to_block(index_ptr);
+    }
+
+    index_ptr->run_byte   = byte;
+    index_ptr->run_length = 1;
+  } else {
+    index_ptr->run_length++;
+  }
+}
+
+static inline bzs_ext_result_t finish_block(bzs_ext_index_t* index_ptr, uint64_t next_block_source_offset)
+{
+  uint32_t block_crc = ~index_ptr->block_crc;
+
+  bzs_ext_result_t ext_result =
+    push_event(index_ptr, BZS_INDEX_BLOCK_RECORD, index_ptr->block_source_offset, block_crc);
+  if (ext_result != 0) {
+    return ext_result;
+  }
+
+  index_ptr->stream_crc          = bzs_ext_combine_crc(index_ptr->stream_crc, block_crc);
+  index_ptr->block_length        = 0;
+  index_ptr->block_crc           = BZS_CRC_INIT;
+  index_ptr->block_source_offset = next_block_source_offset;
+
+  return 0;
+}
+
+static inline bzs_ext_result_t
+  append_source(bzs_ext_index_t* index_ptr, const bzs_ext_byte_t* source, size_t source_length, bool is_finishing)
+{
+  if (source_length == 0) {
+    return 0;
+  }
+
+  // Source after finish belongs to next stream.
+  if (index_ptr->is_stream_finished) {
+    reset_stream(index_ptr);
+  }
+
+  for (size_t index = 0; index < source_length; index++) {
+    add_byte(index_ptr, source[index]);
+    index_ptr->source_offset++;
+
+    // Finishing compressor includes last run into full block when all source is consumed.
+    if (index_ptr->block_length < index_ptr->max_block_length || (is_finishing && index == source_length - 1)) {
+      continue;
+    }
+
+    // Full block doesn't include current run, it will be added into next block.
+    bzs_ext_result_t ext_result = finish_block(index_ptr, index_ptr->source_offset - index_ptr->run_length);
+    if (ext_result != 0) {
+      return ext_result;
+    }
+  }
+
+  return 0;
+}
+
+bzs_ext_result_t bzs_ext_index_append_source(
+  bzs_ext_index_t*      index_ptr,
+  const bzs_ext_byte_t* source,
+  size_t                source_length)
+{
+  return append_source(index_ptr, source, source_length, false);
+}
+
+bzs_ext_result_t bzs_ext_index_flush_source(bzs_ext_index_t* index_ptr)
+{
+  if (index_ptr->is_stream_finished) {
+    return 0;
+  }
+
+  if (index_ptr->run_byte != BZS_NO_RUN_BYTE) {
+    add_run_to_block(index_ptr);
+
+    index_ptr->run_byte   = BZS_NO_RUN_BYTE;
+    index_ptr->run_length = 0;
+  }
+
+  // Compressor ignores empty block.
+  if (index_ptr->block_length == 0) {
+    return 0;
+  }
+
+  return finish_block(index_ptr, index_ptr->source_offset);
+}
+
+bzs_ext_result_t bzs_ext_index_finish_source(bzs_ext_index_t* index_ptr)
+{
+  if (index_ptr->is_stream_finished) {
+    return 0;
+  }
+
+  bzs_ext_result_t ext_result = bzs_ext_index_flush_source(index_ptr);
+  if (ext_result != 0) {
+    return ext_result;
+  }
+
+  ext_result = push_event(index_ptr, BZS_INDEX_END_RECORD, index_ptr->source_offset, index_ptr->stream_crc);
+  if (ext_result != 0) {
+    return ext_result;
+  }
+
+  index_ptr->is_stream_finished = true;
+
+  return 0;
+}
+
+bzs_ext_result_t bzs_ext_index_append_member(
+  bzs_ext_index_t*      index_ptr,
+  const bzs_ext_byte_t* source,
+  size_t                source_length)
+{
+  reset_stream(index_ptr);
+
+  bzs_ext_result_t ext_result = append_source(index_ptr, source, source_length, true);
+  if (ext_result != 0) {
+    return ext_result;
+  }
+
+  return bzs_ext_index_finish_source(index_ptr);
+}
+
+// -- destination --
+
+static inline bzs_ext_result_t
+  add_record(bzs_ext_index_t* index_ptr, char type, uint64_t source_offset, uint64_t destination_bit_offset)
+{
+  if (index_ptr->records_length + BZS_INDEX_RECORD_LENGTH > index_ptr->records_capacity) {
+    size_t records_capacity =
+      index_ptr->records_capacity == 0 ? BZS_INITIAL_RECORDS_CAPACITY : index_ptr->records_capacity * 2;
+
+    bzs_ext_byte_t* records = realloc(index_ptr->records, records_capacity);
+    if (records == NULL) {
+      return BZS_EXT_ERROR_ALLOCATE_FAILED;
+    }
+
+    index_ptr->records          = records;
+    index_ptr->records_capacity = records_capacity;
+  }
+
+  bzs_ext_byte_t* record = index_ptr->records + index_ptr->records_length;
+  record[0]              = (bzs_ext_byte_t) type;
+
+  for (size_t index = 0; index < 8; index++) {
+    record[1 + index] = (bzs_ext_byte_t) (source_offset >> (index * 8));
+    record[9 + index] = (bzs_ext_byte_t) (destination_bit_offset >> (index * 8));
+  }
+
+  index_ptr->records_length += BZS_INDEX_RECORD_LENGTH;
+
+  return 0;
+}
+
+static inline bool is_event_found(const bzs_ext_index_t* index_ptr, const bzs_ext_index_event_t* event_ptr)
+{
+  uint64_t magic = event_ptr->type == BZS_INDEX_BLOCK_RECORD ? BZS_BLOCK_MAGIC : BZS_END_MAGIC;
+
+  return index_ptr->magic_bits == magic && index_ptr->crc_bits == event_ptr->crc;
+}
+
+bzs_ext_result_t bzs_ext_index_append_destination(
+  bzs_ext_index_t*      index_ptr,
+  const bzs_ext_byte_t* destination,
+  size_t                destination_length)
+{
+  bzs_ext_result_t ext_result;
+
+  for (size_t index = 0; index < destination_length; index++) {
+    if (index_ptr->is_stream_expected) {
+      // Each stream starts from new byte.
+      ext_result = add_record(
+        index_ptr, BZS_INDEX_STREAM_RECORD, index_ptr->stream_source_offset, index_ptr->destination_bits_count);
+      if (ext_result != 0) {
+        return ext_result;
+      }
+
+      index_ptr->is_stream_expected = false;
+    }
+
+    bzs_ext_byte_t byte = destination[index];
+
+    for (int bit_index = 7; bit_index >= 0; bit_index--) {
+      // Magic (48 bits) is followed by CRC (32 bits).
+      index_ptr->magic_bits = ((index_ptr->magic_bits << 1) | (index_ptr->crc_bits >> 31)) & BZS_MAGIC_MASK;
+      index_ptr->crc_bits   = (index_ptr->crc_bits << 1) | ((byte >> bit_index) & 1);
+      index_ptr->destination_bits_count++;
+
+      if (index_ptr->events_count == 0) {
+        continue;
+      }
+
+      const bzs_ext_index_event_t* event_ptr = &index_ptr->events[index_ptr->first_event_index];
+      if (!is_event_found(index_ptr, event_ptr)) {
+        continue;
+      }
+
+      ext_result = add_record(
+        index_ptr,
+        event_ptr->type,
+        event_ptr->source_offset,
+        index_ptr->destination_bits_count - BZS_MAGIC_WITH_CRC_BITS);
+      if (ext_result != 0) {
+        return ext_result;
+      }
+
+      if (event_ptr->type == BZS_INDEX_END_RECORD) {
+        index_ptr->stream_source_offset = event_ptr->source_offset;
+        index_ptr->is_stream_expected   = true;
+      }
+
+      shift_event(index_ptr);
+    }
+  }
+
+  return 0;
+}
+
+bzs_ext_result_t bzs_ext_index_update(
+  bzs_ext_index_t*      index_ptr,
+  int                   stream_action,
+  const bzs_ext_byte_t* source,
+  size_t                source_length,
+  const bzs_ext_byte_t* destination,
+  size_t                destination_length)
+{
+  bzs_ext_result_t ext_result = bzs_ext_index_append_source(index_ptr, source, source_length);
+  if (ext_result != 0) {
+    return ext_result;
+  }
+
+  // Flush and finish are used without source.
+  if (stream_action == BZ_FLUSH) {
+    ext_result = bzs_ext_index_flush_source(index_ptr);
+  } else if (stream_action == BZ_FINISH) {
+    ext_result = bzs_ext_index_finish_source(index_ptr);
+  }
+
+  if (ext_result != 0) {
+    return ext_result;
+  }
+
+  return bzs_ext_index_append_destination(index_ptr, destination, destination_length);
+}
+
+// -- cleanup --
+
+void bzs_ext_destroy_index(bzs_ext_index_t* index_ptr)
+{
+  free(index_ptr->events);
+  free(index_ptr->records);
+  free(index_ptr);
+}
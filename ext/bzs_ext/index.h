@@ -0,0 +1,94 @@
+// Ruby bindings for bzip2 library.
+// Copyright (c) 2022 AUTHORS, MIT License.
+
+#if !defined(BZS_EXT_INDEX_H)
+#define BZS_EXT_INDEX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "bzs_ext/common.h"
+#include "bzs_ext/option.h"
+
+// Index contains uncompressed offset and compressed bit offset of each stream and block boundary.
+// Bzip2 library doesn't provide block boundaries, so index repeats block filling for consumed source
+//   and finds block and stream magics followed by expected CRC in compressed destination.
+// Each record is a record type followed by uncompressed offset and compressed bit offset (little endian 64 bit).
+
+#define BZS_INDEX_STREAM_RECORD 'S'
+#define BZS_INDEX_BLOCK_RECORD  'B'
+#define BZS_INDEX_END_RECORD    'E'
+#define BZS_INDEX_RECORD_LENGTH 17
+
+typedef struct
+{
+  char     type;
+  uint64_t source_offset;
+  uint32_t crc;
+} bzs_ext_index_event_t;
+
+typedef struct
+{
+  // Source.
+  size_t   max_block_length;
+  size_t   block_length;
+  uint32_t run_byte;
+  uint32_t run_length;
+  uint32_t block_crc;
+  uint32_t stream_crc;
+  uint64_t source_offset;
+  uint64_t block_source_offset;
+  bool     is_stream_finished;
+
+  // Source events waiting for destination.
+  bzs_ext_index_event_t* events;
+  size_t                 first_event_index;
+  size_t                 events_count;
+  size_t                 events_capacity;
+
+  // Destination.
+  uint64_t magic_bits;
+  uint32_t crc_bits;
+  uint64_t destination_bits_count;
+  uint64_t stream_source_offset;
+  bool     is_stream_expected;
+
+  bzs_ext_byte_t* records;
+  size_t          records_length;
+  size_t          records_capacity;
+} bzs_ext_index_t;
+
+bzs_ext_result_t bzs_ext_create_index(bzs_ext_index_t** index_ptr_ptr, bzs_ext_option_t block_size);
+
+// Source should be provided in the same order and with the same portions as for compressor.
+bzs_ext_result_t bzs_ext_index_append_source(
+  bzs_ext_index_t*      index_ptr,
+  const bzs_ext_byte_t* source,
+  size_t                source_length);
+bzs_ext_result_t bzs_ext_index_flush_source(bzs_ext_index_t* index_ptr);
+bzs_ext_result_t bzs_ext_index_finish_source(bzs_ext_index_t* index_ptr);
+
+// Member is a whole stream compressed by single finish, index should receive members only.
+bzs_ext_result_t bzs_ext_index_append_member(
+  bzs_ext_index_t*      index_ptr,
+  const bzs_ext_byte_t* source,
+  size_t                source_length);
+
+bzs_ext_result_t bzs_ext_index_append_destination(
+  bzs_ext_index_t*      index_ptr,
+  const bzs_ext_byte_t* destination,
+  size_t                destination_length);
+
+// Appends consumed source and produced destination after single compressor call with provided action.
+bzs_ext_result_t bzs_ext_index_update(
+  bzs_ext_index_t*      index_ptr,
+  int                   stream_action,
+  const bzs_ext_byte_t* source,
+  size_t                source_length,
+  const bzs_ext_byte_t* destination,
+  size_t                destination_length);
+
+void bzs_ext_destroy_index(bzs_ext_index_t* index_ptr);
+
+#endif // BZS_EXT_INDEX_H
@@ -4,28 +4,48 @@
 #include "bzs_ext/io.h"
 
 #include <bzlib.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include "bzs_ext/allocator.h"
+#include "bzs_ext/block.h"
 #include "bzs_ext/buffer.h"
+#include "bzs_ext/cache.h"
+#include "bzs_ext/crc.h"
+#include "bzs_ext/digest.h"
 #include "bzs_ext/error.h"
+#include "bzs_ext/governor.h"
 #include "bzs_ext/gvl.h"
+#include "bzs_ext/index.h"
+#include "bzs_ext/limit.h"
+#include "bzs_ext/line.h"
 #include "bzs_ext/macro.h"
 #include "bzs_ext/option.h"
+#include "bzs_ext/parallel.h"
+#include "bzs_ext/pattern.h"
+#include "bzs_ext/pool.h"
+#include "bzs_ext/recompress.h"
+#include "bzs_ext/uring.h"
 #include "bzs_ext/utils.h"
 #include "ruby/io.h"
 
 // Additional possible results:
 enum
 {
-  BZS_EXT_FILE_READ_FINISHED = 128
+  BZS_EXT_FILE_READ_FINISHED = 128,
+  BZS_EXT_IO_EXCEPTION_RAISED
 };
 
 // -- file --
 
 static inline bzs_ext_result_t
-  read_file(FILE* source_file, bzs_ext_byte_t* source_buffer, size_t* source_length_ptr, size_t source_buffer_length)
+  read_file(void* data, bzs_ext_byte_t* source_buffer, size_t* source_length_ptr, size_t source_buffer_length)
 {
+  FILE*  source_file = data;
   size_t read_length = fread(source_buffer, 1, source_buffer_length, source_file);
   if (read_length == 0 && feof(source_file)) {
     return BZS_EXT_FILE_READ_FINISHED;
@@ -41,8 +61,9 @@ static inline bzs_ext_result_t
 }
 
 static inline bzs_ext_result_t
-  write_file(FILE* destination_file, bzs_ext_byte_t* destination_buffer, size_t destination_length)
+  write_file(void* data, const bzs_ext_byte_t* destination_buffer, size_t destination_length)
 {
+  FILE*  destination_file = data;
   size_t written_length = fwrite(destination_buffer, 1, destination_length, destination_file);
   if (written_length != destination_length) {
     return BZS_EXT_ERROR_WRITE_IO;
@@ -51,6 +72,61 @@ static inline bzs_ext_result_t
   return 0;
 }
 
+// -- writer --
+
+// Writer receives destination written by algorithm, it writes file by default.
+
+typedef bzs_ext_result_t (*write_function_t)(void* data, const bzs_ext_byte_t* destination, size_t destination_length);
+
+typedef struct
+{
+  write_function_t function;
+  void*            data;
+} writer_t;
+
+// -- reader --
+
+// Reader provides source for algorithm, it reads file by default.
+
+typedef bzs_ext_result_t (*read_function_t)(
+  void* data, bzs_ext_byte_t* source_buffer, size_t* source_length_ptr, size_t source_buffer_length);
+
+typedef struct
+{
+  read_function_t function;
+  void*           data;
+} reader_t;
+
+// Limited reader counts received source for decompressor ratio limit.
+// It finishes reading when decompressor has already provided prefix.
+
+typedef struct
+{
+  reader_t*        reader_ptr;
+  bzs_ext_limit_t* limit_ptr;
+} limited_reader_t;
+
+static bzs_ext_result_t
+  read_limited(void* data, bzs_ext_byte_t* source_buffer, size_t* source_length_ptr, size_t source_buffer_length)
+{
+  limited_reader_t* limited_reader_ptr = data;
+  reader_t*         reader_ptr         = limited_reader_ptr->reader_ptr;
+
+  if (bzs_ext_limit_is_prefix_finished(limited_reader_ptr->limit_ptr)) {
+    return BZS_EXT_FILE_READ_FINISHED;
+  }
+
+  bzs_ext_result_t ext_result =
+    reader_ptr->function(reader_ptr->data, source_buffer, source_length_ptr, source_buffer_length);
+  if (ext_result != 0) {
+    return ext_result;
+  }
+
+  bzs_ext_limit_add_source(limited_reader_ptr->limit_ptr, *source_length_ptr);
+
+  return 0;
+}
+
 // -- buffer --
 
 static inline bzs_ext_result_t create_buffers(
@@ -83,7 +159,7 @@ static inline bzs_ext_result_t create_buffers(
 // Algorithm can use same buffer again.
 
 static inline bzs_ext_result_t read_more_source(
-  FILE*                  source_file,
+  reader_t*              reader_ptr,
   const bzs_ext_byte_t** source_ptr,
   size_t*                source_length_ptr,
   bzs_ext_byte_t*        source_buffer,
@@ -110,8 +186,8 @@ static inline bzs_ext_result_t read_more_source(
   bzs_ext_byte_t* remaining_source_buffer = source_buffer + source_length;
   size_t          new_source_length;
 
-  bzs_ext_result_t ext_result =
-    read_file(source_file, remaining_source_buffer, &new_source_length, remaining_source_buffer_length);
+  bzs_ext_result_t ext_result = reader_ptr->function(
+    reader_ptr->data, remaining_source_buffer, &new_source_length, remaining_source_buffer_length);
 
   if (ext_result != 0) {
     return ext_result;
@@ -127,7 +203,7 @@ static inline bzs_ext_result_t read_more_source(
     bool is_function_called = false;                                                                            \
                                                                                                                 \
     while (true) {                                                                                              \
-      ext_result = read_more_source(source_file, &source, &source_length, source_buffer, source_buffer_length); \
+      ext_result = read_more_source(reader_ptr, &source, &source_length, source_buffer, source_buffer_length);  \
       if (ext_result == BZS_EXT_FILE_READ_FINISHED) {                                                           \
         break;                                                                                                  \
       } else if (ext_result != 0) {                                                                             \
@@ -152,11 +228,11 @@ static inline bzs_ext_result_t read_more_source(
   } while (false);
 
 // Algorithm has written data into destination buffer.
-// We need to write this data into file.
+// We need to provide this data to writer.
 // Than algorithm can use same buffer again.
 
 static inline bzs_ext_result_t flush_destination_buffer(
-  FILE*           destination_file,
+  writer_t*       writer_ptr,
   bzs_ext_byte_t* destination_buffer,
   size_t*         destination_length_ptr,
   size_t          destination_buffer_length)
@@ -166,7 +242,7 @@ static inline bzs_ext_result_t flush_destination_buffer(
     return BZS_EXT_ERROR_NOT_ENOUGH_DESTINATION_BUFFER;
   }
 
-  bzs_ext_result_t ext_result = write_file(destination_file, destination_buffer, *destination_length_ptr);
+  bzs_ext_result_t ext_result = writer_ptr->function(writer_ptr->data, destination_buffer, *destination_length_ptr);
   if (ext_result != 0) {
     return ext_result;
   }
@@ -177,13 +253,13 @@ static inline bzs_ext_result_t flush_destination_buffer(
 }
 
 static inline bzs_ext_result_t
-  write_remaining_destination(FILE* destination_file, bzs_ext_byte_t* destination_buffer, size_t destination_length)
+  write_remaining_destination(writer_t* writer_ptr, bzs_ext_byte_t* destination_buffer, size_t destination_length)
 {
   if (destination_length == 0) {
     return 0;
   }
 
-  return write_file(destination_file, destination_buffer, destination_length);
+  return writer_ptr->function(writer_ptr->data, destination_buffer, destination_length);
 }
 
 // -- utils --
@@ -199,382 +275,2913 @@ static inline bzs_ext_result_t
     bzs_ext_raise_error(BZS_EXT_ERROR_ACCESS_IO);      \
   }
 
-// -- buffered compress --
+// -- io --
+
+// Ruby IO with file descriptor (file, pipe or socket) is read and written natively.
+// Descriptor can be nonblocking, current thread waits for it like ruby IO does.
+// Other objects should respond to "read" or "write", each call receives whole buffer.
+// Ruby exception can't be raised before resources will be released, so it is stored and raised later.
+// Digest receives bytes read from source or written into destination.
 
 typedef struct
 {
-  bz_stream*       stream_ptr;
-  int              stream_action;
-  bzs_ext_byte_t** remaining_source_ptr;
-  size_t*          remaining_source_length_ptr;
-  bzs_ext_byte_t*  remaining_destination_buffer;
-  size_t*          remaining_destination_buffer_length_ptr;
-  bzs_result_t     result;
-} compress_args_t;
-
-static inline void* compress_wrapper(void* data)
+  VALUE            io;
+  int              fd;
+  bool             gvl;
+  int              exception;
+  bzs_ext_cache_t  cache;
+  bzs_ext_digest_t digest;
+} io_t;
+
+static inline void init_io(io_t* io_ptr, VALUE io, bool is_source, bool gvl)
 {
-  compress_args_t* args = data;
+  if (!is_source && RB_TYPE_P(io, T_FILE)) {
+    // Duplex IO (popen) writes into separate IO.
+    io = rb_io_get_write_io(io);
+  }
 
-  args->stream_ptr->next_in   = (char*) *args->remaining_source_ptr;
-  args->stream_ptr->avail_in  = bzs_consume_size(*args->remaining_source_length_ptr);
-  args->stream_ptr->next_out  = (char*) args->remaining_destination_buffer;
-  args->stream_ptr->avail_out = bzs_consume_size(*args->remaining_destination_buffer_length_ptr);
+  io_ptr->io        = io;
+  io_ptr->fd        = -1;
+  io_ptr->gvl       = gvl;
+  io_ptr->exception = 0;
 
-  args->result = BZ2_bzCompress(args->stream_ptr, args->stream_action);
+  // Cache and digest are enabled by file options.
+  bzs_ext_init_cache(&io_ptr->cache, -1, !is_source, false, 0);
+  bzs_ext_init_digest(&io_ptr->digest, BZS_DIGEST_NONE);
 
-  *args->remaining_source_ptr                    = (bzs_ext_byte_t*) args->stream_ptr->next_in;
-  *args->remaining_source_length_ptr             = args->stream_ptr->avail_in;
-  *args->remaining_destination_buffer_length_ptr = args->stream_ptr->avail_out;
+  if (!RB_TYPE_P(io, T_FILE)) {
+    if (!rb_respond_to(io, rb_intern(is_source ? "read" : "write"))) {
+      Check_Type(io, T_FILE);
+    }
 
-  return NULL;
+    return;
+  }
+
+  rb_io_t* io_fptr;
+  GetOpenFile(io, io_fptr);
+
+  if (is_source) {
+    rb_io_check_readable(io_fptr);
+
+    // Source buffered by ruby is not available from descriptor.
+    if (rb_io_read_pending(io_fptr)) {
+      return;
+    }
+  } else {
+    rb_io_check_writable(io_fptr);
+
+    // Destination buffered by ruby should be written before native destination.
+    rb_io_flush(io);
+  }
+
+#if defined(HAVE_RB_IO_DESCRIPTOR)
+  io_ptr->fd = rb_io_descriptor(io);
+#else
+  io_ptr->fd = io_fptr->fd;
+#endif
 }
 
-#define BUFFERED_COMPRESS(gvl, args, RUN_OK)                                                                        \
-  bzs_ext_result_t ext_result;                                                                                      \
-                                                                                                                    \
-  while (true) {                                                                                                    \
-    bzs_ext_byte_t* remaining_destination_buffer             = destination_buffer + *destination_length_ptr;        \
-    size_t          remaining_destination_buffer_length      = destination_buffer_length - *destination_length_ptr; \
-    size_t          prev_remaining_destination_buffer_length = remaining_destination_buffer_length;                 \
-                                                                                                                    \
-    args.remaining_destination_buffer            = remaining_destination_buffer;                                    \
-    args.remaining_destination_buffer_length_ptr = &remaining_destination_buffer_length;                            \
-                                                                                                                    \
-    BZS_EXT_GVL_WRAP(gvl, compress_wrapper, &args);                                                                 \
-    if (args.result != RUN_OK && args.result != BZ_PARAM_ERROR && args.result != BZ_STREAM_END) {                   \
-      return bzs_ext_get_error(args.result);                                                                        \
-    }                                                                                                               \
-                                                                                                                    \
-    *destination_length_ptr += prev_remaining_destination_buffer_length - remaining_destination_buffer_length;      \
-                                                                                                                    \
-    if (args.result == BZ_STREAM_END) {                                                                             \
-      break;                                                                                                        \
-    }                                                                                                               \
-                                                                                                                    \
-    if (*args.remaining_source_length_ptr != 0 || remaining_destination_buffer_length == 0) {                       \
-      ext_result = flush_destination_buffer(                                                                        \
-        destination_file, destination_buffer, destination_length_ptr, destination_buffer_length);                   \
-                                                                                                                    \
-      if (ext_result != 0) {                                                                                        \
-        return ext_result;                                                                                          \
-      }                                                                                                             \
-                                                                                                                    \
-      continue;                                                                                                     \
-    }                                                                                                               \
-                                                                                                                    \
-    break;                                                                                                          \
-  }                                                                                                                 \
-                                                                                                                    \
-  return 0;
+NORETURN(static void raise_io_error(
+  bzs_ext_result_t ext_result, const io_t* source_io_ptr, const io_t* destination_io_ptr));
 
-static inline bzs_ext_result_t buffered_compress(
-  bz_stream*             stream_ptr,
-  const bzs_ext_byte_t** source_ptr,
-  size_t*                source_length_ptr,
-  FILE*                  destination_file,
-  bzs_ext_byte_t*        destination_buffer,
-  size_t*                destination_length_ptr,
-  size_t                 destination_buffer_length,
-  bool                   gvl)
+static void raise_io_error(bzs_ext_result_t ext_result, const io_t* source_io_ptr, const io_t* destination_io_ptr)
 {
-  compress_args_t run_args = {
-    .stream_ptr                  = stream_ptr,
-    .stream_action               = BZ_RUN,
-    .remaining_source_ptr        = (bzs_ext_byte_t**) source_ptr,
-    .remaining_source_length_ptr = source_length_ptr};
-  BUFFERED_COMPRESS(gvl, run_args, BZ_RUN_OK);
+  if (ext_result == BZS_EXT_IO_EXCEPTION_RAISED) {
+    rb_jump_tag(source_io_ptr->exception != 0 ? source_io_ptr->exception : destination_io_ptr->exception);
+  }
+
+  bzs_ext_raise_error(ext_result);
 }
 
-// -- buffered compressor finish --
+// -- io digest --
 
-static inline bzs_ext_result_t buffered_compressor_finish(
-  bz_stream*      stream_ptr,
-  FILE*           destination_file,
-  bzs_ext_byte_t* destination_buffer,
-  size_t*         destination_length_ptr,
-  size_t          destination_buffer_length,
-  bool            gvl)
+static inline void init_digests(io_t* source_io_ptr, io_t* destination_io_ptr, bzs_ext_digest_type_t digest)
 {
-  bzs_ext_byte_t* remaining_source        = NULL;
-  size_t          remaining_source_length = 0;
+  bzs_ext_init_digest(&source_io_ptr->digest, digest);
+  bzs_ext_init_digest(&destination_io_ptr->digest, digest);
+}
 
-  compress_args_t finish_args = {
-    .stream_ptr                  = stream_ptr,
-    .stream_action               = BZ_FINISH,
-    .remaining_source_ptr        = &remaining_source,
-    .remaining_source_length_ptr = &remaining_source_length};
-  BUFFERED_COMPRESS(gvl, finish_args, BZ_FINISH_OK);
+// Returns hash with source and destination digests, nil means digests are disabled.
+static inline VALUE get_digests_value(const io_t* source_io_ptr, const io_t* destination_io_ptr)
+{
+  if (source_io_ptr->digest.type == BZS_DIGEST_NONE) {
+    return Qnil;
+  }
+
+  return bzs_ext_get_digests_value(&source_io_ptr->digest, &destination_io_ptr->digest);
 }
 
-// -- compress --
+// -- io cache --
 
-static inline bzs_ext_result_t compress(
-  bz_stream*      stream_ptr,
-  FILE*           source_file,
-  bzs_ext_byte_t* source_buffer,
-  size_t          source_buffer_length,
-  FILE*           destination_file,
-  bzs_ext_byte_t* destination_buffer,
-  size_t          destination_buffer_length,
-  bool            gvl)
+typedef struct
 {
-  bzs_ext_result_t      ext_result;
-  const bzs_ext_byte_t* source             = source_buffer;
-  size_t                source_length      = 0;
-  size_t                destination_length = 0;
-
-  BUFFERED_READ_SOURCE(
-    buffered_compress,
-    stream_ptr,
-    &source,
-    &source_length,
-    destination_file,
-    destination_buffer,
-    &destination_length,
-    destination_buffer_length,
-    gvl);
+  bzs_ext_cache_t* cache_ptr;
+  size_t           length;
+} add_cache_args_t;
 
-  ext_result = buffered_compressor_finish(
-    stream_ptr, destination_file, destination_buffer, &destination_length, destination_buffer_length, gvl);
+static inline void* add_cache_wrapper(void* data)
+{
+  add_cache_args_t* args = data;
 
-  if (ext_result != 0) {
-    return ext_result;
-  }
+  bzs_ext_cache_add(args->cache_ptr, args->length);
 
-  return write_remaining_destination(destination_file, destination_buffer, destination_length);
+  return NULL;
 }
 
-VALUE bzs_ext_compress_io(VALUE BZS_EXT_UNUSED(self), VALUE source, VALUE destination, VALUE options)
+static inline void add_cache(io_t* io_ptr, size_t length)
 {
-  GET_FILE(source);
-  GET_FILE(destination);
-  Check_Type(options, T_HASH);
-  BZS_EXT_GET_SIZE_OPTION(options, source_buffer_length);
-  BZS_EXT_GET_SIZE_OPTION(options, destination_buffer_length);
-  BZS_EXT_GET_BOOL_OPTION(options, gvl);
-  BZS_EXT_RESOLVE_COMPRESSOR_OPTIONS(options);
+  if (io_ptr->cache.fd < 0) {
+    return;
+  }
 
-  bz_stream stream = {
-    .bzalloc = NULL,
-    .bzfree  = NULL,
-    .opaque  = NULL,
-  };
+  // Destination can wait for writeback.
+  add_cache_args_t args = {.cache_ptr = &io_ptr->cache, .length = length};
 
-  bzs_result_t result = BZ2_bzCompressInit(&stream, block_size, verbosity, work_factor);
-  if (result != BZ_OK) {
-    bzs_ext_raise_error(bzs_ext_get_error(result));
-  }
+  BZS_EXT_GVL_WRAP(io_ptr->gvl, add_cache_wrapper, &args);
+}
 
-  if (source_buffer_length == 0) {
-    source_buffer_length = BZS_DEFAULT_SOURCE_BUFFER_LENGTH_FOR_COMPRESSOR;
-  }
-  if (destination_buffer_length == 0) {
-    destination_buffer_length = BZS_DEFAULT_DESTINATION_BUFFER_LENGTH_FOR_COMPRESSOR;
-  }
+typedef struct
+{
+  io_t*            source_io_ptr;
+  io_t*            destination_io_ptr;
+  bzs_ext_result_t ext_result;
+} finish_caches_args_t;
 
-  bzs_ext_byte_t* source_buffer;
-  bzs_ext_byte_t* destination_buffer;
+static inline void* finish_caches_wrapper(void* data)
+{
+  finish_caches_args_t* args = data;
 
-  bzs_ext_result_t ext_result =
-    create_buffers(&source_buffer, source_buffer_length, &destination_buffer, destination_buffer_length);
-  if (ext_result != 0) {
-    BZ2_bzCompressEnd(&stream);
-    bzs_ext_raise_error(ext_result);
-  }
+  bzs_ext_result_t source_ext_result      = bzs_ext_finish_cache(&args->source_io_ptr->cache);
+  bzs_ext_result_t destination_ext_result = bzs_ext_finish_cache(&args->destination_io_ptr->cache);
 
-  ext_result = compress(
-    &stream,
-    source_file,
-    source_buffer,
-    source_buffer_length,
-    destination_file,
-    destination_buffer,
-    destination_buffer_length,
-    gvl);
+  args->ext_result = source_ext_result != 0 ? source_ext_result : destination_ext_result;
 
-  free(source_buffer);
-  free(destination_buffer);
-  BZ2_bzCompressEnd(&stream);
+  return NULL;
+}
 
-  if (ext_result != 0) {
-    bzs_ext_raise_error(ext_result);
-  }
+static inline void init_caches(io_t* source_io_ptr, io_t* destination_io_ptr, bool drop_cache, size_t preallocate)
+{
+  bzs_ext_init_cache(&source_io_ptr->cache, source_io_ptr->fd, false, drop_cache, 0);
+  bzs_ext_init_cache(&destination_io_ptr->cache, destination_io_ptr->fd, true, drop_cache, preallocate);
+}
 
-  // Ruby itself won't flush stdio file before closing fd, flush is required.
-  fflush(destination_file);
+// Previous error has priority.
+static inline bzs_ext_result_t
+  finish_caches(io_t* source_io_ptr, io_t* destination_io_ptr, bzs_ext_result_t ext_result, bool gvl)
+{
+  finish_caches_args_t args = {
+    .source_io_ptr = source_io_ptr, .destination_io_ptr = destination_io_ptr, .ext_result = 0};
 
-  return Qnil;
+  BZS_EXT_GVL_WRAP(gvl, finish_caches_wrapper, &args);
+
+  return ext_result != 0 ? ext_result : args.ext_result;
 }
 
-// -- buffered decompress --
+// -- io wait --
 
 typedef struct
 {
-  bz_stream*       stream_ptr;
-  bzs_ext_byte_t** remaining_source_ptr;
-  size_t*          remaining_source_length_ptr;
-  bzs_ext_byte_t*  remaining_destination_buffer;
-  size_t*          remaining_destination_buffer_length_ptr;
-  bzs_result_t     result;
-} decompress_args_t;
+  int  fd;
+  int  error;
+  bool is_readable;
+} wait_args_t;
 
-static inline void* decompress_wrapper(void* data)
+static VALUE wait_io_wrapper(VALUE data)
 {
-  decompress_args_t* args = data;
-
-  args->stream_ptr->next_in   = (char*) *args->remaining_source_ptr;
-  args->stream_ptr->avail_in  = bzs_consume_size(*args->remaining_source_length_ptr);
-  args->stream_ptr->next_out  = (char*) args->remaining_destination_buffer;
-  args->stream_ptr->avail_out = bzs_consume_size(*args->remaining_destination_buffer_length_ptr);
+  wait_args_t* args = (wait_args_t*) data;
 
-  args->result = BZ2_bzDecompress(args->stream_ptr);
+  // Ruby checks errno to find out whether descriptor is not ready or call was interrupted.
+  errno = args->error;
 
-  *args->remaining_source_ptr                    = (bzs_ext_byte_t*) args->stream_ptr->next_in;
-  *args->remaining_source_length_ptr             = args->stream_ptr->avail_in;
-  *args->remaining_destination_buffer_length_ptr = args->stream_ptr->avail_out;
+  int is_waited = args->is_readable ? rb_io_wait_readable(args->fd) : rb_io_wait_writable(args->fd);
 
-  return NULL;
+  return is_waited ? Qtrue : Qfalse;
 }
 
-static inline bzs_ext_result_t buffered_decompress(
-  bz_stream*             stream_ptr,
-  const bzs_ext_byte_t** source_ptr,
-  size_t*                source_length_ptr,
-  FILE*                  destination_file,
-  bzs_ext_byte_t*        destination_buffer,
-  size_t*                destination_length_ptr,
-  size_t                 destination_buffer_length,
-  bool                   gvl)
+static inline bzs_ext_result_t wait_io(io_t* io_ptr, int error, bool is_readable, bzs_ext_result_t error_result)
 {
-  bzs_ext_result_t ext_result;
+  wait_args_t args = {.fd = io_ptr->fd, .error = error, .is_readable = is_readable};
 
-  decompress_args_t args = {
-    .stream_ptr                  = stream_ptr,
-    .remaining_source_ptr        = (bzs_ext_byte_t**) source_ptr,
-    .remaining_source_length_ptr = source_length_ptr};
+  VALUE is_waited = rb_protect(wait_io_wrapper, (VALUE) &args, &io_ptr->exception);
+  if (io_ptr->exception != 0) {
+    return BZS_EXT_IO_EXCEPTION_RAISED;
+  }
 
-  while (true) {
-    bzs_ext_byte_t* remaining_destination_buffer             = destination_buffer + *destination_length_ptr;
-    size_t          remaining_destination_buffer_length      = destination_buffer_length - *destination_length_ptr;
-    size_t          prev_remaining_destination_buffer_length = remaining_destination_buffer_length;
+  return is_waited == Qtrue ? 0 : error_result;
+}
 
-    args.remaining_destination_buffer            = remaining_destination_buffer;
-    args.remaining_destination_buffer_length_ptr = &remaining_destination_buffer_length;
+// -- io read --
 
-    BZS_EXT_GVL_WRAP(gvl, decompress_wrapper, &args);
-    if (args.result != BZ_OK && args.result != BZ_PARAM_ERROR && args.result != BZ_STREAM_END) {
-      return bzs_ext_get_error(args.result);
-    }
+typedef struct
+{
+  int               fd;
+  bzs_ext_byte_t*   source_buffer;
+  size_t            source_buffer_length;
+  bzs_ext_digest_t* digest_ptr;
+  ssize_t           result;
+  int               error;
+} read_fd_args_t;
+
+static inline void* read_fd_wrapper(void* data)
+{
+  read_fd_args_t* args = data;
 
-    *destination_length_ptr += prev_remaining_destination_buffer_length - remaining_destination_buffer_length;
+  args->result = read(args->fd, args->source_buffer, args->source_buffer_length);
+  args->error  = errno;
+
+  if (args->result > 0) {
+    bzs_ext_digest_update(args->digest_ptr, args->source_buffer, args->result);
+  }
+
+  return NULL;
+}
+
+typedef struct
+{
+  VALUE  io;
+  size_t source_buffer_length;
+} read_object_args_t;
+
+static VALUE read_object_wrapper(VALUE data)
+{
+  read_object_args_t* args = (read_object_args_t*) data;
+
+  return rb_funcall(args->io, rb_intern("read"), 1, SIZET2NUM(args->source_buffer_length));
+}
+
+static inline bzs_ext_result_t
+  read_object(io_t* io_ptr, bzs_ext_byte_t* source_buffer, size_t* source_length_ptr, size_t source_buffer_length)
+{
+  read_object_args_t args = {.io = io_ptr->io, .source_buffer_length = source_buffer_length};
+
+  VALUE source = rb_protect(read_object_wrapper, (VALUE) &args, &io_ptr->exception);
+  if (io_ptr->exception != 0) {
+    return BZS_EXT_IO_EXCEPTION_RAISED;
+  }
+
+  if (source == Qnil) {
+    return BZS_EXT_FILE_READ_FINISHED;
+  }
+
+  if (!RB_TYPE_P(source, T_STRING) || (size_t) RSTRING_LEN(source) > source_buffer_length) {
+    return BZS_EXT_ERROR_READ_IO;
+  }
+
+  size_t source_length = RSTRING_LEN(source);
+  if (source_length == 0) {
+    return BZS_EXT_FILE_READ_FINISHED;
+  }
+
+  memcpy(source_buffer, RSTRING_PTR(source), source_length);
+  bzs_ext_digest_update(&io_ptr->digest, source_buffer, source_length);
+
+  *source_length_ptr = source_length;
+
+  return 0;
+}
+
+static bzs_ext_result_t
+  read_io(void* data, bzs_ext_byte_t* source_buffer, size_t* source_length_ptr, size_t source_buffer_length)
+{
+  io_t* io_ptr = data;
+
+  if (io_ptr->fd == -1) {
+    return read_object(io_ptr, source_buffer, source_length_ptr, source_buffer_length);
+  }
+
+  read_fd_args_t args = {
+    .fd                   = io_ptr->fd,
+    .source_buffer        = source_buffer,
+    .source_buffer_length = source_buffer_length,
+    .digest_ptr           = &io_ptr->digest};
+
+  while (true) {
+    BZS_EXT_GVL_WRAP(io_ptr->gvl, read_fd_wrapper, &args);
+
+    if (args.result == 0) {
+      return BZS_EXT_FILE_READ_FINISHED;
+    }
+
+    if (args.result > 0) {
+      add_cache(io_ptr, args.result);
+
+      *source_length_ptr = args.result;
+      return 0;
+    }
+
+    bzs_ext_result_t ext_result = wait_io(io_ptr, args.error, true, BZS_EXT_ERROR_READ_IO);
+    if (ext_result != 0) {
+      return ext_result;
+    }
+  }
+}
+
+// -- io write --
+
+typedef struct
+{
+  int                   fd;
+  const bzs_ext_byte_t* destination;
+  size_t                destination_length;
+  bzs_ext_digest_t*     digest_ptr;
+  ssize_t               result;
+  int                   error;
+} write_fd_args_t;
+
+static inline void* write_fd_wrapper(void* data)
+{
+  write_fd_args_t* args = data;
+
+  args->result = write(args->fd, args->destination, args->destination_length);
+  args->error  = errno;
+
+  if (args->result > 0) {
+    bzs_ext_digest_update(args->digest_ptr, args->destination, args->result);
+  }
+
+  return NULL;
+}
+
+typedef struct
+{
+  VALUE                 io;
+  const bzs_ext_byte_t* destination;
+  size_t                destination_length;
+} write_object_args_t;
+
+static VALUE write_object_wrapper(VALUE data)
+{
+  write_object_args_t* args = (write_object_args_t*) data;
+
+  VALUE destination = rb_str_new((const char*) args->destination, args->destination_length);
+
+  return rb_funcall(args->io, rb_intern("write"), 1, destination);
+}
+
+static inline bzs_ext_result_t
+  write_object(io_t* io_ptr, const bzs_ext_byte_t* destination, size_t destination_length)
+{
+  write_object_args_t args = {.io = io_ptr->io, .destination = destination, .destination_length = destination_length};
+
+  rb_protect(write_object_wrapper, (VALUE) &args, &io_ptr->exception);
+  if (io_ptr->exception != 0) {
+    return BZS_EXT_IO_EXCEPTION_RAISED;
+  }
+
+  bzs_ext_digest_update(&io_ptr->digest, destination, destination_length);
+
+  return 0;
+}
+
+static bzs_ext_result_t write_io(void* data, const bzs_ext_byte_t* destination, size_t destination_length)
+{
+  io_t* io_ptr = data;
+
+  if (io_ptr->fd == -1) {
+    return write_object(io_ptr, destination, destination_length);
+  }
+
+  write_fd_args_t args                       = {.fd = io_ptr->fd, .digest_ptr = &io_ptr->digest};
+  size_t          written_destination_length = destination_length;
+
+  while (destination_length != 0) {
+    args.destination        = destination;
+    args.destination_length = destination_length;
+
+    BZS_EXT_GVL_WRAP(io_ptr->gvl, write_fd_wrapper, &args);
+
+    if (args.result >= 0) {
+      destination += args.result;
+      destination_length -= args.result;
+      continue;
+    }
+
+    bzs_ext_result_t ext_result = wait_io(io_ptr, args.error, false, BZS_EXT_ERROR_WRITE_IO);
+    if (ext_result != 0) {
+      return ext_result;
+    }
+  }
+
+  add_cache(io_ptr, written_destination_length);
+
+  return 0;
+}
+
+// -- uring --
+
+// Uring reads and writes descriptors of regular files with registered buffers.
+// Algorithm receives source from registered source buffer and writes into registered destination buffer directly.
+// Whole loop is running without global VM lock.
+
+typedef struct
+{
+  bzs_ext_uring_t*  uring_ptr;
+  bz_stream*        stream_ptr;
+  bool              is_compressor;
+  bzs_ext_option_t  verbosity;
+  bzs_ext_option_t  small;
+  bzs_ext_limit_t*  limit_ptr;
+  bzs_ext_cache_t*  source_cache_ptr;
+  bzs_ext_cache_t*  destination_cache_ptr;
+  bzs_ext_digest_t* source_digest_ptr;
+  bzs_ext_digest_t* destination_digest_ptr;
+  bzs_ext_result_t  ext_result;
+} uring_args_t;
+
+static inline bzs_ext_result_t
+  uring_get_source(uring_args_t* args, const bzs_ext_byte_t** source_ptr, size_t* source_length_ptr)
+{
+  bzs_ext_result_t ext_result = bzs_ext_uring_get_source(args->uring_ptr, source_ptr, source_length_ptr);
+  if (ext_result != 0) {
+    return ext_result;
+  }
+
+  // Source is already in registered buffer.
+  bzs_ext_cache_add(args->source_cache_ptr, *source_length_ptr);
+  bzs_ext_digest_update(args->source_digest_ptr, *source_ptr, *source_length_ptr);
+
+  return 0;
+}
+
+static inline bzs_ext_result_t
+  uring_write_destination(uring_args_t* args, const bzs_ext_byte_t* destination_buffer, size_t destination_length)
+{
+  // Registered buffer can't be changed until it will be written.
+  bzs_ext_digest_update(args->destination_digest_ptr, destination_buffer, destination_length);
+
+  bzs_ext_result_t ext_result = bzs_ext_uring_write_destination(args->uring_ptr, destination_length);
+  if (ext_result != 0) {
+    return ext_result;
+  }
+
+  bzs_ext_cache_add(args->destination_cache_ptr, destination_length);
+
+  return 0;
+}
+
+static inline bzs_ext_result_t uring_flush_destination(
+  uring_args_t*    args,
+  bzs_ext_byte_t** destination_buffer_ptr,
+  size_t*          destination_buffer_length_ptr,
+  size_t*          destination_length_ptr)
+{
+  bzs_ext_result_t ext_result = uring_write_destination(args, *destination_buffer_ptr, *destination_length_ptr);
+  if (ext_result != 0) {
+    return ext_result;
+  }
+
+  *destination_length_ptr = 0;
+
+  return bzs_ext_uring_get_destination(args->uring_ptr, destination_buffer_ptr, destination_buffer_length_ptr);
+}
+
+static inline bzs_ext_result_t uring_compress(uring_args_t* args)
+{
+  bzs_ext_uring_t* uring_ptr  = args->uring_ptr;
+  bz_stream*       stream_ptr = args->stream_ptr;
+  bzs_ext_byte_t* destination_buffer;
+  size_t          destination_buffer_length;
+  size_t          destination_length = 0;
+  bzs_result_t    result;
+
+  bzs_ext_result_t ext_result =
+    bzs_ext_uring_get_destination(uring_ptr, &destination_buffer, &destination_buffer_length);
+  if (ext_result != 0) {
+    return ext_result;
+  }
+
+  while (true) {
+    const bzs_ext_byte_t* source;
+    size_t                source_length;
+
+    ext_result = uring_get_source(args, &source, &source_length);
+    if (ext_result != 0) {
+      return ext_result;
+    }
+
+    if (source_length == 0) {
+      break;
+    }
+
+    while (source_length != 0) {
+      if (destination_length == destination_buffer_length) {
+        ext_result =
+          uring_flush_destination(args, &destination_buffer, &destination_buffer_length, &destination_length);
+        if (ext_result != 0) {
+          return ext_result;
+        }
+      }
+
+      stream_ptr->next_in   = (char*) source;
+      stream_ptr->avail_in  = bzs_consume_size(source_length);
+      stream_ptr->next_out  = (char*) destination_buffer + destination_length;
+      stream_ptr->avail_out = bzs_consume_size(destination_buffer_length - destination_length);
+
+      result = BZ2_bzCompress(stream_ptr, BZ_RUN);
+      if (result != BZ_RUN_OK) {
+        return bzs_ext_get_error(result);
+      }
+
+      source_length -= (const bzs_ext_byte_t*) stream_ptr->next_in - source;
+      source             = (const bzs_ext_byte_t*) stream_ptr->next_in;
+      destination_length = (bzs_ext_byte_t*) stream_ptr->next_out - destination_buffer;
+    }
+
+    ext_result = bzs_ext_uring_release_source(uring_ptr);
+    if (ext_result != 0) {
+      return ext_result;
+    }
+  }
+
+  while (true) {
+    if (destination_length == destination_buffer_length) {
+      ext_result =
+        uring_flush_destination(args, &destination_buffer, &destination_buffer_length, &destination_length);
+      if (ext_result != 0) {
+        return ext_result;
+      }
+    }
+
+    stream_ptr->next_in   = NULL;
+    stream_ptr->avail_in  = 0;
+    stream_ptr->next_out  = (char*) destination_buffer + destination_length;
+    stream_ptr->avail_out = bzs_consume_size(destination_buffer_length - destination_length);
+
+    result = BZ2_bzCompress(stream_ptr, BZ_FINISH);
+    if (result != BZ_FINISH_OK && result != BZ_STREAM_END) {
+      return bzs_ext_get_error(result);
+    }
+
+    destination_length = (bzs_ext_byte_t*) stream_ptr->next_out - destination_buffer;
+
+    if (result == BZ_STREAM_END) {
+      break;
+    }
+  }
+
+  ext_result = uring_write_destination(args, destination_buffer, destination_length);
+  if (ext_result != 0) {
+    return ext_result;
+  }
+
+  return bzs_ext_uring_finish(uring_ptr);
+}
+
+static inline bzs_ext_result_t uring_decompress(uring_args_t* args)
+{
+  bzs_ext_uring_t* uring_ptr  = args->uring_ptr;
+  bz_stream*       stream_ptr = args->stream_ptr;
+  bzs_ext_limit_t* limit_ptr  = args->limit_ptr;
+  bzs_ext_byte_t* destination_buffer;
+  size_t          destination_buffer_length;
+  size_t          destination_length = 0;
+  bool            is_finished        = false;
+
+  bzs_ext_result_t ext_result =
+    bzs_ext_uring_get_destination(uring_ptr, &destination_buffer, &destination_buffer_length);
+  if (ext_result != 0) {
+    return ext_result;
+  }
+
+  bzs_next_stream_t next_stream;
+  bzs_init_next_stream(&next_stream);
+
+  while (!is_finished) {
+    const bzs_ext_byte_t* source;
+    size_t                source_length;
+
+    ext_result = uring_get_source(args, &source, &source_length);
+    if (ext_result != 0) {
+      return ext_result;
+    }
+
+    if (source_length == 0) {
+      break;
+    }
+
+    bzs_ext_limit_add_source(limit_ptr, source_length);
+
+    while (true) {
+      ext_result =
+        bzs_find_next_stream(&next_stream, stream_ptr, args->verbosity, args->small, &source, &source_length);
+      if (ext_result != 0) {
+        return ext_result;
+      }
+
+      if (!bzs_is_next_stream_found(&next_stream)) {
+        // Trailing data won't be read, next source may contain remaining part of header.
+        is_finished = next_stream.is_finished;
+        break;
+      }
+
+      if (destination_length == destination_buffer_length) {
+        ext_result =
+          uring_flush_destination(args, &destination_buffer, &destination_buffer_length, &destination_length);
+        if (ext_result != 0) {
+          return ext_result;
+        }
+      }
+
+      size_t remaining_destination_buffer_length =
+        bzs_ext_limit_get_destination_buffer_length(limit_ptr, destination_buffer_length - destination_length);
+
+      stream_ptr->next_in   = (char*) source;
+      stream_ptr->avail_in  = bzs_consume_size(source_length);
+      stream_ptr->next_out  = (char*) destination_buffer + destination_length;
+      stream_ptr->avail_out = bzs_consume_size(remaining_destination_buffer_length);
+
+      bzs_result_t result = BZ2_bzDecompress(stream_ptr);
+      if (result != BZ_OK && result != BZ_STREAM_END) {
+        return bzs_ext_get_error(result);
+      }
+
+      size_t written_destination_length = remaining_destination_buffer_length - stream_ptr->avail_out;
+
+      source_length -= (const bzs_ext_byte_t*) stream_ptr->next_in - source;
+      source = (const bzs_ext_byte_t*) stream_ptr->next_in;
+      destination_length += written_destination_length;
+
+      // Destination above limit won't be written.
+      ext_result = bzs_ext_limit_add_destination(limit_ptr, written_destination_length);
+      if (ext_result != 0) {
+        return ext_result;
+      }
+
+      if (bzs_ext_limit_is_prefix_finished(limit_ptr)) {
+        is_finished = true;
+        break;
+      }
+
+      if (result == BZ_STREAM_END) {
+        // Remaining source may contain next concatenated stream.
+        next_stream.is_stream_end = true;
+        continue;
+      }
+
+      // Decompressor requires more source when it has not filled destination.
+      if (source_length == 0 && written_destination_length != remaining_destination_buffer_length) {
+        break;
+      }
+    }
+
+    ext_result = bzs_ext_uring_release_source(uring_ptr);
+    if (ext_result != 0) {
+      return ext_result;
+    }
+  }
+
+  ext_result = uring_write_destination(args, destination_buffer, destination_length);
+  if (ext_result != 0) {
+    return ext_result;
+  }
+
+  return bzs_ext_uring_finish(uring_ptr);
+}
+
+static inline void* uring_wrapper(void* data)
+{
+  uring_args_t* args = data;
+
+  args->ext_result = args->is_compressor ? uring_compress(args) : uring_decompress(args);
+
+  return NULL;
+}
+
+// Returns not implemented error when uring can't be used, so IO should be processed by regular reads and writes.
+static inline bzs_ext_result_t process_uring(
+  uring_args_t* args,
+  io_t*         source_io_ptr,
+  io_t*         destination_io_ptr,
+  size_t        buffers_count,
+  size_t        source_buffer_length,
+  size_t        destination_buffer_length,
+  bool          gvl)
+{
+  if (source_io_ptr->fd < 0 || destination_io_ptr->fd < 0) {
+    return BZS_EXT_ERROR_NOT_IMPLEMENTED;
+  }
+
+  bzs_ext_result_t ext_result = bzs_ext_create_uring(
+    &args->uring_ptr,
+    source_io_ptr->fd,
+    destination_io_ptr->fd,
+    buffers_count,
+    source_buffer_length,
+    destination_buffer_length);
+  if (ext_result != 0) {
+    return ext_result;
+  }
+
+  args->source_cache_ptr       = &source_io_ptr->cache;
+  args->destination_cache_ptr  = &destination_io_ptr->cache;
+  args->source_digest_ptr      = &source_io_ptr->digest;
+  args->destination_digest_ptr = &destination_io_ptr->digest;
+
+  BZS_EXT_GVL_WRAP(gvl, uring_wrapper, args);
+
+  bzs_ext_destroy_uring(args->uring_ptr);
+
+  return args->ext_result;
+}
+
+// -- buffered compress --
+
+typedef struct
+{
+  bz_stream*       stream_ptr;
+  int              stream_action;
+  bzs_ext_byte_t** remaining_source_ptr;
+  size_t*          remaining_source_length_ptr;
+  bzs_ext_byte_t*  remaining_destination_buffer;
+  size_t*          remaining_destination_buffer_length_ptr;
+  bzs_ext_index_t* index_ptr;
+  bzs_result_t     result;
+  bzs_ext_result_t ext_result;
+} compress_args_t;
+
+static inline void* compress_wrapper(void* data)
+{
+  compress_args_t* args = data;
+
+  const bzs_ext_byte_t* source = *args->remaining_source_ptr;
+
+  args->stream_ptr->next_in   = (char*) source;
+  args->stream_ptr->avail_in  = bzs_consume_size(*args->remaining_source_length_ptr);
+  args->stream_ptr->next_out  = (char*) args->remaining_destination_buffer;
+  args->stream_ptr->avail_out = bzs_consume_size(*args->remaining_destination_buffer_length_ptr);
+
+  args->result = BZ2_bzCompress(args->stream_ptr, args->stream_action);
+
+  if (args->index_ptr != NULL) {
+    args->ext_result = bzs_ext_index_update(
+      args->index_ptr,
+      args->stream_action,
+      source,
+      (const bzs_ext_byte_t*) args->stream_ptr->next_in - source,
+      args->remaining_destination_buffer,
+      (const bzs_ext_byte_t*) args->stream_ptr->next_out - args->remaining_destination_buffer);
+  }
+
+  *args->remaining_source_ptr                    = (bzs_ext_byte_t*) args->stream_ptr->next_in;
+  *args->remaining_source_length_ptr             = args->stream_ptr->avail_in;
+  *args->remaining_destination_buffer_length_ptr = args->stream_ptr->avail_out;
+
+  return NULL;
+}
+
+#define BUFFERED_COMPRESS(gvl, args, RUN_OK)                                                                        \
+  bzs_ext_result_t ext_result;                                                                                      \
+                                                                                                                    \
+  while (true) {                                                                                                    \
+    bzs_ext_byte_t* remaining_destination_buffer             = destination_buffer + *destination_length_ptr;        \
+    size_t          remaining_destination_buffer_length      = destination_buffer_length - *destination_length_ptr; \
+    size_t          prev_remaining_destination_buffer_length = remaining_destination_buffer_length;                 \
+                                                                                                                    \
+    args.remaining_destination_buffer            = remaining_destination_buffer;                                    \
+    args.remaining_destination_buffer_length_ptr = &remaining_destination_buffer_length;                            \
+                                                                                                                    \
+    BZS_EXT_GVL_WRAP(gvl, compress_wrapper, &args);                                                                 \
+    if (args.result != RUN_OK && args.result != BZ_PARAM_ERROR && args.result != BZ_STREAM_END) {                   \
+      return bzs_ext_get_error(args.result);                                                                        \
+    }                                                                                                               \
+                                                                                                                    \
+    if (args.ext_result != 0) {                                                                                     \
+      return args.ext_result;                                                                                       \
+    }                                                                                                               \
+                                                                                                                    \
+    *destination_length_ptr += prev_remaining_destination_buffer_length - remaining_destination_buffer_length;      \
+                                                                                                                    \
+    if (args.result == BZ_STREAM_END) {                                                                             \
+      break;                                                                                                        \
+    }                                                                                                               \
+                                                                                                                    \
+    if (*args.remaining_source_length_ptr != 0 || remaining_destination_buffer_length == 0) {                       \
+      ext_result = flush_destination_buffer(                                                                        \
+        writer_ptr, destination_buffer, destination_length_ptr, destination_buffer_length);                         \
+                                                                                                                    \
+      if (ext_result != 0) {                                                                                        \
+        return ext_result;                                                                                          \
+      }                                                                                                             \
+                                                                                                                    \
+      continue;                                                                                                     \
+    }                                                                                                               \
+                                                                                                                    \
+    break;                                                                                                          \
+  }                                                                                                                 \
+                                                                                                                    \
+  return 0;
+
+static inline bzs_ext_result_t buffered_compress(
+  bz_stream*             stream_ptr,
+  const bzs_ext_byte_t** source_ptr,
+  size_t*                source_length_ptr,
+  writer_t*              writer_ptr,
+  bzs_ext_byte_t*        destination_buffer,
+  size_t*                destination_length_ptr,
+  size_t                 destination_buffer_length,
+  bzs_ext_index_t*       index_ptr,
+  bool                   gvl)
+{
+  compress_args_t run_args = {
+    .stream_ptr                  = stream_ptr,
+    .stream_action               = BZ_RUN,
+    .remaining_source_ptr        = (bzs_ext_byte_t**) source_ptr,
+    .remaining_source_length_ptr = source_length_ptr,
+    .index_ptr                   = index_ptr};
+  BUFFERED_COMPRESS(gvl, run_args, BZ_RUN_OK);
+}
+
+// -- buffered compressor finish --
+
+static inline bzs_ext_result_t buffered_compressor_finish(
+  bz_stream*       stream_ptr,
+  writer_t*        writer_ptr,
+  bzs_ext_byte_t*  destination_buffer,
+  size_t*          destination_length_ptr,
+  size_t           destination_buffer_length,
+  bzs_ext_index_t* index_ptr,
+  bool             gvl)
+{
+  bzs_ext_byte_t* remaining_source        = NULL;
+  size_t          remaining_source_length = 0;
+
+  compress_args_t finish_args = {
+    .stream_ptr                  = stream_ptr,
+    .stream_action               = BZ_FINISH,
+    .remaining_source_ptr        = &remaining_source,
+    .remaining_source_length_ptr = &remaining_source_length,
+    .index_ptr                   = index_ptr};
+  BUFFERED_COMPRESS(gvl, finish_args, BZ_FINISH_OK);
+}
+
+// -- checkpoint --
+
+// Checkpoint is made after each finished member, when all its destination is written.
+// Destination is synced, then block receives source length of finished members and length of written destination.
+// Compression can be resumed from these offsets, because each member is an independent stream.
+
+typedef struct
+{
+  io_t* destination_io_ptr;
+  off_t initial_destination_offset;
+} checkpoint_t;
+
+typedef struct
+{
+  int fd;
+  int result;
+} sync_args_t;
+
+static inline void* sync_wrapper(void* data)
+{
+  sync_args_t* args = data;
+
+  args->result = fsync(args->fd);
+
+  return NULL;
+}
+
+typedef struct
+{
+  size_t source_length;
+  size_t destination_length;
+} yield_checkpoint_args_t;
+
+static VALUE yield_checkpoint_wrapper(VALUE data)
+{
+  yield_checkpoint_args_t* args = (yield_checkpoint_args_t*) data;
+
+  return rb_yield_values(2, SIZET2NUM(args->source_length), SIZET2NUM(args->destination_length));
+}
+
+static inline bzs_ext_result_t init_checkpoint(checkpoint_t* checkpoint_ptr, io_t* destination_io_ptr)
+{
+  // Checkpoint requires destination file with position.
+  if (destination_io_ptr->fd < 0) {
+    return BZS_EXT_ERROR_NOT_IMPLEMENTED;
+  }
+
+  off_t offset = lseek(destination_io_ptr->fd, 0, SEEK_CUR);
+  if (offset < 0) {
+    return BZS_EXT_ERROR_NOT_IMPLEMENTED;
+  }
+
+  checkpoint_ptr->destination_io_ptr         = destination_io_ptr;
+  checkpoint_ptr->initial_destination_offset = offset;
+
+  return 0;
+}
+
+static inline bzs_ext_result_t make_checkpoint(checkpoint_t* checkpoint_ptr, size_t source_length)
+{
+  io_t*       io_ptr    = checkpoint_ptr->destination_io_ptr;
+  sync_args_t sync_args = {.fd = io_ptr->fd};
+
+  BZS_EXT_GVL_WRAP(io_ptr->gvl, sync_wrapper, &sync_args);
+  if (sync_args.result != 0) {
+    return BZS_EXT_ERROR_WRITE_IO;
+  }
+
+  off_t offset = lseek(io_ptr->fd, 0, SEEK_CUR);
+  if (offset < 0) {
+    return BZS_EXT_ERROR_WRITE_IO;
+  }
+
+  yield_checkpoint_args_t args = {
+    .source_length      = source_length,
+    .destination_length = (size_t) (offset - checkpoint_ptr->initial_destination_offset)};
+
+  rb_protect(yield_checkpoint_wrapper, (VALUE) &args, &io_ptr->exception);
+  if (io_ptr->exception != 0) {
+    return BZS_EXT_IO_EXCEPTION_RAISED;
+  }
+
+  return 0;
+}
+
+// -- buffered compress members --
+
+// Member size limits source of each stream, zero means single stream.
+
+typedef struct
+{
+  size_t           member_size;
+  size_t           member_source_length;
+  size_t           finished_source_length;
+  bzs_ext_option_t block_size;
+  bzs_ext_option_t verbosity;
+  bzs_ext_option_t work_factor;
+  checkpoint_t*    checkpoint_ptr;
+} members_t;
+
+static inline size_t get_member_source_length(const members_t* members_ptr, size_t source_length)
+{
+  if (members_ptr->member_size == 0) {
+    return source_length;
+  }
+
+  size_t remaining_member_source_length = members_ptr->member_size - members_ptr->member_source_length;
+
+  return source_length < remaining_member_source_length ? source_length : remaining_member_source_length;
+}
+
+static inline bzs_ext_result_t buffered_compress_members(
+  bz_stream*             stream_ptr,
+  const bzs_ext_byte_t** source_ptr,
+  size_t*                source_length_ptr,
+  writer_t*              writer_ptr,
+  bzs_ext_byte_t*        destination_buffer,
+  size_t*                destination_length_ptr,
+  size_t                 destination_buffer_length,
+  members_t*             members_ptr,
+  bzs_ext_index_t*       index_ptr,
+  bool                   gvl)
+{
+  bzs_ext_result_t ext_result;
+
+  while (true) {
+    // Full member will be finished only when next source is available.
+    if (
+      members_ptr->member_size != 0 && members_ptr->member_source_length == members_ptr->member_size &&
+      *source_length_ptr != 0) {
+      ext_result = buffered_compressor_finish(
+        stream_ptr,
+        writer_ptr,
+        destination_buffer,
+        destination_length_ptr,
+        destination_buffer_length,
+        index_ptr,
+        gvl);
+      if (ext_result != 0) {
+        return ext_result;
+      }
+
+      // Restart will reuse memory of previous member.
+      ext_result =
+        bzs_restart_compressor(stream_ptr, members_ptr->block_size, members_ptr->verbosity, members_ptr->work_factor);
+      if (ext_result != 0) {
+        return ext_result;
+      }
+
+      members_ptr->finished_source_length += members_ptr->member_source_length;
+      members_ptr->member_source_length = 0;
+
+      if (members_ptr->checkpoint_ptr != NULL) {
+        ext_result = write_remaining_destination(writer_ptr, destination_buffer, *destination_length_ptr);
+        if (ext_result != 0) {
+          return ext_result;
+        }
+
+        *destination_length_ptr = 0;
+
+        ext_result = make_checkpoint(members_ptr->checkpoint_ptr, members_ptr->finished_source_length);
+        if (ext_result != 0) {
+          return ext_result;
+        }
+      }
+    }
+
+    size_t member_source_length           = get_member_source_length(members_ptr, *source_length_ptr);
+    size_t remaining_member_source_length = member_source_length;
+
+    ext_result = buffered_compress(
+      stream_ptr,
+      source_ptr,
+      &remaining_member_source_length,
+      writer_ptr,
+      destination_buffer,
+      destination_length_ptr,
+      destination_buffer_length,
+      index_ptr,
+      gvl);
+    if (ext_result != 0) {
+      return ext_result;
+    }
+
+    size_t written_source_length = member_source_length - remaining_member_source_length;
+    *source_length_ptr -= written_source_length;
+    members_ptr->member_source_length += written_source_length;
+
+    if (*source_length_ptr == 0) {
+      return 0;
+    }
+  }
+}
+
+// -- compress --
+
+static inline bzs_ext_result_t compress(
+  bz_stream*       stream_ptr,
+  reader_t*        reader_ptr,
+  bzs_ext_byte_t*  source_buffer,
+  size_t           source_buffer_length,
+  writer_t*        writer_ptr,
+  bzs_ext_byte_t*  destination_buffer,
+  size_t           destination_buffer_length,
+  members_t*       members_ptr,
+  bzs_ext_index_t* index_ptr,
+  bool             gvl)
+{
+  bzs_ext_result_t      ext_result;
+  const bzs_ext_byte_t* source             = source_buffer;
+  size_t                source_length      = 0;
+  size_t                destination_length = 0;
+
+  BUFFERED_READ_SOURCE(
+    buffered_compress_members,
+    stream_ptr,
+    &source,
+    &source_length,
+    writer_ptr,
+    destination_buffer,
+    &destination_length,
+    destination_buffer_length,
+    members_ptr,
+    index_ptr,
+    gvl);
+
+  ext_result = buffered_compressor_finish(
+    stream_ptr, writer_ptr, destination_buffer, &destination_length, destination_buffer_length, index_ptr, gvl);
+
+  if (ext_result != 0) {
+    return ext_result;
+  }
+
+  return write_remaining_destination(writer_ptr, destination_buffer, destination_length);
+}
+
+// Result with enabled digests is [index, digests].
+static inline VALUE
+  get_compress_result_value(VALUE index_value, const io_t* source_io_ptr, const io_t* destination_io_ptr)
+{
+  VALUE digests_value = get_digests_value(source_io_ptr, destination_io_ptr);
+  if (digests_value == Qnil) {
+    return index_value;
+  }
+
+  return rb_ary_new_from_args(2, index_value, digests_value);
+}
+
+VALUE bzs_ext_compress_io(VALUE BZS_EXT_UNUSED(self), VALUE source, VALUE destination, VALUE options)
+{
+  Check_Type(options, T_HASH);
+  BZS_EXT_GET_SIZE_OPTION(options, source_buffer_length);
+  BZS_EXT_GET_SIZE_OPTION(options, destination_buffer_length);
+  BZS_EXT_GET_BOOL_OPTION(options, gvl);
+  BZS_EXT_RESOLVE_COMPRESSOR_OPTIONS(options);
+  BZS_EXT_RESOLVE_BOOL_OPTION(options, index, BZS_DEFAULT_INDEX);
+  BZS_EXT_RESOLVE_SIZE_OPTION(options, member_size, BZS_DEFAULT_MEMBER_SIZE);
+  BZS_EXT_RESOLVE_SIZE_OPTION(options, uring, BZS_DEFAULT_URING);
+  BZS_EXT_RESOLVE_BOOL_OPTION(options, drop_cache, BZS_DEFAULT_DROP_CACHE);
+  BZS_EXT_RESOLVE_SIZE_OPTION(options, preallocate, BZS_DEFAULT_PREALLOCATE);
+  BZS_EXT_RESOLVE_DIGEST_OPTION(options, digest);
+  BZS_EXT_RESOLVE_SIZE_OPTION(options, checkpoint, BZS_DEFAULT_CHECKPOINT);
+
+  io_t source_io;
+  io_t destination_io;
+
+  init_io(&source_io, source, true, gvl);
+  init_io(&destination_io, destination, false, gvl);
+  init_digests(&source_io, &destination_io, digest);
+
+  // Each checkpoint finishes member, block receives checkpoints.
+  checkpoint_t  checkpoint_data;
+  checkpoint_t* checkpoint_ptr = NULL;
+
+  if (checkpoint != 0) {
+    member_size = checkpoint;
+
+    if (rb_block_given_p()) {
+      checkpoint_ptr = &checkpoint_data;
+
+      bzs_ext_result_t ext_result = init_checkpoint(checkpoint_ptr, &destination_io);
+      if (ext_result != 0) {
+        bzs_ext_raise_error(ext_result);
+      }
+    }
+  }
+
+  // Allocator will be used to restart stream for each member.
+  bz_stream           stream;
+  bzs_ext_allocator_t allocator;
+
+  bzs_ext_reservation_t reserved_memory;
+
+  bzs_ext_result_t ext_result = bzs_ext_governor_reserve_compressors(block_size, 1, &reserved_memory);
+  if (ext_result != 0) {
+    bzs_ext_raise_error(ext_result);
+  }
+
+  bzs_ext_init_allocator(&allocator);
+  bzs_ext_use_allocator(&stream, &allocator);
+
+  bzs_result_t result = BZ2_bzCompressInit(&stream, block_size, verbosity, work_factor);
+  if (result != BZ_OK) {
+    bzs_ext_release_allocator(&allocator);
+    bzs_ext_governor_release(reserved_memory);
+    bzs_ext_raise_error(bzs_ext_get_error(result));
+  }
+
+  if (source_buffer_length == 0) {
+    source_buffer_length = BZS_DEFAULT_SOURCE_BUFFER_LENGTH_FOR_COMPRESSOR;
+  }
+  if (destination_buffer_length == 0) {
+    destination_buffer_length = BZS_DEFAULT_DESTINATION_BUFFER_LENGTH_FOR_COMPRESSOR;
+  }
+
+  init_caches(&source_io, &destination_io, drop_cache, preallocate);
+
+  // Index and members require regular compress.
+  if (uring != 0 && !index && member_size == 0) {
+    uring_args_t uring_args = {.stream_ptr = &stream, .is_compressor = true, .ext_result = 0};
+
+    ext_result = process_uring(
+      &uring_args, &source_io, &destination_io, uring, source_buffer_length, destination_buffer_length, gvl);
+    if (ext_result != BZS_EXT_ERROR_NOT_IMPLEMENTED) {
+      BZ2_bzCompressEnd(&stream);
+      bzs_ext_release_allocator(&allocator);
+      bzs_ext_governor_release(reserved_memory);
+
+      ext_result = finish_caches(&source_io, &destination_io, ext_result, gvl);
+
+      if (ext_result != 0) {
+        raise_io_error(ext_result, &source_io, &destination_io);
+      }
+
+      return get_compress_result_value(Qnil, &source_io, &destination_io);
+    }
+  }
+
+  bzs_ext_byte_t* source_buffer;
+  bzs_ext_byte_t* destination_buffer;
+
+  ext_result = create_buffers(&source_buffer, source_buffer_length, &destination_buffer, destination_buffer_length);
+  if (ext_result != 0) {
+    BZ2_bzCompressEnd(&stream);
+    bzs_ext_release_allocator(&allocator);
+    bzs_ext_governor_release(reserved_memory);
+    finish_caches(&source_io, &destination_io, ext_result, gvl);
+    bzs_ext_raise_error(ext_result);
+  }
+
+  bzs_ext_index_t* index_ptr = NULL;
+
+  if (index) {
+    ext_result = bzs_ext_create_index(&index_ptr, block_size);
+    if (ext_result != 0) {
+      free(source_buffer);
+      free(destination_buffer);
+      BZ2_bzCompressEnd(&stream);
+      bzs_ext_release_allocator(&allocator);
+      bzs_ext_governor_release(reserved_memory);
+      finish_caches(&source_io, &destination_io, ext_result, gvl);
+      bzs_ext_raise_error(ext_result);
+    }
+  }
+
+  members_t members = {
+    .member_size            = member_size,
+    .member_source_length   = 0,
+    .finished_source_length = 0,
+    .block_size             = block_size,
+    .verbosity              = verbosity,
+    .work_factor            = work_factor,
+    .checkpoint_ptr         = checkpoint_ptr};
+
+  reader_t reader = {.function = read_io, .data = &source_io};
+  writer_t writer = {.function = write_io, .data = &destination_io};
+
+  ext_result = compress(
+    &stream,
+    &reader,
+    source_buffer,
+    source_buffer_length,
+    &writer,
+    destination_buffer,
+    destination_buffer_length,
+    &members,
+    index_ptr,
+    gvl);
+
+  free(source_buffer);
+  free(destination_buffer);
+  BZ2_bzCompressEnd(&stream);
+  bzs_ext_release_allocator(&allocator);
+  bzs_ext_governor_release(reserved_memory);
+
+  ext_result = finish_caches(&source_io, &destination_io, ext_result, gvl);
+
+  VALUE index_value = Qnil;
+
+  if (index_ptr != NULL) {
+    if (ext_result == 0) {
+      index_value = rb_str_new((const char*) index_ptr->records, index_ptr->records_length);
+    }
+
+    bzs_ext_destroy_index(index_ptr);
+  }
+
+  if (ext_result != 0) {
+    raise_io_error(ext_result, &source_io, &destination_io);
+  }
+
+  return get_compress_result_value(index_value, &source_io, &destination_io);
+}
+
+// -- buffered decompress --
+
+typedef struct
+{
+  bz_stream*       stream_ptr;
+  bzs_ext_byte_t** remaining_source_ptr;
+  size_t*          remaining_source_length_ptr;
+  bzs_ext_byte_t*  remaining_destination_buffer;
+  size_t*          remaining_destination_buffer_length_ptr;
+  bzs_result_t     result;
+} decompress_args_t;
+
+static inline void* decompress_wrapper(void* data)
+{
+  decompress_args_t* args = data;
+
+  args->stream_ptr->next_in   = (char*) *args->remaining_source_ptr;
+  args->stream_ptr->avail_in  = bzs_consume_size(*args->remaining_source_length_ptr);
+  args->stream_ptr->next_out  = (char*) args->remaining_destination_buffer;
+  args->stream_ptr->avail_out = bzs_consume_size(*args->remaining_destination_buffer_length_ptr);
+
+  args->result = BZ2_bzDecompress(args->stream_ptr);
+
+  *args->remaining_source_ptr                    = (bzs_ext_byte_t*) args->stream_ptr->next_in;
+  *args->remaining_source_length_ptr             = args->stream_ptr->avail_in;
+  *args->remaining_destination_buffer_length_ptr = args->stream_ptr->avail_out;
+
+  return NULL;
+}
+
+static inline bzs_ext_result_t buffered_decompress(
+  bz_stream*             stream_ptr,
+  const bzs_ext_byte_t** source_ptr,
+  size_t*                source_length_ptr,
+  writer_t*              writer_ptr,
+  bzs_ext_byte_t*        destination_buffer,
+  size_t*                destination_length_ptr,
+  size_t                 destination_buffer_length,
+  bzs_ext_option_t       verbosity,
+  bzs_ext_option_t       small,
+  bool                   gvl,
+  bzs_ext_limit_t*       limit_ptr,
+  bzs_next_stream_t*     next_stream_ptr)
+{
+  bzs_ext_result_t ext_result;
+
+  decompress_args_t args = {
+    .stream_ptr                  = stream_ptr,
+    .remaining_source_ptr        = (bzs_ext_byte_t**) source_ptr,
+    .remaining_source_length_ptr = source_length_ptr};
+
+  while (true) {
+    ext_result = bzs_find_next_stream(next_stream_ptr, stream_ptr, verbosity, small, source_ptr, source_length_ptr);
+    if (ext_result != 0) {
+      return ext_result;
+    }
+
+    if (!bzs_is_next_stream_found(next_stream_ptr)) {
+      // Next source may contain remaining part of header.
+      break;
+    }
+
+    bzs_ext_byte_t* remaining_destination_buffer        = destination_buffer + *destination_length_ptr;
+    size_t          remaining_destination_buffer_length = destination_buffer_length - *destination_length_ptr;
+    size_t          limited_destination_buffer_length =
+      bzs_ext_limit_get_destination_buffer_length(limit_ptr, remaining_destination_buffer_length);
+    size_t prev_limited_destination_buffer_length = limited_destination_buffer_length;
+
+    args.remaining_destination_buffer            = remaining_destination_buffer;
+    args.remaining_destination_buffer_length_ptr = &limited_destination_buffer_length;
+
+    BZS_EXT_GVL_WRAP(gvl, decompress_wrapper, &args);
+    if (args.result != BZ_OK && args.result != BZ_PARAM_ERROR && args.result != BZ_STREAM_END) {
+      return bzs_ext_get_error(args.result);
+    }
+
+    size_t written_destination_length = prev_limited_destination_buffer_length - limited_destination_buffer_length;
+    *destination_length_ptr += written_destination_length;
+    remaining_destination_buffer_length -= written_destination_length;
+
+    // Destination above limit won't be provided to writer.
+    ext_result = bzs_ext_limit_add_destination(limit_ptr, written_destination_length);
+    if (ext_result != 0) {
+      return ext_result;
+    }
+
+    if (bzs_ext_limit_is_prefix_finished(limit_ptr)) {
+      // Remaining source is not required, reader won't read more source.
+      *source_length_ptr = 0;
+      break;
+    }
 
     if (args.result == BZ_STREAM_END) {
+      // Remaining source may contain next concatenated stream.
+      next_stream_ptr->is_stream_end = true;
+      continue;
+    }
+
+    if (*args.remaining_source_length_ptr != 0 || remaining_destination_buffer_length == 0) {
+      ext_result = flush_destination_buffer(
+        writer_ptr, destination_buffer, destination_length_ptr, destination_buffer_length);
+
+      if (ext_result != 0) {
+        return ext_result;
+      }
+
+      continue;
+    }
+
+    break;
+  }
+
+  return 0;
+}
+
+// -- decompress --
+
+static inline bzs_ext_result_t decompress(
+  bz_stream*       stream_ptr,
+  reader_t*        source_reader_ptr,
+  bzs_ext_byte_t*  source_buffer,
+  size_t           source_buffer_length,
+  writer_t*        writer_ptr,
+  bzs_ext_byte_t*  destination_buffer,
+  size_t           destination_buffer_length,
+  bzs_ext_option_t verbosity,
+  bzs_ext_option_t small,
+  bool             gvl,
+  bzs_ext_limit_t* limit_ptr)
+{
+  bzs_ext_result_t      ext_result;
+  const bzs_ext_byte_t* source             = source_buffer;
+  size_t                source_length      = 0;
+  size_t                destination_length = 0;
+
+  limited_reader_t limited_reader = {.reader_ptr = source_reader_ptr, .limit_ptr = limit_ptr};
+  reader_t         reader         = {.function = read_limited, .data = &limited_reader};
+  reader_t*        reader_ptr     = &reader;
+
+  bzs_next_stream_t next_stream;
+  bzs_init_next_stream(&next_stream);
+
+  BUFFERED_READ_SOURCE(
+    buffered_decompress,
+    stream_ptr,
+    &source,
+    &source_length,
+    writer_ptr,
+    destination_buffer,
+    &destination_length,
+    destination_buffer_length,
+    verbosity,
+    small,
+    gvl,
+    limit_ptr,
+    &next_stream);
+
+  return write_remaining_destination(writer_ptr, destination_buffer, destination_length);
+}
+
+VALUE bzs_ext_decompress_io(VALUE BZS_EXT_UNUSED(self), VALUE source, VALUE destination, VALUE options)
+{
+  Check_Type(options, T_HASH);
+  BZS_EXT_GET_SIZE_OPTION(options, source_buffer_length);
+  BZS_EXT_GET_SIZE_OPTION(options, destination_buffer_length);
+  BZS_EXT_GET_BOOL_OPTION(options, gvl);
+  BZS_EXT_RESOLVE_DECOMPRESSOR_OPTIONS(options);
+  BZS_EXT_RESOLVE_LIMIT_OPTIONS(options);
+  BZS_EXT_RESOLVE_SIZE_OPTION(options, limit, BZS_DEFAULT_LIMIT);
+  BZS_EXT_RESOLVE_SIZE_OPTION(options, uring, BZS_DEFAULT_URING);
+  BZS_EXT_RESOLVE_BOOL_OPTION(options, drop_cache, BZS_DEFAULT_DROP_CACHE);
+  BZS_EXT_RESOLVE_SIZE_OPTION(options, preallocate, BZS_DEFAULT_PREALLOCATE);
+  BZS_EXT_RESOLVE_DIGEST_OPTION(options, digest);
+
+  io_t source_io;
+  io_t destination_io;
+
+  init_io(&source_io, source, true, gvl);
+  init_io(&destination_io, destination, false, gvl);
+  init_digests(&source_io, &destination_io, digest);
+
+  bz_stream stream = {
+    .bzalloc = NULL,
+    .bzfree  = NULL,
+    .opaque  = NULL,
+  };
+
+  bzs_ext_reservation_t reserved_memory;
+
+  bzs_ext_result_t ext_result = bzs_ext_governor_reserve_decompressors(1, &small, &reserved_memory);
+  if (ext_result != 0) {
+    bzs_ext_raise_error(ext_result);
+  }
+
+  bzs_result_t result = BZ2_bzDecompressInit(&stream, verbosity, small);
+  if (result != BZ_OK) {
+    bzs_ext_governor_release(reserved_memory);
+    bzs_ext_raise_error(bzs_ext_get_error(result));
+  }
+
+  if (source_buffer_length == 0) {
+    source_buffer_length = BZS_DEFAULT_SOURCE_BUFFER_LENGTH_FOR_DECOMPRESSOR;
+  }
+  if (destination_buffer_length == 0) {
+    destination_buffer_length = BZS_DEFAULT_DESTINATION_BUFFER_LENGTH_FOR_DECOMPRESSOR;
+  }
+
+  bzs_ext_limit_t output_limit;
+
+  bzs_ext_init_limit(&output_limit, max_output_size, max_ratio, limit);
+  init_caches(&source_io, &destination_io, drop_cache, preallocate);
+
+  if (uring != 0) {
+    uring_args_t uring_args = {
+      .stream_ptr    = &stream,
+      .is_compressor = false,
+      .verbosity     = verbosity,
+      .small         = small,
+      .limit_ptr     = &output_limit,
+      .ext_result    = 0};
+
+    ext_result = process_uring(
+      &uring_args, &source_io, &destination_io, uring, source_buffer_length, destination_buffer_length, gvl);
+    if (ext_result != BZS_EXT_ERROR_NOT_IMPLEMENTED) {
+      BZ2_bzDecompressEnd(&stream);
+      bzs_ext_governor_release(reserved_memory);
+
+      ext_result = finish_caches(&source_io, &destination_io, ext_result, gvl);
+
+      if (ext_result != 0) {
+        raise_io_error(ext_result, &source_io, &destination_io);
+      }
+
+      return get_digests_value(&source_io, &destination_io);
+    }
+  }
+
+  bzs_ext_byte_t* source_buffer;
+  bzs_ext_byte_t* destination_buffer;
+
+  ext_result = create_buffers(&source_buffer, source_buffer_length, &destination_buffer, destination_buffer_length);
+  if (ext_result != 0) {
+    BZ2_bzDecompressEnd(&stream);
+    bzs_ext_governor_release(reserved_memory);
+    finish_caches(&source_io, &destination_io, ext_result, gvl);
+    bzs_ext_raise_error(ext_result);
+  }
+
+  reader_t reader = {.function = read_io, .data = &source_io};
+  writer_t writer = {.function = write_io, .data = &destination_io};
+
+  ext_result = decompress(
+    &stream,
+    &reader,
+    source_buffer,
+    source_buffer_length,
+    &writer,
+    destination_buffer,
+    destination_buffer_length,
+    verbosity,
+    small,
+    gvl,
+    &output_limit);
+
+  free(source_buffer);
+  free(destination_buffer);
+  BZ2_bzDecompressEnd(&stream);
+  bzs_ext_governor_release(reserved_memory);
+
+  ext_result = finish_caches(&source_io, &destination_io, ext_result, gvl);
+
+  if (ext_result != 0) {
+    raise_io_error(ext_result, &source_io, &destination_io);
+  }
+
+  return get_digests_value(&source_io, &destination_io);
+}
+
+// -- decompress lines --
+
+typedef struct
+{
+  bzs_ext_line_splitter_t* line_splitter_ptr;
+  size_t                   batch;
+  VALUE                    batch_value;
+} lines_t;
+
+static bzs_ext_result_t yield_line(void* data, const bzs_ext_byte_t* line, size_t line_length)
+{
+  lines_t* lines_ptr  = data;
+  VALUE    line_value = rb_str_new((const char*) line, line_length);
+
+  if (lines_ptr->batch == 0) {
+    rb_yield(line_value);
+    return 0;
+  }
+
+  rb_ary_push(lines_ptr->batch_value, line_value);
+
+  if ((size_t) RARRAY_LEN(lines_ptr->batch_value) == lines_ptr->batch) {
+    VALUE batch_value      = lines_ptr->batch_value;
+    lines_ptr->batch_value = rb_ary_new();
+
+    rb_yield(batch_value);
+  }
+
+  return 0;
+}
+
+static bzs_ext_result_t write_lines(void* data, const bzs_ext_byte_t* destination, size_t destination_length)
+{
+  lines_t* lines_ptr = data;
+
+  return bzs_ext_line_splitter_append(
+    lines_ptr->line_splitter_ptr, destination, destination_length, yield_line, lines_ptr);
+}
+
+typedef struct
+{
+  bz_stream*            stream_ptr;
+  reader_t*             reader_ptr;
+  bzs_ext_byte_t*       source_buffer;
+  size_t                source_buffer_length;
+  bzs_ext_byte_t*       destination_buffer;
+  size_t                destination_buffer_length;
+  bzs_ext_option_t      verbosity;
+  bzs_ext_option_t      small;
+  bool                  gvl;
+  bzs_ext_reservation_t reserved_memory;
+  lines_t               lines;
+  bzs_ext_limit_t       output_limit;
+} each_line_args_t;
+
+static VALUE each_line(VALUE args_value)
+{
+  each_line_args_t* args   = (each_line_args_t*) args_value;
+  writer_t          writer = {.function = write_lines, .data = &args->lines};
+
+  bzs_ext_result_t ext_result = decompress(
+    args->stream_ptr,
+    args->reader_ptr,
+    args->source_buffer,
+    args->source_buffer_length,
+    &writer,
+    args->destination_buffer,
+    args->destination_buffer_length,
+    args->verbosity,
+    args->small,
+    args->gvl,
+    &args->output_limit);
+
+  if (ext_result == 0) {
+    ext_result = bzs_ext_line_splitter_finish(args->lines.line_splitter_ptr, yield_line, &args->lines);
+  }
+
+  if (ext_result != 0) {
+    bzs_ext_raise_error(ext_result);
+  }
+
+  // Last batch can be incomplete.
+  if (args->lines.batch != 0 && RARRAY_LEN(args->lines.batch_value) != 0) {
+    rb_yield(args->lines.batch_value);
+  }
+
+  return Qnil;
+}
+
+// Block can break iteration or raise error, resources should be released anyway.
+
+static VALUE each_line_ensure(VALUE args_value)
+{
+  each_line_args_t* args = (each_line_args_t*) args_value;
+
+  free(args->source_buffer);
+  free(args->destination_buffer);
+  BZ2_bzDecompressEnd(args->stream_ptr);
+  bzs_ext_governor_release(args->reserved_memory);
+  bzs_ext_destroy_line_splitter(args->lines.line_splitter_ptr);
+
+  return Qnil;
+}
+
+VALUE bzs_ext_each_line_io(VALUE BZS_EXT_UNUSED(self), VALUE source, VALUE separator, VALUE options)
+{
+  GET_FILE(source);
+  Check_Type(separator, T_STRING);
+  Check_Type(options, T_HASH);
+  BZS_EXT_GET_SIZE_OPTION(options, source_buffer_length);
+  BZS_EXT_GET_SIZE_OPTION(options, destination_buffer_length);
+  BZS_EXT_GET_BOOL_OPTION(options, gvl);
+  BZS_EXT_RESOLVE_DECOMPRESSOR_OPTIONS(options);
+  BZS_EXT_RESOLVE_LIMIT_OPTIONS(options);
+  BZS_EXT_RESOLVE_SIZE_OPTION(options, batch, BZS_DEFAULT_BATCH);
+
+  bzs_ext_reservation_t reserved_memory;
+
+  bzs_ext_result_t ext_result = bzs_ext_governor_reserve_decompressors(1, &small, &reserved_memory);
+  if (ext_result != 0) {
+    bzs_ext_raise_error(ext_result);
+  }
+
+  bzs_ext_line_splitter_t* line_splitter_ptr;
+
+  ext_result = bzs_ext_create_line_splitter(
+    &line_splitter_ptr, (const bzs_ext_byte_t*) RSTRING_PTR(separator), RSTRING_LEN(separator));
+  if (ext_result != 0) {
+    bzs_ext_governor_release(reserved_memory);
+    bzs_ext_raise_error(ext_result);
+  }
+
+  bz_stream stream = {
+    .bzalloc = NULL,
+    .bzfree  = NULL,
+    .opaque  = NULL,
+  };
+
+  bzs_result_t result = BZ2_bzDecompressInit(&stream, verbosity, small);
+  if (result != BZ_OK) {
+    bzs_ext_destroy_line_splitter(line_splitter_ptr);
+    bzs_ext_governor_release(reserved_memory);
+    bzs_ext_raise_error(bzs_ext_get_error(result));
+  }
+
+  if (source_buffer_length == 0) {
+    source_buffer_length = BZS_DEFAULT_SOURCE_BUFFER_LENGTH_FOR_DECOMPRESSOR;
+  }
+  if (destination_buffer_length == 0) {
+    destination_buffer_length = BZS_DEFAULT_DESTINATION_BUFFER_LENGTH_FOR_DECOMPRESSOR;
+  }
+
+  bzs_ext_byte_t* source_buffer;
+  bzs_ext_byte_t* destination_buffer;
+
+  ext_result = create_buffers(&source_buffer, source_buffer_length, &destination_buffer, destination_buffer_length);
+  if (ext_result != 0) {
+    BZ2_bzDecompressEnd(&stream);
+    bzs_ext_destroy_line_splitter(line_splitter_ptr);
+    bzs_ext_governor_release(reserved_memory);
+    bzs_ext_raise_error(ext_result);
+  }
+
+  lines_t  lines  = {.line_splitter_ptr = line_splitter_ptr, .batch = batch, .batch_value = rb_ary_new()};
+  reader_t reader = {.function = read_file, .data = source_file};
+
+  each_line_args_t args = {
+    .stream_ptr                = &stream,
+    .reader_ptr                = &reader,
+    .source_buffer             = source_buffer,
+    .source_buffer_length      = source_buffer_length,
+    .destination_buffer        = destination_buffer,
+    .destination_buffer_length = destination_buffer_length,
+    .verbosity                 = verbosity,
+    .small                     = small,
+    .gvl                       = gvl,
+    .reserved_memory           = reserved_memory,
+    .lines                     = lines};
+
+  bzs_ext_init_limit(&args.output_limit, max_output_size, max_ratio, 0);
+
+  rb_ensure(each_line, (VALUE) &args, each_line_ensure, (VALUE) &args);
+
+  RB_GC_GUARD(args.lines.batch_value);
+
+  return Qnil;
+}
+
+// -- grep --
+
+// Grep works without global VM lock, matching lines are collected without ruby objects.
+
+#define BZS_GREP_SEPARATOR                '\n'
+#define BZS_INITIAL_GREP_MATCHES_CAPACITY 16
+#define BZS_INITIAL_GREP_LINES_CAPACITY   (1 << 12) // 4 KB
+
+typedef struct
+{
+  size_t offset;
+  size_t line_offset;
+  size_t line_length;
+} grep_match_t;
+
+typedef struct
+{
+  bzs_ext_pattern_t*       pattern_ptr;
+  bzs_ext_line_splitter_t* line_splitter_ptr;
+  size_t                   offset;
+  grep_match_t*            matches;
+  size_t                   matches_count;
+  size_t                   matches_capacity;
+  bzs_ext_byte_t*          lines;
+  size_t                   lines_length;
+  size_t                   lines_capacity;
+} grep_t;
+
+static inline bzs_ext_result_t
+  append_grep_match(grep_t* grep_ptr, size_t offset, const bzs_ext_byte_t* line, size_t line_length)
+{
+  if (grep_ptr->matches_count == grep_ptr->matches_capacity) {
+    size_t matches_capacity =
+      grep_ptr->matches_capacity == 0 ? BZS_INITIAL_GREP_MATCHES_CAPACITY : grep_ptr->matches_capacity * 2;
+
+    grep_match_t* matches = realloc(grep_ptr->matches, matches_capacity * sizeof(grep_match_t));
+    if (matches == NULL) {
+      return BZS_EXT_ERROR_ALLOCATE_FAILED;
+    }
+
+    grep_ptr->matches          = matches;
+    grep_ptr->matches_capacity = matches_capacity;
+  }
+
+  size_t lines_length = grep_ptr->lines_length + line_length;
+
+  if (lines_length > grep_ptr->lines_capacity) {
+    size_t lines_capacity =
+      grep_ptr->lines_capacity == 0 ? BZS_INITIAL_GREP_LINES_CAPACITY : grep_ptr->lines_capacity;
+    while (lines_capacity < lines_length) {
+      lines_capacity *= 2;
+    }
+
+    bzs_ext_byte_t* lines = realloc(grep_ptr->lines, lines_capacity);
+    if (lines == NULL) {
+      return BZS_EXT_ERROR_ALLOCATE_FAILED;
+    }
+
+    grep_ptr->lines          = lines;
+    grep_ptr->lines_capacity = lines_capacity;
+  }
+
+  memcpy(grep_ptr->lines + grep_ptr->lines_length, line, line_length);
+
+  grep_ptr->matches[grep_ptr->matches_count++] =
+    (grep_match_t){.offset = offset, .line_offset = grep_ptr->lines_length, .line_length = line_length};
+  grep_ptr->lines_length = lines_length;
+
+  return 0;
+}
+
+static bzs_ext_result_t match_line(void* data, const bzs_ext_byte_t* line, size_t line_length)
+{
+  grep_t* grep_ptr = data;
+  size_t  offset   = grep_ptr->offset;
+
+  grep_ptr->offset += line_length;
+
+  // Separator is not a part of line for pattern.
+  size_t text_length = line_length;
+  if (text_length != 0 && line[text_length - 1] == BZS_GREP_SEPARATOR) {
+    text_length--;
+  }
+
+  if (!bzs_ext_pattern_match(grep_ptr->pattern_ptr, line, text_length)) {
+    return 0;
+  }
+
+  return append_grep_match(grep_ptr, offset, line, line_length);
+}
+
+static bzs_ext_result_t grep_lines(void* data, const bzs_ext_byte_t* destination, size_t destination_length)
+{
+  grep_t* grep_ptr = data;
+
+  return bzs_ext_line_splitter_append(
+    grep_ptr->line_splitter_ptr, destination, destination_length, match_line, grep_ptr);
+}
+
+typedef struct
+{
+  bz_stream*       stream_ptr;
+  reader_t*        reader_ptr;
+  bzs_ext_byte_t*  source_buffer;
+  size_t           source_buffer_length;
+  bzs_ext_byte_t*  destination_buffer;
+  size_t           destination_buffer_length;
+  bzs_ext_option_t verbosity;
+  bzs_ext_option_t small;
+  grep_t*          grep_ptr;
+  bzs_ext_limit_t  output_limit;
+  bzs_ext_result_t ext_result;
+} grep_args_t;
+
+static inline void* grep_wrapper(void* data)
+{
+  grep_args_t* args   = data;
+  writer_t     writer = {.function = grep_lines, .data = args->grep_ptr};
+
+  // Whole loop is running without global VM lock, so decompress should not release it again.
+  args->ext_result = decompress(
+    args->stream_ptr,
+    args->reader_ptr,
+    args->source_buffer,
+    args->source_buffer_length,
+    &writer,
+    args->destination_buffer,
+    args->destination_buffer_length,
+    args->verbosity,
+    args->small,
+    true,
+    &args->output_limit);
+
+  if (args->ext_result == 0) {
+    args->ext_result = bzs_ext_line_splitter_finish(args->grep_ptr->line_splitter_ptr, match_line, args->grep_ptr);
+  }
+
+  return NULL;
+}
+
+static inline VALUE get_grep_matches(const grep_t* grep_ptr)
+{
+  VALUE matches = rb_ary_new_capa(grep_ptr->matches_count);
+
+  for (size_t index = 0; index < grep_ptr->matches_count; index++) {
+    const grep_match_t* match_ptr = &grep_ptr->matches[index];
+
+    VALUE offset = SIZET2NUM(match_ptr->offset);
+    VALUE line   = rb_str_new((const char*) grep_ptr->lines + match_ptr->line_offset, match_ptr->line_length);
+
+    rb_ary_push(matches, rb_ary_new_from_args(2, offset, line));
+  }
+
+  return matches;
+}
+
+static inline void release_grep(grep_t* grep_ptr)
+{
+  if (grep_ptr->matches != NULL) {
+    free(grep_ptr->matches);
+  }
+
+  if (grep_ptr->lines != NULL) {
+    free(grep_ptr->lines);
+  }
+
+  bzs_ext_destroy_line_splitter(grep_ptr->line_splitter_ptr);
+  bzs_ext_destroy_pattern(grep_ptr->pattern_ptr);
+}
+
+VALUE bzs_ext_grep_io(VALUE BZS_EXT_UNUSED(self), VALUE source, VALUE pattern, VALUE is_regexp, VALUE options)
+{
+  GET_FILE(source);
+  Check_Type(pattern, T_STRING);
+  Check_Type(options, T_HASH);
+  BZS_EXT_GET_SIZE_OPTION(options, source_buffer_length);
+  BZS_EXT_GET_SIZE_OPTION(options, destination_buffer_length);
+  BZS_EXT_GET_BOOL_OPTION(options, gvl);
+  BZS_EXT_RESOLVE_DECOMPRESSOR_OPTIONS(options);
+  BZS_EXT_RESOLVE_LIMIT_OPTIONS(options);
+
+  bzs_ext_reservation_t reserved_memory;
+
+  bzs_ext_result_t ext_result = bzs_ext_governor_reserve_decompressors(1, &small, &reserved_memory);
+  if (ext_result != 0) {
+    bzs_ext_raise_error(ext_result);
+  }
+
+  bzs_ext_pattern_t* pattern_ptr;
+
+  ext_result = bzs_ext_create_pattern(
+    &pattern_ptr, (const bzs_ext_byte_t*) RSTRING_PTR(pattern), RSTRING_LEN(pattern), RTEST(is_regexp));
+  if (ext_result != 0) {
+    bzs_ext_governor_release(reserved_memory);
+    bzs_ext_raise_error(ext_result);
+  }
+
+  const bzs_ext_byte_t     separator = BZS_GREP_SEPARATOR;
+  bzs_ext_line_splitter_t* line_splitter_ptr;
+
+  ext_result = bzs_ext_create_line_splitter(&line_splitter_ptr, &separator, 1);
+  if (ext_result != 0) {
+    bzs_ext_destroy_pattern(pattern_ptr);
+    bzs_ext_governor_release(reserved_memory);
+    bzs_ext_raise_error(ext_result);
+  }
+
+  grep_t grep = {.pattern_ptr = pattern_ptr, .line_splitter_ptr = line_splitter_ptr};
+
+  bz_stream stream = {
+    .bzalloc = NULL,
+    .bzfree  = NULL,
+    .opaque  = NULL,
+  };
+
+  bzs_result_t result = BZ2_bzDecompressInit(&stream, verbosity, small);
+  if (result != BZ_OK) {
+    release_grep(&grep);
+    bzs_ext_governor_release(reserved_memory);
+    bzs_ext_raise_error(bzs_ext_get_error(result));
+  }
+
+  if (source_buffer_length == 0) {
+    source_buffer_length = BZS_DEFAULT_SOURCE_BUFFER_LENGTH_FOR_DECOMPRESSOR;
+  }
+  if (destination_buffer_length == 0) {
+    destination_buffer_length = BZS_DEFAULT_DESTINATION_BUFFER_LENGTH_FOR_DECOMPRESSOR;
+  }
+
+  bzs_ext_byte_t* source_buffer;
+  bzs_ext_byte_t* destination_buffer;
+
+  ext_result = create_buffers(&source_buffer, source_buffer_length, &destination_buffer, destination_buffer_length);
+  if (ext_result != 0) {
+    BZ2_bzDecompressEnd(&stream);
+    bzs_ext_governor_release(reserved_memory);
+    release_grep(&grep);
+    bzs_ext_raise_error(ext_result);
+  }
+
+  reader_t reader = {.function = read_file, .data = source_file};
+
+  grep_args_t args = {
+    .stream_ptr                = &stream,
+    .reader_ptr                = &reader,
+    .source_buffer             = source_buffer,
+    .source_buffer_length      = source_buffer_length,
+    .destination_buffer        = destination_buffer,
+    .destination_buffer_length = destination_buffer_length,
+    .verbosity                 = verbosity,
+    .small                     = small,
+    .grep_ptr                  = &grep,
+    .ext_result                = 0};
+
+  bzs_ext_init_limit(&args.output_limit, max_output_size, max_ratio, 0);
+
+  BZS_EXT_GVL_WRAP(gvl, grep_wrapper, &args);
+
+  free(source_buffer);
+  free(destination_buffer);
+  BZ2_bzDecompressEnd(&stream);
+  bzs_ext_governor_release(reserved_memory);
+
+  if (args.ext_result != 0) {
+    release_grep(&grep);
+    bzs_ext_raise_error(args.ext_result);
+  }
+
+  VALUE matches = get_grep_matches(&grep);
+
+  release_grep(&grep);
+
+  return matches;
+}
+
+// -- recompress --
+
+typedef struct
+{
+  bzs_ext_recompressor_t* recompressor_ptr;
+  FILE*                   source_file;
+  bzs_ext_byte_t*         source_buffer;
+  size_t                  source_buffer_length;
+  writer_t*               writer_ptr;
+  bzs_ext_result_t        ext_result;
+} recompress_args_t;
+
+static inline bzs_ext_result_t recompress(recompress_args_t* args)
+{
+  bzs_ext_result_t ext_result;
+  writer_t*        writer_ptr = args->writer_ptr;
+
+  while (true) {
+    size_t source_length;
+
+    ext_result = read_file(args->source_file, args->source_buffer, &source_length, args->source_buffer_length);
+    if (ext_result == BZS_EXT_FILE_READ_FINISHED) {
+      break;
+    } else if (ext_result != 0) {
+      return ext_result;
+    }
+
+    ext_result = bzs_ext_recompressor_append(
+      args->recompressor_ptr, args->source_buffer, source_length, writer_ptr->function, writer_ptr->data);
+    if (ext_result != 0) {
+      return ext_result;
+    }
+  }
+
+  return bzs_ext_recompressor_finish(args->recompressor_ptr, writer_ptr->function, writer_ptr->data);
+}
+
+static inline void* recompress_wrapper(void* data)
+{
+  recompress_args_t* args = data;
+
+  args->ext_result = recompress(args);
+
+  return NULL;
+}
+
+VALUE bzs_ext_recompress_io(VALUE BZS_EXT_UNUSED(self), VALUE source, VALUE destination, VALUE options)
+{
+  GET_FILE(source);
+  GET_FILE(destination);
+  Check_Type(options, T_HASH);
+  BZS_EXT_GET_SIZE_OPTION(options, source_buffer_length);
+  BZS_EXT_GET_SIZE_OPTION(options, destination_buffer_length);
+  BZS_EXT_GET_BOOL_OPTION(options, gvl);
+  BZS_EXT_RESOLVE_COMPRESSOR_OPTIONS(options);
+  BZS_EXT_RESOLVE_BOOL_OPTION(options, small, BZS_DEFAULT_SMALL);
+  BZS_EXT_RESOLVE_BOOL_OPTION(options, index, BZS_DEFAULT_INDEX);
+  BZS_EXT_RESOLVE_SIZE_OPTION(options, member_size, BZS_DEFAULT_MEMBER_SIZE);
+
+  if (source_buffer_length == 0) {
+    source_buffer_length = BZS_DEFAULT_SOURCE_BUFFER_LENGTH_FOR_DECOMPRESSOR;
+  }
+  if (destination_buffer_length == 0) {
+    destination_buffer_length = BZS_DEFAULT_DESTINATION_BUFFER_LENGTH_FOR_COMPRESSOR;
+  }
+
+  // Recompressor reservation can wait for memory and raise pending interrupt, so it is created first.
+  bzs_ext_recompressor_t* recompressor_ptr;
+
+  bzs_ext_result_t ext_result = bzs_ext_create_recompressor(
+    &recompressor_ptr, block_size, work_factor, verbosity, small, destination_buffer_length);
+  if (ext_result != 0) {
+    bzs_ext_raise_error(ext_result);
+  }
+
+  bzs_ext_byte_t* source_buffer = malloc(source_buffer_length);
+  if (source_buffer == NULL) {
+    bzs_ext_destroy_recompressor(recompressor_ptr);
+    bzs_ext_raise_error(BZS_EXT_ERROR_ALLOCATE_FAILED);
+  }
+
+  bzs_ext_index_t* index_ptr = NULL;
+
+  if (index) {
+    ext_result = bzs_ext_create_index(&index_ptr, block_size);
+    if (ext_result != 0) {
+      bzs_ext_destroy_recompressor(recompressor_ptr);
+      free(source_buffer);
+      bzs_ext_raise_error(ext_result);
+    }
+  }
+
+  recompressor_ptr->member_size = member_size;
+  recompressor_ptr->index_ptr   = index_ptr;
+
+  writer_t writer = {.function = write_file, .data = destination_file};
+
+  recompress_args_t args = {
+    .recompressor_ptr     = recompressor_ptr,
+    .source_file          = source_file,
+    .source_buffer        = source_buffer,
+    .source_buffer_length = source_buffer_length,
+    .writer_ptr           = &writer,
+    .ext_result           = 0};
+
+  // Whole recompression is running without global VM lock.
+  BZS_EXT_GVL_WRAP(gvl, recompress_wrapper, &args);
+
+  ext_result = args.ext_result;
+
+  bzs_ext_destroy_recompressor(recompressor_ptr);
+  free(source_buffer);
+
+  VALUE index_value = Qnil;
+
+  if (index_ptr != NULL) {
+    if (ext_result == 0) {
+      index_value = rb_str_new((const char*) index_ptr->records, index_ptr->records_length);
+    }
+
+    bzs_ext_destroy_index(index_ptr);
+  }
+
+  if (ext_result != 0) {
+    bzs_ext_raise_error(ext_result);
+  }
+
+  // Ruby itself won't flush stdio file before closing fd, flush is required.
+  fflush(destination_file);
+
+  return index_value;
+}
+
+// -- many --
+
+// Each pair of files is processed independently, error of one pair doesn't stop other pairs.
+// Source of compressed file is split into chunks, each chunk is compressed as separate member by any worker.
+// So single large file is compressed by all workers, bzip2 decompressor is able to read concatenated members.
+// Finished members are written into destination in order by worker that finished next member.
+// Bzip2 can't find block boundaries without decompression, so each decompressed file is processed by single worker.
+
+typedef struct
+{
+  char*             source_path;
+  char*             destination_path;
+  FILE*             destination_file;
+  size_t            source_length;
+  bzs_ext_member_t* members;
+  bool*             is_member_finished;
+  size_t            members_count;
+  size_t            written_members_count;
+  pthread_mutex_t   mutex;
+  bool              is_mutex_initialized;
+  bzs_ext_result_t  ext_result;
+} many_file_t;
+
+typedef struct
+{
+  many_file_t*     files;
+  size_t           files_count;
+  size_t           chunk_length;
+  size_t           source_buffer_length;
+  size_t           destination_buffer_length;
+  bzs_ext_option_t verbosity;
+  bzs_ext_option_t small;
+  size_t           max_output_size;
+  size_t           max_ratio;
+} many_t;
+
+typedef struct
+{
+  many_t*      many_ptr;
+  many_file_t* file_ptr;
+  size_t       member_index;
+} many_chunk_t;
+
+static inline char* copy_path(VALUE path)
+{
+  const char* path_value  = StringValueCStr(path);
+  size_t      path_length = strlen(path_value) + 1;
+
+  char* result = malloc(path_length);
+  if (result != NULL) {
+    memcpy(result, path_value, path_length);
+  }
+
+  return result;
+}
+
+static inline void release_many(many_t* many_ptr)
+{
+  for (size_t index = 0; index < many_ptr->files_count; index++) {
+    many_file_t* file_ptr = &many_ptr->files[index];
+
+    if (file_ptr->members != NULL) {
+      for (size_t member_index = 0; member_index < file_ptr->members_count; member_index++) {
+        free(file_ptr->members[member_index].destination);
+      }
+    }
+
+    if (file_ptr->destination_file != NULL) {
+      fclose(file_ptr->destination_file);
+    }
+
+    if (file_ptr->is_mutex_initialized) {
+      pthread_mutex_destroy(&file_ptr->mutex);
+    }
+
+    free(file_ptr->source_path);
+    free(file_ptr->destination_path);
+    free(file_ptr->members);
+    free(file_ptr->is_member_finished);
+  }
+
+  free(many_ptr->files);
+}
+
+// Pairs are validated before memory reservation, so init can't raise.
+static inline void validate_pairs(VALUE pairs)
+{
+  Check_Type(pairs, T_ARRAY);
+
+  size_t files_count = RARRAY_LEN(pairs);
+
+  for (size_t index = 0; index < files_count; index++) {
+    VALUE pair = rb_ary_entry(pairs, index);
+    Check_Type(pair, T_ARRAY);
+
+    if (RARRAY_LEN(pair) != 2) {
+      bzs_ext_raise_error(BZS_EXT_ERROR_VALIDATE_FAILED);
+    }
+
+    VALUE source      = rb_ary_entry(pair, 0);
+    VALUE destination = rb_ary_entry(pair, 1);
+    StringValueCStr(source);
+    StringValueCStr(destination);
+  }
+}
+
+static inline bzs_ext_result_t init_many(many_t* many_ptr, VALUE pairs)
+{
+  size_t files_count = RARRAY_LEN(pairs);
+
+  many_ptr->files       = calloc(files_count != 0 ? files_count : 1, sizeof(many_file_t));
+  many_ptr->files_count = 0;
+
+  if (many_ptr->files == NULL) {
+    return BZS_EXT_ERROR_ALLOCATE_FAILED;
+  }
+
+  for (size_t index = 0; index < files_count; index++) {
+    VALUE        pair     = rb_ary_entry(pairs, index);
+    many_file_t* file_ptr = &many_ptr->files[index];
+
+    many_ptr->files_count++;
+
+    file_ptr->source_path          = copy_path(rb_ary_entry(pair, 0));
+    file_ptr->destination_path     = copy_path(rb_ary_entry(pair, 1));
+    file_ptr->is_mutex_initialized = pthread_mutex_init(&file_ptr->mutex, NULL) == 0;
+
+    if (file_ptr->source_path == NULL || file_ptr->destination_path == NULL || !file_ptr->is_mutex_initialized) {
+      release_many(many_ptr);
+      return BZS_EXT_ERROR_ALLOCATE_FAILED;
+    }
+  }
+
+  return 0;
+}
+
+static inline VALUE get_many_results(const many_t* many_ptr)
+{
+  VALUE results = rb_ary_new_capa(many_ptr->files_count);
+
+  for (size_t index = 0; index < many_ptr->files_count; index++) {
+    bzs_ext_result_t ext_result = many_ptr->files[index].ext_result;
+    rb_ary_push(results, ext_result == 0 ? Qnil : bzs_ext_new_error(ext_result));
+  }
+
+  return results;
+}
+
+typedef struct
+{
+  bzs_ext_task_t*  tasks;
+  size_t           tasks_count;
+  size_t           threads_count;
+  bzs_ext_result_t ext_result;
+} run_tasks_args_t;
+
+static inline void* run_tasks_wrapper(void* data)
+{
+  run_tasks_args_t* args = data;
+
+  args->ext_result = bzs_ext_run_tasks(args->tasks, args->tasks_count, args->threads_count);
+
+  return NULL;
+}
+
+// -- compress many --
+
+static inline bzs_ext_result_t
+  read_chunk(const char* source_path, off_t source_offset, bzs_ext_byte_t* source, size_t source_length)
+{
+  // Each worker uses its own descriptor, so chunks of the same file can be read at the same time.
+  int source_fd = open(source_path, O_RDONLY);
+  if (source_fd == -1) {
+    return BZS_EXT_ERROR_ACCESS_IO;
+  }
+
+  while (source_length != 0) {
+    ssize_t read_length = pread(source_fd, source, source_length, source_offset);
+    if (read_length <= 0) {
+      close(source_fd);
+      return BZS_EXT_ERROR_READ_IO;
+    }
+
+    source += read_length;
+    source_length -= read_length;
+    source_offset += read_length;
+  }
+
+  close(source_fd);
+
+  return 0;
+}
+
+static inline bzs_ext_result_t write_member(many_file_t* file_ptr, const bzs_ext_member_t* member_ptr)
+{
+  if (file_ptr->destination_file == NULL) {
+    file_ptr->destination_file = fopen(file_ptr->destination_path, "wb");
+    if (file_ptr->destination_file == NULL) {
+      return BZS_EXT_ERROR_ACCESS_IO;
+    }
+  }
+
+  return write_file(file_ptr->destination_file, member_ptr->destination, member_ptr->destination_length);
+}
+
+static inline void finish_member(many_file_t* file_ptr, size_t member_index, bzs_ext_result_t ext_result)
+{
+  pthread_mutex_lock(&file_ptr->mutex);
+
+  if (file_ptr->ext_result == 0) {
+    file_ptr->ext_result = ext_result;
+  }
+
+  file_ptr->is_member_finished[member_index] = true;
+
+  while (file_ptr->written_members_count != file_ptr->members_count &&
+         file_ptr->is_member_finished[file_ptr->written_members_count]) {
+    bzs_ext_member_t* member_ptr = &file_ptr->members[file_ptr->written_members_count];
+
+    if (file_ptr->ext_result == 0) {
+      file_ptr->ext_result = write_member(file_ptr, member_ptr);
+    }
+
+    free(member_ptr->destination);
+    member_ptr->destination = NULL;
+
+    file_ptr->written_members_count++;
+  }
+
+  if (file_ptr->written_members_count == file_ptr->members_count && file_ptr->destination_file != NULL) {
+    if (fclose(file_ptr->destination_file) != 0 && file_ptr->ext_result == 0) {
+      file_ptr->ext_result = BZS_EXT_ERROR_WRITE_IO;
+    }
+
+    file_ptr->destination_file = NULL;
+  }
+
+  pthread_mutex_unlock(&file_ptr->mutex);
+}
+
+static void compress_chunk(void* data)
+{
+  many_chunk_t*     chunk_ptr    = data;
+  many_file_t*      file_ptr     = chunk_ptr->file_ptr;
+  size_t            member_index = chunk_ptr->member_index;
+  bzs_ext_member_t* member_ptr   = &file_ptr->members[member_index];
+
+  pthread_mutex_lock(&file_ptr->mutex);
+  bzs_ext_result_t ext_result = file_ptr->ext_result;
+  pthread_mutex_unlock(&file_ptr->mutex);
+
+  // Other members are not required when file has failed.
+  if (ext_result != 0) {
+    finish_member(file_ptr, member_index, 0);
+    return;
+  }
+
+  bzs_ext_byte_t* source = malloc(member_ptr->source_length != 0 ? member_ptr->source_length : 1);
+  if (source == NULL) {
+    finish_member(file_ptr, member_index, BZS_EXT_ERROR_ALLOCATE_FAILED);
+    return;
+  }
+
+  off_t source_offset = (off_t) (member_index * chunk_ptr->many_ptr->chunk_length);
+
+  ext_result = read_chunk(file_ptr->source_path, source_offset, source, member_ptr->source_length);
+  if (ext_result == 0) {
+    member_ptr->source = source;
+    bzs_ext_compress_member(member_ptr);
+    member_ptr->source = NULL;
+
+    ext_result = member_ptr->ext_result;
+  }
+
+  free(source);
+
+  finish_member(file_ptr, member_index, ext_result);
+}
+
+static inline bzs_ext_result_t init_compress_file(
+  many_file_t*     file_ptr,
+  size_t           chunk_length,
+  bzs_ext_option_t block_size,
+  bzs_ext_option_t work_factor,
+  bzs_ext_option_t verbosity)
+{
+  struct stat source_stat;
+  if (stat(file_ptr->source_path, &source_stat) != 0) {
+    return BZS_EXT_ERROR_ACCESS_IO;
+  }
+
+  size_t source_length = (size_t) source_stat.st_size;
+  size_t members_count = (source_length + chunk_length - 1) / chunk_length;
+  if (members_count == 0) {
+    // Empty source should be compressed into empty member.
+    members_count = 1;
+  }
+
+  file_ptr->members            = calloc(members_count, sizeof(bzs_ext_member_t));
+  file_ptr->is_member_finished = calloc(members_count, sizeof(bool));
+  if (file_ptr->members == NULL || file_ptr->is_member_finished == NULL) {
+    return BZS_EXT_ERROR_ALLOCATE_FAILED;
+  }
+
+  for (size_t index = 0; index < members_count; index++) {
+    bzs_ext_member_t* member_ptr = &file_ptr->members[index];
+    size_t            offset     = index * chunk_length;
+
+    member_ptr->source_length = source_length - offset < chunk_length ? source_length - offset : chunk_length;
+    member_ptr->block_size    = block_size;
+    member_ptr->work_factor   = work_factor;
+    member_ptr->verbosity     = verbosity;
+  }
+
+  file_ptr->source_length = source_length;
+  file_ptr->members_count = members_count;
+
+  return 0;
+}
+
+VALUE bzs_ext_compress_many(VALUE BZS_EXT_UNUSED(self), VALUE pairs, VALUE options)
+{
+  Check_Type(options, T_HASH);
+  BZS_EXT_GET_BOOL_OPTION(options, gvl);
+  BZS_EXT_RESOLVE_COMPRESSOR_OPTIONS(options);
+  BZS_EXT_RESOLVE_SIZE_OPTION(options, threads, BZS_DEFAULT_POOL_THREADS);
+  BZS_EXT_RESOLVE_SIZE_OPTION(options, member_size, BZS_DEFAULT_MEMBER_SIZE);
+  validate_pairs(pairs);
+
+  // Each thread compresses its own chunk, count of chunks is not known before files are opened.
+  size_t threads_count = bzs_ext_get_threads_count(threads);
+  bzs_ext_reservation_t reserved_memory;
+
+  bzs_ext_result_t ext_result = bzs_ext_governor_reserve_compressors(block_size, threads_count, &reserved_memory);
+  if (ext_result != 0) {
+    bzs_ext_raise_error(ext_result);
+  }
+
+  many_t many = {.chunk_length = member_size != 0 ? member_size : (size_t) block_size * BZS_BLOCK_SIZE_UNIT};
+  ext_result = init_many(&many, pairs);
+  if (ext_result != 0) {
+    bzs_ext_governor_release(reserved_memory);
+    bzs_ext_raise_error(ext_result);
+  }
+
+  size_t chunks_count = 0;
+
+  for (size_t index = 0; index < many.files_count; index++) {
+    many_file_t* file_ptr = &many.files[index];
+
+    file_ptr->ext_result = init_compress_file(file_ptr, many.chunk_length, block_size, work_factor, verbosity);
+    if (file_ptr->ext_result == BZS_EXT_ERROR_ALLOCATE_FAILED) {
+      release_many(&many);
+      bzs_ext_governor_release(reserved_memory);
+      bzs_ext_raise_error(BZS_EXT_ERROR_ALLOCATE_FAILED);
+    }
+
+    chunks_count += file_ptr->members_count;
+  }
+
+  many_chunk_t*   chunks = malloc(sizeof(many_chunk_t) * (chunks_count != 0 ? chunks_count : 1));
+  bzs_ext_task_t* tasks  = malloc(sizeof(bzs_ext_task_t) * (chunks_count != 0 ? chunks_count : 1));
+  if (chunks == NULL || tasks == NULL) {
+    free(chunks);
+    free(tasks);
+    release_many(&many);
+    bzs_ext_governor_release(reserved_memory);
+    bzs_ext_raise_error(BZS_EXT_ERROR_ALLOCATE_FAILED);
+  }
+
+  size_t chunk_index = 0;
+
+  for (size_t index = 0; index < many.files_count; index++) {
+    many_file_t* file_ptr = &many.files[index];
+
+    for (size_t member_index = 0; member_index < file_ptr->members_count; member_index++) {
+      many_chunk_t* chunk_ptr = &chunks[chunk_index];
+
+      chunk_ptr->many_ptr     = &many;
+      chunk_ptr->file_ptr     = file_ptr;
+      chunk_ptr->member_index = member_index;
+
+      tasks[chunk_index].function = compress_chunk;
+      tasks[chunk_index].data     = chunk_ptr;
+
+      chunk_index++;
+    }
+  }
+
+  run_tasks_args_t args = {
+    .tasks         = tasks,
+    .tasks_count   = chunks_count,
+    .threads_count = threads_count};
+
+  BZS_EXT_GVL_WRAP(gvl, run_tasks_wrapper, &args);
+  bzs_ext_governor_release(reserved_memory);
+
+  free(chunks);
+  free(tasks);
+
+  if (args.ext_result != 0) {
+    release_many(&many);
+    bzs_ext_raise_error(args.ext_result);
+  }
+
+  VALUE results = get_many_results(&many);
+
+  release_many(&many);
+
+  return results;
+}
+
+// -- decompress many --
+
+static inline bzs_ext_result_t decompress_file(many_t* many_ptr, many_file_t* file_ptr)
+{
+  FILE* source_file = fopen(file_ptr->source_path, "rb");
+  if (source_file == NULL) {
+    return BZS_EXT_ERROR_ACCESS_IO;
+  }
+
+  FILE* destination_file = fopen(file_ptr->destination_path, "wb");
+  if (destination_file == NULL) {
+    fclose(source_file);
+    return BZS_EXT_ERROR_ACCESS_IO;
+  }
+
+  bz_stream stream = {
+    .bzalloc = NULL,
+    .bzfree  = NULL,
+    .opaque  = NULL,
+  };
+
+  bzs_ext_result_t ext_result;
+
+  bzs_result_t result = BZ2_bzDecompressInit(&stream, many_ptr->verbosity, many_ptr->small);
+  if (result != BZ_OK) {
+    ext_result = bzs_ext_get_error(result);
+  } else {
+    bzs_ext_byte_t* source_buffer;
+    bzs_ext_byte_t* destination_buffer;
+
+    ext_result = create_buffers(
+      &source_buffer, many_ptr->source_buffer_length, &destination_buffer, many_ptr->destination_buffer_length);
+
+    if (ext_result == 0) {
+      reader_t        reader = {.function = read_file, .data = source_file};
+      writer_t        writer = {.function = write_file, .data = destination_file};
+      bzs_ext_limit_t output_limit;
+
+      bzs_ext_init_limit(&output_limit, many_ptr->max_output_size, many_ptr->max_ratio, 0);
+
+      // Worker is already running without GVL.
+      ext_result = decompress(
+        &stream,
+        &reader,
+        source_buffer,
+        many_ptr->source_buffer_length,
+        &writer,
+        destination_buffer,
+        many_ptr->destination_buffer_length,
+        many_ptr->verbosity,
+        many_ptr->small,
+        true,
+        &output_limit);
+
+      free(source_buffer);
+      free(destination_buffer);
+    }
+
+    BZ2_bzDecompressEnd(&stream);
+  }
+
+  fclose(source_file);
+
+  if (fclose(destination_file) != 0 && ext_result == 0) {
+    ext_result = BZS_EXT_ERROR_WRITE_IO;
+  }
+
+  return ext_result;
+}
+
+static void decompress_chunk(void* data)
+{
+  many_chunk_t* chunk_ptr = data;
+
+  chunk_ptr->file_ptr->ext_result = decompress_file(chunk_ptr->many_ptr, chunk_ptr->file_ptr);
+}
+
+VALUE bzs_ext_decompress_many(VALUE BZS_EXT_UNUSED(self), VALUE pairs, VALUE options)
+{
+  Check_Type(options, T_HASH);
+  BZS_EXT_GET_SIZE_OPTION(options, source_buffer_length);
+  BZS_EXT_GET_SIZE_OPTION(options, destination_buffer_length);
+  BZS_EXT_GET_BOOL_OPTION(options, gvl);
+  BZS_EXT_RESOLVE_DECOMPRESSOR_OPTIONS(options);
+  BZS_EXT_RESOLVE_LIMIT_OPTIONS(options);
+  BZS_EXT_RESOLVE_SIZE_OPTION(options, threads, BZS_DEFAULT_POOL_THREADS);
+  validate_pairs(pairs);
+
+  // Each thread decompresses its own file, all decompressors can be downgraded into small mode.
+  size_t files_count   = RARRAY_LEN(pairs);
+  size_t threads_count = bzs_ext_get_threads_count(threads);
+  bzs_ext_reservation_t reserved_memory;
+
+  bzs_ext_result_t ext_result = bzs_ext_governor_reserve_decompressors(
+    files_count < threads_count ? files_count : threads_count, &small, &reserved_memory);
+  if (ext_result != 0) {
+    bzs_ext_raise_error(ext_result);
+  }
+
+  if (source_buffer_length == 0) {
+    source_buffer_length = BZS_DEFAULT_SOURCE_BUFFER_LENGTH_FOR_DECOMPRESSOR;
+  }
+  if (destination_buffer_length == 0) {
+    destination_buffer_length = BZS_DEFAULT_DESTINATION_BUFFER_LENGTH_FOR_DECOMPRESSOR;
+  }
+
+  many_t many = {
+    .source_buffer_length      = source_buffer_length,
+    .destination_buffer_length = destination_buffer_length,
+    .verbosity                 = verbosity,
+    .small                     = small,
+    .max_output_size           = max_output_size,
+    .max_ratio                 = max_ratio};
+
+  ext_result = init_many(&many, pairs);
+  if (ext_result != 0) {
+    bzs_ext_governor_release(reserved_memory);
+    bzs_ext_raise_error(ext_result);
+  }
+
+  many_chunk_t*   chunks = malloc(sizeof(many_chunk_t) * (files_count != 0 ? files_count : 1));
+  bzs_ext_task_t* tasks  = malloc(sizeof(bzs_ext_task_t) * (files_count != 0 ? files_count : 1));
+  if (chunks == NULL || tasks == NULL) {
+    free(chunks);
+    free(tasks);
+    release_many(&many);
+    bzs_ext_governor_release(reserved_memory);
+    bzs_ext_raise_error(BZS_EXT_ERROR_ALLOCATE_FAILED);
+  }
+
+  for (size_t index = 0; index < files_count; index++) {
+    many_chunk_t* chunk_ptr = &chunks[index];
+
+    chunk_ptr->many_ptr     = &many;
+    chunk_ptr->file_ptr     = &many.files[index];
+    chunk_ptr->member_index = 0;
+
+    tasks[index].function = decompress_chunk;
+    tasks[index].data     = chunk_ptr;
+  }
+
+  run_tasks_args_t args = {
+    .tasks         = tasks,
+    .tasks_count   = files_count,
+    .threads_count = threads_count};
+
+  BZS_EXT_GVL_WRAP(gvl, run_tasks_wrapper, &args);
+  bzs_ext_governor_release(reserved_memory);
+
+  free(chunks);
+  free(tasks);
+
+  if (args.ext_result != 0) {
+    release_many(&many);
+    bzs_ext_raise_error(args.ext_result);
+  }
+
+  VALUE results = get_many_results(&many);
+
+  release_many(&many);
+
+  return results;
+}
+
+// -- merge --
+
+// Blocks of all source streams are copied into single destination stream at bit granularity without decompression.
+// Destination stream CRC combines CRCs of all blocks, sources are opened one by one.
+// Destination header is written before block sizes of sources are known, so max block size is written after merge.
+
+#define BZS_MERGE_HEADER "BZh9"
+
+typedef struct
+{
+  char**                source_paths;
+  size_t                sources_count;
+  FILE*                 destination_file;
+  bzs_ext_byte_t*       source_buffer;
+  size_t                source_buffer_length;
+  bzs_ext_bit_writer_t* writer_ptr;
+  uint32_t              block_size;
+  uint32_t              stream_crc;
+  bzs_ext_result_t      ext_result;
+} merge_args_t;
+
+static bzs_ext_result_t merge_block(void* data, bzs_ext_block_event_t event, uint32_t value)
+{
+  merge_args_t* args = data;
+
+  if (event == BZS_BLOCK_STREAM_EVENT) {
+    if (value > args->block_size) {
+      args->block_size = value;
+    }
+  } else if (event == BZS_BLOCK_BLOCK_EVENT) {
+    args->stream_crc = bzs_ext_combine_crc(args->stream_crc, value);
+  }
+
+  return 0;
+}
+
+static inline bzs_ext_result_t merge_source(merge_args_t* args, const char* source_path)
+{
+  FILE* source_file = fopen(source_path, "rb");
+  if (source_file == NULL) {
+    return BZS_EXT_ERROR_ACCESS_IO;
+  }
+
+  bzs_ext_block_scanner_t scanner;
+  bzs_ext_init_block_scanner(&scanner, merge_block, args, args->writer_ptr);
+
+  bzs_ext_result_t ext_result;
+
+  while (true) {
+    size_t source_length;
+
+    ext_result = read_file(source_file, args->source_buffer, &source_length, args->source_buffer_length);
+    if (ext_result == BZS_EXT_FILE_READ_FINISHED) {
+      ext_result = bzs_ext_block_scanner_finish(&scanner);
+      break;
+    } else if (ext_result != 0) {
       break;
     }
 
-    if (*args.remaining_source_length_ptr != 0 || remaining_destination_buffer_length == 0) {
-      ext_result = flush_destination_buffer(
-        destination_file, destination_buffer, destination_length_ptr, destination_buffer_length);
+    ext_result = bzs_ext_block_scanner_append(&scanner, args->source_buffer, source_length);
+    if (ext_result != 0) {
+      break;
+    }
+  }
 
-      if (ext_result != 0) {
-        return ext_result;
-      }
+  fclose(source_file);
 
-      continue;
+  return ext_result;
+}
+
+static inline bzs_ext_result_t merge(merge_args_t* args)
+{
+  FILE* destination_file = args->destination_file;
+
+  long header_offset = ftell(destination_file);
+  if (header_offset < 0) {
+    return BZS_EXT_ERROR_WRITE_IO;
+  }
+
+  bzs_ext_result_t ext_result =
+    write_file(destination_file, (const bzs_ext_byte_t*) BZS_MERGE_HEADER, BZS_STREAM_HEADER_LENGTH);
+  if (ext_result != 0) {
+    return ext_result;
+  }
+
+  for (size_t index = 0; index < args->sources_count; index++) {
+    ext_result = merge_source(args, args->source_paths[index]);
+    if (ext_result != 0) {
+      return ext_result;
     }
+  }
 
-    break;
+  ext_result = bzs_ext_bit_writer_finish_stream(args->writer_ptr, args->stream_crc);
+  if (ext_result != 0) {
+    return ext_result;
+  }
+
+  // Default block size is kept when sources have no streams.
+  if (args->block_size == 0) {
+    return 0;
+  }
+
+  if (fseek(destination_file, header_offset + BZS_STREAM_HEADER_LENGTH - 1, SEEK_SET) != 0) {
+    return BZS_EXT_ERROR_WRITE_IO;
+  }
+
+  if (fputc('0' + (int) args->block_size, destination_file) == EOF || fseek(destination_file, 0, SEEK_END) != 0) {
+    return BZS_EXT_ERROR_WRITE_IO;
   }
 
   return 0;
 }
 
-// -- decompress --
-
-static inline bzs_ext_result_t decompress(
-  bz_stream*      stream_ptr,
-  FILE*           source_file,
-  bzs_ext_byte_t* source_buffer,
-  size_t          source_buffer_length,
-  FILE*           destination_file,
-  bzs_ext_byte_t* destination_buffer,
-  size_t          destination_buffer_length,
-  bool            gvl)
+static inline void* merge_wrapper(void* data)
 {
-  bzs_ext_result_t      ext_result;
-  const bzs_ext_byte_t* source             = source_buffer;
-  size_t                source_length      = 0;
-  size_t                destination_length = 0;
+  merge_args_t* args = data;
 
-  BUFFERED_READ_SOURCE(
-    buffered_decompress,
-    stream_ptr,
-    &source,
-    &source_length,
-    destination_file,
-    destination_buffer,
-    &destination_length,
-    destination_buffer_length,
-    gvl);
+  args->ext_result = merge(args);
 
-  return write_remaining_destination(destination_file, destination_buffer, destination_length);
+  return NULL;
 }
 
-VALUE bzs_ext_decompress_io(VALUE BZS_EXT_UNUSED(self), VALUE source, VALUE destination, VALUE options)
+static inline void release_source_paths(char** source_paths, size_t sources_count)
 {
-  GET_FILE(source);
+  for (size_t index = 0; index < sources_count; index++) {
+    free(source_paths[index]);
+  }
+
+  free(source_paths);
+}
+
+VALUE bzs_ext_merge_io(VALUE BZS_EXT_UNUSED(self), VALUE sources, VALUE destination, VALUE options)
+{
+  Check_Type(sources, T_ARRAY);
   GET_FILE(destination);
   Check_Type(options, T_HASH);
   BZS_EXT_GET_SIZE_OPTION(options, source_buffer_length);
   BZS_EXT_GET_SIZE_OPTION(options, destination_buffer_length);
   BZS_EXT_GET_BOOL_OPTION(options, gvl);
-  BZS_EXT_RESOLVE_DECOMPRESSOR_OPTIONS(options);
-
-  bz_stream stream = {
-    .bzalloc = NULL,
-    .bzfree  = NULL,
-    .opaque  = NULL,
-  };
-
-  bzs_result_t result = BZ2_bzDecompressInit(&stream, verbosity, small);
-  if (result != BZ_OK) {
-    bzs_ext_raise_error(bzs_ext_get_error(result));
-  }
 
   if (source_buffer_length == 0) {
     source_buffer_length = BZS_DEFAULT_SOURCE_BUFFER_LENGTH_FOR_DECOMPRESSOR;
   }
   if (destination_buffer_length == 0) {
-    destination_buffer_length = BZS_DEFAULT_DESTINATION_BUFFER_LENGTH_FOR_DECOMPRESSOR;
+    destination_buffer_length = BZS_DEFAULT_DESTINATION_BUFFER_LENGTH_FOR_COMPRESSOR;
   }
 
-  bzs_ext_byte_t* source_buffer;
-  bzs_ext_byte_t* destination_buffer;
+  size_t sources_count = RARRAY_LEN(sources);
+
+  for (size_t index = 0; index < sources_count; index++) {
+    VALUE source = rb_ary_entry(sources, index);
+    StringValueCStr(source);
+  }
+
+  // Paths are copied, sources will be opened without global VM lock.
+  char** source_paths = calloc(sources_count != 0 ? sources_count : 1, sizeof(char*));
+  if (source_paths == NULL) {
+    bzs_ext_raise_error(BZS_EXT_ERROR_ALLOCATE_FAILED);
+  }
+
+  for (size_t index = 0; index < sources_count; index++) {
+    source_paths[index] = copy_path(rb_ary_entry(sources, index));
+    if (source_paths[index] == NULL) {
+      release_source_paths(source_paths, index);
+      bzs_ext_raise_error(BZS_EXT_ERROR_ALLOCATE_FAILED);
+    }
+  }
+
+  bzs_ext_byte_t* source_buffer = malloc(source_buffer_length);
+  if (source_buffer == NULL) {
+    release_source_paths(source_paths, sources_count);
+    bzs_ext_raise_error(BZS_EXT_ERROR_ALLOCATE_FAILED);
+  }
+
+  bzs_ext_bit_writer_t writer;
 
   bzs_ext_result_t ext_result =
-    create_buffers(&source_buffer, source_buffer_length, &destination_buffer, destination_buffer_length);
+    bzs_ext_init_bit_writer(&writer, destination_buffer_length, write_file, destination_file);
   if (ext_result != 0) {
-    BZ2_bzDecompressEnd(&stream);
+    free(source_buffer);
+    release_source_paths(source_paths, sources_count);
     bzs_ext_raise_error(ext_result);
   }
 
-  ext_result = decompress(
-    &stream,
-    source_file,
-    source_buffer,
-    source_buffer_length,
-    destination_file,
-    destination_buffer,
-    destination_buffer_length,
-    gvl);
-
+  merge_args_t args = {
+    .source_paths         = source_paths,
+    .sources_count        = sources_count,
+    .destination_file     = destination_file,
+    .source_buffer        = source_buffer,
+    .source_buffer_length = source_buffer_length,
+    .writer_ptr           = &writer,
+    .block_size           = 0,
+    .stream_crc           = 0,
+    .ext_result           = 0};
+
+  // Whole merge is running without global VM lock.
+  BZS_EXT_GVL_WRAP(gvl, merge_wrapper, &args);
+
+  bzs_ext_free_bit_writer(&writer);
   free(source_buffer);
-  free(destination_buffer);
-  BZ2_bzDecompressEnd(&stream);
+  release_source_paths(source_paths, sources_count);
 
-  if (ext_result != 0) {
-    bzs_ext_raise_error(ext_result);
+  if (args.ext_result != 0) {
+    bzs_ext_raise_error(args.ext_result);
   }
 
   // Ruby itself won't flush stdio file before closing fd, flush is required.
@@ -583,10 +3190,319 @@ VALUE bzs_ext_decompress_io(VALUE BZS_EXT_UNUSED(self), VALUE source, VALUE dest
   return Qnil;
 }
 
+// -- split --
+
+// Source is scanned once, blocks are copied into standalone parts at bit granularity without decompression.
+// Each part receives stream header, its blocks and end of stream marker with CRC combined from CRCs of its blocks.
+// Part is finished at first block boundary after its share of source (count of parts) or after part size.
+// Part header receives max block size of its source streams, header is patched when part is finished.
+
+// Parts are named like bzip2recover results, so they are sorted in source order.
+#define BZS_SPLIT_PART_PATH_FORMAT "%s.%05zu.bz2"
+
+typedef struct
+{
+  FILE*                 source_file;
+  const char*           destination_prefix;
+  bzs_ext_byte_t*       source_buffer;
+  size_t                source_buffer_length;
+  bzs_ext_bit_writer_t* writer_ptr;
+  size_t                parts;
+  size_t                size;
+  uint64_t              source_length;
+  uint32_t              stream_block_size;
+  FILE*                 part_file;
+  uint32_t              part_block_size;
+  uint32_t              part_crc;
+  uint64_t              finished_parts_blocks_length;
+  size_t                parts_count;
+  bzs_ext_result_t      ext_result;
+} split_args_t;
+
+static inline char* get_part_path(const char* destination_prefix, size_t part_index)
+{
+  int path_length = snprintf(NULL, 0, BZS_SPLIT_PART_PATH_FORMAT, destination_prefix, part_index + 1);
+  if (path_length < 0) {
+    return NULL;
+  }
+
+  char* path = malloc((size_t) path_length + 1);
+  if (path != NULL) {
+    snprintf(path, (size_t) path_length + 1, BZS_SPLIT_PART_PATH_FORMAT, destination_prefix, part_index + 1);
+  }
+
+  return path;
+}
+
+static inline bzs_ext_result_t finish_part(split_args_t* args)
+{
+  FILE* part_file = args->part_file;
+
+  bzs_ext_result_t ext_result = bzs_ext_bit_writer_finish_stream(args->writer_ptr, args->part_crc);
+
+  // Block size digit is the last byte of header.
+  if (
+    ext_result == 0 && (fseek(part_file, BZS_STREAM_HEADER_LENGTH - 1, SEEK_SET) != 0 ||
+                        fputc('0' + (int) args->part_block_size, part_file) == EOF)) {
+    ext_result = BZS_EXT_ERROR_WRITE_IO;
+  }
+
+  if (fclose(args->part_file) != 0 && ext_result == 0) {
+    ext_result = BZS_EXT_ERROR_WRITE_IO;
+  }
+
+  args->part_file = NULL;
+
+  return ext_result;
+}
+
+static inline bzs_ext_result_t start_part(split_args_t* args)
+{
+  char* path = get_part_path(args->destination_prefix, args->parts_count);
+  if (path == NULL) {
+    return BZS_EXT_ERROR_ALLOCATE_FAILED;
+  }
+
+  args->part_file = fopen(path, "wb");
+  free(path);
+
+  if (args->part_file == NULL) {
+    return BZS_EXT_ERROR_ACCESS_IO;
+  }
+
+  args->parts_count++;
+  args->part_block_size = args->stream_block_size;
+  args->part_crc        = 0;
+
+  bzs_ext_bit_writer_t* writer_ptr = args->writer_ptr;
+  writer_ptr->data                 = args->part_file;
+  writer_ptr->written_length       = 0;
+
+  bzs_ext_byte_t       block_size_digit                  = (bzs_ext_byte_t) ('0' + args->part_block_size);
+  const bzs_ext_byte_t header[BZS_STREAM_HEADER_LENGTH] = {'B', 'Z', 'h', block_size_digit};
+
+  for (size_t index = 0; index < BZS_STREAM_HEADER_LENGTH; index++) {
+    bzs_ext_result_t ext_result = bzs_ext_bit_writer_write_byte(writer_ptr, header[index]);
+    if (ext_result != 0) {
+      return ext_result;
+    }
+  }
+
+  return 0;
+}
+
+static inline bool is_part_finished(const split_args_t* args)
+{
+  uint64_t part_blocks_length = bzs_ext_bit_writer_get_length(args->writer_ptr) - BZS_STREAM_HEADER_LENGTH;
+
+  if (args->size != 0) {
+    return part_blocks_length >= args->size;
+  }
+
+  // Parts divide blocks of source equally, so count of parts can't be exceeded.
+  uint64_t blocks_length = args->finished_parts_blocks_length + part_blocks_length;
+
+  return blocks_length * args->parts >= args->source_length * args->parts_count;
+}
+
+static bzs_ext_result_t split_block(void* data, bzs_ext_block_event_t event, uint32_t value)
+{
+  split_args_t*    args = data;
+  bzs_ext_result_t ext_result;
+
+  if (event == BZS_BLOCK_STREAM_EVENT) {
+    args->stream_block_size = value;
+    return 0;
+  }
+
+  if (event != BZS_BLOCK_BLOCK_EVENT) {
+    return 0;
+  }
+
+  // Previous block is completely written, current block will be written into next part.
+  if (args->part_file != NULL && is_part_finished(args)) {
+    args->finished_parts_blocks_length +=
+      bzs_ext_bit_writer_get_length(args->writer_ptr) - BZS_STREAM_HEADER_LENGTH;
+
+    ext_result = finish_part(args);
+    if (ext_result != 0) {
+      return ext_result;
+    }
+  }
+
+  if (args->part_file == NULL) {
+    ext_result = start_part(args);
+    if (ext_result != 0) {
+      return ext_result;
+    }
+  }
+
+  if (args->part_block_size < args->stream_block_size) {
+    args->part_block_size = args->stream_block_size;
+  }
+
+  args->part_crc = bzs_ext_combine_crc(args->part_crc, value);
+
+  return 0;
+}
+
+static inline bzs_ext_result_t split(split_args_t* args)
+{
+  bzs_ext_block_scanner_t scanner;
+  bzs_ext_init_block_scanner(&scanner, split_block, args, args->writer_ptr);
+
+  bzs_ext_result_t ext_result;
+
+  while (true) {
+    size_t source_length;
+
+    ext_result = read_file(args->source_file, args->source_buffer, &source_length, args->source_buffer_length);
+    if (ext_result == BZS_EXT_FILE_READ_FINISHED) {
+      break;
+    } else if (ext_result != 0) {
+      return ext_result;
+    }
+
+    ext_result = bzs_ext_block_scanner_append(&scanner, args->source_buffer, source_length);
+    if (ext_result != 0) {
+      return ext_result;
+    }
+  }
+
+  ext_result = bzs_ext_block_scanner_finish(&scanner);
+  if (ext_result != 0) {
+    return ext_result;
+  }
+
+  // Source without blocks is split into single empty part.
+  if (args->parts_count == 0) {
+    ext_result = start_part(args);
+    if (ext_result != 0) {
+      return ext_result;
+    }
+  }
+
+  return finish_part(args);
+}
+
+static inline void* split_wrapper(void* data)
+{
+  split_args_t* args = data;
+
+  args->ext_result = split(args);
+
+  // Part remains open after error.
+  if (args->part_file != NULL) {
+    fclose(args->part_file);
+  }
+
+  return NULL;
+}
+
+static inline VALUE get_part_paths(const char* destination_prefix, size_t parts_count)
+{
+  VALUE paths = rb_ary_new_capa(parts_count);
+
+  for (size_t index = 0; index < parts_count; index++) {
+    char* path = get_part_path(destination_prefix, index);
+    if (path == NULL) {
+      bzs_ext_raise_error(BZS_EXT_ERROR_ALLOCATE_FAILED);
+    }
+
+    VALUE path_value = rb_str_new_cstr(path);
+    free(path);
+
+    rb_ary_push(paths, path_value);
+  }
+
+  return paths;
+}
+
+VALUE bzs_ext_split_io(VALUE BZS_EXT_UNUSED(self), VALUE source, VALUE destination_prefix, VALUE options)
+{
+  GET_FILE(source);
+  Check_Type(destination_prefix, T_STRING);
+  Check_Type(options, T_HASH);
+  BZS_EXT_GET_SIZE_OPTION(options, source_buffer_length);
+  BZS_EXT_GET_SIZE_OPTION(options, destination_buffer_length);
+  BZS_EXT_GET_BOOL_OPTION(options, gvl);
+  BZS_EXT_RESOLVE_SIZE_OPTION(options, parts, BZS_DEFAULT_PARTS);
+  BZS_EXT_RESOLVE_SIZE_OPTION(options, size, BZS_DEFAULT_SIZE);
+
+  if ((parts == 0) == (size == 0)) {
+    bzs_ext_raise_error(BZS_EXT_ERROR_VALIDATE_FAILED);
+  }
+
+  if (source_buffer_length == 0) {
+    source_buffer_length = BZS_DEFAULT_SOURCE_BUFFER_LENGTH_FOR_DECOMPRESSOR;
+  }
+  if (destination_buffer_length == 0) {
+    destination_buffer_length = BZS_DEFAULT_DESTINATION_BUFFER_LENGTH_FOR_COMPRESSOR;
+  }
+
+  // Source length is required to divide source into parts.
+  struct stat source_stat;
+  off_t       source_offset = ftello(source_file);
+  if (fstat(fileno(source_file), &source_stat) != 0 || source_offset < 0) {
+    bzs_ext_raise_error(BZS_EXT_ERROR_ACCESS_IO);
+  }
+
+  const char* destination_prefix_value = StringValueCStr(destination_prefix);
+
+  bzs_ext_byte_t* source_buffer = malloc(source_buffer_length);
+  if (source_buffer == NULL) {
+    bzs_ext_raise_error(BZS_EXT_ERROR_ALLOCATE_FAILED);
+  }
+
+  bzs_ext_bit_writer_t writer;
+
+  bzs_ext_result_t ext_result = bzs_ext_init_bit_writer(&writer, destination_buffer_length, write_file, NULL);
+  if (ext_result != 0) {
+    free(source_buffer);
+    bzs_ext_raise_error(ext_result);
+  }
+
+  split_args_t args = {
+    .source_file                  = source_file,
+    .destination_prefix           = destination_prefix_value,
+    .source_buffer                = source_buffer,
+    .source_buffer_length         = source_buffer_length,
+    .writer_ptr                   = &writer,
+    .parts                        = parts,
+    .size                         = size,
+    .source_length                = (uint64_t) (source_stat.st_size - source_offset),
+    .stream_block_size            = BZS_MAX_BLOCK_SIZE,
+    .part_file                    = NULL,
+    .part_block_size              = 0,
+    .part_crc                     = 0,
+    .finished_parts_blocks_length = 0,
+    .parts_count                  = 0,
+    .ext_result                   = 0};
+
+  // Whole split is running without global VM lock.
+  BZS_EXT_GVL_WRAP(gvl, split_wrapper, &args);
+
+  bzs_ext_free_bit_writer(&writer);
+  free(source_buffer);
+
+  if (args.ext_result != 0) {
+    bzs_ext_raise_error(args.ext_result);
+  }
+
+  return get_part_paths(destination_prefix_value, args.parts_count);
+}
+
 // -- exports --
 
 void bzs_ext_io_exports(VALUE root_module)
 {
   rb_define_module_function(root_module, "_native_compress_io", RUBY_METHOD_FUNC(bzs_ext_compress_io), 3);
   rb_define_module_function(root_module, "_native_decompress_io", RUBY_METHOD_FUNC(bzs_ext_decompress_io), 3);
+  rb_define_module_function(root_module, "_native_each_line_io", RUBY_METHOD_FUNC(bzs_ext_each_line_io), 3);
+  rb_define_module_function(root_module, "_native_grep_io", RUBY_METHOD_FUNC(bzs_ext_grep_io), 4);
+  rb_define_module_function(root_module, "_native_recompress_io", RUBY_METHOD_FUNC(bzs_ext_recompress_io), 3);
+  rb_define_module_function(root_module, "_native_compress_many", RUBY_METHOD_FUNC(bzs_ext_compress_many), 2);
+  rb_define_module_function(root_module, "_native_decompress_many", RUBY_METHOD_FUNC(bzs_ext_decompress_many), 2);
+  rb_define_module_function(root_module, "_native_merge_io", RUBY_METHOD_FUNC(bzs_ext_merge_io), 3);
+  rb_define_module_function(root_module, "_native_split_io", RUBY_METHOD_FUNC(bzs_ext_split_io), 3);
 }
@@ -8,6 +8,13 @@
 
 VALUE bzs_ext_compress_io(VALUE self, VALUE source, VALUE destination, VALUE options);
 VALUE bzs_ext_decompress_io(VALUE self, VALUE source, VALUE destination, VALUE options);
+VALUE bzs_ext_each_line_io(VALUE self, VALUE source, VALUE separator, VALUE options);
+VALUE bzs_ext_grep_io(VALUE self, VALUE source, VALUE pattern, VALUE is_regexp, VALUE options);
+VALUE bzs_ext_recompress_io(VALUE self, VALUE source, VALUE destination, VALUE options);
+VALUE bzs_ext_compress_many(VALUE self, VALUE pairs, VALUE options);
+VALUE bzs_ext_decompress_many(VALUE self, VALUE pairs, VALUE options);
+VALUE bzs_ext_merge_io(VALUE self, VALUE sources, VALUE destination, VALUE options);
+VALUE bzs_ext_split_io(VALUE self, VALUE source, VALUE destination_prefix, VALUE options);
 
 void bzs_ext_io_exports(VALUE root_module);
 
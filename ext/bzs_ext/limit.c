@@ -0,0 +1,86 @@
+// Ruby bindings for bzip2 library.
+// Copyright (c) 2022 AUTHORS, MIT License.
+
+#include "bzs_ext/limit.h"
+
+#include <stdint.h>
+
+#include "bzs_ext/error.h"
+
+void bzs_ext_init_limit(bzs_ext_limit_t* limit_ptr, size_t max_output_size, size_t max_ratio, size_t prefix_length)
+{
+  limit_ptr->max_output_size    = max_output_size;
+  limit_ptr->max_ratio          = max_ratio;
+  limit_ptr->prefix_length      = prefix_length;
+  limit_ptr->source_length      = 0;
+  limit_ptr->destination_length = 0;
+}
+
+void bzs_ext_limit_add_source(bzs_ext_limit_t* limit_ptr, size_t source_length)
+{
+  limit_ptr->source_length += source_length;
+}
+
+static inline size_t get_max_destination_length(const bzs_ext_limit_t* limit_ptr)
+{
+  size_t max_destination_length = SIZE_MAX;
+
+  if (limit_ptr->max_output_size != 0) {
+    max_destination_length = limit_ptr->max_output_size;
+  }
+
+  if (limit_ptr->max_ratio != 0) {
+    size_t source_length = limit_ptr->source_length;
+
+    // Ratio limit can't overflow.
+    size_t ratio_destination_length = source_length > SIZE_MAX / limit_ptr->max_ratio ?
+                                        SIZE_MAX :
+                                        source_length * limit_ptr->max_ratio;
+
+    if (max_destination_length > ratio_destination_length) {
+      max_destination_length = ratio_destination_length;
+    }
+  }
+
+  return max_destination_length;
+}
+
+size_t bzs_ext_limit_get_destination_buffer_length(const bzs_ext_limit_t* limit_ptr, size_t destination_buffer_length)
+{
+  if (limit_ptr->prefix_length != 0) {
+    size_t remaining_prefix_length = limit_ptr->prefix_length > limit_ptr->destination_length ?
+                                       limit_ptr->prefix_length - limit_ptr->destination_length :
+                                       0;
+
+    if (destination_buffer_length > remaining_prefix_length) {
+      destination_buffer_length = remaining_prefix_length;
+    }
+  }
+
+  size_t max_destination_length = get_max_destination_length(limit_ptr);
+  if (max_destination_length == SIZE_MAX || max_destination_length < limit_ptr->destination_length) {
+    return destination_buffer_length;
+  }
+
+  // One byte above limit is enough to detect that limit is crossed.
+  size_t remaining_destination_length = max_destination_length - limit_ptr->destination_length + 1;
+
+  return destination_buffer_length < remaining_destination_length ? destination_buffer_length :
+                                                                    remaining_destination_length;
+}
+
+bzs_ext_result_t bzs_ext_limit_add_destination(bzs_ext_limit_t* limit_ptr, size_t destination_length)
+{
+  limit_ptr->destination_length += destination_length;
+
+  if (limit_ptr->destination_length > get_max_destination_length(limit_ptr)) {
+    return BZS_EXT_ERROR_DECOMPRESSOR_OUTPUT_LIMIT_EXCEEDED;
+  }
+
+  return 0;
+}
+
+bool bzs_ext_limit_is_prefix_finished(const bzs_ext_limit_t* limit_ptr)
+{
+  return limit_ptr->prefix_length != 0 && limit_ptr->destination_length >= limit_ptr->prefix_length;
+}
@@ -0,0 +1,41 @@
+// Ruby bindings for bzip2 library.
+// Copyright (c) 2022 AUTHORS, MIT License.
+
+#if !defined(BZS_EXT_LIMIT_H)
+#define BZS_EXT_LIMIT_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "bzs_ext/common.h"
+
+// Limit protects decompressor from small hostile source which expands into huge destination.
+// Max output size limits total destination length, max ratio limits destination length per byte of received source.
+// Zero means unlimited.
+
+// Destination is clamped to one byte above limit, so decompressor stops as soon as limit is crossed.
+// Destination above limit is never provided to consumer.
+
+// Prefix length is not an error, destination is clamped to prefix and decompressor stops after it.
+// Zero means whole destination.
+
+typedef struct
+{
+  size_t max_output_size;
+  size_t max_ratio;
+  size_t prefix_length;
+  size_t source_length;
+  size_t destination_length;
+} bzs_ext_limit_t;
+
+void bzs_ext_init_limit(bzs_ext_limit_t* limit_ptr, size_t max_output_size, size_t max_ratio, size_t prefix_length);
+
+void bzs_ext_limit_add_source(bzs_ext_limit_t* limit_ptr, size_t source_length);
+
+// Returns part of destination buffer length which can be used for next decompression.
+size_t bzs_ext_limit_get_destination_buffer_length(const bzs_ext_limit_t* limit_ptr, size_t destination_buffer_length);
+
+bzs_ext_result_t bzs_ext_limit_add_destination(bzs_ext_limit_t* limit_ptr, size_t destination_length);
+bool             bzs_ext_limit_is_prefix_finished(const bzs_ext_limit_t* limit_ptr);
+
+#endif // BZS_EXT_LIMIT_H
@@ -0,0 +1,224 @@
+// Ruby bindings for bzip2 library.
+// Copyright (c) 2022 AUTHORS, MIT License.
+
+#include "bzs_ext/line.h"
+
+#include <string.h>
+
+#include "bzs_ext/error.h"
+
+#define BZS_INITIAL_LINE_BUFFER_LENGTH 256
+
+// -- initialization --
+
+bzs_ext_result_t bzs_ext_create_line_splitter(
+  bzs_ext_line_splitter_t** line_splitter_ptr_ptr,
+  const bzs_ext_byte_t*     separator,
+  size_t                    separator_length)
+{
+  if (separator_length == 0) {
+    return BZS_EXT_ERROR_VALIDATE_FAILED;
+  }
+
+  bzs_ext_line_splitter_t* line_splitter_ptr = calloc(1, sizeof(bzs_ext_line_splitter_t));
+  if (line_splitter_ptr == NULL) {
+    return BZS_EXT_ERROR_ALLOCATE_FAILED;
+  }
+
+  bzs_ext_byte_t* separator_copy = malloc(separator_length);
+  if (separator_copy == NULL) {
+    free(line_splitter_ptr);
+    return BZS_EXT_ERROR_ALLOCATE_FAILED;
+  }
+
+  memcpy(separator_copy, separator, separator_length);
+
+  line_splitter_ptr->separator        = separator_copy;
+  line_splitter_ptr->separator_length = separator_length;
+
+  *line_splitter_ptr_ptr = line_splitter_ptr;
+
+  return 0;
+}
+
+// -- line buffer --
+
+static inline bzs_ext_result_t
+  append_line_buffer(bzs_ext_line_splitter_t* line_splitter_ptr, const bzs_ext_byte_t* source, size_t source_length)
+{
+  if (source_length == 0) {
+    return 0;
+  }
+
+  size_t line_length = line_splitter_ptr->line_length + source_length;
+
+  if (line_length > line_splitter_ptr->line_buffer_length) {
+    size_t line_buffer_length = line_splitter_ptr->line_buffer_length == 0 ? BZS_INITIAL_LINE_BUFFER_LENGTH :
+                                                                              line_splitter_ptr->line_buffer_length;
+    while (line_buffer_length < line_length) {
+      line_buffer_length *= 2;
+    }
+
+    bzs_ext_byte_t* line_buffer = realloc(line_splitter_ptr->line_buffer, line_buffer_length);
+    if (line_buffer == NULL) {
+      return BZS_EXT_ERROR_ALLOCATE_FAILED;
+    }
+
+    line_splitter_ptr->line_buffer        = line_buffer;
+    line_splitter_ptr->line_buffer_length = line_buffer_length;
+  }
+
+  memcpy(line_splitter_ptr->line_buffer + line_splitter_ptr->line_length, source, source_length);
+  line_splitter_ptr->line_length = line_length;
+
+  return 0;
+}
+
+static inline bzs_ext_result_t provide_line_buffer(
+  bzs_ext_line_splitter_t* line_splitter_ptr,
+  const bzs_ext_byte_t*    source,
+  size_t                   source_length,
+  bzs_ext_line_function_t  function,
+  void*                    data)
+{
+  bzs_ext_result_t ext_result = append_line_buffer(line_splitter_ptr, source, source_length);
+  if (ext_result != 0) {
+    return ext_result;
+  }
+
+  // Line buffer should be empty before function call, function may not return.
+  size_t line_length             = line_splitter_ptr->line_length;
+  line_splitter_ptr->line_length = 0;
+
+  return function(data, line_splitter_ptr->line_buffer, line_length);
+}
+
+// -- separator --
+
+// Memchr is vectorized by libc, it finds first byte of separator.
+
+static inline const bzs_ext_byte_t* find_separator(
+  const bzs_ext_byte_t* source,
+  size_t                source_length,
+  const bzs_ext_byte_t* separator,
+  size_t                separator_length)
+{
+  while (source_length >= separator_length) {
+    const bzs_ext_byte_t* separator_start = memchr(source, separator[0], source_length - separator_length + 1);
+    if (separator_start == NULL) {
+      return NULL;
+    }
+
+    if (memcmp(separator_start + 1, separator + 1, separator_length - 1) == 0) {
+      return separator_start;
+    }
+
+    source_length -= separator_start + 1 - source;
+    source = separator_start + 1;
+  }
+
+  return NULL;
+}
+
+// Line buffer never contains complete separator, but it can end with separator prefix.
+// Returns length of separator suffix at the beginning of source, zero means separator was not found.
+
+static inline size_t find_separator_suffix(
+  const bzs_ext_line_splitter_t* line_splitter_ptr,
+  const bzs_ext_byte_t*          source,
+  size_t                         source_length)
+{
+  const bzs_ext_byte_t* separator        = line_splitter_ptr->separator;
+  size_t                separator_length = line_splitter_ptr->separator_length;
+  size_t                line_length      = line_splitter_ptr->line_length;
+
+  size_t max_prefix_length = separator_length - 1 < line_length ? separator_length - 1 : line_length;
+
+  // Longest prefix means first separator.
+  for (size_t prefix_length = max_prefix_length; prefix_length != 0; prefix_length--) {
+    size_t suffix_length = separator_length - prefix_length;
+
+    if (
+      suffix_length <= source_length &&
+      memcmp(line_splitter_ptr->line_buffer + line_length - prefix_length, separator, prefix_length) == 0 &&
+      memcmp(source, separator + prefix_length, suffix_length) == 0) {
+      return suffix_length;
+    }
+  }
+
+  return 0;
+}
+
+// -- split --
+
+bzs_ext_result_t bzs_ext_line_splitter_append(
+  bzs_ext_line_splitter_t* line_splitter_ptr,
+  const bzs_ext_byte_t*    source,
+  size_t                   source_length,
+  bzs_ext_line_function_t  function,
+  void*                    data)
+{
+  bzs_ext_result_t      ext_result;
+  const bzs_ext_byte_t* line       = source;
+  const bzs_ext_byte_t* source_end = source + source_length;
+
+  if (line_splitter_ptr->line_length != 0) {
+    size_t suffix_length = find_separator_suffix(line_splitter_ptr, source, source_length);
+    if (suffix_length != 0) {
+      ext_result = provide_line_buffer(line_splitter_ptr, source, suffix_length, function, data);
+      if (ext_result != 0) {
+        return ext_result;
+      }
+
+      line += suffix_length;
+    }
+  }
+
+  while (true) {
+    const bzs_ext_byte_t* separator_start = find_separator(
+      line, source_end - line, line_splitter_ptr->separator, line_splitter_ptr->separator_length);
+    if (separator_start == NULL) {
+      break;
+    }
+
+    const bzs_ext_byte_t* line_end = separator_start + line_splitter_ptr->separator_length;
+
+    if (line_splitter_ptr->line_length != 0) {
+      ext_result = provide_line_buffer(line_splitter_ptr, line, line_end - line, function, data);
+    } else {
+      ext_result = function(data, line, line_end - line);
+    }
+
+    if (ext_result != 0) {
+      return ext_result;
+    }
+
+    line = line_end;
+  }
+
+  return append_line_buffer(line_splitter_ptr, line, source_end - line);
+}
+
+bzs_ext_result_t bzs_ext_line_splitter_finish(
+  bzs_ext_line_splitter_t* line_splitter_ptr,
+  bzs_ext_line_function_t  function,
+  void*                    data)
+{
+  if (line_splitter_ptr->line_length == 0) {
+    return 0;
+  }
+
+  return provide_line_buffer(line_splitter_ptr, NULL, 0, function, data);
+}
+
+// -- cleanup --
+
+void bzs_ext_destroy_line_splitter(bzs_ext_line_splitter_t* line_splitter_ptr)
+{
+  if (line_splitter_ptr->line_buffer != NULL) {
+    free(line_splitter_ptr->line_buffer);
+  }
+
+  free(line_splitter_ptr->separator);
+  free(line_splitter_ptr);
+}
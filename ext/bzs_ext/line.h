@@ -0,0 +1,47 @@
+// Ruby bindings for bzip2 library.
+// Copyright (c) 2022 AUTHORS, MIT License.
+
+#if !defined(BZS_EXT_LINE_H)
+#define BZS_EXT_LINE_H
+
+#include <stdlib.h>
+
+#include "bzs_ext/common.h"
+
+// Line splitter finds separators directly in decompressed destination.
+// Complete line will be provided without copy when it is located inside single destination.
+// Line started in previous destination will be collected in line buffer.
+
+typedef bzs_ext_result_t (*bzs_ext_line_function_t)(void* data, const bzs_ext_byte_t* line, size_t line_length);
+
+typedef struct
+{
+  bzs_ext_byte_t* separator;
+  size_t          separator_length;
+  bzs_ext_byte_t* line_buffer;
+  size_t          line_buffer_length;
+  size_t          line_length;
+} bzs_ext_line_splitter_t;
+
+bzs_ext_result_t bzs_ext_create_line_splitter(
+  bzs_ext_line_splitter_t** line_splitter_ptr_ptr,
+  const bzs_ext_byte_t*     separator,
+  size_t                    separator_length);
+
+// Function will be called for each complete line, line includes separator.
+bzs_ext_result_t bzs_ext_line_splitter_append(
+  bzs_ext_line_splitter_t* line_splitter_ptr,
+  const bzs_ext_byte_t*    source,
+  size_t                   source_length,
+  bzs_ext_line_function_t  function,
+  void*                    data);
+
+// Function will be called for remaining line without separator.
+bzs_ext_result_t bzs_ext_line_splitter_finish(
+  bzs_ext_line_splitter_t* line_splitter_ptr,
+  bzs_ext_line_function_t  function,
+  void*                    data);
+
+void bzs_ext_destroy_line_splitter(bzs_ext_line_splitter_t* line_splitter_ptr);
+
+#endif // BZS_EXT_LINE_H
@@ -5,19 +5,29 @@
 
 #include "bzs_ext/buffer.h"
 #include "bzs_ext/common.h"
+#include "bzs_ext/governor.h"
 #include "bzs_ext/io.h"
 #include "bzs_ext/option.h"
+#include "bzs_ext/pool.h"
 #include "bzs_ext/stream/compressor.h"
 #include "bzs_ext/stream/decompressor.h"
 #include "bzs_ext/string.h"
 
 void Init_bzs_ext()
 {
+#if defined(HAVE_RB_EXT_RACTOR_SAFE)
+  // Extension doesn't keep ruby objects in global state, native global state is protected by mutex.
+  // It should be declared before methods definition.
+  rb_ext_ractor_safe(true);
+#endif
+
   VALUE root_module = rb_define_module(BZS_EXT_MODULE_NAME);
 
   bzs_ext_buffer_exports(root_module);
+  bzs_ext_governor_exports(root_module);
   bzs_ext_io_exports(root_module);
   bzs_ext_option_exports(root_module);
+  bzs_ext_pool_exports(root_module);
   bzs_ext_compressor_exports(root_module);
   bzs_ext_decompressor_exports(root_module);
   bzs_ext_string_exports(root_module);
@@ -4,6 +4,10 @@
 #include "bzs_ext/option.h"
 
 #include "bzs_ext/error.h"
+#include "bzs_ext/governor.h"
+#include "bzs_ext/gvl.h"
+#include "bzs_ext/macro.h"
+#include "bzs_ext/tune.h"
 
 // -- values --
 
@@ -74,6 +78,114 @@ bzs_ext_option_t bzs_ext_resolve_int_option_value(VALUE options, const char* nam
   }
 }
 
+size_t bzs_ext_resolve_size_option_value(VALUE options, const char* name, size_t default_value)
+{
+  VALUE raw_value = get_raw_value(options, name);
+  if (raw_value != Qnil) {
+    return get_size_value(raw_value);
+  } else {
+    return default_value;
+  }
+}
+
+// -- tune --
+
+// Work factor changes speed of sorting for repetitive data, it doesn't change compressed data.
+static const bzs_ext_option_t tune_work_factors[] = {1, BZS_DEFAULT_WORK_FACTOR, BZS_MAX_WORK_FACTOR};
+
+#define TUNE_WORK_FACTORS_COUNT (sizeof(tune_work_factors) / sizeof(bzs_ext_option_t))
+#define TUNE_CANDIDATES_COUNT   ((BZS_MAX_BLOCK_SIZE - BZS_MIN_BLOCK_SIZE + 1) * TUNE_WORK_FACTORS_COUNT)
+
+typedef struct
+{
+  const bzs_ext_byte_t*  sample;
+  size_t                 sample_length;
+  bzs_ext_option_t       verbosity;
+  bzs_ext_measurement_t* measurements;
+  bzs_ext_result_t       ext_result;
+} tune_args_t;
+
+static inline void* tune_wrapper(void* data)
+{
+  tune_args_t* args = data;
+
+  for (size_t index = 0; index < TUNE_CANDIDATES_COUNT; index++) {
+    bzs_ext_measurement_t* measurement_ptr = &args->measurements[index];
+
+    args->ext_result =
+      bzs_ext_measure_compressor(args->sample, args->sample_length, args->verbosity, measurement_ptr);
+
+    if (args->ext_result != 0) {
+      break;
+    }
+  }
+
+  return NULL;
+}
+
+static inline VALUE get_measurement_value(const bzs_ext_measurement_t* measurement_ptr)
+{
+  VALUE measurement = rb_hash_new();
+
+  rb_hash_aset(measurement, ID2SYM(rb_intern("block_size")), INT2NUM(measurement_ptr->block_size));
+  rb_hash_aset(measurement, ID2SYM(rb_intern("work_factor")), INT2NUM(measurement_ptr->work_factor));
+  rb_hash_aset(measurement, ID2SYM(rb_intern("destination_length")), SIZET2NUM(measurement_ptr->destination_length));
+  rb_hash_aset(measurement, ID2SYM(rb_intern("time")), ULL2NUM(measurement_ptr->time));
+  rb_hash_aset(measurement, ID2SYM(rb_intern("latency")), ULL2NUM(measurement_ptr->latency));
+  rb_hash_aset(measurement, ID2SYM(rb_intern("memory")), SIZET2NUM(measurement_ptr->memory));
+
+  return measurement;
+}
+
+VALUE bzs_ext_tune_options(VALUE BZS_EXT_UNUSED(self), VALUE sample, VALUE options)
+{
+  Check_Type(sample, T_STRING);
+  Check_Type(options, T_HASH);
+  BZS_EXT_GET_BOOL_OPTION(options, gvl);
+  BZS_EXT_RESOLVE_VERBOSITY_OPTION(options);
+
+  bzs_ext_measurement_t measurements[TUNE_CANDIDATES_COUNT];
+  size_t                index = 0;
+
+  for (bzs_ext_option_t block_size = BZS_MIN_BLOCK_SIZE; block_size <= BZS_MAX_BLOCK_SIZE; block_size++) {
+    for (size_t work_factor_index = 0; work_factor_index < TUNE_WORK_FACTORS_COUNT; work_factor_index++) {
+      measurements[index].block_size  = block_size;
+      measurements[index].work_factor = tune_work_factors[work_factor_index];
+      index++;
+    }
+  }
+
+  tune_args_t args = {
+    .sample        = (const bzs_ext_byte_t*) RSTRING_PTR(sample),
+    .sample_length = RSTRING_LEN(sample),
+    .verbosity     = verbosity,
+    .measurements  = measurements,
+    .ext_result    = 0};
+
+  // Candidates are measured one by one, largest block size requires most memory.
+  bzs_ext_reservation_t reserved_memory;
+
+  bzs_ext_result_t ext_result = bzs_ext_governor_reserve_compressors(BZS_MAX_BLOCK_SIZE, 1, &reserved_memory);
+  if (ext_result != 0) {
+    bzs_ext_raise_error(ext_result);
+  }
+
+  BZS_EXT_GVL_WRAP(gvl, tune_wrapper, &args);
+  bzs_ext_governor_release(reserved_memory);
+
+  if (args.ext_result != 0) {
+    bzs_ext_raise_error(args.ext_result);
+  }
+
+  VALUE result = rb_ary_new_capa(TUNE_CANDIDATES_COUNT);
+
+  for (index = 0; index < TUNE_CANDIDATES_COUNT; index++) {
+    rb_ary_push(result, get_measurement_value(&measurements[index]));
+  }
+
+  return result;
+}
+
 // -- others --
 
 void bzs_ext_option_exports(VALUE root_module)
@@ -95,4 +207,10 @@ void bzs_ext_option_exports(VALUE root_module)
   rb_define_const(module, "MIN_VERBOSITY", SIZET2NUM(BZS_MIN_VERBOSITY));
   rb_define_const(module, "MAX_VERBOSITY", SIZET2NUM(BZS_MAX_VERBOSITY));
   rb_define_const(module, "DEFAULT_VERBOSITY", SIZET2NUM(BZS_DEFAULT_VERBOSITY));
+
+  rb_define_const(module, "DEFAULT_THREADS", SIZET2NUM(BZS_DEFAULT_THREADS));
+  rb_define_const(module, "DEFAULT_READ_AHEAD", SIZET2NUM(BZS_DEFAULT_READ_AHEAD));
+  rb_define_const(module, "DEFAULT_MEMBER_SIZE", SIZET2NUM(BZS_DEFAULT_MEMBER_SIZE));
+
+  rb_define_module_function(root_module, "_native_tune_options", RUBY_METHOD_FUNC(bzs_ext_tune_options), 2);
 }
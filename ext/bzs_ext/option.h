@@ -13,6 +13,9 @@
 #define BZS_MAX_BLOCK_SIZE     9
 #define BZS_DEFAULT_BLOCK_SIZE BZS_MAX_BLOCK_SIZE
 
+// Block size option is a count of block size units.
+#define BZS_BLOCK_SIZE_UNIT 100000
+
 #define BZS_MIN_WORK_FACTOR     0
 #define BZS_MAX_WORK_FACTOR     250
 #define BZS_DEFAULT_WORK_FACTOR BZS_MIN_WORK_FACTOR
@@ -27,6 +30,41 @@
 
 #define BZS_DEFAULT_QUIET 1
 
+#define BZS_DEFAULT_THREADS 1
+
+// Zero means count of online processors.
+#define BZS_DEFAULT_POOL_THREADS 0
+
+#define BZS_DEFAULT_READ_AHEAD 0
+
+#define BZS_DEFAULT_INDEX 0
+
+#define BZS_DEFAULT_MEMBER_SIZE 0
+
+#define BZS_DEFAULT_BATCH 0
+
+// Zero means unlimited decompressor output.
+#define BZS_DEFAULT_MAX_OUTPUT_SIZE 0
+#define BZS_DEFAULT_MAX_RATIO       0
+
+// Zero means whole decompressed destination.
+#define BZS_DEFAULT_LIMIT 0
+
+// Zero means regular reads and writes without uring.
+#define BZS_DEFAULT_URING 0
+
+#define BZS_DEFAULT_DROP_CACHE 0
+
+// Zero means destination without preallocation.
+#define BZS_DEFAULT_PREALLOCATE 0
+
+// Zero means compression without checkpoints.
+#define BZS_DEFAULT_CHECKPOINT 0
+
+// Split requires count of parts or size of part.
+#define BZS_DEFAULT_PARTS 0
+#define BZS_DEFAULT_SIZE  0
+
 // Bzip2 options are integers instead of unsigned integers.
 typedef int bzs_ext_option_t;
 
@@ -38,11 +76,14 @@ size_t bzs_ext_get_size_option_value(VALUE options, const char* name);
 
 bzs_ext_option_t bzs_ext_resolve_bool_option_value(VALUE options, const char* name, bzs_ext_option_t default_value);
 bzs_ext_option_t bzs_ext_resolve_int_option_value(VALUE options, const char* name, bzs_ext_option_t default_value);
+size_t           bzs_ext_resolve_size_option_value(VALUE options, const char* name, size_t default_value);
 
 #define BZS_EXT_RESOLVE_BOOL_OPTION(options, name, default_value) \
   bzs_ext_option_t name = bzs_ext_resolve_bool_option_value(options, #name, default_value);
 #define BZS_EXT_RESOLVE_INT_OPTION(options, name, default_value) \
   bzs_ext_option_t name = bzs_ext_resolve_int_option_value(options, #name, default_value);
+#define BZS_EXT_RESOLVE_SIZE_OPTION(options, name, default_value) \
+  size_t name = bzs_ext_resolve_size_option_value(options, #name, default_value);
 
 #define BZS_EXT_RESOLVE_VERBOSITY_OPTION(options)                 \
   BZS_EXT_RESOLVE_BOOL_OPTION(options, quiet, BZS_DEFAULT_QUIET); \
@@ -57,6 +98,12 @@ bzs_ext_option_t bzs_ext_resolve_int_option_value(VALUE options, const char* nam
   BZS_EXT_RESOLVE_BOOL_OPTION(options, small, BZS_DEFAULT_SMALL); \
   BZS_EXT_RESOLVE_VERBOSITY_OPTION(options);
 
+#define BZS_EXT_RESOLVE_LIMIT_OPTIONS(options)                                        \
+  BZS_EXT_RESOLVE_SIZE_OPTION(options, max_output_size, BZS_DEFAULT_MAX_OUTPUT_SIZE); \
+  BZS_EXT_RESOLVE_SIZE_OPTION(options, max_ratio, BZS_DEFAULT_MAX_RATIO);
+
+VALUE bzs_ext_tune_options(VALUE self, VALUE sample, VALUE options);
+
 void bzs_ext_option_exports(VALUE root_module);
 
 #endif // BZS_EXT_OPTIONS_H
@@ -0,0 +1,479 @@
+// Ruby bindings for bzip2 library.
+// Copyright (c) 2022 AUTHORS, MIT License.
+
+// Glibc declares processors affinity as gnu extension.
+#if defined(HAVE_SCHED_GETAFFINITY) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE 1
+#endif
+
+#include "bzs_ext/parallel.h"
+
+#include <bzlib.h>
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bzs_ext/error.h"
+#include "bzs_ext/utils.h"
+
+// -- count --
+
+size_t bzs_ext_get_threads_count(size_t threads)
+{
+  if (threads != 0) {
+    return threads;
+  }
+
+#if defined(HAVE_SCHED_GETAFFINITY)
+  // Process can be limited to some processors.
+  cpu_set_t affinity;
+  if (sched_getaffinity(0, sizeof(cpu_set_t), &affinity) == 0) {
+    int processors_count = CPU_COUNT(&affinity);
+    if (processors_count > 0) {
+      return (size_t) processors_count;
+    }
+  }
+#endif
+
+  long processors_count = sysconf(_SC_NPROCESSORS_ONLN);
+  if (processors_count < 1) {
+    return 1;
+  }
+
+  return (size_t) processors_count;
+}
+
+size_t bzs_ext_get_members_count(size_t source_length, size_t threads)
+{
+  size_t members_count = source_length / BZS_MIN_MEMBER_SOURCE_LENGTH;
+  if (members_count > threads) {
+    members_count = threads;
+  }
+
+  if (members_count == 0) {
+    return 1;
+  }
+
+  return members_count;
+}
+
+// -- member --
+
+// Bzip2 guarantees that destination will be at least 1% larger than source plus 600 bytes.
+static inline size_t get_destination_bound(size_t source_length)
+{
+  return source_length + source_length / 100 + 600;
+}
+
+static inline bzs_ext_result_t compress_member(bz_stream* stream_ptr, bzs_ext_member_t* member_ptr)
+{
+  bzs_ext_byte_t* remaining_source                    = (bzs_ext_byte_t*) member_ptr->source;
+  size_t          remaining_source_length             = member_ptr->source_length;
+  bzs_ext_byte_t* remaining_destination_buffer        = member_ptr->destination;
+  size_t          remaining_destination_buffer_length = member_ptr->destination_length;
+
+  while (true) {
+    // Source length may not fit into unsigned int, finish is possible only for last portion of source.
+    unsigned int avail_in      = bzs_consume_size(remaining_source_length);
+    int          stream_action = avail_in == remaining_source_length ? BZ_FINISH : BZ_RUN;
+
+    stream_ptr->next_in   = (char*) remaining_source;
+    stream_ptr->avail_in  = avail_in;
+    stream_ptr->next_out  = (char*) remaining_destination_buffer;
+    stream_ptr->avail_out = bzs_consume_size(remaining_destination_buffer_length);
+
+    bzs_result_t result = BZ2_bzCompress(stream_ptr, stream_action);
+
+    remaining_source_length -= avail_in - stream_ptr->avail_in;
+    remaining_source = (bzs_ext_byte_t*) stream_ptr->next_in;
+    remaining_destination_buffer_length -= (bzs_ext_byte_t*) stream_ptr->next_out - remaining_destination_buffer;
+    remaining_destination_buffer = (bzs_ext_byte_t*) stream_ptr->next_out;
+
+    if (result == BZ_STREAM_END) {
+      break;
+    }
+
+    if (result != BZ_RUN_OK && result != BZ_FINISH_OK) {
+      return bzs_ext_get_error(result);
+    }
+
+    if (remaining_destination_buffer_length == 0) {
+      // Destination bound should be enough for any source.
+      return BZS_EXT_ERROR_NOT_ENOUGH_DESTINATION_BUFFER;
+    }
+  }
+
+  member_ptr->destination_length -= remaining_destination_buffer_length;
+
+  return 0;
+}
+
+void bzs_ext_compress_member(bzs_ext_member_t* member_ptr)
+{
+  bz_stream stream = {
+    .bzalloc = NULL,
+    .bzfree  = NULL,
+    .opaque  = NULL,
+  };
+
+  member_ptr->destination        = NULL;
+  member_ptr->destination_length = 0;
+
+  bzs_result_t result =
+    BZ2_bzCompressInit(&stream, member_ptr->block_size, member_ptr->verbosity, member_ptr->work_factor);
+  if (result != BZ_OK) {
+    member_ptr->ext_result = bzs_ext_get_error(result);
+    return;
+  }
+
+  size_t          destination_length = get_destination_bound(member_ptr->source_length);
+  bzs_ext_byte_t* destination        = malloc(destination_length);
+  if (destination == NULL) {
+    BZ2_bzCompressEnd(&stream);
+    member_ptr->ext_result = BZS_EXT_ERROR_ALLOCATE_FAILED;
+    return;
+  }
+
+  member_ptr->destination        = destination;
+  member_ptr->destination_length = destination_length;
+
+  bzs_ext_result_t ext_result = compress_member(&stream, member_ptr);
+
+  BZ2_bzCompressEnd(&stream);
+
+  if (ext_result != 0) {
+    free(destination);
+
+    member_ptr->destination        = NULL;
+    member_ptr->destination_length = 0;
+  }
+
+  member_ptr->ext_result = ext_result;
+}
+
+// -- members --
+
+static void compress_member_wrapper(void* data)
+{
+  bzs_ext_compress_member(data);
+}
+
+bzs_ext_result_t bzs_ext_compress_members(bzs_ext_member_t* members, size_t members_count)
+{
+  bzs_ext_task_t*  tasks      = malloc(sizeof(bzs_ext_task_t) * members_count);
+  bzs_ext_result_t ext_result = BZS_EXT_ERROR_ALLOCATE_FAILED;
+
+  if (tasks != NULL) {
+    for (size_t index = 0; index < members_count; index++) {
+      tasks[index] = (bzs_ext_task_t) {.function = compress_member_wrapper, .data = &members[index]};
+    }
+
+    ext_result = bzs_ext_run_tasks(tasks, members_count, members_count);
+
+    free(tasks);
+  }
+
+  if (ext_result != 0) {
+    // Members can be compressed in current thread.
+    for (size_t index = 0; index < members_count; index++) {
+      bzs_ext_compress_member(&members[index]);
+    }
+  }
+
+  ext_result = 0;
+
+  for (size_t index = 0; ext_result == 0 && index < members_count; index++) {
+    ext_result = members[index].ext_result;
+  }
+
+  return ext_result;
+}
+
+// -- pipeline --
+
+static void compress_pipeline_member(void* data)
+{
+  bzs_ext_pipeline_member_t* pipeline_member_ptr = data;
+  bzs_ext_pipeline_t*        pipeline_ptr        = pipeline_member_ptr->pipeline_ptr;
+
+  pthread_mutex_lock(&pipeline_ptr->mutex);
+  bool is_stopped = pipeline_ptr->is_stopped;
+  pthread_mutex_unlock(&pipeline_ptr->mutex);
+
+  // Stopped pipeline doesn't need remaining members.
+  if (!is_stopped) {
+    bzs_ext_compress_member(&pipeline_member_ptr->member);
+  }
+
+  // Source is not required after compression.
+  free(pipeline_member_ptr->source_buffer);
+  pipeline_member_ptr->source_buffer = NULL;
+
+  pthread_mutex_lock(&pipeline_ptr->mutex);
+
+  pipeline_member_ptr->is_finished = true;
+  pipeline_ptr->finished_members_count++;
+
+  pthread_cond_broadcast(&pipeline_ptr->finished_condition);
+  pthread_mutex_unlock(&pipeline_ptr->mutex);
+}
+
+bzs_ext_result_t bzs_ext_create_pipeline(
+  bzs_ext_pipeline_t** pipeline_ptr_ptr,
+  size_t               threads_count,
+  size_t               member_size,
+  bzs_ext_option_t     block_size,
+  bzs_ext_option_t     work_factor,
+  bzs_ext_option_t     verbosity)
+{
+  bzs_ext_pipeline_t* pipeline_ptr = malloc(sizeof(bzs_ext_pipeline_t));
+  if (pipeline_ptr == NULL) {
+    return BZS_EXT_ERROR_ALLOCATE_FAILED;
+  }
+
+  // Each worker can compress one member while another member is waiting for it.
+  size_t members_capacity = threads_count * 2;
+
+  pipeline_ptr->members = calloc(members_capacity, sizeof(bzs_ext_pipeline_member_t));
+  if (pipeline_ptr->members == NULL || pthread_mutex_init(&pipeline_ptr->mutex, NULL) != 0) {
+    free(pipeline_ptr->members);
+    free(pipeline_ptr);
+    return BZS_EXT_ERROR_ALLOCATE_FAILED;
+  }
+
+  bzs_ext_result_t ext_result = bzs_ext_acquire_pool(&pipeline_ptr->pool_ptr);
+  if (ext_result != 0) {
+    pthread_mutex_destroy(&pipeline_ptr->mutex);
+    free(pipeline_ptr->members);
+    free(pipeline_ptr);
+    return ext_result;
+  }
+
+  pthread_cond_init(&pipeline_ptr->finished_condition, NULL);
+
+  for (size_t index = 0; index < members_capacity; index++) {
+    pipeline_ptr->members[index].pipeline_ptr = pipeline_ptr;
+  }
+
+  pipeline_ptr->members_capacity        = members_capacity;
+  pipeline_ptr->submitted_members_count = 0;
+  pipeline_ptr->finished_members_count  = 0;
+  pipeline_ptr->read_members_count      = 0;
+  pipeline_ptr->read_destination_length = 0;
+  pipeline_ptr->chunk                   = NULL;
+  pipeline_ptr->chunk_length            = 0;
+  pipeline_ptr->chunk_capacity          = member_size != 0 ? member_size : (size_t) block_size * BZS_BLOCK_SIZE_UNIT;
+  pipeline_ptr->block_size              = block_size;
+  pipeline_ptr->work_factor             = work_factor;
+  pipeline_ptr->verbosity               = verbosity;
+  pipeline_ptr->pid                     = getpid();
+  pipeline_ptr->is_stopped              = false;
+  pipeline_ptr->is_interrupted          = false;
+
+  *pipeline_ptr_ptr = pipeline_ptr;
+
+  return 0;
+}
+
+bzs_ext_result_t bzs_ext_pipeline_append(
+  bzs_ext_pipeline_t*   pipeline_ptr,
+  const bzs_ext_byte_t* source,
+  size_t                source_length,
+  size_t*               appended_length_ptr)
+{
+  if (pipeline_ptr->chunk == NULL) {
+    pipeline_ptr->chunk = malloc(pipeline_ptr->chunk_capacity);
+    if (pipeline_ptr->chunk == NULL) {
+      return BZS_EXT_ERROR_ALLOCATE_FAILED;
+    }
+  }
+
+  size_t remaining_chunk_length = pipeline_ptr->chunk_capacity - pipeline_ptr->chunk_length;
+  if (source_length > remaining_chunk_length) {
+    source_length = remaining_chunk_length;
+  }
+
+  memcpy(pipeline_ptr->chunk + pipeline_ptr->chunk_length, source, source_length);
+  pipeline_ptr->chunk_length += source_length;
+
+  *appended_length_ptr = source_length;
+
+  return 0;
+}
+
+bool bzs_ext_pipeline_is_chunk_full(const bzs_ext_pipeline_t* pipeline_ptr)
+{
+  return pipeline_ptr->chunk_length == pipeline_ptr->chunk_capacity;
+}
+
+bool bzs_ext_pipeline_is_full(const bzs_ext_pipeline_t* pipeline_ptr)
+{
+  return pipeline_ptr->submitted_members_count - pipeline_ptr->read_members_count == pipeline_ptr->members_capacity;
+}
+
+bool bzs_ext_pipeline_is_empty(const bzs_ext_pipeline_t* pipeline_ptr)
+{
+  return pipeline_ptr->submitted_members_count == pipeline_ptr->read_members_count;
+}
+
+bzs_ext_result_t bzs_ext_pipeline_submit(bzs_ext_pipeline_t* pipeline_ptr)
+{
+  if (bzs_ext_pipeline_is_full(pipeline_ptr)) {
+    return BZS_EXT_ERROR_UNEXPECTED;
+  }
+
+  size_t index = pipeline_ptr->submitted_members_count % pipeline_ptr->members_capacity;
+
+  bzs_ext_pipeline_member_t* pipeline_member_ptr = &pipeline_ptr->members[index];
+  bzs_ext_member_t*          member_ptr          = &pipeline_member_ptr->member;
+
+  member_ptr->source             = pipeline_ptr->chunk;
+  member_ptr->source_length      = pipeline_ptr->chunk_length;
+  member_ptr->destination        = NULL;
+  member_ptr->destination_length = 0;
+  member_ptr->block_size         = pipeline_ptr->block_size;
+  member_ptr->work_factor        = pipeline_ptr->work_factor;
+  member_ptr->verbosity          = pipeline_ptr->verbosity;
+  member_ptr->ext_result         = 0;
+
+  // Chunk is owned by member now.
+  pipeline_member_ptr->source_buffer = pipeline_ptr->chunk;
+  pipeline_member_ptr->is_finished   = false;
+
+  pipeline_ptr->chunk        = NULL;
+  pipeline_ptr->chunk_length = 0;
+
+  pthread_mutex_lock(&pipeline_ptr->mutex);
+  pipeline_ptr->submitted_members_count++;
+  pthread_mutex_unlock(&pipeline_ptr->mutex);
+
+  bzs_ext_task_t task = {.function = compress_pipeline_member, .data = pipeline_member_ptr};
+  bzs_ext_pool_submit(pipeline_ptr->pool_ptr, task);
+
+  return 0;
+}
+
+bzs_ext_result_t bzs_ext_pipeline_read(
+  bzs_ext_pipeline_t* pipeline_ptr,
+  bzs_ext_byte_t*     destination,
+  size_t              destination_length,
+  size_t*             read_length_ptr)
+{
+  size_t           read_length = 0;
+  bzs_ext_result_t ext_result  = 0;
+
+  pthread_mutex_lock(&pipeline_ptr->mutex);
+
+  while (!bzs_ext_pipeline_is_empty(pipeline_ptr) && read_length != destination_length) {
+    size_t                     index               = pipeline_ptr->read_members_count % pipeline_ptr->members_capacity;
+    bzs_ext_pipeline_member_t* pipeline_member_ptr = &pipeline_ptr->members[index];
+    bzs_ext_member_t*          member_ptr          = &pipeline_member_ptr->member;
+
+    if (!pipeline_member_ptr->is_finished) {
+      break;
+    }
+
+    if (member_ptr->ext_result != 0) {
+      ext_result = member_ptr->ext_result;
+      break;
+    }
+
+    size_t remaining_member_length = member_ptr->destination_length - pipeline_ptr->read_destination_length;
+    size_t length                  = destination_length - read_length;
+    if (length > remaining_member_length) {
+      length = remaining_member_length;
+    }
+
+    memcpy(destination + read_length, member_ptr->destination + pipeline_ptr->read_destination_length, length);
+
+    read_length += length;
+    pipeline_ptr->read_destination_length += length;
+
+    if (pipeline_ptr->read_destination_length == member_ptr->destination_length) {
+      free(member_ptr->destination);
+      member_ptr->destination = NULL;
+
+      pipeline_ptr->read_members_count++;
+      pipeline_ptr->read_destination_length = 0;
+    }
+  }
+
+  pthread_mutex_unlock(&pipeline_ptr->mutex);
+
+  *read_length_ptr = read_length;
+
+  return ext_result;
+}
+
+void* bzs_ext_pipeline_wait(void* data)
+{
+  bzs_ext_pipeline_t* pipeline_ptr = data;
+
+  pthread_mutex_lock(&pipeline_ptr->mutex);
+
+  if (!bzs_ext_pipeline_is_empty(pipeline_ptr)) {
+    size_t                     index               = pipeline_ptr->read_members_count % pipeline_ptr->members_capacity;
+    bzs_ext_pipeline_member_t* pipeline_member_ptr = &pipeline_ptr->members[index];
+
+    while (!pipeline_ptr->is_interrupted && !pipeline_member_ptr->is_finished) {
+      pthread_cond_wait(&pipeline_ptr->finished_condition, &pipeline_ptr->mutex);
+    }
+  }
+
+  pipeline_ptr->is_interrupted = false;
+
+  pthread_mutex_unlock(&pipeline_ptr->mutex);
+
+  return NULL;
+}
+
+// Interrupt can be received after wait, so next wait may return early, producer checks its state again.
+void bzs_ext_pipeline_interrupt(void* data)
+{
+  bzs_ext_pipeline_t* pipeline_ptr = data;
+
+  pthread_mutex_lock(&pipeline_ptr->mutex);
+  pipeline_ptr->is_interrupted = true;
+  pthread_cond_broadcast(&pipeline_ptr->finished_condition);
+  pthread_mutex_unlock(&pipeline_ptr->mutex);
+}
+
+void bzs_ext_destroy_pipeline(bzs_ext_pipeline_t* pipeline_ptr)
+{
+  // Workers are not copied into child after fork, so submitted members won't be finished.
+  // Mutex could be locked by worker during fork, child can't wait for members.
+  bool is_forked = pipeline_ptr->pid != getpid();
+
+  if (!is_forked) {
+    pthread_mutex_lock(&pipeline_ptr->mutex);
+
+    pipeline_ptr->is_stopped = true;
+
+    // Submitted members are referenced by pool tasks.
+    while (pipeline_ptr->finished_members_count != pipeline_ptr->submitted_members_count) {
+      pthread_cond_wait(&pipeline_ptr->finished_condition, &pipeline_ptr->mutex);
+    }
+
+    pthread_mutex_unlock(&pipeline_ptr->mutex);
+  }
+
+  bzs_ext_release_pool(pipeline_ptr->pool_ptr);
+
+  for (size_t index = 0; index < pipeline_ptr->members_capacity; index++) {
+    bzs_ext_pipeline_member_t* pipeline_member_ptr = &pipeline_ptr->members[index];
+
+    // Unfinished member could be modified by worker during fork, its buffers are leaked.
+    if (!is_forked || pipeline_member_ptr->is_finished) {
+      free(pipeline_member_ptr->member.destination);
+    }
+  }
+
+  if (!is_forked) {
+    pthread_cond_destroy(&pipeline_ptr->finished_condition);
+    pthread_mutex_destroy(&pipeline_ptr->mutex);
+  }
+
+  free(pipeline_ptr->chunk);
+  free(pipeline_ptr->members);
+  free(pipeline_ptr);
+}
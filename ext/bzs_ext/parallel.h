@@ -0,0 +1,121 @@
+// Ruby bindings for bzip2 library.
+// Copyright (c) 2022 AUTHORS, MIT License.
+
+#if !defined(BZS_EXT_PARALLEL_H)
+#define BZS_EXT_PARALLEL_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "bzs_ext/common.h"
+#include "bzs_ext/option.h"
+#include "bzs_ext/pool.h"
+
+// Bzip2 can't sort single block in multiple threads.
+// We can split source into independent members and compress each member in separate thread.
+// Bzip2 decompressor is able to read concatenated members.
+// Too small members will decrease compression ratio, so member source length has lower limit.
+#define BZS_MIN_MEMBER_SOURCE_LENGTH (1 << 16) // 64 KB
+
+typedef struct
+{
+  const bzs_ext_byte_t* source;
+  size_t                source_length;
+  bzs_ext_byte_t*       destination;
+  size_t                destination_length;
+  bzs_ext_option_t      block_size;
+  bzs_ext_option_t      work_factor;
+  bzs_ext_option_t      verbosity;
+  bzs_ext_result_t      ext_result;
+} bzs_ext_member_t;
+
+// Zero threads means count of processors available for process.
+size_t bzs_ext_get_threads_count(size_t threads);
+size_t bzs_ext_get_members_count(size_t source_length, size_t threads);
+
+// Member destination will be allocated, it should be freed by caller.
+// Workers can't wait for governor, so caller should reserve memory for all simultaneous members.
+void bzs_ext_compress_member(bzs_ext_member_t* member_ptr);
+
+// Members will be compressed in pool, it can be used without GVL.
+bzs_ext_result_t bzs_ext_compress_members(bzs_ext_member_t* members, size_t members_count);
+
+// -- pipeline --
+
+// Pipeline accumulates source into chunks, each chunk will be compressed as separate member by pool workers.
+// Chunk length equals to member size or block size, so each member contains single block by default.
+// Members are stored in bounded ring, producer has to wait for oldest member when ring is full.
+// Compressed members can be read only in order of submission.
+
+typedef struct bzs_ext_pipeline bzs_ext_pipeline_t;
+
+typedef struct
+{
+  bzs_ext_member_t    member;
+  bzs_ext_byte_t*     source_buffer;
+  bzs_ext_pipeline_t* pipeline_ptr;
+  bool                is_finished;
+} bzs_ext_pipeline_member_t;
+
+struct bzs_ext_pipeline
+{
+  bzs_ext_pipeline_member_t* members;
+  size_t                     members_capacity;
+  size_t                     submitted_members_count;
+  size_t                     finished_members_count;
+  size_t                     read_members_count;
+  size_t                     read_destination_length;
+  bzs_ext_byte_t*            chunk;
+  size_t                     chunk_length;
+  size_t                     chunk_capacity;
+  bzs_ext_option_t           block_size;
+  bzs_ext_option_t           work_factor;
+  bzs_ext_option_t           verbosity;
+  bzs_ext_pool_t*            pool_ptr;
+  pthread_mutex_t            mutex;
+  pthread_cond_t             finished_condition;
+  pid_t                      pid;
+  bool                       is_stopped;
+  bool                       is_interrupted;
+};
+
+// Zero member size means block size.
+bzs_ext_result_t bzs_ext_create_pipeline(
+  bzs_ext_pipeline_t** pipeline_ptr,
+  size_t               threads_count,
+  size_t               member_size,
+  bzs_ext_option_t     block_size,
+  bzs_ext_option_t     work_factor,
+  bzs_ext_option_t     verbosity);
+
+// Appends source into current chunk.
+bzs_ext_result_t bzs_ext_pipeline_append(
+  bzs_ext_pipeline_t*   pipeline_ptr,
+  const bzs_ext_byte_t* source,
+  size_t                source_length,
+  size_t*               appended_length_ptr);
+
+bool bzs_ext_pipeline_is_chunk_full(const bzs_ext_pipeline_t* pipeline_ptr);
+bool bzs_ext_pipeline_is_full(const bzs_ext_pipeline_t* pipeline_ptr);
+bool bzs_ext_pipeline_is_empty(const bzs_ext_pipeline_t* pipeline_ptr);
+
+// Submits current chunk even if it is empty, pipeline should not be full.
+bzs_ext_result_t bzs_ext_pipeline_submit(bzs_ext_pipeline_t* pipeline_ptr);
+
+// Copies compressed members into destination without waiting.
+bzs_ext_result_t bzs_ext_pipeline_read(
+  bzs_ext_pipeline_t* pipeline_ptr,
+  bzs_ext_byte_t*     destination,
+  size_t              destination_length,
+  size_t*             read_length_ptr);
+
+// Waits until oldest member will be finished, it can be used without GVL.
+void* bzs_ext_pipeline_wait(void* pipeline_ptr);
+// Wakes waiting producer, it can be used as unblocking function.
+void bzs_ext_pipeline_interrupt(void* pipeline_ptr);
+
+// Pipeline from parent process can be destroyed in child, unfinished members will be leaked.
+void bzs_ext_destroy_pipeline(bzs_ext_pipeline_t* pipeline_ptr);
+
+#endif // BZS_EXT_PARALLEL_H
@@ -0,0 +1,282 @@
+// Ruby bindings for bzip2 library.
+// Copyright (c) 2022 AUTHORS, MIT License.
+
+// Glibc declares memmem as gnu extension.
+#if defined(HAVE_MEMMEM) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE 1
+#endif
+
+#include "bzs_ext/pattern.h"
+
+#include <ctype.h>
+#include <string.h>
+
+#include "bzs_ext/error.h"
+
+// -- initialization --
+
+static inline bzs_ext_result_t
+  compile_regexp(bzs_ext_pattern_t* pattern_ptr, const bzs_ext_byte_t* source, size_t source_length)
+{
+  // Each source byte provides at most single atom.
+  bzs_ext_pattern_atom_t* atoms = malloc((source_length != 0 ? source_length : 1) * sizeof(bzs_ext_pattern_atom_t));
+  if (atoms == NULL) {
+    return BZS_EXT_ERROR_ALLOCATE_FAILED;
+  }
+
+  pattern_ptr->atoms = atoms;
+
+  size_t atoms_count = 0;
+
+  for (size_t index = 0; index < source_length; index++) {
+    bzs_ext_byte_t byte = source[index];
+
+    switch (byte) {
+      case '^':
+        if (index != 0) {
+          return BZS_EXT_ERROR_VALIDATE_FAILED;
+        }
+
+        pattern_ptr->is_start_anchored = true;
+        continue;
+
+      case '$':
+        if (index != source_length - 1) {
+          return BZS_EXT_ERROR_VALIDATE_FAILED;
+        }
+
+        pattern_ptr->is_end_anchored = true;
+        continue;
+
+      case '*':
+        if (atoms_count == 0 || atoms[atoms_count - 1].is_repeated) {
+          return BZS_EXT_ERROR_VALIDATE_FAILED;
+        }
+
+        atoms[atoms_count - 1].is_repeated = true;
+        continue;
+
+      case '.':
+        atoms[atoms_count++] = (bzs_ext_pattern_atom_t){.byte = 0, .is_any = true, .is_repeated = false};
+        continue;
+
+      case '\\':
+        if (++index == source_length) {
+          return BZS_EXT_ERROR_VALIDATE_FAILED;
+        }
+
+        // Escaped letters and digits are character classes or anchors.
+        byte = source[index];
+        if (isalnum(byte)) {
+          return BZS_EXT_ERROR_VALIDATE_FAILED;
+        }
+
+        break;
+
+      case '[':
+      case ']':
+      case '(':
+      case ')':
+      case '{':
+      case '}':
+      case '+':
+      case '?':
+      case '|':
+        // Other regular expression features are not supported.
+        return BZS_EXT_ERROR_VALIDATE_FAILED;
+
+      default:
+        break;
+    }
+
+    atoms[atoms_count++] = (bzs_ext_pattern_atom_t){.byte = byte, .is_any = false, .is_repeated = false};
+  }
+
+  pattern_ptr->atoms_count = atoms_count;
+
+  return 0;
+}
+
+bzs_ext_result_t bzs_ext_create_pattern(
+  bzs_ext_pattern_t**   pattern_ptr_ptr,
+  const bzs_ext_byte_t* source,
+  size_t                source_length,
+  bool                  is_regexp)
+{
+  bzs_ext_pattern_t* pattern_ptr = calloc(1, sizeof(bzs_ext_pattern_t));
+  if (pattern_ptr == NULL) {
+    return BZS_EXT_ERROR_ALLOCATE_FAILED;
+  }
+
+  if (is_regexp) {
+    bzs_ext_result_t ext_result = compile_regexp(pattern_ptr, source, source_length);
+    if (ext_result != 0) {
+      bzs_ext_destroy_pattern(pattern_ptr);
+      return ext_result;
+    }
+
+    *pattern_ptr_ptr = pattern_ptr;
+
+    return 0;
+  }
+
+  bzs_ext_byte_t* literal = malloc(source_length != 0 ? source_length : 1);
+  if (literal == NULL) {
+    free(pattern_ptr);
+    return BZS_EXT_ERROR_ALLOCATE_FAILED;
+  }
+
+  memcpy(literal, source, source_length);
+
+  pattern_ptr->literal        = literal;
+  pattern_ptr->literal_length = source_length;
+  pattern_ptr->is_literal     = true;
+
+  *pattern_ptr_ptr = pattern_ptr;
+
+  return 0;
+}
+
+// -- match --
+
+static inline bool match_atom(const bzs_ext_pattern_atom_t* atom_ptr, bzs_ext_byte_t byte)
+{
+  return atom_ptr->is_any || atom_ptr->byte == byte;
+}
+
+static bool match_here(
+  const bzs_ext_pattern_t*      pattern_ptr,
+  const bzs_ext_pattern_atom_t* atoms,
+  size_t                        atoms_count,
+  const bzs_ext_byte_t*         text,
+  const bzs_ext_byte_t*         text_end);
+
+static bool match_repeated(
+  const bzs_ext_pattern_t*      pattern_ptr,
+  const bzs_ext_pattern_atom_t* atoms,
+  size_t                        atoms_count,
+  const bzs_ext_byte_t*         text,
+  const bzs_ext_byte_t*         text_end)
+{
+  const bzs_ext_pattern_atom_t* repeated_atom_ptr = atoms;
+
+  // Shortest repeat is enough to detect match.
+  while (true) {
+    if (match_here(pattern_ptr, atoms + 1, atoms_count - 1, text, text_end)) {
+      return true;
+    }
+
+    if (text == text_end || !match_atom(repeated_atom_ptr, *text)) {
+      return false;
+    }
+
+    text++;
+  }
+}
+
+static bool match_here(
+  const bzs_ext_pattern_t*      pattern_ptr,
+  const bzs_ext_pattern_atom_t* atoms,
+  size_t                        atoms_count,
+  const bzs_ext_byte_t*         text,
+  const bzs_ext_byte_t*         text_end)
+{
+  while (atoms_count != 0) {
+    if (atoms->is_repeated) {
+      return match_repeated(pattern_ptr, atoms, atoms_count, text, text_end);
+    }
+
+    if (text == text_end || !match_atom(atoms, *text)) {
+      return false;
+    }
+
+    atoms++;
+    atoms_count--;
+    text++;
+  }
+
+  return !pattern_ptr->is_end_anchored || text == text_end;
+}
+
+static inline bool match_regexp(const bzs_ext_pattern_t* pattern_ptr, const bzs_ext_byte_t* line, size_t line_length)
+{
+  const bzs_ext_pattern_atom_t* atoms       = pattern_ptr->atoms;
+  size_t                        atoms_count = pattern_ptr->atoms_count;
+  const bzs_ext_byte_t*         line_end    = line + line_length;
+
+  if (pattern_ptr->is_start_anchored) {
+    return match_here(pattern_ptr, atoms, atoms_count, line, line_end);
+  }
+
+  // Memchr can skip positions that can't start match.
+  bool is_first_byte_required = atoms_count != 0 && !atoms->is_any && !atoms->is_repeated;
+
+  for (const bzs_ext_byte_t* text = line; text <= line_end; text++) {
+    if (is_first_byte_required) {
+      text = memchr(text, atoms->byte, line_end - text);
+      if (text == NULL) {
+        return false;
+      }
+    }
+
+    if (match_here(pattern_ptr, atoms, atoms_count, text, line_end)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static inline bool match_literal(const bzs_ext_pattern_t* pattern_ptr, const bzs_ext_byte_t* line, size_t line_length)
+{
+  const bzs_ext_byte_t* literal        = pattern_ptr->literal;
+  size_t                literal_length = pattern_ptr->literal_length;
+
+#if defined(HAVE_MEMMEM)
+  return memmem(line, line_length, literal, literal_length) != NULL;
+#else
+  while (line_length >= literal_length) {
+    const bzs_ext_byte_t* literal_start = memchr(line, literal[0], line_length - literal_length + 1);
+    if (literal_start == NULL) {
+      return false;
+    }
+
+    if (memcmp(literal_start + 1, literal + 1, literal_length - 1) == 0) {
+      return true;
+    }
+
+    line_length -= literal_start + 1 - line;
+    line = literal_start + 1;
+  }
+
+  return false;
+#endif
+}
+
+bool bzs_ext_pattern_match(const bzs_ext_pattern_t* pattern_ptr, const bzs_ext_byte_t* line, size_t line_length)
+{
+  if (!pattern_ptr->is_literal) {
+    return match_regexp(pattern_ptr, line, line_length);
+  }
+
+  if (pattern_ptr->literal_length == 0) {
+    return true;
+  }
+
+  return match_literal(pattern_ptr, line, line_length);
+}
+
+// -- cleanup --
+
+void bzs_ext_destroy_pattern(bzs_ext_pattern_t* pattern_ptr)
+{
+  if (pattern_ptr->literal != NULL) {
+    free(pattern_ptr->literal);
+  }
+
+  if (pattern_ptr->atoms != NULL) {
+    free(pattern_ptr->atoms);
+  }
+
+  free(pattern_ptr);
+}
@@ -0,0 +1,44 @@
+// Ruby bindings for bzip2 library.
+// Copyright (c) 2022 AUTHORS, MIT License.
+
+#if !defined(BZS_EXT_PATTERN_H)
+#define BZS_EXT_PATTERN_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "bzs_ext/common.h"
+
+// Pattern is a literal or simple regular expression.
+// Regular expression supports "^" at the beginning, "$" at the end, "." any byte, "*" repeat
+//   and "\" escape for punctuation.
+
+typedef struct
+{
+  bzs_ext_byte_t byte;
+  bool           is_any;
+  bool           is_repeated;
+} bzs_ext_pattern_atom_t;
+
+typedef struct
+{
+  bzs_ext_byte_t*         literal;
+  size_t                  literal_length;
+  bzs_ext_pattern_atom_t* atoms;
+  size_t                  atoms_count;
+  bool                    is_literal;
+  bool                    is_start_anchored;
+  bool                    is_end_anchored;
+} bzs_ext_pattern_t;
+
+bzs_ext_result_t bzs_ext_create_pattern(
+  bzs_ext_pattern_t**   pattern_ptr_ptr,
+  const bzs_ext_byte_t* source,
+  size_t                source_length,
+  bool                  is_regexp);
+
+bool bzs_ext_pattern_match(const bzs_ext_pattern_t* pattern_ptr, const bzs_ext_byte_t* line, size_t line_length);
+
+void bzs_ext_destroy_pattern(bzs_ext_pattern_t* pattern_ptr);
+
+#endif // BZS_EXT_PATTERN_H
@@ -0,0 +1,597 @@
+// Ruby bindings for bzip2 library.
+// Copyright (c) 2022 AUTHORS, MIT License.
+
+// Glibc declares thread affinity as gnu extension.
+#if defined(HAVE_PTHREAD_ATTR_SETAFFINITY_NP) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE 1
+#endif
+
+#include "bzs_ext/pool.h"
+
+#include <sched.h>
+#include <unistd.h>
+
+#include "bzs_ext/error.h"
+#include "bzs_ext/macro.h"
+#include "bzs_ext/option.h"
+#include "bzs_ext/parallel.h"
+
+#if defined(HAVE_SETPRIORITY) && defined(__linux__)
+// Linux keeps nice value for each thread.
+#define THREAD_NICE_SUPPORTED
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
+#define INITIAL_QUEUE_CAPACITY 16
+
+typedef struct
+{
+  size_t threads;
+  bool   has_nice;
+  int    nice;
+#if defined(HAVE_PTHREAD_ATTR_SETAFFINITY_NP)
+  bool      has_affinity;
+  cpu_set_t affinity;
+#endif
+} config_t;
+
+static config_t config = {.threads = BZS_DEFAULT_POOL_THREADS, .has_nice = false, .nice = 0};
+
+// Mutex protects config, current pool and references of all pools.
+static pthread_mutex_t mutex            = PTHREAD_MUTEX_INITIALIZER;
+static bzs_ext_pool_t* current_pool_ptr = NULL;
+
+// -- queue --
+
+static inline bool push_task(bzs_ext_task_queue_t* queue_ptr, bzs_ext_task_t task)
+{
+  pthread_mutex_lock(&queue_ptr->mutex);
+
+  if (queue_ptr->tasks_count == queue_ptr->tasks_capacity) {
+    size_t          tasks_capacity = queue_ptr->tasks_capacity * 2;
+    bzs_ext_task_t* tasks          = malloc(sizeof(bzs_ext_task_t) * tasks_capacity);
+    if (tasks == NULL) {
+      pthread_mutex_unlock(&queue_ptr->mutex);
+      return false;
+    }
+
+    // Ring is unwrapped into new tasks.
+    for (size_t index = 0; index < queue_ptr->tasks_count; index++) {
+      tasks[index] = queue_ptr->tasks[(queue_ptr->first_task_index + index) % queue_ptr->tasks_capacity];
+    }
+
+    free(queue_ptr->tasks);
+
+    queue_ptr->tasks            = tasks;
+    queue_ptr->tasks_capacity   = tasks_capacity;
+    queue_ptr->first_task_index = 0;
+  }
+
+  size_t index            = (queue_ptr->first_task_index + queue_ptr->tasks_count) % queue_ptr->tasks_capacity;
+  queue_ptr->tasks[index] = task;
+  queue_ptr->tasks_count++;
+
+  pthread_mutex_unlock(&queue_ptr->mutex);
+
+  return true;
+}
+
+static inline bool pop_first_task(bzs_ext_task_queue_t* queue_ptr, bzs_ext_task_t* task_ptr)
+{
+  pthread_mutex_lock(&queue_ptr->mutex);
+
+  bool is_found = queue_ptr->tasks_count != 0;
+  if (is_found) {
+    *task_ptr                   = queue_ptr->tasks[queue_ptr->first_task_index];
+    queue_ptr->first_task_index = (queue_ptr->first_task_index + 1) % queue_ptr->tasks_capacity;
+    queue_ptr->tasks_count--;
+  }
+
+  pthread_mutex_unlock(&queue_ptr->mutex);
+
+  return is_found;
+}
+
+static inline bool pop_last_task(bzs_ext_task_queue_t* queue_ptr, bzs_ext_task_t* task_ptr)
+{
+  pthread_mutex_lock(&queue_ptr->mutex);
+
+  bool is_found = queue_ptr->tasks_count != 0;
+  if (is_found) {
+    queue_ptr->tasks_count--;
+    *task_ptr = queue_ptr->tasks[(queue_ptr->first_task_index + queue_ptr->tasks_count) % queue_ptr->tasks_capacity];
+  }
+
+  pthread_mutex_unlock(&queue_ptr->mutex);
+
+  return is_found;
+}
+
+// -- worker --
+
+static inline bool get_task(bzs_ext_pool_t* pool_ptr, size_t queue_index, bzs_ext_task_t* task_ptr)
+{
+  if (pop_first_task(&pool_ptr->queues[queue_index], task_ptr)) {
+    return true;
+  }
+
+  for (size_t offset = 1; offset < pool_ptr->queues_count; offset++) {
+    size_t index = (queue_index + offset) % pool_ptr->queues_count;
+
+    if (pop_last_task(&pool_ptr->queues[index], task_ptr)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static inline void apply_nice(const bzs_ext_pool_t* BZS_EXT_UNUSED(pool_ptr))
+{
+#if defined(THREAD_NICE_SUPPORTED)
+  if (pool_ptr->has_nice) {
+    // Decreasing nice value requires privileges, worker will keep process priority in this case.
+    setpriority(PRIO_PROCESS, (id_t) syscall(SYS_gettid), pool_ptr->nice);
+  }
+#endif
+}
+
+static void* run_worker(void* data)
+{
+  bzs_ext_pool_t* pool_ptr = data;
+  bzs_ext_task_t  task;
+
+  pthread_mutex_lock(&pool_ptr->mutex);
+  size_t queue_index = pool_ptr->next_worker_index % pool_ptr->queues_count;
+  pool_ptr->next_worker_index++;
+  pthread_mutex_unlock(&pool_ptr->mutex);
+
+  apply_nice(pool_ptr);
+
+  while (true) {
+    if (get_task(pool_ptr, queue_index, &task)) {
+      pthread_mutex_lock(&pool_ptr->mutex);
+      pool_ptr->tasks_count--;
+      pthread_mutex_unlock(&pool_ptr->mutex);
+
+      task.function(task.data);
+      continue;
+    }
+
+    pthread_mutex_lock(&pool_ptr->mutex);
+
+    while (pool_ptr->tasks_count == 0 && !pool_ptr->is_stopped) {
+      pthread_cond_wait(&pool_ptr->submitted_condition, &pool_ptr->mutex);
+    }
+
+    // Stopped worker finishes remaining tasks.
+    bool is_finished = pool_ptr->tasks_count == 0;
+
+    pthread_mutex_unlock(&pool_ptr->mutex);
+
+    if (is_finished) {
+      break;
+    }
+  }
+
+  return NULL;
+}
+
+// -- pool --
+
+static inline void destroy_queues(bzs_ext_pool_t* pool_ptr, size_t queues_count)
+{
+  for (size_t index = 0; index < queues_count; index++) {
+    bzs_ext_task_queue_t* queue_ptr = &pool_ptr->queues[index];
+
+    pthread_mutex_destroy(&queue_ptr->mutex);
+    free(queue_ptr->tasks);
+  }
+
+  free(pool_ptr->queues);
+}
+
+static inline bzs_ext_result_t create_queues(bzs_ext_pool_t* pool_ptr, size_t queues_count)
+{
+  pool_ptr->queues = malloc(sizeof(bzs_ext_task_queue_t) * queues_count);
+  if (pool_ptr->queues == NULL) {
+    return BZS_EXT_ERROR_ALLOCATE_FAILED;
+  }
+
+  for (size_t index = 0; index < queues_count; index++) {
+    bzs_ext_task_queue_t* queue_ptr = &pool_ptr->queues[index];
+
+    queue_ptr->tasks            = malloc(sizeof(bzs_ext_task_t) * INITIAL_QUEUE_CAPACITY);
+    queue_ptr->tasks_capacity   = INITIAL_QUEUE_CAPACITY;
+    queue_ptr->first_task_index = 0;
+    queue_ptr->tasks_count      = 0;
+
+    if (queue_ptr->tasks == NULL || pthread_mutex_init(&queue_ptr->mutex, NULL) != 0) {
+      free(queue_ptr->tasks);
+      destroy_queues(pool_ptr, index);
+      return BZS_EXT_ERROR_ALLOCATE_FAILED;
+    }
+  }
+
+  pool_ptr->queues_count = queues_count;
+
+  return 0;
+}
+
+static inline void stop_pool(bzs_ext_pool_t* pool_ptr)
+{
+  pthread_mutex_lock(&pool_ptr->mutex);
+  pool_ptr->is_stopped = true;
+  pthread_cond_broadcast(&pool_ptr->submitted_condition);
+  pthread_mutex_unlock(&pool_ptr->mutex);
+
+  for (size_t index = 0; index < pool_ptr->threads_count; index++) {
+    pthread_join(pool_ptr->threads[index], NULL);
+  }
+
+  pthread_cond_destroy(&pool_ptr->submitted_condition);
+  pthread_mutex_destroy(&pool_ptr->mutex);
+
+  destroy_queues(pool_ptr, pool_ptr->queues_count);
+
+  free(pool_ptr->threads);
+  free(pool_ptr);
+}
+
+static inline void start_workers(bzs_ext_pool_t* pool_ptr, const config_t* BZS_EXT_UNUSED(config_ptr))
+{
+  pthread_attr_t* attributes_ptr = NULL;
+
+#if defined(HAVE_PTHREAD_ATTR_SETAFFINITY_NP)
+  pthread_attr_t attributes;
+
+  if (config_ptr->has_affinity && pthread_attr_init(&attributes) == 0) {
+    if (pthread_attr_setaffinity_np(&attributes, sizeof(cpu_set_t), &config_ptr->affinity) == 0) {
+      attributes_ptr = &attributes;
+    } else {
+      pthread_attr_destroy(&attributes);
+    }
+  }
+#endif
+
+  // Tasks from queue without thread will be stolen by other workers.
+  for (size_t index = 0; index < pool_ptr->queues_count; index++) {
+    if (pthread_create(&pool_ptr->threads[pool_ptr->threads_count], attributes_ptr, run_worker, pool_ptr) == 0) {
+      pool_ptr->threads_count++;
+    }
+  }
+
+  if (attributes_ptr != NULL) {
+    pthread_attr_destroy(attributes_ptr);
+  }
+}
+
+// Mutex should be locked.
+static inline bzs_ext_result_t create_pool(bzs_ext_pool_t** pool_ptr_ptr, const config_t* config_ptr)
+{
+  bzs_ext_pool_t* pool_ptr = malloc(sizeof(bzs_ext_pool_t));
+  if (pool_ptr == NULL) {
+    return BZS_EXT_ERROR_ALLOCATE_FAILED;
+  }
+
+  size_t threads_count = bzs_ext_get_threads_count(config_ptr->threads);
+
+  pool_ptr->threads = malloc(sizeof(pthread_t) * threads_count);
+  if (pool_ptr->threads == NULL) {
+    free(pool_ptr);
+    return BZS_EXT_ERROR_ALLOCATE_FAILED;
+  }
+
+  bzs_ext_result_t ext_result = create_queues(pool_ptr, threads_count);
+  if (ext_result != 0) {
+    free(pool_ptr->threads);
+    free(pool_ptr);
+    return ext_result;
+  }
+
+  if (pthread_mutex_init(&pool_ptr->mutex, NULL) != 0) {
+    destroy_queues(pool_ptr, threads_count);
+    free(pool_ptr->threads);
+    free(pool_ptr);
+    return BZS_EXT_ERROR_ALLOCATE_FAILED;
+  }
+
+  pthread_cond_init(&pool_ptr->submitted_condition, NULL);
+
+  pool_ptr->next_queue_index  = 0;
+  pool_ptr->next_worker_index = 0;
+  pool_ptr->threads_count     = 0;
+  pool_ptr->tasks_count       = 0;
+  pool_ptr->references_count  = 0;
+  pool_ptr->pid               = getpid();
+  pool_ptr->has_nice          = config_ptr->has_nice;
+  pool_ptr->nice              = config_ptr->nice;
+  pool_ptr->is_retired        = false;
+  pool_ptr->is_stopped        = false;
+
+  start_workers(pool_ptr, config_ptr);
+
+  *pool_ptr_ptr = pool_ptr;
+
+  return 0;
+}
+
+bzs_ext_result_t bzs_ext_acquire_pool(bzs_ext_pool_t** pool_ptr_ptr)
+{
+  bzs_ext_result_t ext_result = 0;
+
+  pthread_mutex_lock(&mutex);
+
+  if (current_pool_ptr == NULL) {
+    ext_result = create_pool(&current_pool_ptr, &config);
+  }
+
+  if (ext_result == 0) {
+    current_pool_ptr->references_count++;
+    *pool_ptr_ptr = current_pool_ptr;
+  }
+
+  pthread_mutex_unlock(&mutex);
+
+  return ext_result;
+}
+
+void bzs_ext_release_pool(bzs_ext_pool_t* pool_ptr)
+{
+  // Pool from parent process has no workers, its mutexes could be locked during fork.
+  if (pool_ptr->pid != getpid()) {
+    return;
+  }
+
+  pthread_mutex_lock(&mutex);
+  pool_ptr->references_count--;
+  bool is_unused = pool_ptr->is_retired && pool_ptr->references_count == 0;
+  pthread_mutex_unlock(&mutex);
+
+  if (is_unused) {
+    stop_pool(pool_ptr);
+  }
+}
+
+static inline void retire_current_pool(void)
+{
+  pthread_mutex_lock(&mutex);
+
+  bzs_ext_pool_t* pool_ptr  = current_pool_ptr;
+  bool            is_unused = false;
+
+  if (pool_ptr != NULL) {
+    pool_ptr->is_retired = true;
+    is_unused            = pool_ptr->references_count == 0;
+    current_pool_ptr     = NULL;
+  }
+
+  pthread_mutex_unlock(&mutex);
+
+  if (is_unused) {
+    stop_pool(pool_ptr);
+  }
+}
+
+void bzs_ext_pool_submit(bzs_ext_pool_t* pool_ptr, bzs_ext_task_t task)
+{
+  if (pool_ptr->pid != getpid() || pool_ptr->threads_count == 0) {
+    task.function(task.data);
+    return;
+  }
+
+  pthread_mutex_lock(&pool_ptr->mutex);
+
+  bzs_ext_task_queue_t* queue_ptr = &pool_ptr->queues[pool_ptr->next_queue_index % pool_ptr->queues_count];
+  pool_ptr->next_queue_index++;
+
+  // Task is counted only when it is available for workers.
+  bool is_pushed = push_task(queue_ptr, task);
+  if (is_pushed) {
+    pool_ptr->tasks_count++;
+    pthread_cond_signal(&pool_ptr->submitted_condition);
+  }
+
+  pthread_mutex_unlock(&pool_ptr->mutex);
+
+  if (!is_pushed) {
+    task.function(task.data);
+  }
+}
+
+// -- tasks --
+
+// Group submits limited count of runners, each runner processes next tasks until all tasks are taken.
+
+typedef struct
+{
+  bzs_ext_task_t* tasks;
+  size_t          tasks_count;
+  size_t          next_task_index;
+  size_t          runners_count;
+  pthread_mutex_t mutex;
+  pthread_cond_t  finished_condition;
+} group_t;
+
+static void run_group_tasks(void* data)
+{
+  group_t* group_ptr = data;
+
+  pthread_mutex_lock(&group_ptr->mutex);
+
+  while (group_ptr->next_task_index != group_ptr->tasks_count) {
+    bzs_ext_task_t task = group_ptr->tasks[group_ptr->next_task_index];
+    group_ptr->next_task_index++;
+
+    pthread_mutex_unlock(&group_ptr->mutex);
+    task.function(task.data);
+    pthread_mutex_lock(&group_ptr->mutex);
+  }
+
+  group_ptr->runners_count--;
+  if (group_ptr->runners_count == 0) {
+    pthread_cond_signal(&group_ptr->finished_condition);
+  }
+
+  pthread_mutex_unlock(&group_ptr->mutex);
+}
+
+bzs_ext_result_t bzs_ext_run_tasks(bzs_ext_task_t* tasks, size_t tasks_count, size_t concurrency)
+{
+  if (tasks_count == 0) {
+    return 0;
+  }
+
+  if (concurrency == 0 || concurrency > tasks_count) {
+    concurrency = tasks_count;
+  }
+
+  bzs_ext_pool_t*  pool_ptr;
+  bzs_ext_result_t ext_result = bzs_ext_acquire_pool(&pool_ptr);
+  if (ext_result != 0) {
+    return ext_result;
+  }
+
+  group_t group = {
+    .tasks           = tasks,
+    .tasks_count     = tasks_count,
+    .next_task_index = 0,
+    .runners_count   = concurrency,
+  };
+
+  if (pthread_mutex_init(&group.mutex, NULL) != 0) {
+    bzs_ext_release_pool(pool_ptr);
+    return BZS_EXT_ERROR_ALLOCATE_FAILED;
+  }
+
+  pthread_cond_init(&group.finished_condition, NULL);
+
+  for (size_t index = 0; index < concurrency; index++) {
+    bzs_ext_pool_submit(pool_ptr, (bzs_ext_task_t) {.function = run_group_tasks, .data = &group});
+  }
+
+  pthread_mutex_lock(&group.mutex);
+
+  while (group.runners_count != 0) {
+    pthread_cond_wait(&group.finished_condition, &group.mutex);
+  }
+
+  pthread_mutex_unlock(&group.mutex);
+
+  pthread_cond_destroy(&group.finished_condition);
+  pthread_mutex_destroy(&group.mutex);
+
+  bzs_ext_release_pool(pool_ptr);
+
+  return 0;
+}
+
+// -- fork and exit --
+
+static void prepare_fork(void)
+{
+  pthread_mutex_lock(&mutex);
+}
+
+static void finish_fork_in_parent(void)
+{
+  pthread_mutex_unlock(&mutex);
+}
+
+static void finish_fork_in_child(void)
+{
+  // Workers are not copied into child, child will start its own pool.
+  current_pool_ptr = NULL;
+
+  pthread_mutex_unlock(&mutex);
+}
+
+static void stop_at_exit(VALUE BZS_EXT_UNUSED(data))
+{
+  retire_current_pool();
+}
+
+// -- ruby --
+
+static inline void set_affinity(config_t* config_ptr, VALUE affinity)
+{
+  if (affinity == Qnil) {
+#if defined(HAVE_PTHREAD_ATTR_SETAFFINITY_NP)
+    config_ptr->has_affinity = false;
+#endif
+    return;
+  }
+
+  Check_Type(affinity, T_ARRAY);
+
+#if defined(HAVE_PTHREAD_ATTR_SETAFFINITY_NP)
+  long length = RARRAY_LEN(affinity);
+  if (length == 0) {
+    bzs_ext_raise_error(BZS_EXT_ERROR_VALIDATE_FAILED);
+  }
+
+  CPU_ZERO(&config_ptr->affinity);
+
+  for (long index = 0; index < length; index++) {
+    VALUE processor = rb_ary_entry(affinity, index);
+    Check_Type(processor, T_FIXNUM);
+
+    long processor_index = NUM2LONG(processor);
+    if (processor_index < 0 || processor_index >= CPU_SETSIZE) {
+      bzs_ext_raise_error(BZS_EXT_ERROR_VALIDATE_FAILED);
+    }
+
+    CPU_SET((size_t) processor_index, &config_ptr->affinity);
+  }
+
+  config_ptr->has_affinity = true;
+#else
+  bzs_ext_raise_error(BZS_EXT_ERROR_NOT_IMPLEMENTED);
+#endif
+}
+
+static inline void set_nice(config_t* config_ptr, VALUE nice)
+{
+  if (nice == Qnil) {
+    config_ptr->has_nice = false;
+    return;
+  }
+
+  Check_Type(nice, T_FIXNUM);
+
+#if defined(THREAD_NICE_SUPPORTED)
+  config_ptr->has_nice = true;
+  config_ptr->nice     = NUM2INT(nice);
+#else
+  bzs_ext_raise_error(BZS_EXT_ERROR_NOT_IMPLEMENTED);
+#endif
+}
+
+VALUE bzs_ext_configure_pool(VALUE BZS_EXT_UNUSED(self), VALUE options)
+{
+  Check_Type(options, T_HASH);
+  BZS_EXT_RESOLVE_SIZE_OPTION(options, threads, BZS_DEFAULT_POOL_THREADS);
+
+  config_t new_config = {.threads = threads};
+
+  set_affinity(&new_config, rb_hash_aref(options, ID2SYM(rb_intern("affinity"))));
+  set_nice(&new_config, rb_hash_aref(options, ID2SYM(rb_intern("nice"))));
+
+  pthread_mutex_lock(&mutex);
+  config = new_config;
+  pthread_mutex_unlock(&mutex);
+
+  // Current users will finish their work in retired pool, new users will start new pool.
+  retire_current_pool();
+
+  return Qnil;
+}
+
+void bzs_ext_pool_exports(VALUE root_module)
+{
+  rb_define_module_function(root_module, "_native_configure_pool", RUBY_METHOD_FUNC(bzs_ext_configure_pool), 1);
+
+  pthread_atfork(prepare_fork, finish_fork_in_parent, finish_fork_in_child);
+  rb_set_end_proc(stop_at_exit, Qnil);
+}
@@ -0,0 +1,79 @@
+// Ruby bindings for bzip2 library.
+// Copyright (c) 2022 AUTHORS, MIT License.
+
+#if !defined(BZS_EXT_POOL_H)
+#define BZS_EXT_POOL_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <sys/types.h>
+
+#include "bzs_ext/common.h"
+#include "ruby.h"
+
+// Pool is a single set of long-lived threads owned by extension, all parallel work is submitted into it.
+// Each worker has its own queue, tasks are distributed between queues in round robin order.
+// Worker takes tasks from the front of its queue.
+// Worker steals tasks from the back of other queues when its queue is empty.
+// So neighbour tasks are usually processed at the same time and busy workers are not waiting for each other.
+
+// Pool is started lazily with current configuration, reconfiguration retires current pool.
+// Retired pool is stopped when its last user releases it.
+// Pool is stopped at exit, child process after fork starts its own pool.
+
+// Workers are bound to configured processors and allocate bzip2 states and destinations by themselves.
+// So memory is placed near processors by first touch policy, NUMA library is not required.
+
+typedef void (*bzs_ext_task_function_t)(void* data);
+
+typedef struct
+{
+  bzs_ext_task_function_t function;
+  void*                   data;
+} bzs_ext_task_t;
+
+typedef struct
+{
+  bzs_ext_task_t* tasks;
+  size_t          tasks_capacity;
+  size_t          first_task_index;
+  size_t          tasks_count;
+  pthread_mutex_t mutex;
+} bzs_ext_task_queue_t;
+
+typedef struct
+{
+  bzs_ext_task_queue_t* queues;
+  size_t                queues_count;
+  size_t                next_queue_index;
+  size_t                next_worker_index;
+  pthread_t*            threads;
+  size_t                threads_count;
+  size_t                tasks_count;
+  size_t                references_count;
+  pid_t                 pid;
+  bool                  has_nice;
+  int                   nice;
+  bool                  is_retired;
+  bool                  is_stopped;
+  pthread_mutex_t       mutex;
+  pthread_cond_t        submitted_condition;
+} bzs_ext_pool_t;
+
+// Pool should be released after usage, it can be used without GVL.
+bzs_ext_result_t bzs_ext_acquire_pool(bzs_ext_pool_t** pool_ptr_ptr);
+void             bzs_ext_release_pool(bzs_ext_pool_t* pool_ptr);
+
+// Task will be processed in current thread when pool has no workers or it belongs to parent process.
+void bzs_ext_pool_submit(bzs_ext_pool_t* pool_ptr, bzs_ext_task_t task);
+
+// Runs tasks in pool and waits for them, concurrency limits count of tasks processed at the same time.
+// It can be used without GVL.
+bzs_ext_result_t bzs_ext_run_tasks(bzs_ext_task_t* tasks, size_t tasks_count, size_t concurrency);
+
+VALUE bzs_ext_configure_pool(VALUE self, VALUE options);
+
+void bzs_ext_pool_exports(VALUE root_module);
+
+#endif // BZS_EXT_POOL_H
@@ -0,0 +1,389 @@
+// Ruby bindings for bzip2 library.
+// Copyright (c) 2022 AUTHORS, MIT License.
+
+#include "bzs_ext/read_ahead.h"
+
+#include <string.h>
+
+#include "bzs_ext/error.h"
+#include "bzs_ext/utils.h"
+
+// -- state --
+
+// Mutex should be locked for all state helpers.
+
+static inline size_t get_ready_count(const bzs_ext_read_ahead_t* read_ahead_ptr)
+{
+  return read_ahead_ptr->written_destination_buffers_count - read_ahead_ptr->read_destination_buffers_count;
+}
+
+static inline bool is_idle(const bzs_ext_read_ahead_t* read_ahead_ptr)
+{
+  return read_ahead_ptr->source_length == 0 && read_ahead_ptr->active_source_length == 0 &&
+         read_ahead_ptr->writing_destination_length == 0;
+}
+
+static inline bool can_decompress(const bzs_ext_read_ahead_t* read_ahead_ptr)
+{
+  return (read_ahead_ptr->source_length != 0 || read_ahead_ptr->active_source_length != 0) &&
+         get_ready_count(read_ahead_ptr) != read_ahead_ptr->destination_buffers_count;
+}
+
+// -- worker --
+
+static inline void publish_destination(bzs_ext_read_ahead_t* read_ahead_ptr)
+{
+  size_t index = read_ahead_ptr->written_destination_buffers_count % read_ahead_ptr->destination_buffers_count;
+
+  read_ahead_ptr->destination_lengths[index] = read_ahead_ptr->writing_destination_length;
+  read_ahead_ptr->writing_destination_length = 0;
+  read_ahead_ptr->written_destination_buffers_count++;
+}
+
+// Mutex should not be locked, worker owns active source and writing destination.
+static inline bzs_ext_result_t decompress(
+  bzs_ext_read_ahead_t* read_ahead_ptr,
+  const bzs_ext_byte_t* source,
+  size_t                source_length,
+  bzs_ext_byte_t*       destination,
+  size_t                destination_length,
+  size_t*               read_source_length_ptr,
+  size_t*               written_destination_length_ptr)
+{
+  bz_stream*            stream_ptr       = read_ahead_ptr->stream_ptr;
+  const bzs_ext_byte_t* remaining_source = source;
+
+  *read_source_length_ptr         = 0;
+  *written_destination_length_ptr = 0;
+
+  bzs_ext_result_t ext_result = bzs_find_next_stream(
+    &read_ahead_ptr->next_stream,
+    stream_ptr,
+    read_ahead_ptr->verbosity,
+    read_ahead_ptr->small,
+    &remaining_source,
+    &source_length);
+
+  *read_source_length_ptr = remaining_source - source;
+
+  if (ext_result != 0) {
+    return ext_result;
+  }
+
+  if (!bzs_is_next_stream_found(&read_ahead_ptr->next_stream)) {
+    // Next source may contain remaining part of header, trailing data is consumed.
+    return 0;
+  }
+
+  stream_ptr->next_in   = (char*) remaining_source;
+  stream_ptr->avail_in  = bzs_consume_size(source_length);
+  stream_ptr->next_out  = (char*) destination;
+  stream_ptr->avail_out = bzs_consume_size(destination_length);
+
+  bzs_result_t result = BZ2_bzDecompress(stream_ptr);
+
+  *read_source_length_ptr         = (const bzs_ext_byte_t*) stream_ptr->next_in - source;
+  *written_destination_length_ptr = (bzs_ext_byte_t*) stream_ptr->next_out - destination;
+
+  if (result == BZ_STREAM_END) {
+    // Remaining source may contain next concatenated stream.
+    read_ahead_ptr->next_stream.is_stream_end = true;
+    return 0;
+  }
+
+  if (result != BZ_OK) {
+    return bzs_ext_get_error(result);
+  }
+
+  return 0;
+}
+
+static void* read_ahead_worker(void* data)
+{
+  bzs_ext_read_ahead_t* read_ahead_ptr = data;
+
+  pthread_mutex_lock(&read_ahead_ptr->mutex);
+
+  while (true) {
+    while (!read_ahead_ptr->is_stopped && !can_decompress(read_ahead_ptr)) {
+      pthread_cond_wait(&read_ahead_ptr->condition, &read_ahead_ptr->mutex);
+    }
+
+    if (read_ahead_ptr->is_stopped) {
+      break;
+    }
+
+    if (read_ahead_ptr->active_source_length == 0) {
+      // Worker takes whole queued source, consumer receives empty source buffer.
+      bzs_ext_byte_t* source_buffer        = read_ahead_ptr->source_buffer;
+      read_ahead_ptr->source_buffer        = read_ahead_ptr->active_source_buffer;
+      read_ahead_ptr->active_source_buffer = source_buffer;
+      read_ahead_ptr->active_source        = source_buffer;
+      read_ahead_ptr->active_source_length = read_ahead_ptr->source_length;
+      read_ahead_ptr->source_length        = 0;
+
+      pthread_cond_broadcast(&read_ahead_ptr->condition);
+    }
+
+    size_t index = read_ahead_ptr->written_destination_buffers_count % read_ahead_ptr->destination_buffers_count;
+    const bzs_ext_byte_t* source        = read_ahead_ptr->active_source;
+    size_t                source_length = read_ahead_ptr->active_source_length;
+    bzs_ext_byte_t*       destination =
+      read_ahead_ptr->destination_buffers[index] + read_ahead_ptr->writing_destination_length;
+    size_t destination_length = read_ahead_ptr->destination_buffer_length - read_ahead_ptr->writing_destination_length;
+
+    pthread_mutex_unlock(&read_ahead_ptr->mutex);
+
+    size_t           read_source_length, written_destination_length;
+    bzs_ext_result_t ext_result = decompress(
+      read_ahead_ptr,
+      source,
+      source_length,
+      destination,
+      destination_length,
+      &read_source_length,
+      &written_destination_length);
+
+    pthread_mutex_lock(&read_ahead_ptr->mutex);
+
+    read_ahead_ptr->active_source += read_source_length;
+    read_ahead_ptr->active_source_length -= read_source_length;
+    read_ahead_ptr->writing_destination_length += written_destination_length;
+
+    if (ext_result != 0) {
+      read_ahead_ptr->ext_result = ext_result;
+      pthread_cond_broadcast(&read_ahead_ptr->condition);
+      break;
+    }
+
+    // Partial destination buffer should be provided when worker has no more source.
+    if (
+      read_ahead_ptr->writing_destination_length == read_ahead_ptr->destination_buffer_length ||
+      (read_ahead_ptr->writing_destination_length != 0 && read_ahead_ptr->active_source_length == 0 &&
+       read_ahead_ptr->source_length == 0)) {
+      publish_destination(read_ahead_ptr);
+    }
+
+    pthread_cond_broadcast(&read_ahead_ptr->condition);
+  }
+
+  pthread_mutex_unlock(&read_ahead_ptr->mutex);
+
+  return NULL;
+}
+
+// -- initialization --
+
+static inline void free_read_ahead(bzs_ext_read_ahead_t* read_ahead_ptr)
+{
+  if (read_ahead_ptr->destination_buffers != NULL) {
+    for (size_t index = 0; index < read_ahead_ptr->destination_buffers_count; index++) {
+      free(read_ahead_ptr->destination_buffers[index]);
+    }
+  }
+
+  free(read_ahead_ptr->destination_buffers);
+  free(read_ahead_ptr->destination_lengths);
+  free(read_ahead_ptr->source_buffer);
+  free(read_ahead_ptr->active_source_buffer);
+  free(read_ahead_ptr);
+}
+
+bzs_ext_result_t bzs_ext_create_read_ahead(
+  bzs_ext_read_ahead_t** read_ahead_ptr_ptr,
+  bz_stream*             stream_ptr,
+  bzs_ext_option_t       verbosity,
+  bzs_ext_option_t       small,
+  size_t                 source_buffer_length,
+  size_t                 destination_buffers_count,
+  size_t                 destination_buffer_length)
+{
+  bzs_ext_read_ahead_t* read_ahead_ptr = calloc(1, sizeof(bzs_ext_read_ahead_t));
+  if (read_ahead_ptr == NULL) {
+    return BZS_EXT_ERROR_ALLOCATE_FAILED;
+  }
+
+  read_ahead_ptr->stream_ptr                = stream_ptr;
+  read_ahead_ptr->verbosity                 = verbosity;
+  read_ahead_ptr->small                     = small;
+  read_ahead_ptr->source_buffer_length      = source_buffer_length;
+  read_ahead_ptr->destination_buffers_count = destination_buffers_count;
+  read_ahead_ptr->destination_buffer_length = destination_buffer_length;
+  read_ahead_ptr->source_buffer             = malloc(source_buffer_length);
+  read_ahead_ptr->active_source_buffer      = malloc(source_buffer_length);
+  read_ahead_ptr->destination_buffers       = calloc(destination_buffers_count, sizeof(bzs_ext_byte_t*));
+  read_ahead_ptr->destination_lengths       = calloc(destination_buffers_count, sizeof(size_t));
+
+  bzs_init_next_stream(&read_ahead_ptr->next_stream);
+
+  if (
+    read_ahead_ptr->source_buffer == NULL || read_ahead_ptr->active_source_buffer == NULL ||
+    read_ahead_ptr->destination_buffers == NULL || read_ahead_ptr->destination_lengths == NULL) {
+    free_read_ahead(read_ahead_ptr);
+    return BZS_EXT_ERROR_ALLOCATE_FAILED;
+  }
+
+  for (size_t index = 0; index < destination_buffers_count; index++) {
+    bzs_ext_byte_t* destination_buffer = malloc(destination_buffer_length);
+    if (destination_buffer == NULL) {
+      free_read_ahead(read_ahead_ptr);
+      return BZS_EXT_ERROR_ALLOCATE_FAILED;
+    }
+
+    read_ahead_ptr->destination_buffers[index] = destination_buffer;
+  }
+
+  if (pthread_mutex_init(&read_ahead_ptr->mutex, NULL) != 0) {
+    free_read_ahead(read_ahead_ptr);
+    return BZS_EXT_ERROR_ALLOCATE_FAILED;
+  }
+
+  pthread_cond_init(&read_ahead_ptr->condition, NULL);
+
+  if (pthread_create(&read_ahead_ptr->thread, NULL, read_ahead_worker, read_ahead_ptr) != 0) {
+    pthread_cond_destroy(&read_ahead_ptr->condition);
+    pthread_mutex_destroy(&read_ahead_ptr->mutex);
+    free_read_ahead(read_ahead_ptr);
+    return BZS_EXT_ERROR_ALLOCATE_FAILED;
+  }
+
+  *read_ahead_ptr_ptr = read_ahead_ptr;
+
+  return 0;
+}
+
+// -- source --
+
+size_t bzs_ext_read_ahead_append(
+  bzs_ext_read_ahead_t* read_ahead_ptr,
+  const bzs_ext_byte_t* source,
+  size_t                source_length)
+{
+  pthread_mutex_lock(&read_ahead_ptr->mutex);
+
+  size_t remaining_source_buffer_length = read_ahead_ptr->source_buffer_length - read_ahead_ptr->source_length;
+  if (source_length > remaining_source_buffer_length) {
+    source_length = remaining_source_buffer_length;
+  }
+
+  if (source_length != 0) {
+    memcpy(read_ahead_ptr->source_buffer + read_ahead_ptr->source_length, source, source_length);
+    read_ahead_ptr->source_length += source_length;
+
+    pthread_cond_broadcast(&read_ahead_ptr->condition);
+  }
+
+  pthread_mutex_unlock(&read_ahead_ptr->mutex);
+
+  return source_length;
+}
+
+// -- destination --
+
+bzs_ext_result_t bzs_ext_read_ahead_get_ready_count(bzs_ext_read_ahead_t* read_ahead_ptr, size_t* ready_count_ptr)
+{
+  pthread_mutex_lock(&read_ahead_ptr->mutex);
+
+  bzs_ext_result_t ext_result = read_ahead_ptr->ext_result;
+  *ready_count_ptr            = get_ready_count(read_ahead_ptr);
+
+  pthread_mutex_unlock(&read_ahead_ptr->mutex);
+
+  return ext_result;
+}
+
+void bzs_ext_read_ahead_get_destination(
+  bzs_ext_read_ahead_t*  read_ahead_ptr,
+  const bzs_ext_byte_t** destination_ptr,
+  size_t*                destination_length_ptr)
+{
+  // Worker won't touch filled destination buffer until it will be released.
+  size_t index = read_ahead_ptr->read_destination_buffers_count % read_ahead_ptr->destination_buffers_count;
+
+  *destination_ptr        = read_ahead_ptr->destination_buffers[index];
+  *destination_length_ptr = read_ahead_ptr->destination_lengths[index];
+}
+
+void bzs_ext_read_ahead_release_destination(bzs_ext_read_ahead_t* read_ahead_ptr)
+{
+  pthread_mutex_lock(&read_ahead_ptr->mutex);
+  read_ahead_ptr->read_destination_buffers_count++;
+  pthread_cond_broadcast(&read_ahead_ptr->condition);
+  pthread_mutex_unlock(&read_ahead_ptr->mutex);
+}
+
+bool bzs_ext_read_ahead_is_idle(bzs_ext_read_ahead_t* read_ahead_ptr)
+{
+  pthread_mutex_lock(&read_ahead_ptr->mutex);
+  bool result = is_idle(read_ahead_ptr);
+  pthread_mutex_unlock(&read_ahead_ptr->mutex);
+
+  return result;
+}
+
+// -- wait --
+
+void* bzs_ext_read_ahead_wait_for_source(void* data)
+{
+  bzs_ext_read_ahead_t* read_ahead_ptr = data;
+
+  pthread_mutex_lock(&read_ahead_ptr->mutex);
+
+  while (!read_ahead_ptr->is_interrupted && read_ahead_ptr->ext_result == 0 &&
+         read_ahead_ptr->source_length == read_ahead_ptr->source_buffer_length &&
+         get_ready_count(read_ahead_ptr) == 0) {
+    pthread_cond_wait(&read_ahead_ptr->condition, &read_ahead_ptr->mutex);
+  }
+
+  read_ahead_ptr->is_interrupted = false;
+
+  pthread_mutex_unlock(&read_ahead_ptr->mutex);
+
+  return NULL;
+}
+
+void* bzs_ext_read_ahead_wait_for_destination(void* data)
+{
+  bzs_ext_read_ahead_t* read_ahead_ptr = data;
+
+  pthread_mutex_lock(&read_ahead_ptr->mutex);
+
+  while (!read_ahead_ptr->is_interrupted && read_ahead_ptr->ext_result == 0 && get_ready_count(read_ahead_ptr) == 0 &&
+         !is_idle(read_ahead_ptr)) {
+    pthread_cond_wait(&read_ahead_ptr->condition, &read_ahead_ptr->mutex);
+  }
+
+  read_ahead_ptr->is_interrupted = false;
+
+  pthread_mutex_unlock(&read_ahead_ptr->mutex);
+
+  return NULL;
+}
+
+// Interrupt can be received after wait, so next wait may return early, consumer checks its state again.
+void bzs_ext_read_ahead_interrupt(void* data)
+{
+  bzs_ext_read_ahead_t* read_ahead_ptr = data;
+
+  pthread_mutex_lock(&read_ahead_ptr->mutex);
+  read_ahead_ptr->is_interrupted = true;
+  pthread_cond_broadcast(&read_ahead_ptr->condition);
+  pthread_mutex_unlock(&read_ahead_ptr->mutex);
+}
+
+// -- cleanup --
+
+void bzs_ext_destroy_read_ahead(bzs_ext_read_ahead_t* read_ahead_ptr)
+{
+  pthread_mutex_lock(&read_ahead_ptr->mutex);
+  read_ahead_ptr->is_stopped = true;
+  pthread_cond_broadcast(&read_ahead_ptr->condition);
+  pthread_mutex_unlock(&read_ahead_ptr->mutex);
+
+  pthread_join(read_ahead_ptr->thread, NULL);
+
+  pthread_cond_destroy(&read_ahead_ptr->condition);
+  pthread_mutex_destroy(&read_ahead_ptr->mutex);
+
+  free_read_ahead(read_ahead_ptr);
+}
@@ -0,0 +1,86 @@
+// Ruby bindings for bzip2 library.
+// Copyright (c) 2022 AUTHORS, MIT License.
+
+#if !defined(BZS_EXT_READ_AHEAD_H)
+#define BZS_EXT_READ_AHEAD_H
+
+#include <bzlib.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "bzs_ext/common.h"
+#include "bzs_ext/option.h"
+#include "bzs_ext/utils.h"
+
+// Read ahead worker decompresses queued source in background thread.
+// Worker writes result into ring of pre-allocated destination buffers.
+// Consumer receives filled destination buffers in order, so result is just a copy of already decompressed data.
+// Worker owns stream while read ahead is running.
+
+typedef struct
+{
+  bz_stream*        stream_ptr;
+  bzs_ext_option_t  verbosity;
+  bzs_ext_option_t  small;
+  bzs_next_stream_t next_stream;
+  bzs_ext_byte_t*   source_buffer;
+  size_t            source_length;
+  bzs_ext_byte_t*   active_source_buffer;
+  bzs_ext_byte_t*   active_source;
+  size_t            active_source_length;
+  size_t            source_buffer_length;
+  bzs_ext_byte_t**  destination_buffers;
+  size_t*           destination_lengths;
+  size_t            destination_buffers_count;
+  size_t            destination_buffer_length;
+  size_t            written_destination_buffers_count;
+  size_t            read_destination_buffers_count;
+  size_t            writing_destination_length;
+  pthread_t         thread;
+  pthread_mutex_t   mutex;
+  pthread_cond_t    condition;
+  bzs_ext_result_t  ext_result;
+  bool              is_stopped;
+  bool              is_interrupted;
+} bzs_ext_read_ahead_t;
+
+bzs_ext_result_t bzs_ext_create_read_ahead(
+  bzs_ext_read_ahead_t** read_ahead_ptr,
+  bz_stream*             stream_ptr,
+  bzs_ext_option_t       verbosity,
+  bzs_ext_option_t       small,
+  size_t                 source_buffer_length,
+  size_t                 destination_buffers_count,
+  size_t                 destination_buffer_length);
+
+// Queues source for worker, returns queued length.
+size_t bzs_ext_read_ahead_append(
+  bzs_ext_read_ahead_t* read_ahead_ptr,
+  const bzs_ext_byte_t* source,
+  size_t                source_length);
+
+// Returns count of filled destination buffers or error.
+bzs_ext_result_t bzs_ext_read_ahead_get_ready_count(bzs_ext_read_ahead_t* read_ahead_ptr, size_t* ready_count_ptr);
+
+// Returns oldest filled destination buffer, it should be released after usage.
+void bzs_ext_read_ahead_get_destination(
+  bzs_ext_read_ahead_t* read_ahead_ptr,
+  const bzs_ext_byte_t** destination_ptr,
+  size_t*                destination_length_ptr);
+void bzs_ext_read_ahead_release_destination(bzs_ext_read_ahead_t* read_ahead_ptr);
+
+bool bzs_ext_read_ahead_is_idle(bzs_ext_read_ahead_t* read_ahead_ptr);
+
+// Wait functions can be used without GVL.
+// Waits for source space, filled destination buffer or error.
+void* bzs_ext_read_ahead_wait_for_source(void* read_ahead_ptr);
+// Waits for filled destination buffer, idle worker or error.
+void* bzs_ext_read_ahead_wait_for_destination(void* read_ahead_ptr);
+// Wakes waiting consumer, it can be used as unblocking function.
+void bzs_ext_read_ahead_interrupt(void* read_ahead_ptr);
+
+// Stops worker, stream will be owned by caller again.
+void bzs_ext_destroy_read_ahead(bzs_ext_read_ahead_t* read_ahead_ptr);
+
+#endif // BZS_EXT_READ_AHEAD_H
@@ -0,0 +1,331 @@
+// Ruby bindings for bzip2 library.
+// Copyright (c) 2022 AUTHORS, MIT License.
+
+#include "bzs_ext/recompress.h"
+
+#include "bzs_ext/error.h"
+#include "bzs_ext/governor.h"
+#include "bzs_ext/utils.h"
+
+// -- initialization --
+
+bzs_ext_result_t bzs_ext_create_recompressor(
+  bzs_ext_recompressor_t** recompressor_ptr_ptr,
+  bzs_ext_option_t         block_size,
+  bzs_ext_option_t         work_factor,
+  bzs_ext_option_t         verbosity,
+  bzs_ext_option_t         small,
+  size_t                   destination_buffer_length)
+{
+  // Memory depends on block size, so it should be validated before init.
+  if (block_size < BZS_MIN_BLOCK_SIZE || block_size > BZS_MAX_BLOCK_SIZE) {
+    return BZS_EXT_ERROR_VALIDATE_FAILED;
+  }
+
+  // Both streams are reserved at once, decompressor can be downgraded into small mode.
+  size_t compressor_memory = bzs_ext_get_compressor_memory(block_size);
+  size_t memory            = compressor_memory + bzs_ext_get_decompressor_memory(small);
+  size_t downgraded_memory = small ? 0 : compressor_memory + bzs_ext_get_decompressor_memory(true);
+  bzs_ext_reservation_t reserved_memory;
+
+  bzs_ext_result_t ext_result = bzs_ext_governor_reserve(memory, downgraded_memory, &reserved_memory);
+  if (ext_result != 0) {
+    return ext_result;
+  }
+
+  if (reserved_memory.size != memory) {
+    small = true;
+  }
+
+  bzs_ext_recompressor_t* recompressor_ptr = calloc(1, sizeof(bzs_ext_recompressor_t));
+  if (recompressor_ptr == NULL) {
+    bzs_ext_governor_release(reserved_memory);
+    return BZS_EXT_ERROR_ALLOCATE_FAILED;
+  }
+
+  bzs_ext_byte_t* intermediate_buffer = malloc(BZS_DEFAULT_INTERMEDIATE_BUFFER_LENGTH);
+  if (intermediate_buffer == NULL) {
+    free(recompressor_ptr);
+    bzs_ext_governor_release(reserved_memory);
+    return BZS_EXT_ERROR_ALLOCATE_FAILED;
+  }
+
+  bzs_ext_byte_t* destination_buffer = malloc(destination_buffer_length);
+  if (destination_buffer == NULL) {
+    free(intermediate_buffer);
+    free(recompressor_ptr);
+    bzs_ext_governor_release(reserved_memory);
+    return BZS_EXT_ERROR_ALLOCATE_FAILED;
+  }
+
+  // Allocators will be used to restart streams for each member.
+  bz_stream* decompressor_stream_ptr = &recompressor_ptr->decompressor_stream;
+  bz_stream* compressor_stream_ptr   = &recompressor_ptr->compressor_stream;
+
+  bzs_ext_init_allocator(&recompressor_ptr->decompressor_allocator);
+  bzs_ext_use_allocator(decompressor_stream_ptr, &recompressor_ptr->decompressor_allocator);
+  bzs_ext_init_allocator(&recompressor_ptr->compressor_allocator);
+  bzs_ext_use_allocator(compressor_stream_ptr, &recompressor_ptr->compressor_allocator);
+
+  bzs_result_t result = BZ2_bzDecompressInit(decompressor_stream_ptr, verbosity, small);
+  if (result != BZ_OK) {
+    free(destination_buffer);
+    free(intermediate_buffer);
+    free(recompressor_ptr);
+    bzs_ext_governor_release(reserved_memory);
+    return bzs_ext_get_error(result);
+  }
+
+  result = BZ2_bzCompressInit(compressor_stream_ptr, block_size, verbosity, work_factor);
+  if (result != BZ_OK) {
+    BZ2_bzDecompressEnd(decompressor_stream_ptr);
+    bzs_ext_release_allocator(&recompressor_ptr->decompressor_allocator);
+    free(destination_buffer);
+    free(intermediate_buffer);
+    free(recompressor_ptr);
+    bzs_ext_governor_release(reserved_memory);
+    return bzs_ext_get_error(result);
+  }
+
+  recompressor_ptr->intermediate_buffer        = intermediate_buffer;
+  recompressor_ptr->intermediate_buffer_length = BZS_DEFAULT_INTERMEDIATE_BUFFER_LENGTH;
+  recompressor_ptr->destination_buffer         = destination_buffer;
+  recompressor_ptr->destination_buffer_length  = destination_buffer_length;
+  recompressor_ptr->block_size                 = block_size;
+  recompressor_ptr->work_factor                = work_factor;
+  recompressor_ptr->verbosity                  = verbosity;
+  recompressor_ptr->small                      = small;
+  recompressor_ptr->reserved_memory            = reserved_memory;
+
+  bzs_init_next_stream(&recompressor_ptr->next_stream);
+
+  *recompressor_ptr_ptr = recompressor_ptr;
+
+  return 0;
+}
+
+// -- compress --
+
+static inline bzs_ext_result_t flush_destination(
+  bzs_ext_recompressor_t*               recompressor_ptr,
+  bzs_ext_recompressor_write_function_t function,
+  void*                                 data)
+{
+  size_t destination_length = recompressor_ptr->destination_length;
+  if (destination_length == 0) {
+    return 0;
+  }
+
+  recompressor_ptr->destination_length = 0;
+
+  return function(data, recompressor_ptr->destination_buffer, destination_length);
+}
+
+static inline bzs_ext_result_t run_compressor(
+  bzs_ext_recompressor_t*               recompressor_ptr,
+  int                                   stream_action,
+  const bzs_ext_byte_t*                 source,
+  size_t                                source_length,
+  bzs_ext_recompressor_write_function_t function,
+  void*                                 data)
+{
+  bz_stream*       stream_ptr = &recompressor_ptr->compressor_stream;
+  bzs_ext_result_t ext_result;
+
+  while (true) {
+    bzs_ext_byte_t* remaining_destination_buffer =
+      recompressor_ptr->destination_buffer + recompressor_ptr->destination_length;
+    size_t remaining_destination_buffer_length =
+      recompressor_ptr->destination_buffer_length - recompressor_ptr->destination_length;
+
+    stream_ptr->next_in   = (char*) source;
+    stream_ptr->avail_in  = bzs_consume_size(source_length);
+    stream_ptr->next_out  = (char*) remaining_destination_buffer;
+    stream_ptr->avail_out = bzs_consume_size(remaining_destination_buffer_length);
+
+    bzs_result_t result = BZ2_bzCompress(stream_ptr, stream_action);
+    if (result != BZ_RUN_OK && result != BZ_FINISH_OK && result != BZ_STREAM_END) {
+      return bzs_ext_get_error(result);
+    }
+
+    size_t read_source_length        = (const bzs_ext_byte_t*) stream_ptr->next_in - source;
+    size_t written_destination_length = (bzs_ext_byte_t*) stream_ptr->next_out - remaining_destination_buffer;
+
+    if (recompressor_ptr->index_ptr != NULL) {
+      ext_result = bzs_ext_index_update(
+        recompressor_ptr->index_ptr,
+        stream_action,
+        source,
+        read_source_length,
+        remaining_destination_buffer,
+        written_destination_length);
+      if (ext_result != 0) {
+        return ext_result;
+      }
+    }
+
+    source += read_source_length;
+    source_length -= read_source_length;
+    recompressor_ptr->destination_length += written_destination_length;
+
+    if (result == BZ_STREAM_END || (stream_action == BZ_RUN && source_length == 0)) {
+      return 0;
+    }
+
+    if (recompressor_ptr->destination_length == recompressor_ptr->destination_buffer_length) {
+      ext_result = flush_destination(recompressor_ptr, function, data);
+      if (ext_result != 0) {
+        return ext_result;
+      }
+    }
+  }
+}
+
+static inline bzs_ext_result_t compress_members(
+  bzs_ext_recompressor_t*               recompressor_ptr,
+  const bzs_ext_byte_t*                 source,
+  size_t                                source_length,
+  bzs_ext_recompressor_write_function_t function,
+  void*                                 data)
+{
+  bzs_ext_result_t ext_result;
+  size_t           member_size = recompressor_ptr->member_size;
+
+  while (source_length != 0) {
+    // Full member will be finished only when next source is available.
+    if (member_size != 0 && recompressor_ptr->member_source_length == member_size) {
+      ext_result = run_compressor(recompressor_ptr, BZ_FINISH, NULL, 0, function, data);
+      if (ext_result != 0) {
+        return ext_result;
+      }
+
+      // Restart will reuse memory of previous member.
+      ext_result = bzs_restart_compressor(
+        &recompressor_ptr->compressor_stream,
+        recompressor_ptr->block_size,
+        recompressor_ptr->verbosity,
+        recompressor_ptr->work_factor);
+      if (ext_result != 0) {
+        return ext_result;
+      }
+
+      recompressor_ptr->member_source_length = 0;
+    }
+
+    size_t member_source_length = source_length;
+
+    if (member_size != 0) {
+      size_t remaining_member_source_length = member_size - recompressor_ptr->member_source_length;
+      if (member_source_length > remaining_member_source_length) {
+        member_source_length = remaining_member_source_length;
+      }
+    }
+
+    ext_result = run_compressor(recompressor_ptr, BZ_RUN, source, member_source_length, function, data);
+    if (ext_result != 0) {
+      return ext_result;
+    }
+
+    source += member_source_length;
+    source_length -= member_source_length;
+    recompressor_ptr->member_source_length += member_source_length;
+  }
+
+  return 0;
+}
+
+// -- decompress --
+
+bzs_ext_result_t bzs_ext_recompressor_append(
+  bzs_ext_recompressor_t*               recompressor_ptr,
+  const bzs_ext_byte_t*                 source,
+  size_t                                source_length,
+  bzs_ext_recompressor_write_function_t function,
+  void*                                 data)
+{
+  bz_stream*       stream_ptr                 = &recompressor_ptr->decompressor_stream;
+  bzs_ext_byte_t*  intermediate_buffer        = recompressor_ptr->intermediate_buffer;
+  size_t           intermediate_buffer_length = recompressor_ptr->intermediate_buffer_length;
+  bzs_ext_result_t ext_result;
+
+  while (true) {
+    ext_result = bzs_find_next_stream(
+      &recompressor_ptr->next_stream,
+      stream_ptr,
+      recompressor_ptr->verbosity,
+      recompressor_ptr->small,
+      &source,
+      &source_length);
+    if (ext_result != 0) {
+      return ext_result;
+    }
+
+    if (!bzs_is_next_stream_found(&recompressor_ptr->next_stream)) {
+      // Next source may contain remaining part of header, trailing data is consumed.
+      break;
+    }
+
+    stream_ptr->next_in   = (char*) source;
+    stream_ptr->avail_in  = bzs_consume_size(source_length);
+    stream_ptr->next_out  = (char*) intermediate_buffer;
+    stream_ptr->avail_out = bzs_consume_size(intermediate_buffer_length);
+
+    bzs_result_t result = BZ2_bzDecompress(stream_ptr);
+    if (result != BZ_OK && result != BZ_STREAM_END) {
+      return bzs_ext_get_error(result);
+    }
+
+    size_t read_source_length  = (const bzs_ext_byte_t*) stream_ptr->next_in - source;
+    size_t intermediate_length = (bzs_ext_byte_t*) stream_ptr->next_out - intermediate_buffer;
+
+    source += read_source_length;
+    source_length -= read_source_length;
+
+    // Decompressed data goes directly into compressor.
+    ext_result = compress_members(recompressor_ptr, intermediate_buffer, intermediate_length, function, data);
+    if (ext_result != 0) {
+      return ext_result;
+    }
+
+    if (result == BZ_STREAM_END) {
+      // Remaining source may contain next concatenated stream.
+      recompressor_ptr->next_stream.is_stream_end = true;
+      continue;
+    }
+
+    if (source_length == 0 && intermediate_length != intermediate_buffer_length) {
+      break;
+    }
+  }
+
+  return 0;
+}
+
+bzs_ext_result_t bzs_ext_recompressor_finish(
+  bzs_ext_recompressor_t*               recompressor_ptr,
+  bzs_ext_recompressor_write_function_t function,
+  void*                                 data)
+{
+  bzs_ext_result_t ext_result = run_compressor(recompressor_ptr, BZ_FINISH, NULL, 0, function, data);
+  if (ext_result != 0) {
+    return ext_result;
+  }
+
+  return flush_destination(recompressor_ptr, function, data);
+}
+
+// -- cleanup --
+
+void bzs_ext_destroy_recompressor(bzs_ext_recompressor_t* recompressor_ptr)
+{
+  // Streams should be ended before allocator release.
+  BZ2_bzDecompressEnd(&recompressor_ptr->decompressor_stream);
+  bzs_ext_release_allocator(&recompressor_ptr->decompressor_allocator);
+  BZ2_bzCompressEnd(&recompressor_ptr->compressor_stream);
+  bzs_ext_release_allocator(&recompressor_ptr->compressor_allocator);
+  bzs_ext_governor_release(recompressor_ptr->reserved_memory);
+
+  free(recompressor_ptr->destination_buffer);
+  free(recompressor_ptr->intermediate_buffer);
+  free(recompressor_ptr);
+}
@@ -0,0 +1,73 @@
+// Ruby bindings for bzip2 library.
+// Copyright (c) 2022 AUTHORS, MIT License.
+
+#if !defined(BZS_EXT_RECOMPRESS_H)
+#define BZS_EXT_RECOMPRESS_H
+
+#include <bzlib.h>
+#include <stdlib.h>
+
+#include "bzs_ext/allocator.h"
+#include "bzs_ext/common.h"
+#include "bzs_ext/governor.h"
+#include "bzs_ext/index.h"
+#include "bzs_ext/option.h"
+#include "bzs_ext/utils.h"
+
+// Recompressor decompresses source into intermediate buffer and compresses this buffer with new options.
+// Decompressed data is never provided to ruby, it can work without global VM lock.
+// Member size limits source of each compressed stream, zero means single stream.
+// Index is optional, it is owned by caller.
+// Memory of both streams is reserved through governor, so recompressor should be created with GVL.
+
+#define BZS_DEFAULT_INTERMEDIATE_BUFFER_LENGTH (1 << 18) // 256 KB
+
+typedef bzs_ext_result_t (
+  *bzs_ext_recompressor_write_function_t)(void* data, const bzs_ext_byte_t* destination, size_t destination_length);
+
+typedef struct
+{
+  bz_stream             decompressor_stream;
+  bzs_ext_allocator_t   decompressor_allocator;
+  bz_stream             compressor_stream;
+  bzs_ext_allocator_t   compressor_allocator;
+  bzs_ext_byte_t*       intermediate_buffer;
+  size_t                intermediate_buffer_length;
+  bzs_ext_byte_t*       destination_buffer;
+  size_t                destination_buffer_length;
+  size_t                destination_length;
+  bzs_ext_option_t      block_size;
+  bzs_ext_option_t      work_factor;
+  bzs_ext_option_t      verbosity;
+  bzs_ext_option_t      small;
+  bzs_next_stream_t     next_stream;
+  size_t                member_size;
+  size_t                member_source_length;
+  bzs_ext_reservation_t reserved_memory;
+  bzs_ext_index_t*      index_ptr;
+} bzs_ext_recompressor_t;
+
+bzs_ext_result_t bzs_ext_create_recompressor(
+  bzs_ext_recompressor_t** recompressor_ptr_ptr,
+  bzs_ext_option_t         block_size,
+  bzs_ext_option_t         work_factor,
+  bzs_ext_option_t         verbosity,
+  bzs_ext_option_t         small,
+  size_t                   destination_buffer_length);
+
+// Whole source will be consumed, function receives compressed destination.
+bzs_ext_result_t bzs_ext_recompressor_append(
+  bzs_ext_recompressor_t*               recompressor_ptr,
+  const bzs_ext_byte_t*                 source,
+  size_t                                source_length,
+  bzs_ext_recompressor_write_function_t function,
+  void*                                 data);
+
+bzs_ext_result_t bzs_ext_recompressor_finish(
+  bzs_ext_recompressor_t*               recompressor_ptr,
+  bzs_ext_recompressor_write_function_t function,
+  void*                                 data);
+
+void bzs_ext_destroy_recompressor(bzs_ext_recompressor_t* recompressor_ptr);
+
+#endif // BZS_EXT_RECOMPRESS_H
@@ -7,17 +7,91 @@
 
 #include "bzs_ext/buffer.h"
 #include "bzs_ext/error.h"
+#include "bzs_ext/governor.h"
 #include "bzs_ext/gvl.h"
 #include "bzs_ext/option.h"
 #include "bzs_ext/utils.h"
 
+// -- memory --
+
+// Bzip2 memory is allocated outside of ruby heap, so GC should know about it.
+// Reserved memory is an estimate of memory used by bzip2 library.
+static inline size_t get_external_memory(const bzs_ext_compressor_t* compressor_ptr)
+{
+  return compressor_ptr->reserved_memory.size + compressor_ptr->destination_buffer_length;
+}
+
+static inline void add_gc_memory(bzs_ext_compressor_t* compressor_ptr)
+{
+  compressor_ptr->gc_memory = get_external_memory(compressor_ptr);
+  rb_gc_adjust_memory_usage((ssize_t) compressor_ptr->gc_memory);
+}
+
+static inline void remove_gc_memory(bzs_ext_compressor_t* compressor_ptr)
+{
+  if (compressor_ptr->gc_memory != 0) {
+    rb_gc_adjust_memory_usage(-(ssize_t) compressor_ptr->gc_memory);
+    compressor_ptr->gc_memory = 0;
+  }
+}
+
+static size_t get_compressor_memory_size(const void* data)
+{
+  const bzs_ext_compressor_t* compressor_ptr = data;
+  size_t                      size           = sizeof(bzs_ext_compressor_t);
+
+  if (compressor_ptr->stream_ptr != NULL) {
+    size += sizeof(bz_stream);
+  }
+
+  // Allocator knows real size of memory used by single stream.
+  size += compressor_ptr->allocator.size;
+
+  const bzs_ext_pipeline_t* pipeline_ptr = compressor_ptr->pipeline_ptr;
+  if (pipeline_ptr != NULL) {
+    // Workers are using their own streams, reserved memory is an estimate of them.
+    size += compressor_ptr->reserved_memory.size + pipeline_ptr->members_capacity * pipeline_ptr->chunk_capacity;
+  }
+
+  const bzs_ext_index_t* index_ptr = compressor_ptr->index_ptr;
+  if (index_ptr != NULL) {
+    size += sizeof(bzs_ext_index_t) + index_ptr->records_capacity +
+            index_ptr->events_capacity * sizeof(bzs_ext_index_event_t);
+  }
+
+  if (compressor_ptr->destination_buffer != NULL) {
+    size += compressor_ptr->destination_buffer_length;
+  }
+
+  return size;
+}
+
 // -- initialization --
 
-static void free_compressor(bzs_ext_compressor_t* compressor_ptr)
+static void free_compressor(void* data)
 {
+  bzs_ext_compressor_t* compressor_ptr = data;
+
+  remove_gc_memory(compressor_ptr);
+
   bz_stream* stream_ptr = compressor_ptr->stream_ptr;
   if (stream_ptr != NULL) {
     BZ2_bzCompressEnd(stream_ptr);
+    free(stream_ptr);
+  }
+
+  bzs_ext_release_allocator(&compressor_ptr->allocator);
+
+  bzs_ext_pipeline_t* pipeline_ptr = compressor_ptr->pipeline_ptr;
+  if (pipeline_ptr != NULL) {
+    bzs_ext_destroy_pipeline(pipeline_ptr);
+  }
+
+  bzs_ext_governor_release(compressor_ptr->reserved_memory);
+
+  bzs_ext_index_t* index_ptr = compressor_ptr->index_ptr;
+  if (index_ptr != NULL) {
+    bzs_ext_destroy_index(index_ptr);
   }
 
   bzs_ext_byte_t* destination_buffer = compressor_ptr->destination_buffer;
@@ -28,24 +102,43 @@ static void free_compressor(bzs_ext_compressor_t* compressor_ptr)
   free(compressor_ptr);
 }
 
+// Compressor doesn't keep ruby objects, so it can be freed immediately.
+static const rb_data_type_t compressor_type = {
+  .wrap_struct_name = "bzs_ext_compressor",
+  .function         = {.dmark = NULL, .dfree = free_compressor, .dsize = get_compressor_memory_size},
+  .flags            = RUBY_TYPED_FREE_IMMEDIATELY};
+
 VALUE bzs_ext_allocate_compressor(VALUE klass)
 {
   bzs_ext_compressor_t* compressor_ptr;
-  VALUE                 self = Data_Make_Struct(klass, bzs_ext_compressor_t, NULL, free_compressor, compressor_ptr);
+  VALUE self = TypedData_Make_Struct(klass, bzs_ext_compressor_t, &compressor_type, compressor_ptr);
 
   compressor_ptr->stream_ptr                          = NULL;
+  compressor_ptr->pipeline_ptr                        = NULL;
+  compressor_ptr->index_ptr                           = NULL;
   compressor_ptr->destination_buffer                  = NULL;
   compressor_ptr->destination_buffer_length           = 0;
   compressor_ptr->remaining_destination_buffer        = NULL;
   compressor_ptr->remaining_destination_buffer_length = 0;
+  compressor_ptr->member_size                         = 0;
+  compressor_ptr->member_source_length                = 0;
+  compressor_ptr->block_size                          = BZS_DEFAULT_BLOCK_SIZE;
+  compressor_ptr->verbosity                           = BZS_DEFAULT_VERBOSITY;
+  compressor_ptr->work_factor                         = BZS_DEFAULT_WORK_FACTOR;
   compressor_ptr->gvl                                 = false;
+  compressor_ptr->reserved_memory                     = BZS_EXT_EMPTY_RESERVATION;
+  compressor_ptr->gc_memory                           = 0;
+
+  bzs_ext_init_allocator(&compressor_ptr->allocator);
+  bzs_ext_init_digest(&compressor_ptr->source_digest, BZS_DIGEST_NONE);
+  bzs_ext_init_digest(&compressor_ptr->destination_digest, BZS_DIGEST_NONE);
 
   return self;
 }
 
 #define GET_COMPRESSOR(self)            \
   bzs_ext_compressor_t* compressor_ptr; \
-  Data_Get_Struct(self, bzs_ext_compressor_t, compressor_ptr);
+  TypedData_Get_Struct(self, bzs_ext_compressor_t, &compressor_type, compressor_ptr);
 
 VALUE bzs_ext_initialize_compressor(VALUE self, VALUE options)
 {
@@ -54,71 +147,173 @@ VALUE bzs_ext_initialize_compressor(VALUE self, VALUE options)
   BZS_EXT_GET_SIZE_OPTION(options, destination_buffer_length);
   BZS_EXT_GET_BOOL_OPTION(options, gvl);
   BZS_EXT_RESOLVE_COMPRESSOR_OPTIONS(options);
-
-  bz_stream* stream_ptr = malloc(sizeof(bz_stream));
-  if (stream_ptr == NULL) {
-    bzs_ext_raise_error(BZS_EXT_ERROR_ALLOCATE_FAILED);
+  BZS_EXT_RESOLVE_SIZE_OPTION(options, threads, BZS_DEFAULT_THREADS);
+  BZS_EXT_RESOLVE_BOOL_OPTION(options, index, BZS_DEFAULT_INDEX);
+  BZS_EXT_RESOLVE_SIZE_OPTION(options, member_size, BZS_DEFAULT_MEMBER_SIZE);
+  BZS_EXT_RESOLVE_DIGEST_OPTION(options, digest);
+
+  bz_stream*          stream_ptr    = NULL;
+  bzs_ext_pipeline_t* pipeline_ptr  = NULL;
+  size_t              threads_count = bzs_ext_get_threads_count(threads);
+
+  // Members will be initialized by workers and memory is reserved by block size, so options should be validated before.
+  if (
+    block_size < BZS_MIN_BLOCK_SIZE || block_size > BZS_MAX_BLOCK_SIZE || work_factor < BZS_MIN_WORK_FACTOR ||
+    work_factor > BZS_MAX_WORK_FACTOR) {
+    bzs_ext_raise_error(BZS_EXT_ERROR_VALIDATE_FAILED);
   }
 
-  stream_ptr->bzalloc = NULL;
-  stream_ptr->bzfree  = NULL;
-  stream_ptr->opaque  = NULL;
+  // Each worker compresses its own member.
+  bzs_ext_reservation_t reserved_memory;
 
-  bzs_result_t result = BZ2_bzCompressInit(stream_ptr, block_size, verbosity, work_factor);
-  if (result != BZ_OK) {
-    free(stream_ptr);
-    bzs_ext_raise_error(bzs_ext_get_error(result));
+  bzs_ext_result_t ext_result = bzs_ext_governor_reserve_compressors(block_size, threads_count, &reserved_memory);
+  if (ext_result != 0) {
+    bzs_ext_raise_error(ext_result);
+  }
+
+  if (threads_count > 1) {
+    ext_result = bzs_ext_create_pipeline(&pipeline_ptr, threads_count, member_size, block_size, work_factor, verbosity);
+    if (ext_result != 0) {
+      bzs_ext_governor_release(reserved_memory);
+      bzs_ext_raise_error(ext_result);
+    }
+  } else {
+    stream_ptr = malloc(sizeof(bz_stream));
+    if (stream_ptr == NULL) {
+      bzs_ext_governor_release(reserved_memory);
+      bzs_ext_raise_error(BZS_EXT_ERROR_ALLOCATE_FAILED);
+    }
+
+    // Allocator will be used to restart stream for each member.
+    bzs_ext_use_allocator(stream_ptr, &compressor_ptr->allocator);
+
+    bzs_result_t result = BZ2_bzCompressInit(stream_ptr, block_size, verbosity, work_factor);
+    if (result != BZ_OK) {
+      free(stream_ptr);
+      bzs_ext_release_allocator(&compressor_ptr->allocator);
+      bzs_ext_governor_release(reserved_memory);
+      bzs_ext_raise_error(bzs_ext_get_error(result));
+    }
   }
 
   if (destination_buffer_length == 0) {
     destination_buffer_length = BZS_DEFAULT_DESTINATION_BUFFER_LENGTH_FOR_COMPRESSOR;
   }
 
+  bzs_ext_index_t* index_ptr = NULL;
+
+  if (index) {
+    ext_result = bzs_ext_create_index(&index_ptr, block_size);
+    if (ext_result != 0) {
+      if (stream_ptr != NULL) {
+        BZ2_bzCompressEnd(stream_ptr);
+        free(stream_ptr);
+        bzs_ext_release_allocator(&compressor_ptr->allocator);
+      }
+
+      if (pipeline_ptr != NULL) {
+        bzs_ext_destroy_pipeline(pipeline_ptr);
+      }
+
+      bzs_ext_governor_release(reserved_memory);
+      bzs_ext_raise_error(ext_result);
+    }
+  }
+
   bzs_ext_byte_t* destination_buffer = malloc(destination_buffer_length);
   if (destination_buffer == NULL) {
-    free(stream_ptr);
+    if (index_ptr != NULL) {
+      bzs_ext_destroy_index(index_ptr);
+    }
+
+    if (stream_ptr != NULL) {
+      BZ2_bzCompressEnd(stream_ptr);
+      free(stream_ptr);
+      bzs_ext_release_allocator(&compressor_ptr->allocator);
+    }
+
+    if (pipeline_ptr != NULL) {
+      bzs_ext_destroy_pipeline(pipeline_ptr);
+    }
+
+    bzs_ext_governor_release(reserved_memory);
     bzs_ext_raise_error(BZS_EXT_ERROR_ALLOCATE_FAILED);
   }
 
   compressor_ptr->stream_ptr                          = stream_ptr;
+  compressor_ptr->pipeline_ptr                        = pipeline_ptr;
+  compressor_ptr->index_ptr                           = index_ptr;
   compressor_ptr->destination_buffer                  = destination_buffer;
   compressor_ptr->destination_buffer_length           = destination_buffer_length;
   compressor_ptr->remaining_destination_buffer        = destination_buffer;
   compressor_ptr->remaining_destination_buffer_length = destination_buffer_length;
+  compressor_ptr->member_size                         = member_size;
+  compressor_ptr->block_size                          = block_size;
+  compressor_ptr->verbosity                           = verbosity;
+  compressor_ptr->work_factor                         = work_factor;
   compressor_ptr->gvl                                 = gvl;
+  compressor_ptr->reserved_memory                     = reserved_memory;
+
+  bzs_ext_init_digest(&compressor_ptr->source_digest, digest);
+  bzs_ext_init_digest(&compressor_ptr->destination_digest, digest);
+
+  add_gc_memory(compressor_ptr);
 
   return Qnil;
 }
 
 // -- compress --
 
-#define DO_NOT_USE_AFTER_CLOSE(compressor_ptr)                                            \
-  if (compressor_ptr->stream_ptr == NULL || compressor_ptr->destination_buffer == NULL) { \
-    bzs_ext_raise_error(BZS_EXT_ERROR_USED_AFTER_CLOSE);                                  \
+#define DO_NOT_USE_AFTER_CLOSE(compressor_ptr)                                       \
+  if (                                                                               \
+    (compressor_ptr->stream_ptr == NULL && compressor_ptr->pipeline_ptr == NULL) || \
+    compressor_ptr->destination_buffer == NULL) {                                    \
+    bzs_ext_raise_error(BZS_EXT_ERROR_USED_AFTER_CLOSE);                             \
   }
 
 typedef struct
 {
-  bz_stream*       stream_ptr;
-  int              stream_action;
-  bzs_ext_byte_t** remaining_source_ptr;
-  size_t*          remaining_source_length_ptr;
-  bzs_ext_byte_t** remaining_destination_buffer_ptr;
-  size_t*          remaining_destination_buffer_length_ptr;
-  bzs_result_t     result;
+  bz_stream*        stream_ptr;
+  int               stream_action;
+  bzs_ext_byte_t**  remaining_source_ptr;
+  size_t*           remaining_source_length_ptr;
+  bzs_ext_byte_t**  remaining_destination_buffer_ptr;
+  size_t*           remaining_destination_buffer_length_ptr;
+  bzs_ext_index_t*  index_ptr;
+  bzs_ext_digest_t* source_digest_ptr;
+  bzs_ext_digest_t* destination_digest_ptr;
+  bzs_result_t      result;
+  bzs_ext_result_t  ext_result;
 } compress_args_t;
 
 static inline void* compress_wrapper(void* data)
 {
   compress_args_t* args = data;
 
-  args->stream_ptr->next_in   = (char*) *args->remaining_source_ptr;
+  const bzs_ext_byte_t* source      = *args->remaining_source_ptr;
+  const bzs_ext_byte_t* destination = *args->remaining_destination_buffer_ptr;
+
+  args->stream_ptr->next_in   = (char*) source;
   args->stream_ptr->avail_in  = bzs_consume_size(*args->remaining_source_length_ptr);
-  args->stream_ptr->next_out  = (char*) *args->remaining_destination_buffer_ptr;
+  args->stream_ptr->next_out  = (char*) destination;
   args->stream_ptr->avail_out = bzs_consume_size(*args->remaining_destination_buffer_length_ptr);
 
   args->result = BZ2_bzCompress(args->stream_ptr, args->stream_action);
 
+  bzs_ext_digest_update(args->source_digest_ptr, source, (const bzs_ext_byte_t*) args->stream_ptr->next_in - source);
+  bzs_ext_digest_update(
+    args->destination_digest_ptr, destination, (const bzs_ext_byte_t*) args->stream_ptr->next_out - destination);
+
+  if (args->index_ptr != NULL) {
+    args->ext_result = bzs_ext_index_update(
+      args->index_ptr,
+      args->stream_action,
+      source,
+      (const bzs_ext_byte_t*) args->stream_ptr->next_in - source,
+      destination,
+      (const bzs_ext_byte_t*) args->stream_ptr->next_out - destination);
+  }
+
   *args->remaining_source_ptr                    = (bzs_ext_byte_t*) args->stream_ptr->next_in;
   *args->remaining_source_length_ptr             = args->stream_ptr->avail_in;
   *args->remaining_destination_buffer_ptr        = (bzs_ext_byte_t*) args->stream_ptr->next_out;
@@ -127,36 +322,264 @@ static inline void* compress_wrapper(void* data)
   return NULL;
 }
 
-VALUE bzs_ext_compress(VALUE self, VALUE source_value)
+// -- members --
+
+// Member size limits source of each stream, zero means single stream.
+
+static inline bool is_member_full(const bzs_ext_compressor_t* compressor_ptr)
 {
-  GET_COMPRESSOR(self);
-  DO_NOT_USE_AFTER_CLOSE(compressor_ptr);
-  Check_Type(source_value, T_STRING);
+  return compressor_ptr->member_size != 0 && compressor_ptr->member_source_length == compressor_ptr->member_size;
+}
 
-  const char*     source                  = RSTRING_PTR(source_value);
-  size_t          source_length           = RSTRING_LEN(source_value);
-  bzs_ext_byte_t* remaining_source        = (bzs_ext_byte_t*) source;
-  size_t          remaining_source_length = source_length;
+static inline size_t get_member_source_length(const bzs_ext_compressor_t* compressor_ptr, size_t source_length)
+{
+  if (compressor_ptr->member_size == 0) {
+    return source_length;
+  }
+
+  size_t remaining_member_source_length = compressor_ptr->member_size - compressor_ptr->member_source_length;
+
+  return source_length < remaining_member_source_length ? source_length : remaining_member_source_length;
+}
+
+// Returns false when destination buffer is full.
+static inline bool finish_member(bzs_ext_compressor_t* compressor_ptr)
+{
+  bzs_ext_byte_t* remaining_source        = NULL;
+  size_t          remaining_source_length = 0;
 
   compress_args_t args = {
     .stream_ptr                              = compressor_ptr->stream_ptr,
-    .stream_action                           = BZ_RUN,
+    .stream_action                           = BZ_FINISH,
     .remaining_source_ptr                    = &remaining_source,
     .remaining_source_length_ptr             = &remaining_source_length,
     .remaining_destination_buffer_ptr        = &compressor_ptr->remaining_destination_buffer,
-    .remaining_destination_buffer_length_ptr = &compressor_ptr->remaining_destination_buffer_length};
+    .remaining_destination_buffer_length_ptr = &compressor_ptr->remaining_destination_buffer_length,
+    .index_ptr                               = compressor_ptr->index_ptr,
+    .source_digest_ptr                       = &compressor_ptr->source_digest,
+    .destination_digest_ptr                  = &compressor_ptr->destination_digest};
 
   BZS_EXT_GVL_WRAP(compressor_ptr->gvl, compress_wrapper, &args);
-  if (args.result != BZ_RUN_OK && args.result != BZ_PARAM_ERROR && args.result != BZ_STREAM_END) {
+  if (args.result != BZ_FINISH_OK && args.result != BZ_STREAM_END) {
     bzs_ext_raise_error(bzs_ext_get_error(args.result));
   }
 
+  if (args.ext_result != 0) {
+    bzs_ext_raise_error(args.ext_result);
+  }
+
+  if (args.result == BZ_FINISH_OK) {
+    return false;
+  }
+
+  // Restart will reuse memory of previous member.
+  bzs_ext_result_t ext_result = bzs_restart_compressor(
+    compressor_ptr->stream_ptr, compressor_ptr->block_size, compressor_ptr->verbosity, compressor_ptr->work_factor);
+  if (ext_result != 0) {
+    bzs_ext_raise_error(ext_result);
+  }
+
+  compressor_ptr->member_source_length = 0;
+
+  return true;
+}
+
+// -- parallel compress --
+
+static inline void read_pipeline(bzs_ext_compressor_t* compressor_ptr)
+{
+  size_t read_length;
+
+  bzs_ext_result_t ext_result = bzs_ext_pipeline_read(
+    compressor_ptr->pipeline_ptr,
+    compressor_ptr->remaining_destination_buffer,
+    compressor_ptr->remaining_destination_buffer_length,
+    &read_length);
+
+  if (ext_result == 0 && compressor_ptr->index_ptr != NULL) {
+    ext_result = bzs_ext_index_append_destination(
+      compressor_ptr->index_ptr, compressor_ptr->remaining_destination_buffer, read_length);
+  }
+
+  bzs_ext_digest_update(&compressor_ptr->destination_digest, compressor_ptr->remaining_destination_buffer, read_length);
+
+  compressor_ptr->remaining_destination_buffer += read_length;
+  compressor_ptr->remaining_destination_buffer_length -= read_length;
+
+  if (ext_result != 0) {
+    bzs_ext_raise_error(ext_result);
+  }
+}
+
+static inline void submit_pipeline(bzs_ext_compressor_t* compressor_ptr)
+{
+  bzs_ext_pipeline_t* pipeline_ptr = compressor_ptr->pipeline_ptr;
+  bzs_ext_result_t    ext_result;
+
+  if (compressor_ptr->index_ptr != NULL) {
+    ext_result =
+      bzs_ext_index_append_member(compressor_ptr->index_ptr, pipeline_ptr->chunk, pipeline_ptr->chunk_length);
+    if (ext_result != 0) {
+      bzs_ext_raise_error(ext_result);
+    }
+  }
+
+  ext_result = bzs_ext_pipeline_submit(pipeline_ptr);
+  if (ext_result != 0) {
+    bzs_ext_raise_error(ext_result);
+  }
+}
+
+static inline VALUE compress_parallel(bzs_ext_compressor_t* compressor_ptr, const char* source, size_t source_length)
+{
+  bzs_ext_pipeline_t* pipeline_ptr           = compressor_ptr->pipeline_ptr;
+  size_t              appended_source_length = 0;
+  VALUE               needs_more_destination = Qfalse;
+
+  while (true) {
+    read_pipeline(compressor_ptr);
+
+    if (bzs_ext_pipeline_is_chunk_full(pipeline_ptr)) {
+      if (bzs_ext_pipeline_is_full(pipeline_ptr)) {
+        if (compressor_ptr->remaining_destination_buffer_length == 0) {
+          needs_more_destination = Qtrue;
+          break;
+        }
+
+        // Oldest member should be finished to free space for next chunk.
+        BZS_EXT_GVL_WRAP_INTERRUPTIBLE(
+          compressor_ptr->gvl, bzs_ext_pipeline_wait, bzs_ext_pipeline_interrupt, pipeline_ptr);
+        continue;
+      }
+
+      submit_pipeline(compressor_ptr);
+      continue;
+    }
+
+    if (appended_source_length == source_length) {
+      break;
+    }
+
+    size_t appended_length;
+
+    bzs_ext_result_t ext_result = bzs_ext_pipeline_append(
+      pipeline_ptr,
+      (const bzs_ext_byte_t*) source + appended_source_length,
+      source_length - appended_source_length,
+      &appended_length);
+    if (ext_result != 0) {
+      bzs_ext_raise_error(ext_result);
+    }
+
+    bzs_ext_digest_update(
+      &compressor_ptr->source_digest, (const bzs_ext_byte_t*) source + appended_source_length, appended_length);
+
+    appended_source_length += appended_length;
+  }
+
+  VALUE bytes_written = SIZET2NUM(appended_source_length);
+
+  return rb_ary_new_from_args(2, bytes_written, needs_more_destination);
+}
+
+// Pipeline should compress remaining chunk and provide all members.
+// Finish requires at least one member, empty source will be compressed as empty member.
+
+static inline VALUE flush_parallel(bzs_ext_compressor_t* compressor_ptr, bool is_finish)
+{
+  bzs_ext_pipeline_t* pipeline_ptr = compressor_ptr->pipeline_ptr;
+
+  while (true) {
+    read_pipeline(compressor_ptr);
+
+    if (pipeline_ptr->chunk_length != 0 || (is_finish && pipeline_ptr->submitted_members_count == 0)) {
+      if (!bzs_ext_pipeline_is_full(pipeline_ptr)) {
+        submit_pipeline(compressor_ptr);
+        continue;
+      }
+    } else if (bzs_ext_pipeline_is_empty(pipeline_ptr)) {
+      return Qfalse;
+    }
+
+    if (compressor_ptr->remaining_destination_buffer_length == 0) {
+      return Qtrue;
+    }
+
+    BZS_EXT_GVL_WRAP_INTERRUPTIBLE(
+      compressor_ptr->gvl, bzs_ext_pipeline_wait, bzs_ext_pipeline_interrupt, pipeline_ptr);
+  }
+}
+
+VALUE bzs_ext_compress(VALUE self, VALUE source_value)
+{
+  GET_COMPRESSOR(self);
+  DO_NOT_USE_AFTER_CLOSE(compressor_ptr);
+  Check_Type(source_value, T_STRING);
+
+  const char* source        = RSTRING_PTR(source_value);
+  size_t      source_length = RSTRING_LEN(source_value);
+
+  if (compressor_ptr->pipeline_ptr != NULL) {
+    return compress_parallel(compressor_ptr, source, source_length);
+  }
+
+  bzs_ext_byte_t* remaining_source        = (bzs_ext_byte_t*) source;
+  size_t          remaining_source_length = source_length;
+  VALUE           needs_more_destination;
+
+  while (true) {
+    // Full member will be finished only when next source is available.
+    if (is_member_full(compressor_ptr) && remaining_source_length != 0) {
+      if (!finish_member(compressor_ptr)) {
+        needs_more_destination = Qtrue;
+        break;
+      }
+
+      continue;
+    }
+
+    size_t member_source_length           = get_member_source_length(compressor_ptr, remaining_source_length);
+    size_t remaining_member_source_length = member_source_length;
+
+    compress_args_t args = {
+      .stream_ptr                              = compressor_ptr->stream_ptr,
+      .stream_action                           = BZ_RUN,
+      .remaining_source_ptr                    = &remaining_source,
+      .remaining_source_length_ptr             = &remaining_member_source_length,
+      .remaining_destination_buffer_ptr        = &compressor_ptr->remaining_destination_buffer,
+      .remaining_destination_buffer_length_ptr = &compressor_ptr->remaining_destination_buffer_length,
+      .index_ptr                               = compressor_ptr->index_ptr,
+      .source_digest_ptr                       = &compressor_ptr->source_digest,
+      .destination_digest_ptr                  = &compressor_ptr->destination_digest};
+
+    BZS_EXT_GVL_WRAP(compressor_ptr->gvl, compress_wrapper, &args);
+    if (args.result != BZ_RUN_OK && args.result != BZ_PARAM_ERROR && args.result != BZ_STREAM_END) {
+      bzs_ext_raise_error(bzs_ext_get_error(args.result));
+    }
+
+    if (args.ext_result != 0) {
+      bzs_ext_raise_error(args.ext_result);
+    }
+
+    size_t written_source_length = member_source_length - remaining_member_source_length;
+    remaining_source_length -= written_source_length;
+    compressor_ptr->member_source_length += written_source_length;
+
+    if (
+      args.result == BZ_RUN_OK && remaining_member_source_length == 0 && remaining_source_length != 0 &&
+      compressor_ptr->remaining_destination_buffer_length != 0) {
+      // Member is full, source remains.
+      continue;
+    }
+
+    needs_more_destination = args.result == BZ_RUN_OK && (remaining_source_length != 0 ||
+                                                          compressor_ptr->remaining_destination_buffer_length == 0) ?
+                               Qtrue :
+                               Qfalse;
+    break;
+  }
+
   VALUE bytes_written = SIZET2NUM(source_length - remaining_source_length);
-  VALUE needs_more_destination =
-    args.result == BZ_RUN_OK &&
-        (remaining_source_length != 0 || compressor_ptr->remaining_destination_buffer_length == 0) ?
-      Qtrue :
-      Qfalse;
 
   return rb_ary_new_from_args(2, bytes_written, needs_more_destination);
 }
@@ -168,6 +591,10 @@ VALUE bzs_ext_flush_compressor(VALUE self)
   GET_COMPRESSOR(self);
   DO_NOT_USE_AFTER_CLOSE(compressor_ptr);
 
+  if (compressor_ptr->pipeline_ptr != NULL) {
+    return flush_parallel(compressor_ptr, false);
+  }
+
   bzs_ext_byte_t* remaining_source        = NULL;
   size_t          remaining_source_length = 0;
 
@@ -177,13 +604,20 @@ VALUE bzs_ext_flush_compressor(VALUE self)
     .remaining_source_ptr                    = &remaining_source,
     .remaining_source_length_ptr             = &remaining_source_length,
     .remaining_destination_buffer_ptr        = &compressor_ptr->remaining_destination_buffer,
-    .remaining_destination_buffer_length_ptr = &compressor_ptr->remaining_destination_buffer_length};
+    .remaining_destination_buffer_length_ptr = &compressor_ptr->remaining_destination_buffer_length,
+    .index_ptr                               = compressor_ptr->index_ptr,
+    .source_digest_ptr                       = &compressor_ptr->source_digest,
+    .destination_digest_ptr                  = &compressor_ptr->destination_digest};
 
   BZS_EXT_GVL_WRAP(compressor_ptr->gvl, compress_wrapper, &args);
   if (args.result != BZ_FLUSH_OK && args.result != BZ_PARAM_ERROR && args.result != BZ_RUN_OK) {
     bzs_ext_raise_error(bzs_ext_get_error(args.result));
   }
 
+  if (args.ext_result != 0) {
+    bzs_ext_raise_error(args.ext_result);
+  }
+
   return args.result == BZ_FLUSH_OK &&
              (remaining_source_length != 0 || compressor_ptr->remaining_destination_buffer_length == 0) ?
            Qtrue :
@@ -197,6 +631,10 @@ VALUE bzs_ext_finish_compressor(VALUE self)
   GET_COMPRESSOR(self);
   DO_NOT_USE_AFTER_CLOSE(compressor_ptr);
 
+  if (compressor_ptr->pipeline_ptr != NULL) {
+    return flush_parallel(compressor_ptr, true);
+  }
+
   bzs_ext_byte_t* remaining_source        = NULL;
   size_t          remaining_source_length = 0;
 
@@ -206,13 +644,20 @@ VALUE bzs_ext_finish_compressor(VALUE self)
     .remaining_source_ptr                    = &remaining_source,
     .remaining_source_length_ptr             = &remaining_source_length,
     .remaining_destination_buffer_ptr        = &compressor_ptr->remaining_destination_buffer,
-    .remaining_destination_buffer_length_ptr = &compressor_ptr->remaining_destination_buffer_length};
+    .remaining_destination_buffer_length_ptr = &compressor_ptr->remaining_destination_buffer_length,
+    .index_ptr                               = compressor_ptr->index_ptr,
+    .source_digest_ptr                       = &compressor_ptr->source_digest,
+    .destination_digest_ptr                  = &compressor_ptr->destination_digest};
 
   BZS_EXT_GVL_WRAP(compressor_ptr->gvl, compress_wrapper, &args);
   if (args.result != BZ_FINISH_OK && args.result != BZ_PARAM_ERROR && args.result != BZ_STREAM_END) {
     bzs_ext_raise_error(bzs_ext_get_error(args.result));
   }
 
+  if (args.ext_result != 0) {
+    bzs_ext_raise_error(args.ext_result);
+  }
+
   return args.result == BZ_FINISH_OK &&
              (remaining_source_length != 0 || compressor_ptr->remaining_destination_buffer_length == 0) ?
            Qtrue :
@@ -240,6 +685,31 @@ VALUE bzs_ext_compressor_read_result(VALUE self)
   return result_value;
 }
 
+VALUE bzs_ext_compressor_index(VALUE self)
+{
+  GET_COMPRESSOR(self);
+
+  // Index is available after close.
+  bzs_ext_index_t* index_ptr = compressor_ptr->index_ptr;
+  if (index_ptr == NULL) {
+    return Qnil;
+  }
+
+  return rb_str_new((const char*) index_ptr->records, index_ptr->records_length);
+}
+
+VALUE bzs_ext_compressor_digests(VALUE self)
+{
+  GET_COMPRESSOR(self);
+
+  // Digests are available after close.
+  if (compressor_ptr->source_digest.type == BZS_DIGEST_NONE) {
+    return Qnil;
+  }
+
+  return bzs_ext_get_digests_value(&compressor_ptr->source_digest, &compressor_ptr->destination_digest);
+}
+
 // -- cleanup --
 
 VALUE bzs_ext_compressor_close(VALUE self)
@@ -250,10 +720,25 @@ VALUE bzs_ext_compressor_close(VALUE self)
   bz_stream* stream_ptr = compressor_ptr->stream_ptr;
   if (stream_ptr != NULL) {
     BZ2_bzCompressEnd(stream_ptr);
+    free(stream_ptr);
 
     compressor_ptr->stream_ptr = NULL;
   }
 
+  bzs_ext_release_allocator(&compressor_ptr->allocator);
+
+  bzs_ext_pipeline_t* pipeline_ptr = compressor_ptr->pipeline_ptr;
+  if (pipeline_ptr != NULL) {
+    bzs_ext_destroy_pipeline(pipeline_ptr);
+
+    compressor_ptr->pipeline_ptr = NULL;
+  }
+
+  bzs_ext_governor_release(compressor_ptr->reserved_memory);
+  compressor_ptr->reserved_memory = BZS_EXT_EMPTY_RESERVATION;
+
+  remove_gc_memory(compressor_ptr);
+
   bzs_ext_byte_t* destination_buffer = compressor_ptr->destination_buffer;
   if (destination_buffer != NULL) {
     free(destination_buffer);
@@ -281,5 +766,7 @@ void bzs_ext_compressor_exports(VALUE root_module)
   rb_define_method(compressor, "flush", bzs_ext_flush_compressor, 0);
   rb_define_method(compressor, "finish", bzs_ext_finish_compressor, 0);
   rb_define_method(compressor, "read_result", bzs_ext_compressor_read_result, 0);
+  rb_define_method(compressor, "index", bzs_ext_compressor_index, 0);
+  rb_define_method(compressor, "digests", bzs_ext_compressor_digests, 0);
   rb_define_method(compressor, "close", bzs_ext_compressor_close, 0);
 }
@@ -7,17 +7,34 @@
 #include <bzlib.h>
 #include <stdbool.h>
 
+#include "bzs_ext/allocator.h"
 #include "bzs_ext/common.h"
+#include "bzs_ext/digest.h"
+#include "bzs_ext/governor.h"
+#include "bzs_ext/index.h"
+#include "bzs_ext/parallel.h"
 #include "ruby.h"
 
 typedef struct
 {
-  bz_stream*      stream_ptr;
-  bzs_ext_byte_t* destination_buffer;
-  size_t          destination_buffer_length;
-  bzs_ext_byte_t* remaining_destination_buffer;
-  size_t          remaining_destination_buffer_length;
-  bool            gvl;
+  bz_stream*            stream_ptr;
+  bzs_ext_allocator_t   allocator;
+  bzs_ext_pipeline_t*   pipeline_ptr;
+  bzs_ext_index_t*      index_ptr;
+  bzs_ext_byte_t*       destination_buffer;
+  size_t                destination_buffer_length;
+  bzs_ext_byte_t*       remaining_destination_buffer;
+  size_t                remaining_destination_buffer_length;
+  size_t                member_size;
+  size_t                member_source_length;
+  bzs_ext_option_t      block_size;
+  bzs_ext_option_t      verbosity;
+  bzs_ext_option_t      work_factor;
+  bool                  gvl;
+  bzs_ext_reservation_t reserved_memory;
+  size_t                gc_memory;
+  bzs_ext_digest_t      source_digest;
+  bzs_ext_digest_t      destination_digest;
 } bzs_ext_compressor_t;
 
 VALUE bzs_ext_allocate_compressor(VALUE klass);
@@ -26,6 +43,8 @@ VALUE bzs_ext_compress(VALUE self, VALUE source);
 VALUE bzs_ext_flush_compressor(VALUE self);
 VALUE bzs_ext_finish_compressor(VALUE self);
 VALUE bzs_ext_compressor_read_result(VALUE self);
+VALUE bzs_ext_compressor_index(VALUE self);
+VALUE bzs_ext_compressor_digests(VALUE self);
 VALUE bzs_ext_compressor_close(VALUE self);
 
 void bzs_ext_compressor_exports(VALUE root_module);
@@ -4,20 +4,103 @@
 #include "bzs_ext/stream/decompressor.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "bzs_ext/buffer.h"
 #include "bzs_ext/error.h"
+#include "bzs_ext/governor.h"
 #include "bzs_ext/gvl.h"
 #include "bzs_ext/option.h"
 #include "bzs_ext/utils.h"
 
+// -- memory --
+
+// Bzip2 memory is allocated outside of ruby heap, so GC should know about it.
+// Decompressor allocates memory after reading stream header, reserved memory is an estimate of it.
+static inline size_t get_external_memory(const bzs_ext_decompressor_t* decompressor_ptr)
+{
+  size_t size = decompressor_ptr->reserved_memory.size + decompressor_ptr->destination_buffer_length;
+
+  const bzs_ext_read_ahead_t* read_ahead_ptr = decompressor_ptr->read_ahead_ptr;
+  if (read_ahead_ptr != NULL) {
+    size += read_ahead_ptr->source_buffer_length +
+            read_ahead_ptr->destination_buffers_count * read_ahead_ptr->destination_buffer_length;
+  }
+
+  return size;
+}
+
+static inline void add_gc_memory(bzs_ext_decompressor_t* decompressor_ptr)
+{
+  decompressor_ptr->gc_memory = get_external_memory(decompressor_ptr);
+  rb_gc_adjust_memory_usage((ssize_t) decompressor_ptr->gc_memory);
+}
+
+static inline void remove_gc_memory(bzs_ext_decompressor_t* decompressor_ptr)
+{
+  if (decompressor_ptr->gc_memory != 0) {
+    rb_gc_adjust_memory_usage(-(ssize_t) decompressor_ptr->gc_memory);
+    decompressor_ptr->gc_memory = 0;
+  }
+}
+
+static size_t get_decompressor_memory_size(const void* data)
+{
+  const bzs_ext_decompressor_t* decompressor_ptr = data;
+  size_t                        size             = sizeof(bzs_ext_decompressor_t);
+
+  if (decompressor_ptr->stream_ptr != NULL) {
+    size += sizeof(bz_stream);
+  }
+
+  // Allocator knows real size of memory used by stream.
+  size += decompressor_ptr->allocator.size;
+
+  const bzs_ext_read_ahead_t* read_ahead_ptr = decompressor_ptr->read_ahead_ptr;
+  if (read_ahead_ptr != NULL) {
+    size += sizeof(bzs_ext_read_ahead_t) + read_ahead_ptr->source_buffer_length +
+            read_ahead_ptr->destination_buffers_count * read_ahead_ptr->destination_buffer_length;
+  }
+
+  const bzs_ext_line_splitter_t* line_splitter_ptr = decompressor_ptr->line_splitter_ptr;
+  if (line_splitter_ptr != NULL) {
+    size += sizeof(bzs_ext_line_splitter_t) + line_splitter_ptr->separator_length +
+            line_splitter_ptr->line_buffer_length;
+  }
+
+  if (decompressor_ptr->destination_buffer != NULL) {
+    size += decompressor_ptr->destination_buffer_length;
+  }
+
+  return size;
+}
+
 // -- initialization --
 
-static void free_decompressor(bzs_ext_decompressor_t* decompressor_ptr)
+static void free_decompressor(void* data)
 {
+  bzs_ext_decompressor_t* decompressor_ptr = data;
+
+  remove_gc_memory(decompressor_ptr);
+
+  // Worker should be stopped before stream end.
+  bzs_ext_read_ahead_t* read_ahead_ptr = decompressor_ptr->read_ahead_ptr;
+  if (read_ahead_ptr != NULL) {
+    bzs_ext_destroy_read_ahead(read_ahead_ptr);
+  }
+
   bz_stream* stream_ptr = decompressor_ptr->stream_ptr;
   if (stream_ptr != NULL) {
     BZ2_bzDecompressEnd(stream_ptr);
+    free(stream_ptr);
+  }
+
+  bzs_ext_release_allocator(&decompressor_ptr->allocator);
+  bzs_ext_governor_release(decompressor_ptr->reserved_memory);
+
+  bzs_ext_line_splitter_t* line_splitter_ptr = decompressor_ptr->line_splitter_ptr;
+  if (line_splitter_ptr != NULL) {
+    bzs_ext_destroy_line_splitter(line_splitter_ptr);
   }
 
   bzs_ext_byte_t* destination_buffer = decompressor_ptr->destination_buffer;
@@ -28,23 +111,42 @@ static void free_decompressor(bzs_ext_decompressor_t* decompressor_ptr)
   free(decompressor_ptr);
 }
 
+// Decompressor doesn't keep ruby objects, so it can be freed immediately.
+static const rb_data_type_t decompressor_type = {
+  .wrap_struct_name = "bzs_ext_decompressor",
+  .function         = {.dmark = NULL, .dfree = free_decompressor, .dsize = get_decompressor_memory_size},
+  .flags            = RUBY_TYPED_FREE_IMMEDIATELY};
+
 VALUE bzs_ext_allocate_decompressor(VALUE klass)
 {
   bzs_ext_decompressor_t* decompressor_ptr;
-  VALUE self = Data_Make_Struct(klass, bzs_ext_decompressor_t, NULL, free_decompressor, decompressor_ptr);
+  VALUE self = TypedData_Make_Struct(klass, bzs_ext_decompressor_t, &decompressor_type, decompressor_ptr);
 
   decompressor_ptr->stream_ptr                          = NULL;
   decompressor_ptr->destination_buffer                  = NULL;
   decompressor_ptr->destination_buffer_length           = 0;
   decompressor_ptr->remaining_destination_buffer        = NULL;
   decompressor_ptr->remaining_destination_buffer_length = 0;
+  decompressor_ptr->verbosity                           = BZS_DEFAULT_VERBOSITY;
+  decompressor_ptr->small                               = BZS_DEFAULT_SMALL;
+  decompressor_ptr->gvl                                 = false;
+  decompressor_ptr->read_ahead_ptr                      = NULL;
+  decompressor_ptr->needs_all_read_ahead_result         = false;
+  decompressor_ptr->line_splitter_ptr                   = NULL;
+  decompressor_ptr->reserved_memory                     = BZS_EXT_EMPTY_RESERVATION;
+  decompressor_ptr->gc_memory                           = 0;
+
+  bzs_init_next_stream(&decompressor_ptr->next_stream);
+  bzs_ext_init_allocator(&decompressor_ptr->allocator);
+  bzs_ext_init_digest(&decompressor_ptr->source_digest, BZS_DIGEST_NONE);
+  bzs_ext_init_digest(&decompressor_ptr->destination_digest, BZS_DIGEST_NONE);
 
   return self;
 }
 
 #define GET_DECOMPRESSOR(self)              \
   bzs_ext_decompressor_t* decompressor_ptr; \
-  Data_Get_Struct(self, bzs_ext_decompressor_t, decompressor_ptr);
+  TypedData_Get_Struct(self, bzs_ext_decompressor_t, &decompressor_type, decompressor_ptr);
 
 VALUE bzs_ext_initialize_decompressor(VALUE self, VALUE options)
 {
@@ -53,19 +155,34 @@ VALUE bzs_ext_initialize_decompressor(VALUE self, VALUE options)
   BZS_EXT_GET_SIZE_OPTION(options, destination_buffer_length);
   BZS_EXT_GET_BOOL_OPTION(options, gvl);
   BZS_EXT_RESOLVE_DECOMPRESSOR_OPTIONS(options);
+  BZS_EXT_RESOLVE_SIZE_OPTION(options, read_ahead, BZS_DEFAULT_READ_AHEAD);
+  // Source buffer length is used by read ahead worker, raw decompressor can be created without it.
+  BZS_EXT_RESOLVE_SIZE_OPTION(options, source_buffer_length, 0);
+  BZS_EXT_RESOLVE_LIMIT_OPTIONS(options);
+  BZS_EXT_RESOLVE_DIGEST_OPTION(options, digest);
+
+  // Decompressor can be downgraded into small mode when there is not enough memory.
+  bzs_ext_reservation_t reserved_memory;
+
+  bzs_ext_result_t ext_result = bzs_ext_governor_reserve_decompressors(1, &small, &reserved_memory);
+  if (ext_result != 0) {
+    bzs_ext_raise_error(ext_result);
+  }
 
   bz_stream* stream_ptr = malloc(sizeof(bz_stream));
   if (stream_ptr == NULL) {
+    bzs_ext_governor_release(reserved_memory);
     bzs_ext_raise_error(BZS_EXT_ERROR_ALLOCATE_FAILED);
   }
 
-  stream_ptr->bzalloc = NULL;
-  stream_ptr->bzfree  = NULL;
-  stream_ptr->opaque  = NULL;
+  // Allocator reports memory to governor, it will be used to restart stream for each member.
+  bzs_ext_use_allocator(stream_ptr, &decompressor_ptr->allocator);
 
   bzs_result_t result = BZ2_bzDecompressInit(stream_ptr, verbosity, small);
   if (result != BZ_OK) {
     free(stream_ptr);
+    bzs_ext_release_allocator(&decompressor_ptr->allocator);
+    bzs_ext_governor_release(reserved_memory);
     bzs_ext_raise_error(bzs_ext_get_error(result));
   }
 
@@ -75,16 +192,54 @@ VALUE bzs_ext_initialize_decompressor(VALUE self, VALUE options)
 
   bzs_ext_byte_t* destination_buffer = malloc(destination_buffer_length);
   if (destination_buffer == NULL) {
+    BZ2_bzDecompressEnd(stream_ptr);
     free(stream_ptr);
+    bzs_ext_release_allocator(&decompressor_ptr->allocator);
+    bzs_ext_governor_release(reserved_memory);
     bzs_ext_raise_error(BZS_EXT_ERROR_ALLOCATE_FAILED);
   }
 
+  bzs_ext_read_ahead_t* read_ahead_ptr = NULL;
+
+  if (read_ahead != 0) {
+    if (source_buffer_length == 0) {
+      source_buffer_length = BZS_DEFAULT_SOURCE_BUFFER_LENGTH_FOR_DECOMPRESSOR;
+    }
+
+    ext_result = bzs_ext_create_read_ahead(
+      &read_ahead_ptr,
+      stream_ptr,
+      verbosity,
+      small,
+      source_buffer_length,
+      read_ahead,
+      destination_buffer_length);
+    if (ext_result != 0) {
+      free(destination_buffer);
+      BZ2_bzDecompressEnd(stream_ptr);
+      free(stream_ptr);
+      bzs_ext_release_allocator(&decompressor_ptr->allocator);
+      bzs_ext_governor_release(reserved_memory);
+      bzs_ext_raise_error(ext_result);
+    }
+  }
+
   decompressor_ptr->stream_ptr                          = stream_ptr;
   decompressor_ptr->destination_buffer                  = destination_buffer;
   decompressor_ptr->destination_buffer_length           = destination_buffer_length;
   decompressor_ptr->remaining_destination_buffer        = destination_buffer;
   decompressor_ptr->remaining_destination_buffer_length = destination_buffer_length;
+  decompressor_ptr->verbosity                           = verbosity;
+  decompressor_ptr->small                               = small;
   decompressor_ptr->gvl                                 = gvl;
+  decompressor_ptr->read_ahead_ptr                      = read_ahead_ptr;
+  decompressor_ptr->reserved_memory                     = reserved_memory;
+
+  bzs_ext_init_limit(&decompressor_ptr->output_limit, max_output_size, max_ratio, 0);
+  bzs_ext_init_digest(&decompressor_ptr->source_digest, digest);
+  bzs_ext_init_digest(&decompressor_ptr->destination_digest, digest);
+
+  add_gc_memory(decompressor_ptr);
 
   return Qnil;
 }
@@ -98,12 +253,13 @@ VALUE bzs_ext_initialize_decompressor(VALUE self, VALUE options)
 
 typedef struct
 {
-  bz_stream*       stream_ptr;
-  bzs_ext_byte_t** remaining_source_ptr;
-  size_t*          remaining_source_length_ptr;
-  bzs_ext_byte_t** remaining_destination_buffer_ptr;
-  size_t*          remaining_destination_buffer_length_ptr;
-  bzs_result_t     result;
+  bz_stream*        stream_ptr;
+  bzs_ext_byte_t**  remaining_source_ptr;
+  size_t*           remaining_source_length_ptr;
+  bzs_ext_byte_t**  remaining_destination_buffer_ptr;
+  size_t*           remaining_destination_buffer_length_ptr;
+  bzs_ext_digest_t* source_digest_ptr;
+  bzs_result_t      result;
 } decompress_args_t;
 
 static inline void* decompress_wrapper(void* data)
@@ -117,6 +273,12 @@ static inline void* decompress_wrapper(void* data)
 
   args->result = BZ2_bzDecompress(args->stream_ptr);
 
+  // Destination digest is updated when destination is provided to reader.
+  bzs_ext_digest_update(
+    args->source_digest_ptr,
+    *args->remaining_source_ptr,
+    (const bzs_ext_byte_t*) args->stream_ptr->next_in - *args->remaining_source_ptr);
+
   *args->remaining_source_ptr                    = (bzs_ext_byte_t*) args->stream_ptr->next_in;
   *args->remaining_source_length_ptr             = args->stream_ptr->avail_in;
   *args->remaining_destination_buffer_ptr        = (bzs_ext_byte_t*) args->stream_ptr->next_out;
@@ -125,27 +287,140 @@ static inline void* decompress_wrapper(void* data)
   return NULL;
 }
 
+static inline VALUE decompress_read_ahead(bzs_ext_decompressor_t* decompressor_ptr, VALUE source_value)
+{
+  bzs_ext_read_ahead_t* read_ahead_ptr = decompressor_ptr->read_ahead_ptr;
+
+  const bzs_ext_byte_t* source                  = (const bzs_ext_byte_t*) RSTRING_PTR(source_value);
+  size_t                source_length           = RSTRING_LEN(source_value);
+  size_t                remaining_source_length = source_length;
+  size_t                ready_count;
+
+  while (true) {
+    const bzs_ext_byte_t* remaining_source = source + source_length - remaining_source_length;
+    size_t                appended_length =
+      bzs_ext_read_ahead_append(read_ahead_ptr, remaining_source, remaining_source_length);
+
+    bzs_ext_digest_update(&decompressor_ptr->source_digest, remaining_source, appended_length);
+    remaining_source_length -= appended_length;
+
+    bzs_ext_result_t ext_result = bzs_ext_read_ahead_get_ready_count(read_ahead_ptr, &ready_count);
+    if (ext_result != 0) {
+      bzs_ext_raise_error(ext_result);
+    }
+
+    // Filled destination buffer should be received before waiting for source space.
+    if (remaining_source_length == 0 || ready_count != 0) {
+      break;
+    }
+
+    BZS_EXT_GVL_WRAP_INTERRUPTIBLE(
+      decompressor_ptr->gvl, bzs_ext_read_ahead_wait_for_source, bzs_ext_read_ahead_interrupt, read_ahead_ptr);
+  }
+
+  // Read ahead worker decompresses all appended source.
+  bzs_ext_limit_add_source(&decompressor_ptr->output_limit, source_length - remaining_source_length);
+
+  VALUE bytes_read             = SIZET2NUM(source_length - remaining_source_length);
+  VALUE needs_more_destination = ready_count != 0 ? Qtrue : Qfalse;
+
+  return rb_ary_new_from_args(2, bytes_read, needs_more_destination);
+}
+
 VALUE bzs_ext_decompress(VALUE self, VALUE source_value)
 {
   GET_DECOMPRESSOR(self);
   DO_NOT_USE_AFTER_CLOSE(decompressor_ptr);
   Check_Type(source_value, T_STRING);
 
+  if (decompressor_ptr->read_ahead_ptr != NULL) {
+    return decompress_read_ahead(decompressor_ptr, source_value);
+  }
+
   const char*     source                  = RSTRING_PTR(source_value);
   size_t          source_length           = RSTRING_LEN(source_value);
   bzs_ext_byte_t* remaining_source        = (bzs_ext_byte_t*) source;
   size_t          remaining_source_length = source_length;
 
+  bzs_ext_limit_t* limit_ptr = &decompressor_ptr->output_limit;
+  size_t           limited_destination_buffer_length;
+
   decompress_args_t args = {
     .stream_ptr                              = decompressor_ptr->stream_ptr,
     .remaining_source_ptr                    = &remaining_source,
     .remaining_source_length_ptr             = &remaining_source_length,
     .remaining_destination_buffer_ptr        = &decompressor_ptr->remaining_destination_buffer,
-    .remaining_destination_buffer_length_ptr = &decompressor_ptr->remaining_destination_buffer_length};
-
-  BZS_EXT_GVL_WRAP(decompressor_ptr->gvl, decompress_wrapper, &args);
-  if (args.result != BZ_OK && args.result != BZ_PARAM_ERROR && args.result != BZ_STREAM_END) {
-    bzs_ext_raise_error(bzs_ext_get_error(args.result));
+    .remaining_destination_buffer_length_ptr = &limited_destination_buffer_length,
+    .source_digest_ptr                       = &decompressor_ptr->source_digest};
+
+  bzs_ext_result_t ext_result;
+
+  while (true) {
+    const bzs_ext_byte_t* prev_remaining_source        = remaining_source;
+    size_t                prev_remaining_source_length = remaining_source_length;
+
+    ext_result = bzs_find_next_stream(
+      &decompressor_ptr->next_stream,
+      decompressor_ptr->stream_ptr,
+      decompressor_ptr->verbosity,
+      decompressor_ptr->small,
+      (const bzs_ext_byte_t**) &remaining_source,
+      &remaining_source_length);
+    if (ext_result != 0) {
+      bzs_ext_raise_error(ext_result);
+    }
+
+    bzs_ext_digest_update(
+      &decompressor_ptr->source_digest, prev_remaining_source, remaining_source - prev_remaining_source);
+
+    if (!bzs_is_next_stream_found(&decompressor_ptr->next_stream)) {
+      // Next source may contain remaining part of header, trailing data is consumed.
+      bzs_ext_limit_add_source(limit_ptr, prev_remaining_source_length - remaining_source_length);
+      args.result = BZ_OK;
+      break;
+    }
+
+    limited_destination_buffer_length =
+      bzs_ext_limit_get_destination_buffer_length(limit_ptr, decompressor_ptr->remaining_destination_buffer_length);
+
+    size_t prev_limited_destination_buffer_length = limited_destination_buffer_length;
+
+    BZS_EXT_GVL_WRAP(decompressor_ptr->gvl, decompress_wrapper, &args);
+    if (args.result != BZ_OK && args.result != BZ_PARAM_ERROR && args.result != BZ_STREAM_END) {
+      bzs_ext_raise_error(bzs_ext_get_error(args.result));
+    }
+
+    // Source can be provided again when it wasn't consumed, so ratio is checked against consumed source.
+    bzs_ext_limit_add_source(limit_ptr, prev_remaining_source_length - remaining_source_length);
+
+    size_t written_destination_length = prev_limited_destination_buffer_length - limited_destination_buffer_length;
+
+    ext_result = bzs_ext_limit_add_destination(limit_ptr, written_destination_length);
+    if (ext_result != 0) {
+      // Destination above limit won't be provided to reader.
+      decompressor_ptr->remaining_destination_buffer -= written_destination_length;
+      bzs_ext_raise_error(ext_result);
+    }
+
+    decompressor_ptr->remaining_destination_buffer_length -= written_destination_length;
+
+    if (args.result == BZ_OK && limited_destination_buffer_length == 0 &&
+        decompressor_ptr->remaining_destination_buffer_length != 0) {
+      // Limit was increased by consumed source.
+      continue;
+    }
+
+    if (args.result != BZ_STREAM_END) {
+      break;
+    }
+
+    // Remaining source may contain next concatenated stream.
+    decompressor_ptr->next_stream.is_stream_end = true;
+
+    if (remaining_source_length == 0 || decompressor_ptr->remaining_destination_buffer_length == 0) {
+      args.result = BZ_OK;
+      break;
+    }
   }
 
   VALUE bytes_read             = SIZET2NUM(source_length - remaining_source_length);
@@ -159,25 +434,194 @@ VALUE bzs_ext_decompress(VALUE self, VALUE source_value)
 
 // -- other --
 
-VALUE bzs_ext_decompressor_read_result(VALUE self)
+// Function receives each part of decompressed destination.
+typedef bzs_ext_result_t (*read_function_t)(void* data, const bzs_ext_byte_t* destination, size_t destination_length);
+
+static inline bzs_ext_result_t
+  read_ahead_destination(bzs_ext_decompressor_t* decompressor_ptr, read_function_t function, void* data)
 {
-  GET_DECOMPRESSOR(self);
-  DO_NOT_USE_AFTER_CLOSE(decompressor_ptr);
+  bzs_ext_read_ahead_t* read_ahead_ptr = decompressor_ptr->read_ahead_ptr;
+
+  while (true) {
+    size_t           ready_count;
+    bzs_ext_result_t ext_result = bzs_ext_read_ahead_get_ready_count(read_ahead_ptr, &ready_count);
+    if (ext_result != 0) {
+      return ext_result;
+    }
+
+    for (size_t index = 0; index < ready_count; index++) {
+      const bzs_ext_byte_t* destination;
+      size_t                destination_length;
+
+      bzs_ext_read_ahead_get_destination(read_ahead_ptr, &destination, &destination_length);
+
+      // Destination buffer above limit won't be provided to reader.
+      ext_result = bzs_ext_limit_add_destination(&decompressor_ptr->output_limit, destination_length);
+      if (ext_result == 0) {
+        bzs_ext_digest_update(&decompressor_ptr->destination_digest, destination, destination_length);
+        ext_result = function(data, destination, destination_length);
+      }
+
+      bzs_ext_read_ahead_release_destination(read_ahead_ptr);
+
+      if (ext_result != 0) {
+        return ext_result;
+      }
+    }
+
+    // Flush requires all queued source to be decompressed.
+    if (!decompressor_ptr->needs_all_read_ahead_result) {
+      break;
+    }
+
+    if (ready_count == 0 && bzs_ext_read_ahead_is_idle(read_ahead_ptr)) {
+      decompressor_ptr->needs_all_read_ahead_result = false;
+      break;
+    }
+
+    BZS_EXT_GVL_WRAP_INTERRUPTIBLE(
+      decompressor_ptr->gvl, bzs_ext_read_ahead_wait_for_destination, bzs_ext_read_ahead_interrupt, read_ahead_ptr);
+  }
+
+  return 0;
+}
+
+static inline bzs_ext_result_t
+  read_destination(bzs_ext_decompressor_t* decompressor_ptr, read_function_t function, void* data)
+{
+  if (decompressor_ptr->read_ahead_ptr != NULL) {
+    return read_ahead_destination(decompressor_ptr, function, data);
+  }
 
   bzs_ext_byte_t* destination_buffer                  = decompressor_ptr->destination_buffer;
   size_t          destination_buffer_length           = decompressor_ptr->destination_buffer_length;
   size_t          remaining_destination_buffer_length = decompressor_ptr->remaining_destination_buffer_length;
 
-  const char* result        = (const char*) destination_buffer;
-  size_t      result_length = destination_buffer_length - remaining_destination_buffer_length;
-  VALUE       result_value  = rb_str_new(result, result_length);
+  size_t destination_length = destination_buffer_length - remaining_destination_buffer_length;
 
   decompressor_ptr->remaining_destination_buffer        = destination_buffer;
   decompressor_ptr->remaining_destination_buffer_length = destination_buffer_length;
 
+  bzs_ext_digest_update(&decompressor_ptr->destination_digest, destination_buffer, destination_length);
+
+  return function(data, destination_buffer, destination_length);
+}
+
+static bzs_ext_result_t append_result(void* data, const bzs_ext_byte_t* destination, size_t destination_length)
+{
+  rb_str_cat(*(VALUE*) data, (const char*) destination, destination_length);
+
+  return 0;
+}
+
+VALUE bzs_ext_decompressor_read_result(VALUE self)
+{
+  GET_DECOMPRESSOR(self);
+  DO_NOT_USE_AFTER_CLOSE(decompressor_ptr);
+
+  VALUE result_value = rb_str_new(NULL, 0);
+
+  bzs_ext_result_t ext_result = read_destination(decompressor_ptr, append_result, &result_value);
+  if (ext_result != 0) {
+    bzs_ext_raise_error(ext_result);
+  }
+
   return result_value;
 }
 
+// -- lines --
+
+typedef struct
+{
+  bzs_ext_line_splitter_t* line_splitter_ptr;
+  VALUE                    lines_value;
+} read_lines_args_t;
+
+static bzs_ext_result_t push_line(void* data, const bzs_ext_byte_t* line, size_t line_length)
+{
+  read_lines_args_t* args = data;
+
+  rb_ary_push(args->lines_value, rb_str_new((const char*) line, line_length));
+
+  return 0;
+}
+
+static bzs_ext_result_t append_lines(void* data, const bzs_ext_byte_t* destination, size_t destination_length)
+{
+  read_lines_args_t* args = data;
+
+  return bzs_ext_line_splitter_append(args->line_splitter_ptr, destination, destination_length, push_line, args);
+}
+
+VALUE bzs_ext_decompressor_read_lines(VALUE self, VALUE separator, VALUE is_finished)
+{
+  GET_DECOMPRESSOR(self);
+  DO_NOT_USE_AFTER_CLOSE(decompressor_ptr);
+  Check_Type(separator, T_STRING);
+
+  const bzs_ext_byte_t*    separator_data    = (const bzs_ext_byte_t*) RSTRING_PTR(separator);
+  size_t                   separator_length  = RSTRING_LEN(separator);
+  bzs_ext_line_splitter_t* line_splitter_ptr = decompressor_ptr->line_splitter_ptr;
+  bzs_ext_result_t         ext_result;
+
+  if (line_splitter_ptr == NULL) {
+    ext_result = bzs_ext_create_line_splitter(&line_splitter_ptr, separator_data, separator_length);
+    if (ext_result != 0) {
+      bzs_ext_raise_error(ext_result);
+    }
+
+    decompressor_ptr->line_splitter_ptr = line_splitter_ptr;
+  } else if (
+    separator_length != line_splitter_ptr->separator_length ||
+    memcmp(separator_data, line_splitter_ptr->separator, separator_length) != 0) {
+    // Separator can't be changed while line is incomplete.
+    bzs_ext_raise_error(BZS_EXT_ERROR_VALIDATE_FAILED);
+  }
+
+  read_lines_args_t args = {.line_splitter_ptr = line_splitter_ptr, .lines_value = rb_ary_new()};
+
+  ext_result = read_destination(decompressor_ptr, append_lines, &args);
+
+  // Remaining line without separator will be provided after all destination.
+  if (ext_result == 0 && RTEST(is_finished)) {
+    ext_result = bzs_ext_line_splitter_finish(line_splitter_ptr, push_line, &args);
+
+    bzs_ext_destroy_line_splitter(line_splitter_ptr);
+    decompressor_ptr->line_splitter_ptr = NULL;
+  }
+
+  if (ext_result != 0) {
+    bzs_ext_raise_error(ext_result);
+  }
+
+  return args.lines_value;
+}
+
+VALUE bzs_ext_decompressor_flush(VALUE self)
+{
+  GET_DECOMPRESSOR(self);
+  DO_NOT_USE_AFTER_CLOSE(decompressor_ptr);
+
+  // Next result will wait for read ahead worker to decompress all queued source.
+  if (decompressor_ptr->read_ahead_ptr != NULL) {
+    decompressor_ptr->needs_all_read_ahead_result = true;
+  }
+
+  return Qnil;
+}
+
+VALUE bzs_ext_decompressor_digests(VALUE self)
+{
+  GET_DECOMPRESSOR(self);
+
+  // Digests are available after close.
+  if (decompressor_ptr->source_digest.type == BZS_DIGEST_NONE) {
+    return Qnil;
+  }
+
+  return bzs_ext_get_digests_value(&decompressor_ptr->source_digest, &decompressor_ptr->destination_digest);
+}
+
 // -- cleanup --
 
 VALUE bzs_ext_decompressor_close(VALUE self)
@@ -185,13 +629,28 @@ VALUE bzs_ext_decompressor_close(VALUE self)
   GET_DECOMPRESSOR(self);
   DO_NOT_USE_AFTER_CLOSE(decompressor_ptr);
 
+  bzs_ext_read_ahead_t* read_ahead_ptr = decompressor_ptr->read_ahead_ptr;
+  if (read_ahead_ptr != NULL) {
+    bzs_ext_destroy_read_ahead(read_ahead_ptr);
+
+    decompressor_ptr->read_ahead_ptr = NULL;
+  }
+
   bz_stream* stream_ptr = decompressor_ptr->stream_ptr;
   if (stream_ptr != NULL) {
     BZ2_bzDecompressEnd(stream_ptr);
+    free(stream_ptr);
 
     decompressor_ptr->stream_ptr = NULL;
   }
 
+  bzs_ext_release_allocator(&decompressor_ptr->allocator);
+
+  bzs_ext_governor_release(decompressor_ptr->reserved_memory);
+  decompressor_ptr->reserved_memory = BZS_EXT_EMPTY_RESERVATION;
+
+  remove_gc_memory(decompressor_ptr);
+
   bzs_ext_byte_t* destination_buffer = decompressor_ptr->destination_buffer;
   if (destination_buffer != NULL) {
     free(destination_buffer);
@@ -199,6 +658,13 @@ VALUE bzs_ext_decompressor_close(VALUE self)
     decompressor_ptr->destination_buffer = NULL;
   }
 
+  bzs_ext_line_splitter_t* line_splitter_ptr = decompressor_ptr->line_splitter_ptr;
+  if (line_splitter_ptr != NULL) {
+    bzs_ext_destroy_line_splitter(line_splitter_ptr);
+
+    decompressor_ptr->line_splitter_ptr = NULL;
+  }
+
   // It is possible to keep "destination_buffer_length", "remaining_destination_buffer"
   //   and "remaining_destination_buffer_length" as is.
 
@@ -217,5 +683,8 @@ void bzs_ext_decompressor_exports(VALUE root_module)
   rb_define_method(decompressor, "initialize", bzs_ext_initialize_decompressor, 1);
   rb_define_method(decompressor, "read", bzs_ext_decompress, 1);
   rb_define_method(decompressor, "read_result", bzs_ext_decompressor_read_result, 0);
+  rb_define_method(decompressor, "read_lines", bzs_ext_decompressor_read_lines, 2);
+  rb_define_method(decompressor, "flush", bzs_ext_decompressor_flush, 0);
+  rb_define_method(decompressor, "digests", bzs_ext_decompressor_digests, 0);
   rb_define_method(decompressor, "close", bzs_ext_decompressor_close, 0);
 }
@@ -7,23 +7,46 @@
 #include <bzlib.h>
 #include <stdbool.h>
 
+#include "bzs_ext/allocator.h"
 #include "bzs_ext/common.h"
+#include "bzs_ext/digest.h"
+#include "bzs_ext/governor.h"
+#include "bzs_ext/limit.h"
+#include "bzs_ext/line.h"
+#include "bzs_ext/option.h"
+#include "bzs_ext/read_ahead.h"
+#include "bzs_ext/utils.h"
 #include "ruby.h"
 
 typedef struct
 {
-  bz_stream*      stream_ptr;
-  bzs_ext_byte_t* destination_buffer;
-  size_t          destination_buffer_length;
-  bzs_ext_byte_t* remaining_destination_buffer;
-  size_t          remaining_destination_buffer_length;
-  bool            gvl;
+  bz_stream*               stream_ptr;
+  bzs_ext_allocator_t      allocator;
+  bzs_ext_byte_t*          destination_buffer;
+  size_t                   destination_buffer_length;
+  bzs_ext_byte_t*          remaining_destination_buffer;
+  size_t                   remaining_destination_buffer_length;
+  bzs_ext_option_t         verbosity;
+  bzs_ext_option_t         small;
+  bzs_next_stream_t        next_stream;
+  bool                     gvl;
+  bzs_ext_read_ahead_t*    read_ahead_ptr;
+  bool                     needs_all_read_ahead_result;
+  bzs_ext_line_splitter_t* line_splitter_ptr;
+  bzs_ext_limit_t          output_limit;
+  bzs_ext_reservation_t    reserved_memory;
+  size_t                   gc_memory;
+  bzs_ext_digest_t         source_digest;
+  bzs_ext_digest_t         destination_digest;
 } bzs_ext_decompressor_t;
 
 VALUE bzs_ext_allocate_decompressor(VALUE klass);
 VALUE bzs_ext_initialize_decompressor(VALUE self, VALUE options);
 VALUE bzs_ext_decompress(VALUE self, VALUE source);
 VALUE bzs_ext_decompressor_read_result(VALUE self);
+VALUE bzs_ext_decompressor_read_lines(VALUE self, VALUE separator, VALUE is_finished);
+VALUE bzs_ext_decompressor_flush(VALUE self);
+VALUE bzs_ext_decompressor_digests(VALUE self);
 VALUE bzs_ext_decompressor_close(VALUE self);
 
 void bzs_ext_decompressor_exports(VALUE root_module);
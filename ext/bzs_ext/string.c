@@ -4,13 +4,19 @@
 #include "bzs_ext/string.h"
 
 #include <bzlib.h>
+#include <string.h>
 
 #include "bzs_ext/buffer.h"
 #include "bzs_ext/common.h"
+#include "bzs_ext/digest.h"
 #include "bzs_ext/error.h"
+#include "bzs_ext/governor.h"
 #include "bzs_ext/gvl.h"
+#include "bzs_ext/limit.h"
 #include "bzs_ext/macro.h"
 #include "bzs_ext/option.h"
+#include "bzs_ext/parallel.h"
+#include "bzs_ext/recompress.h"
 #include "bzs_ext/utils.h"
 
 // -- buffer --
@@ -38,19 +44,46 @@ static inline bzs_ext_result_t increase_destination_buffer(
   return 0;
 }
 
+// -- result --
+
+// Result with enabled digests is [destination, digests].
+static inline VALUE get_result_value(
+  VALUE destination_value, const bzs_ext_digest_t* source_digest_ptr, const bzs_ext_digest_t* destination_digest_ptr)
+{
+  if (source_digest_ptr->type == BZS_DIGEST_NONE) {
+    return destination_value;
+  }
+
+  return rb_ary_new_from_args(
+    2, destination_value, bzs_ext_get_digests_value(source_digest_ptr, destination_digest_ptr));
+}
+
 // -- compress --
 
 typedef struct
 {
-  bz_stream*       stream_ptr;
-  int              stream_action;
-  bzs_ext_byte_t** remaining_source_ptr;
-  size_t*          remaining_source_length_ptr;
-  bzs_ext_byte_t*  remaining_destination_buffer;
-  size_t*          remaining_destination_buffer_length_ptr;
-  bzs_result_t     result;
+  bz_stream*        stream_ptr;
+  int               stream_action;
+  bzs_ext_byte_t**  remaining_source_ptr;
+  size_t*           remaining_source_length_ptr;
+  bzs_ext_byte_t*   remaining_destination_buffer;
+  size_t*           remaining_destination_buffer_length_ptr;
+  bzs_ext_digest_t* source_digest_ptr;
+  bzs_ext_digest_t* destination_digest_ptr;
+  bzs_result_t      result;
 } compress_args_t;
 
+// Digests receive source consumed by algorithm and destination written by algorithm.
+#define UPDATE_DIGESTS(args)                                                            \
+  bzs_ext_digest_update(                                                                \
+    args->source_digest_ptr,                                                            \
+    *args->remaining_source_ptr,                                                        \
+    (bzs_ext_byte_t*) args->stream_ptr->next_in - *args->remaining_source_ptr);         \
+  bzs_ext_digest_update(                                                                \
+    args->destination_digest_ptr,                                                       \
+    args->remaining_destination_buffer,                                                 \
+    (bzs_ext_byte_t*) args->stream_ptr->next_out - args->remaining_destination_buffer);
+
 static inline void* compress_wrapper(void* data)
 {
   compress_args_t* args = data;
@@ -62,6 +95,8 @@ static inline void* compress_wrapper(void* data)
 
   args->result = BZ2_bzCompress(args->stream_ptr, args->stream_action);
 
+  UPDATE_DIGESTS(args);
+
   *args->remaining_source_ptr                    = (bzs_ext_byte_t*) args->stream_ptr->next_in;
   *args->remaining_source_length_ptr             = args->stream_ptr->avail_in;
   *args->remaining_destination_buffer_length_ptr = args->stream_ptr->avail_out;
@@ -104,12 +139,14 @@ static inline void* compress_wrapper(void* data)
   }
 
 static inline bzs_ext_result_t compress(
-  bz_stream*  stream_ptr,
-  const char* source,
-  size_t      source_length,
-  VALUE       destination_value,
-  size_t      destination_buffer_length,
-  bool        gvl)
+  bz_stream*        stream_ptr,
+  const char*       source,
+  size_t            source_length,
+  VALUE             destination_value,
+  size_t            destination_buffer_length,
+  bool              gvl,
+  bzs_ext_digest_t* source_digest_ptr,
+  bzs_ext_digest_t* destination_digest_ptr)
 {
   bzs_ext_result_t ext_result;
   bzs_ext_byte_t*  remaining_source                    = (bzs_ext_byte_t*) source;
@@ -121,14 +158,18 @@ static inline bzs_ext_result_t compress(
     .stream_ptr                  = stream_ptr,
     .stream_action               = BZ_RUN,
     .remaining_source_ptr        = &remaining_source,
-    .remaining_source_length_ptr = &remaining_source_length};
+    .remaining_source_length_ptr = &remaining_source_length,
+    .source_digest_ptr           = source_digest_ptr,
+    .destination_digest_ptr      = destination_digest_ptr};
   BUFFERED_COMPRESS(gvl, run_args, BZ_RUN_OK);
 
   compress_args_t finish_args = {
     .stream_ptr                  = stream_ptr,
     .stream_action               = BZ_FINISH,
     .remaining_source_ptr        = &remaining_source,
-    .remaining_source_length_ptr = &remaining_source_length};
+    .remaining_source_length_ptr = &remaining_source_length,
+    .source_digest_ptr           = source_digest_ptr,
+    .destination_digest_ptr      = destination_digest_ptr};
   BUFFERED_COMPRESS(gvl, finish_args, BZ_FINISH_OK);
 
   int exception;
@@ -141,6 +182,125 @@ static inline bzs_ext_result_t compress(
   return 0;
 }
 
+// -- parallel compress --
+
+typedef struct
+{
+  bzs_ext_member_t* members;
+  size_t            members_count;
+  bzs_ext_digest_t* source_digest_ptr;
+  bzs_ext_digest_t* destination_digest_ptr;
+  bzs_ext_result_t  ext_result;
+} compress_members_args_t;
+
+static inline void* compress_members_wrapper(void* data)
+{
+  compress_members_args_t* args = data;
+
+  args->ext_result = bzs_ext_compress_members(args->members, args->members_count);
+  if (args->ext_result != 0) {
+    return NULL;
+  }
+
+  // Members are digested in source order after parallel compression.
+  for (size_t index = 0; index < args->members_count; index++) {
+    const bzs_ext_member_t* member_ptr = &args->members[index];
+
+    bzs_ext_digest_update(args->source_digest_ptr, member_ptr->source, member_ptr->source_length);
+    bzs_ext_digest_update(args->destination_digest_ptr, member_ptr->destination, member_ptr->destination_length);
+  }
+
+  return NULL;
+}
+
+static inline VALUE compress_parallel(
+  const char*       source,
+  size_t            source_length,
+  size_t            members_count,
+  bzs_ext_option_t  block_size,
+  bzs_ext_option_t  work_factor,
+  bzs_ext_option_t  verbosity,
+  bool              gvl,
+  bzs_ext_digest_t* source_digest_ptr,
+  bzs_ext_digest_t* destination_digest_ptr)
+{
+  // Each member is compressed by its own worker.
+  bzs_ext_reservation_t reserved_memory;
+
+  bzs_ext_result_t ext_result = bzs_ext_governor_reserve_compressors(block_size, members_count, &reserved_memory);
+  if (ext_result != 0) {
+    bzs_ext_raise_error(ext_result);
+  }
+
+  bzs_ext_member_t* members = malloc(sizeof(bzs_ext_member_t) * members_count);
+  if (members == NULL) {
+    bzs_ext_governor_release(reserved_memory);
+    bzs_ext_raise_error(BZS_EXT_ERROR_ALLOCATE_FAILED);
+  }
+
+  size_t member_source_length = source_length / members_count;
+
+  for (size_t index = 0; index < members_count; index++) {
+    bzs_ext_member_t* member_ptr = &members[index];
+
+    member_ptr->source        = (const bzs_ext_byte_t*) source + member_source_length * index;
+    member_ptr->source_length = member_source_length;
+    member_ptr->block_size    = block_size;
+    member_ptr->work_factor   = work_factor;
+    member_ptr->verbosity     = verbosity;
+  }
+
+  // Last member receives remainder of source.
+  members[members_count - 1].source_length += source_length % members_count;
+
+  compress_members_args_t args = {
+    .members                = members,
+    .members_count          = members_count,
+    .source_digest_ptr      = source_digest_ptr,
+    .destination_digest_ptr = destination_digest_ptr};
+  BZS_EXT_GVL_WRAP(gvl, compress_members_wrapper, &args);
+  bzs_ext_governor_release(reserved_memory);
+
+  ext_result = args.ext_result;
+
+  size_t destination_length = 0;
+
+  for (size_t index = 0; index < members_count; index++) {
+    destination_length += members[index].destination_length;
+  }
+
+  int exception;
+
+  BZS_EXT_CREATE_STRING_BUFFER(destination_value, destination_length, exception);
+  if (exception != 0 && ext_result == 0) {
+    ext_result = BZS_EXT_ERROR_ALLOCATE_FAILED;
+  }
+
+  char* destination = ext_result == 0 ? RSTRING_PTR(destination_value) : NULL;
+
+  for (size_t index = 0; index < members_count; index++) {
+    bzs_ext_member_t* member_ptr = &members[index];
+    if (member_ptr->destination == NULL) {
+      continue;
+    }
+
+    if (destination != NULL) {
+      memcpy(destination, member_ptr->destination, member_ptr->destination_length);
+      destination += member_ptr->destination_length;
+    }
+
+    free(member_ptr->destination);
+  }
+
+  free(members);
+
+  if (ext_result != 0) {
+    bzs_ext_raise_error(ext_result);
+  }
+
+  return destination_value;
+}
+
 VALUE bzs_ext_compress_string(VALUE BZS_EXT_UNUSED(self), VALUE source_value, VALUE options)
 {
   Check_Type(source_value, T_STRING);
@@ -148,6 +308,32 @@ VALUE bzs_ext_compress_string(VALUE BZS_EXT_UNUSED(self), VALUE source_value, VA
   BZS_EXT_GET_SIZE_OPTION(options, destination_buffer_length);
   BZS_EXT_GET_BOOL_OPTION(options, gvl);
   BZS_EXT_RESOLVE_COMPRESSOR_OPTIONS(options);
+  BZS_EXT_RESOLVE_SIZE_OPTION(options, threads, BZS_DEFAULT_THREADS);
+  BZS_EXT_RESOLVE_DIGEST_OPTION(options, digest);
+
+  const char* source        = RSTRING_PTR(source_value);
+  size_t      source_length = RSTRING_LEN(source_value);
+
+  bzs_ext_digest_t source_digest;
+  bzs_ext_digest_t destination_digest;
+  bzs_ext_init_digest(&source_digest, digest);
+  bzs_ext_init_digest(&destination_digest, digest);
+
+  size_t members_count = bzs_ext_get_members_count(source_length, bzs_ext_get_threads_count(threads));
+  if (members_count > 1) {
+    VALUE destination_value = compress_parallel(
+      source,
+      source_length,
+      members_count,
+      block_size,
+      work_factor,
+      verbosity,
+      gvl,
+      &source_digest,
+      &destination_digest);
+
+    return get_result_value(destination_value, &source_digest, &destination_digest);
+  }
 
   bz_stream stream = {
     .bzalloc = NULL,
@@ -155,8 +341,16 @@ VALUE bzs_ext_compress_string(VALUE BZS_EXT_UNUSED(self), VALUE source_value, VA
     .opaque  = NULL,
   };
 
+  bzs_ext_reservation_t reserved_memory;
+
+  bzs_ext_result_t ext_result = bzs_ext_governor_reserve_compressors(block_size, 1, &reserved_memory);
+  if (ext_result != 0) {
+    bzs_ext_raise_error(ext_result);
+  }
+
   bzs_result_t result = BZ2_bzCompressInit(&stream, block_size, verbosity, work_factor);
   if (result != BZ_OK) {
+    bzs_ext_governor_release(reserved_memory);
     bzs_ext_raise_error(bzs_ext_get_error(result));
   }
 
@@ -169,37 +363,46 @@ VALUE bzs_ext_compress_string(VALUE BZS_EXT_UNUSED(self), VALUE source_value, VA
   BZS_EXT_CREATE_STRING_BUFFER(destination_value, destination_buffer_length, exception);
   if (exception != 0) {
     BZ2_bzCompressEnd(&stream);
+    bzs_ext_governor_release(reserved_memory);
     bzs_ext_raise_error(BZS_EXT_ERROR_ALLOCATE_FAILED);
   }
 
-  const char* source        = RSTRING_PTR(source_value);
-  size_t      source_length = RSTRING_LEN(source_value);
-
-  bzs_ext_result_t ext_result =
-    compress(&stream, source, source_length, destination_value, destination_buffer_length, gvl);
+  ext_result = compress(
+    &stream,
+    source,
+    source_length,
+    destination_value,
+    destination_buffer_length,
+    gvl,
+    &source_digest,
+    &destination_digest);
 
   result = BZ2_bzCompressEnd(&stream);
   if (result != BZ_OK) {
     ext_result = bzs_ext_get_error(result);
   }
 
+  bzs_ext_governor_release(reserved_memory);
+
   if (ext_result != 0) {
     bzs_ext_raise_error(ext_result);
   }
 
-  return destination_value;
+  return get_result_value(destination_value, &source_digest, &destination_digest);
 }
 
 // -- decompress --
 
 typedef struct
 {
-  bz_stream*       stream_ptr;
-  bzs_ext_byte_t** remaining_source_ptr;
-  size_t*          remaining_source_length_ptr;
-  bzs_ext_byte_t*  remaining_destination_buffer;
-  size_t*          remaining_destination_buffer_length_ptr;
-  bzs_result_t     result;
+  bz_stream*        stream_ptr;
+  bzs_ext_byte_t**  remaining_source_ptr;
+  size_t*           remaining_source_length_ptr;
+  bzs_ext_byte_t*   remaining_destination_buffer;
+  size_t*           remaining_destination_buffer_length_ptr;
+  bzs_ext_digest_t* source_digest_ptr;
+  bzs_ext_digest_t* destination_digest_ptr;
+  bzs_result_t      result;
 } decompress_args_t;
 
 static inline void* decompress_wrapper(void* data)
@@ -213,6 +416,8 @@ static inline void* decompress_wrapper(void* data)
 
   args->result = BZ2_bzDecompress(args->stream_ptr);
 
+  UPDATE_DIGESTS(args);
+
   *args->remaining_source_ptr                    = (bzs_ext_byte_t*) args->stream_ptr->next_in;
   *args->remaining_source_length_ptr             = args->stream_ptr->avail_in;
   *args->remaining_destination_buffer_length_ptr = args->stream_ptr->avail_out;
@@ -221,12 +426,17 @@ static inline void* decompress_wrapper(void* data)
 }
 
 static inline bzs_ext_result_t decompress(
-  bz_stream*  stream_ptr,
-  const char* source,
-  size_t      source_length,
-  VALUE       destination_value,
-  size_t      destination_buffer_length,
-  bool        gvl)
+  bz_stream*        stream_ptr,
+  const char*       source,
+  size_t            source_length,
+  VALUE             destination_value,
+  size_t            destination_buffer_length,
+  bzs_ext_option_t  verbosity,
+  bzs_ext_option_t  small,
+  bool              gvl,
+  bzs_ext_limit_t*  limit_ptr,
+  bzs_ext_digest_t* source_digest_ptr,
+  bzs_ext_digest_t* destination_digest_ptr)
 {
   bzs_ext_result_t ext_result;
   bzs_ext_byte_t*  remaining_source                    = (bzs_ext_byte_t*) source;
@@ -237,30 +447,78 @@ static inline bzs_ext_result_t decompress(
   decompress_args_t args = {
     .stream_ptr                  = stream_ptr,
     .remaining_source_ptr        = &remaining_source,
-    .remaining_source_length_ptr = &remaining_source_length};
+    .remaining_source_length_ptr = &remaining_source_length,
+    .source_digest_ptr           = source_digest_ptr,
+    .destination_digest_ptr      = destination_digest_ptr};
+
+  bzs_next_stream_t next_stream;
+  bzs_init_next_stream(&next_stream);
+
+  // Ratio is checked against whole source.
+  bzs_ext_limit_add_source(limit_ptr, source_length);
 
   while (true) {
     bzs_ext_byte_t* remaining_destination_buffer =
       (bzs_ext_byte_t*) RSTRING_PTR(destination_value) + destination_length;
-    size_t prev_remaining_destination_buffer_length = remaining_destination_buffer_length;
+    size_t limited_destination_buffer_length =
+      bzs_ext_limit_get_destination_buffer_length(limit_ptr, remaining_destination_buffer_length);
+    size_t prev_limited_destination_buffer_length = limited_destination_buffer_length;
 
     args.remaining_destination_buffer            = remaining_destination_buffer;
-    args.remaining_destination_buffer_length_ptr = &remaining_destination_buffer_length;
+    args.remaining_destination_buffer_length_ptr = &limited_destination_buffer_length;
 
     BZS_EXT_GVL_WRAP(gvl, decompress_wrapper, &args);
     if (args.result != BZ_OK && args.result != BZ_PARAM_ERROR && args.result != BZ_STREAM_END) {
       return bzs_ext_get_error(args.result);
     }
 
-    destination_length += prev_remaining_destination_buffer_length - remaining_destination_buffer_length;
+    size_t written_destination_length = prev_limited_destination_buffer_length - limited_destination_buffer_length;
+    destination_length += written_destination_length;
+    remaining_destination_buffer_length -= written_destination_length;
 
-    if (args.result == BZ_STREAM_END) {
+    ext_result = bzs_ext_limit_add_destination(limit_ptr, written_destination_length);
+    if (ext_result != 0) {
+      return ext_result;
+    }
+
+    if (bzs_ext_limit_is_prefix_finished(limit_ptr)) {
       break;
     }
 
+    if (args.result == BZ_STREAM_END) {
+      // Remaining source may contain next concatenated stream.
+      next_stream.is_stream_end = true;
+
+      const bzs_ext_byte_t* prev_remaining_source = remaining_source;
+
+      ext_result = bzs_find_next_stream(
+        &next_stream,
+        stream_ptr,
+        verbosity,
+        small,
+        (const bzs_ext_byte_t**) &remaining_source,
+        &remaining_source_length);
+      if (ext_result != 0) {
+        return ext_result;
+      }
+
+      bzs_ext_digest_update(source_digest_ptr, prev_remaining_source, remaining_source - prev_remaining_source);
+
+      // Source is complete, so partial header is ignored too.
+      if (!bzs_is_next_stream_found(&next_stream)) {
+        break;
+      }
+
+      continue;
+    }
+
     if (remaining_source_length != 0 || remaining_destination_buffer_length == 0) {
+      // Destination buffer won't be increased above limit.
       ext_result = increase_destination_buffer(
-        destination_value, destination_length, &remaining_destination_buffer_length, destination_buffer_length);
+        destination_value,
+        destination_length,
+        &remaining_destination_buffer_length,
+        bzs_ext_limit_get_destination_buffer_length(limit_ptr, destination_buffer_length));
 
       if (ext_result != 0) {
         return ext_result;
@@ -289,6 +547,9 @@ VALUE bzs_ext_decompress_string(VALUE BZS_EXT_UNUSED(self), VALUE source_value,
   BZS_EXT_GET_SIZE_OPTION(options, destination_buffer_length);
   BZS_EXT_GET_BOOL_OPTION(options, gvl);
   BZS_EXT_RESOLVE_DECOMPRESSOR_OPTIONS(options);
+  BZS_EXT_RESOLVE_LIMIT_OPTIONS(options);
+  BZS_EXT_RESOLVE_SIZE_OPTION(options, limit, BZS_DEFAULT_LIMIT);
+  BZS_EXT_RESOLVE_DIGEST_OPTION(options, digest);
 
   bz_stream stream = {
     .bzalloc = NULL,
@@ -296,8 +557,16 @@ VALUE bzs_ext_decompress_string(VALUE BZS_EXT_UNUSED(self), VALUE source_value,
     .opaque  = NULL,
   };
 
+  bzs_ext_reservation_t reserved_memory;
+
+  bzs_ext_result_t ext_result = bzs_ext_governor_reserve_decompressors(1, &small, &reserved_memory);
+  if (ext_result != 0) {
+    bzs_ext_raise_error(ext_result);
+  }
+
   bzs_result_t result = BZ2_bzDecompressInit(&stream, verbosity, small);
   if (result != BZ_OK) {
+    bzs_ext_governor_release(reserved_memory);
     bzs_ext_raise_error(bzs_ext_get_error(result));
   }
 
@@ -305,29 +574,369 @@ VALUE bzs_ext_decompress_string(VALUE BZS_EXT_UNUSED(self), VALUE source_value,
     destination_buffer_length = BZS_DEFAULT_DESTINATION_BUFFER_LENGTH_FOR_DECOMPRESSOR;
   }
 
+  // Small prefix doesn't require large destination buffer.
+  if (limit != 0 && destination_buffer_length > limit) {
+    destination_buffer_length = limit;
+  }
+
   int exception;
 
   BZS_EXT_CREATE_STRING_BUFFER(destination_value, destination_buffer_length, exception);
   if (exception != 0) {
     BZ2_bzDecompressEnd(&stream);
+    bzs_ext_governor_release(reserved_memory);
     bzs_ext_raise_error(BZS_EXT_ERROR_ALLOCATE_FAILED);
   }
 
   const char* source        = RSTRING_PTR(source_value);
   size_t      source_length = RSTRING_LEN(source_value);
 
-  bzs_ext_result_t ext_result =
-    decompress(&stream, source, source_length, destination_value, destination_buffer_length, gvl);
+  bzs_ext_limit_t output_limit;
+  bzs_ext_init_limit(&output_limit, max_output_size, max_ratio, limit);
+
+  bzs_ext_digest_t source_digest;
+  bzs_ext_digest_t destination_digest;
+  bzs_ext_init_digest(&source_digest, digest);
+  bzs_ext_init_digest(&destination_digest, digest);
+
+  ext_result = decompress(
+    &stream,
+    source,
+    source_length,
+    destination_value,
+    destination_buffer_length,
+    verbosity,
+    small,
+    gvl,
+    &output_limit,
+    &source_digest,
+    &destination_digest);
 
   result = BZ2_bzDecompressEnd(&stream);
-  if (result != BZ_OK) {
+  if (result != BZ_OK && ext_result == 0) {
     ext_result = bzs_ext_get_error(result);
   }
 
+  bzs_ext_governor_release(reserved_memory);
+
+  if (ext_result != 0) {
+    bzs_ext_raise_error(ext_result);
+  }
+
+  return get_result_value(destination_value, &source_digest, &destination_digest);
+}
+
+// -- each chunk --
+
+// Each filled destination buffer is yielded as separate chunk, so source is decompressed lazily.
+// Block can break iteration or raise error, stream should be released anyway.
+
+typedef struct
+{
+  bz_stream*            stream_ptr;
+  VALUE                 source_value;
+  bzs_ext_byte_t*       destination_buffer;
+  size_t                destination_buffer_length;
+  bzs_ext_option_t      verbosity;
+  bzs_ext_option_t      small;
+  bool                  gvl;
+  bzs_ext_reservation_t reserved_memory;
+  bzs_ext_limit_t       output_limit;
+  bzs_ext_digest_t      digest;
+} each_chunk_args_t;
+
+static VALUE each_chunk(VALUE args_value)
+{
+  each_chunk_args_t* args      = (each_chunk_args_t*) args_value;
+  bzs_ext_limit_t*   limit_ptr = &args->output_limit;
+
+  const char*     source                  = RSTRING_PTR(args->source_value);
+  size_t          source_length           = RSTRING_LEN(args->source_value);
+  bzs_ext_byte_t* remaining_source        = (bzs_ext_byte_t*) source;
+  size_t          remaining_source_length = source_length;
+  size_t          destination_length      = 0;
+
+  // Chunks are not digested, digest without type ignores data.
+  decompress_args_t decompress_args = {
+    .stream_ptr                  = args->stream_ptr,
+    .remaining_source_ptr        = &remaining_source,
+    .remaining_source_length_ptr = &remaining_source_length,
+    .source_digest_ptr           = &args->digest,
+    .destination_digest_ptr      = &args->digest};
+
+  bzs_next_stream_t next_stream;
+  bzs_init_next_stream(&next_stream);
+
+  bzs_ext_limit_add_source(limit_ptr, source_length);
+
+  while (true) {
+    size_t remaining_destination_buffer_length = bzs_ext_limit_get_destination_buffer_length(
+      limit_ptr, args->destination_buffer_length - destination_length);
+    size_t prev_remaining_destination_buffer_length = remaining_destination_buffer_length;
+
+    decompress_args.remaining_destination_buffer            = args->destination_buffer + destination_length;
+    decompress_args.remaining_destination_buffer_length_ptr = &remaining_destination_buffer_length;
+
+    BZS_EXT_GVL_WRAP(args->gvl, decompress_wrapper, &decompress_args);
+    if (decompress_args.result != BZ_OK && decompress_args.result != BZ_PARAM_ERROR &&
+        decompress_args.result != BZ_STREAM_END) {
+      bzs_ext_raise_error(bzs_ext_get_error(decompress_args.result));
+    }
+
+    size_t written_destination_length = prev_remaining_destination_buffer_length - remaining_destination_buffer_length;
+    destination_length += written_destination_length;
+
+    bzs_ext_result_t ext_result = bzs_ext_limit_add_destination(limit_ptr, written_destination_length);
+    if (ext_result != 0) {
+      bzs_ext_raise_error(ext_result);
+    }
+
+    bool is_finished = bzs_ext_limit_is_prefix_finished(limit_ptr);
+
+    if (!is_finished && decompress_args.result == BZ_STREAM_END) {
+      // Remaining source may contain next concatenated stream.
+      next_stream.is_stream_end = true;
+
+      ext_result = bzs_find_next_stream(
+        &next_stream,
+        args->stream_ptr,
+        args->verbosity,
+        args->small,
+        (const bzs_ext_byte_t**) &remaining_source,
+        &remaining_source_length);
+      if (ext_result != 0) {
+        bzs_ext_raise_error(ext_result);
+      }
+
+      // Source is complete, so partial header is ignored too.
+      is_finished = !bzs_is_next_stream_found(&next_stream);
+    } else if (remaining_source_length == 0 && remaining_destination_buffer_length != 0) {
+      // Decompressor has provided all destination for available source.
+      is_finished = true;
+    }
+
+    if ((is_finished || destination_length == args->destination_buffer_length) && destination_length != 0) {
+      rb_yield(rb_str_new((const char*) args->destination_buffer, destination_length));
+      destination_length = 0;
+    }
+
+    if (is_finished) {
+      break;
+    }
+  }
+
+  return Qnil;
+}
+
+static VALUE each_chunk_ensure(VALUE args_value)
+{
+  each_chunk_args_t* args = (each_chunk_args_t*) args_value;
+
+  free(args->destination_buffer);
+  BZ2_bzDecompressEnd(args->stream_ptr);
+  bzs_ext_governor_release(args->reserved_memory);
+
+  return Qnil;
+}
+
+VALUE bzs_ext_each_chunk_string(VALUE BZS_EXT_UNUSED(self), VALUE source_value, VALUE options)
+{
+  Check_Type(source_value, T_STRING);
+  Check_Type(options, T_HASH);
+  BZS_EXT_GET_SIZE_OPTION(options, destination_buffer_length);
+  BZS_EXT_GET_BOOL_OPTION(options, gvl);
+  BZS_EXT_RESOLVE_DECOMPRESSOR_OPTIONS(options);
+  BZS_EXT_RESOLVE_LIMIT_OPTIONS(options);
+  BZS_EXT_RESOLVE_SIZE_OPTION(options, limit, BZS_DEFAULT_LIMIT);
+
+  // Block can modify source, decompressor will use frozen copy.
+  source_value = rb_str_new_frozen(source_value);
+
+  bz_stream stream = {
+    .bzalloc = NULL,
+    .bzfree  = NULL,
+    .opaque  = NULL,
+  };
+
+  bzs_ext_reservation_t reserved_memory;
+
+  bzs_ext_result_t ext_result = bzs_ext_governor_reserve_decompressors(1, &small, &reserved_memory);
+  if (ext_result != 0) {
+    bzs_ext_raise_error(ext_result);
+  }
+
+  bzs_result_t result = BZ2_bzDecompressInit(&stream, verbosity, small);
+  if (result != BZ_OK) {
+    bzs_ext_governor_release(reserved_memory);
+    bzs_ext_raise_error(bzs_ext_get_error(result));
+  }
+
+  if (destination_buffer_length == 0) {
+    destination_buffer_length = BZS_DEFAULT_DESTINATION_BUFFER_LENGTH_FOR_DECOMPRESSOR;
+  }
+
+  bzs_ext_byte_t* destination_buffer = malloc(destination_buffer_length);
+  if (destination_buffer == NULL) {
+    BZ2_bzDecompressEnd(&stream);
+    bzs_ext_governor_release(reserved_memory);
+    bzs_ext_raise_error(BZS_EXT_ERROR_ALLOCATE_FAILED);
+  }
+
+  each_chunk_args_t args = {
+    .stream_ptr                = &stream,
+    .source_value              = source_value,
+    .destination_buffer        = destination_buffer,
+    .destination_buffer_length = destination_buffer_length,
+    .verbosity                 = verbosity,
+    .small                     = small,
+    .gvl                       = gvl,
+    .reserved_memory           = reserved_memory};
+
+  bzs_ext_init_limit(&args.output_limit, max_output_size, max_ratio, limit);
+  bzs_ext_init_digest(&args.digest, BZS_DIGEST_NONE);
+
+  rb_ensure(each_chunk, (VALUE) &args, each_chunk_ensure, (VALUE) &args);
+
+  RB_GC_GUARD(source_value);
+
+  return Qnil;
+}
+
+// -- recompress --
+
+// Destination is collected in native buffer, ruby string will be created after recompression.
+
+typedef struct
+{
+  bzs_ext_byte_t* destination;
+  size_t          destination_length;
+  size_t          destination_capacity;
+} recompress_destination_t;
+
+static bzs_ext_result_t
+  append_recompress_destination(void* data, const bzs_ext_byte_t* destination, size_t destination_length)
+{
+  recompress_destination_t* recompress_destination_ptr = data;
+
+  size_t new_destination_length = recompress_destination_ptr->destination_length + destination_length;
+
+  if (new_destination_length > recompress_destination_ptr->destination_capacity) {
+    size_t destination_capacity = recompress_destination_ptr->destination_capacity * 2;
+    if (destination_capacity < new_destination_length) {
+      destination_capacity = new_destination_length;
+    }
+
+    bzs_ext_byte_t* new_destination = realloc(recompress_destination_ptr->destination, destination_capacity);
+    if (new_destination == NULL) {
+      return BZS_EXT_ERROR_ALLOCATE_FAILED;
+    }
+
+    recompress_destination_ptr->destination          = new_destination;
+    recompress_destination_ptr->destination_capacity = destination_capacity;
+  }
+
+  memcpy(
+    recompress_destination_ptr->destination + recompress_destination_ptr->destination_length,
+    destination,
+    destination_length);
+  recompress_destination_ptr->destination_length = new_destination_length;
+
+  return 0;
+}
+
+typedef struct
+{
+  bzs_ext_recompressor_t*   recompressor_ptr;
+  const bzs_ext_byte_t*     source;
+  size_t                    source_length;
+  recompress_destination_t* recompress_destination_ptr;
+  bzs_ext_result_t          ext_result;
+} recompress_args_t;
+
+static inline void* recompress_wrapper(void* data)
+{
+  recompress_args_t* args = data;
+
+  args->ext_result = bzs_ext_recompressor_append(
+    args->recompressor_ptr,
+    args->source,
+    args->source_length,
+    append_recompress_destination,
+    args->recompress_destination_ptr);
+
+  if (args->ext_result == 0) {
+    args->ext_result = bzs_ext_recompressor_finish(
+      args->recompressor_ptr, append_recompress_destination, args->recompress_destination_ptr);
+  }
+
+  return NULL;
+}
+
+VALUE bzs_ext_recompress_string(VALUE BZS_EXT_UNUSED(self), VALUE source_value, VALUE options)
+{
+  Check_Type(source_value, T_STRING);
+  Check_Type(options, T_HASH);
+  BZS_EXT_GET_SIZE_OPTION(options, destination_buffer_length);
+  BZS_EXT_GET_BOOL_OPTION(options, gvl);
+  BZS_EXT_RESOLVE_COMPRESSOR_OPTIONS(options);
+  BZS_EXT_RESOLVE_BOOL_OPTION(options, small, BZS_DEFAULT_SMALL);
+  BZS_EXT_RESOLVE_SIZE_OPTION(options, member_size, BZS_DEFAULT_MEMBER_SIZE);
+
+  if (destination_buffer_length == 0) {
+    destination_buffer_length = BZS_DEFAULT_DESTINATION_BUFFER_LENGTH_FOR_COMPRESSOR;
+  }
+
+  bzs_ext_recompressor_t* recompressor_ptr;
+
+  bzs_ext_result_t ext_result = bzs_ext_create_recompressor(
+    &recompressor_ptr, block_size, work_factor, verbosity, small, destination_buffer_length);
+  if (ext_result != 0) {
+    bzs_ext_raise_error(ext_result);
+  }
+
+  recompressor_ptr->member_size = member_size;
+
+  recompress_destination_t recompress_destination = {
+    .destination = NULL, .destination_length = 0, .destination_capacity = 0};
+
+  recompress_args_t args = {
+    .recompressor_ptr           = recompressor_ptr,
+    .source                     = (const bzs_ext_byte_t*) RSTRING_PTR(source_value),
+    .source_length              = RSTRING_LEN(source_value),
+    .recompress_destination_ptr = &recompress_destination,
+    .ext_result                 = 0};
+
+  BZS_EXT_GVL_WRAP(gvl, recompress_wrapper, &args);
+
+  bzs_ext_destroy_recompressor(recompressor_ptr);
+
+  ext_result = args.ext_result;
   if (ext_result != 0) {
+    if (recompress_destination.destination != NULL) {
+      free(recompress_destination.destination);
+    }
+
     bzs_ext_raise_error(ext_result);
   }
 
+  int exception;
+
+  BZS_EXT_CREATE_STRING_BUFFER(destination_value, recompress_destination.destination_length, exception);
+  if (exception == 0 && recompress_destination.destination_length != 0) {
+    memcpy(
+      RSTRING_PTR(destination_value), recompress_destination.destination, recompress_destination.destination_length);
+  }
+
+  if (recompress_destination.destination != NULL) {
+    free(recompress_destination.destination);
+  }
+
+  if (exception != 0) {
+    bzs_ext_raise_error(BZS_EXT_ERROR_ALLOCATE_FAILED);
+  }
+
+  RB_GC_GUARD(source_value);
+
   return destination_value;
 }
 
@@ -337,4 +946,6 @@ void bzs_ext_string_exports(VALUE root_module)
 {
   rb_define_module_function(root_module, "_native_compress_string", RUBY_METHOD_FUNC(bzs_ext_compress_string), 2);
   rb_define_module_function(root_module, "_native_decompress_string", RUBY_METHOD_FUNC(bzs_ext_decompress_string), 2);
+  rb_define_module_function(root_module, "_native_each_chunk_string", RUBY_METHOD_FUNC(bzs_ext_each_chunk_string), 2);
+  rb_define_module_function(root_module, "_native_recompress_string", RUBY_METHOD_FUNC(bzs_ext_recompress_string), 2);
 }
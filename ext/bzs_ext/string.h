@@ -8,6 +8,8 @@
 
 VALUE bzs_ext_compress_string(VALUE self, VALUE source, VALUE options);
 VALUE bzs_ext_decompress_string(VALUE self, VALUE source, VALUE options);
+VALUE bzs_ext_each_chunk_string(VALUE self, VALUE source, VALUE options);
+VALUE bzs_ext_recompress_string(VALUE self, VALUE source, VALUE options);
 
 void bzs_ext_string_exports(VALUE root_module);
 
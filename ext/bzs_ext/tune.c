@@ -0,0 +1,123 @@
+// Ruby bindings for bzip2 library.
+// Copyright (c) 2022 AUTHORS, MIT License.
+
+#include "bzs_ext/tune.h"
+
+#include <bzlib.h>
+#include <time.h>
+
+#include "bzs_ext/allocator.h"
+#include "bzs_ext/error.h"
+#include "bzs_ext/utils.h"
+
+static inline uint64_t get_time(void)
+{
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+
+  return (uint64_t) time.tv_sec * 1000000000 + (uint64_t) time.tv_nsec;
+}
+
+// Bzip2 guarantees that destination will be at least 1% larger than source plus 600 bytes.
+static inline size_t get_destination_bound(size_t source_length)
+{
+  return source_length + source_length / 100 + 600;
+}
+
+static inline bzs_ext_result_t compress_sample(
+  bz_stream*             stream_ptr,
+  const bzs_ext_byte_t*  sample,
+  size_t                 sample_length,
+  bzs_ext_byte_t*        destination,
+  size_t                 destination_length,
+  bzs_ext_measurement_t* measurement_ptr,
+  uint64_t               start_time)
+{
+  const bzs_ext_byte_t* remaining_sample        = sample;
+  size_t                remaining_sample_length = sample_length;
+
+  stream_ptr->next_out  = (char*) destination;
+  stream_ptr->avail_out = bzs_consume_size(destination_length);
+
+  while (true) {
+    unsigned int avail_in      = bzs_consume_size(remaining_sample_length);
+    int          stream_action = BZ_FINISH;
+
+    if (avail_in > BZS_TUNE_PORTION_LENGTH) {
+      avail_in      = BZS_TUNE_PORTION_LENGTH;
+      stream_action = BZ_RUN;
+    }
+
+    stream_ptr->next_in  = (char*) remaining_sample;
+    stream_ptr->avail_in = avail_in;
+
+    bzs_result_t result = BZ2_bzCompress(stream_ptr, stream_action);
+    if (result != BZ_RUN_OK && result != BZ_FINISH_OK && result != BZ_STREAM_END) {
+      return bzs_ext_get_error(result);
+    }
+
+    remaining_sample_length -= avail_in - stream_ptr->avail_in;
+    remaining_sample = (const bzs_ext_byte_t*) stream_ptr->next_in;
+
+    if (measurement_ptr->latency == 0 && (bzs_ext_byte_t*) stream_ptr->next_out != destination) {
+      // Compressor provides first output when first block is sorted.
+      measurement_ptr->latency = get_time() - start_time;
+    }
+
+    if (result == BZ_STREAM_END) {
+      break;
+    }
+
+    if (stream_ptr->avail_out == 0) {
+      // Destination bound should be enough for any source.
+      return BZS_EXT_ERROR_NOT_ENOUGH_DESTINATION_BUFFER;
+    }
+  }
+
+  measurement_ptr->destination_length = (bzs_ext_byte_t*) stream_ptr->next_out - destination;
+
+  return 0;
+}
+
+bzs_ext_result_t bzs_ext_measure_compressor(
+  const bzs_ext_byte_t*  sample,
+  size_t                 sample_length,
+  bzs_ext_option_t       verbosity,
+  bzs_ext_measurement_t* measurement_ptr)
+{
+  size_t          destination_length = get_destination_bound(sample_length);
+  bzs_ext_byte_t* destination        = malloc(destination_length);
+  if (destination == NULL) {
+    return BZS_EXT_ERROR_ALLOCATE_FAILED;
+  }
+
+  bz_stream           stream;
+  bzs_ext_allocator_t allocator;
+
+  bzs_ext_init_allocator(&allocator);
+  bzs_ext_use_allocator(&stream, &allocator);
+
+  measurement_ptr->latency = 0;
+
+  uint64_t start_time = get_time();
+
+  bzs_result_t result =
+    BZ2_bzCompressInit(&stream, measurement_ptr->block_size, verbosity, measurement_ptr->work_factor);
+  if (result != BZ_OK) {
+    free(destination);
+    bzs_ext_release_allocator(&allocator);
+    return bzs_ext_get_error(result);
+  }
+
+  bzs_ext_result_t ext_result =
+    compress_sample(&stream, sample, sample_length, destination, destination_length, measurement_ptr, start_time);
+
+  measurement_ptr->time   = get_time() - start_time;
+  measurement_ptr->memory = allocator.max_size;
+
+  BZ2_bzCompressEnd(&stream);
+  bzs_ext_release_allocator(&allocator);
+  free(destination);
+
+  return ext_result;
+}
@@ -0,0 +1,36 @@
+// Ruby bindings for bzip2 library.
+// Copyright (c) 2022 AUTHORS, MIT License.
+
+#if !defined(BZS_EXT_TUNE_H)
+#define BZS_EXT_TUNE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "bzs_ext/common.h"
+#include "bzs_ext/option.h"
+
+// Tuner compresses sample with each candidate of block size and work factor.
+// Sample is provided to compressor by portions, so we can measure time of first compressed output.
+// Memory is measured by allocator as max size of memory used by compressor.
+
+#define BZS_TUNE_PORTION_LENGTH (1 << 16) // 64 KB
+
+typedef struct
+{
+  bzs_ext_option_t block_size;
+  bzs_ext_option_t work_factor;
+  size_t           destination_length;
+  uint64_t         time;
+  uint64_t         latency;
+  size_t           memory;
+} bzs_ext_measurement_t;
+
+// Measurement should have block size and work factor, time and latency are nanoseconds.
+bzs_ext_result_t bzs_ext_measure_compressor(
+  const bzs_ext_byte_t*  sample,
+  size_t                 sample_length,
+  bzs_ext_option_t       verbosity,
+  bzs_ext_measurement_t* measurement_ptr);
+
+#endif // BZS_EXT_TUNE_H
@@ -0,0 +1,638 @@
+// Ruby bindings for bzip2 library.
+// Copyright (c) 2022 AUTHORS, MIT License.
+
+#include "bzs_ext/uring.h"
+
+#include "bzs_ext/error.h"
+#include "bzs_ext/macro.h"
+
+#if defined(HAVE_LINUX_IO_URING_H) && defined(HAVE_CONST___NR_IO_URING_SETUP)
+#define URING_SUPPORTED
+#endif
+
+#if defined(URING_SUPPORTED)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "bzs_ext/utils.h"
+
+// -- ring --
+
+typedef struct
+{
+  int                  fd;
+  void*                sq_ring;
+  size_t               sq_ring_size;
+  void*                cq_ring;
+  size_t               cq_ring_size;
+  struct io_uring_sqe* sqes;
+  size_t               sqes_size;
+  unsigned*            sq_head;
+  unsigned*            sq_tail;
+  unsigned*            sq_array;
+  unsigned             sq_mask;
+  unsigned*            cq_head;
+  unsigned*            cq_tail;
+  struct io_uring_cqe* cqes;
+  unsigned             cq_mask;
+} ring_t;
+
+static inline int enter_ring(const ring_t* ring_ptr, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+  return (int) syscall(__NR_io_uring_enter, ring_ptr->fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static inline void release_ring(ring_t* ring_ptr)
+{
+  if (ring_ptr->sqes != MAP_FAILED) {
+    munmap(ring_ptr->sqes, ring_ptr->sqes_size);
+  }
+
+  if (ring_ptr->cq_ring != MAP_FAILED && ring_ptr->cq_ring != ring_ptr->sq_ring) {
+    munmap(ring_ptr->cq_ring, ring_ptr->cq_ring_size);
+  }
+
+  if (ring_ptr->sq_ring != MAP_FAILED) {
+    munmap(ring_ptr->sq_ring, ring_ptr->sq_ring_size);
+  }
+
+  close(ring_ptr->fd);
+}
+
+static inline bzs_ext_result_t init_ring(ring_t* ring_ptr, unsigned entries)
+{
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+
+  int fd = (int) syscall(__NR_io_uring_setup, entries, &params);
+  if (fd < 0) {
+    // Kernel or its security policy doesn't allow io_uring.
+    return BZS_EXT_ERROR_NOT_IMPLEMENTED;
+  }
+
+  ring_ptr->fd           = fd;
+  ring_ptr->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring_ptr->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  ring_ptr->sqes_size    = params.sq_entries * sizeof(struct io_uring_sqe);
+  ring_ptr->cq_ring      = MAP_FAILED;
+  ring_ptr->sqes         = MAP_FAILED;
+
+  // Submission and completion rings can be mapped at once.
+  bool is_single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (is_single_mmap && ring_ptr->cq_ring_size > ring_ptr->sq_ring_size) {
+    ring_ptr->sq_ring_size = ring_ptr->cq_ring_size;
+  }
+
+  ring_ptr->sq_ring = mmap(
+    NULL, ring_ptr->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if (ring_ptr->sq_ring == MAP_FAILED) {
+    release_ring(ring_ptr);
+    return BZS_EXT_ERROR_NOT_IMPLEMENTED;
+  }
+
+  if (is_single_mmap) {
+    ring_ptr->cq_ring = ring_ptr->sq_ring;
+  } else {
+    ring_ptr->cq_ring = mmap(
+      NULL, ring_ptr->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (ring_ptr->cq_ring == MAP_FAILED) {
+      release_ring(ring_ptr);
+      return BZS_EXT_ERROR_NOT_IMPLEMENTED;
+    }
+  }
+
+  ring_ptr->sqes =
+    mmap(NULL, ring_ptr->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (ring_ptr->sqes == MAP_FAILED) {
+    release_ring(ring_ptr);
+    return BZS_EXT_ERROR_NOT_IMPLEMENTED;
+  }
+
+  char* sq_ring = ring_ptr->sq_ring;
+  char* cq_ring = ring_ptr->cq_ring;
+
+  ring_ptr->sq_head  = (unsigned*) (sq_ring + params.sq_off.head);
+  ring_ptr->sq_tail  = (unsigned*) (sq_ring + params.sq_off.tail);
+  ring_ptr->sq_array = (unsigned*) (sq_ring + params.sq_off.array);
+  ring_ptr->sq_mask  = *(unsigned*) (sq_ring + params.sq_off.ring_mask);
+  ring_ptr->cq_head  = (unsigned*) (cq_ring + params.cq_off.head);
+  ring_ptr->cq_tail  = (unsigned*) (cq_ring + params.cq_off.tail);
+  ring_ptr->cqes     = (struct io_uring_cqe*) (cq_ring + params.cq_off.cqes);
+  ring_ptr->cq_mask  = *(unsigned*) (cq_ring + params.cq_off.ring_mask);
+
+  return 0;
+}
+
+// -- buffers --
+
+typedef struct
+{
+  bzs_ext_byte_t* buffer;
+  size_t          length;
+  size_t          processed_length;
+  off_t           offset;
+  bool            is_pending;
+  bool            is_ready;
+} buffer_t;
+
+struct bzs_ext_uring
+{
+  ring_t           ring;
+  int              source_fd;
+  int              destination_fd;
+  bzs_ext_byte_t*  memory;
+  buffer_t*        buffers;
+  size_t           buffers_count;
+  size_t           source_buffer_length;
+  size_t           destination_buffer_length;
+  size_t           current_source_index;
+  off_t            next_source_offset;
+  off_t            source_position;
+  bool             is_source_finished;
+  size_t           next_destination_index;
+  size_t           current_destination_index;
+  off_t            destination_offset;
+  size_t           pending_count;
+  bzs_ext_result_t ext_result;
+};
+
+// Buffers contain source buffers and than destination buffers, index is used as registered buffer index.
+
+static inline buffer_t* get_source_buffer(bzs_ext_uring_t* uring_ptr, size_t index)
+{
+  return &uring_ptr->buffers[index];
+}
+
+static inline buffer_t* get_destination_buffer(bzs_ext_uring_t* uring_ptr, size_t index)
+{
+  return &uring_ptr->buffers[uring_ptr->buffers_count + index];
+}
+
+// -- submit --
+
+static bzs_ext_result_t process_completions(bzs_ext_uring_t* uring_ptr, bool needs_wait);
+
+static inline bzs_ext_result_t submit(bzs_ext_uring_t* uring_ptr, buffer_t* buffer_ptr, bool is_source)
+{
+  ring_t*  ring_ptr = &uring_ptr->ring;
+  unsigned tail     = *ring_ptr->sq_tail;
+  unsigned index    = tail & ring_ptr->sq_mask;
+
+  // Each buffer has single operation, so submission ring is never full.
+  struct io_uring_sqe* sqe_ptr = &ring_ptr->sqes[index];
+  memset(sqe_ptr, 0, sizeof(struct io_uring_sqe));
+
+  size_t buffer_index = buffer_ptr - uring_ptr->buffers;
+
+  sqe_ptr->opcode    = is_source ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+  sqe_ptr->fd        = is_source ? uring_ptr->source_fd : uring_ptr->destination_fd;
+  sqe_ptr->off       = buffer_ptr->offset + buffer_ptr->processed_length;
+  sqe_ptr->addr      = (uintptr_t) (buffer_ptr->buffer + buffer_ptr->processed_length);
+  sqe_ptr->len       = bzs_consume_size(buffer_ptr->length - buffer_ptr->processed_length);
+  sqe_ptr->buf_index = (uint16_t) buffer_index;
+  sqe_ptr->user_data = buffer_index;
+
+  ring_ptr->sq_array[index] = index;
+  __atomic_store_n(ring_ptr->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+  buffer_ptr->is_pending = true;
+  buffer_ptr->is_ready   = false;
+  uring_ptr->pending_count++;
+
+  while (true) {
+    if (enter_ring(ring_ptr, 1, 0, 0) >= 0) {
+      return 0;
+    }
+
+    if (errno == EINTR) {
+      continue;
+    }
+
+    // Kernel has no resources for new submission until completions will be received.
+    if ((errno == EAGAIN || errno == EBUSY) && uring_ptr->pending_count > 1) {
+      bzs_ext_result_t ext_result = process_completions(uring_ptr, true);
+      if (ext_result != 0) {
+        return ext_result;
+      }
+
+      continue;
+    }
+
+    // Kernel consumes entries only inside enter (no submission polling) and returns error only when nothing was
+    // consumed, so entry is still visible in ring. Tail should be rolled back, otherwise next enter will submit it.
+    __atomic_store_n(ring_ptr->sq_tail, tail, __ATOMIC_RELEASE);
+
+    // Operation won't be completed.
+    buffer_ptr->is_pending = false;
+    uring_ptr->pending_count--;
+
+    return is_source ? BZS_EXT_ERROR_READ_IO : BZS_EXT_ERROR_WRITE_IO;
+  }
+}
+
+static inline bzs_ext_result_t submit_source(bzs_ext_uring_t* uring_ptr, buffer_t* buffer_ptr)
+{
+  buffer_ptr->length           = uring_ptr->source_buffer_length;
+  buffer_ptr->processed_length = 0;
+  buffer_ptr->offset           = uring_ptr->next_source_offset;
+
+  uring_ptr->next_source_offset += uring_ptr->source_buffer_length;
+
+  return submit(uring_ptr, buffer_ptr, true);
+}
+
+// -- complete --
+
+static inline bzs_ext_result_t complete(bzs_ext_uring_t* uring_ptr, size_t buffer_index, int result)
+{
+  buffer_t* buffer_ptr = &uring_ptr->buffers[buffer_index];
+  bool      is_source  = buffer_index < uring_ptr->buffers_count;
+
+  buffer_ptr->is_pending = false;
+  uring_ptr->pending_count--;
+
+  if (result == -EINTR || result == -EAGAIN) {
+    return submit(uring_ptr, buffer_ptr, is_source);
+  }
+
+  if (result < 0 || (result == 0 && !is_source)) {
+    return is_source ? BZS_EXT_ERROR_READ_IO : BZS_EXT_ERROR_WRITE_IO;
+  }
+
+  if (result == 0) {
+    // Source buffer is partially filled, next source buffers will be empty.
+    uring_ptr->is_source_finished = true;
+    buffer_ptr->length            = buffer_ptr->processed_length;
+    buffer_ptr->is_ready          = true;
+
+    return 0;
+  }
+
+  buffer_ptr->processed_length += (size_t) result;
+
+  // Operation can be partially completed, remaining part should be submitted again.
+  if (buffer_ptr->processed_length != buffer_ptr->length) {
+    return submit(uring_ptr, buffer_ptr, is_source);
+  }
+
+  buffer_ptr->is_ready = true;
+
+  return 0;
+}
+
+static bzs_ext_result_t process_completions(bzs_ext_uring_t* uring_ptr, bool needs_wait)
+{
+  ring_t* ring_ptr = &uring_ptr->ring;
+
+  while (true) {
+    unsigned head = *ring_ptr->cq_head;
+    unsigned tail = __atomic_load_n(ring_ptr->cq_tail, __ATOMIC_ACQUIRE);
+
+    if (head != tail) {
+      // All available completions are processed at once.
+      while (head != tail) {
+        const struct io_uring_cqe* cqe_ptr = &ring_ptr->cqes[head & ring_ptr->cq_mask];
+
+        size_t buffer_index = cqe_ptr->user_data;
+        int    result       = cqe_ptr->res;
+
+        head++;
+        __atomic_store_n(ring_ptr->cq_head, head, __ATOMIC_RELEASE);
+
+        bzs_ext_result_t ext_result = complete(uring_ptr, buffer_index, result);
+        if (ext_result != 0) {
+          return ext_result;
+        }
+      }
+
+      return 0;
+    }
+
+    if (!needs_wait || uring_ptr->pending_count == 0) {
+      return 0;
+    }
+
+    if (enter_ring(ring_ptr, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+      return BZS_EXT_ERROR_UNEXPECTED;
+    }
+  }
+}
+
+// Error is stored, because operations should be completed before buffers will be released.
+#define PROCESS_COMPLETIONS(uring_ptr, needs_wait)                      \
+  if (uring_ptr->ext_result == 0) {                                     \
+    uring_ptr->ext_result = process_completions(uring_ptr, needs_wait); \
+  }                                                                     \
+                                                                        \
+  if (uring_ptr->ext_result != 0) {                                     \
+    return uring_ptr->ext_result;                                       \
+  }
+
+// -- create --
+
+bzs_ext_result_t bzs_ext_create_uring(
+  bzs_ext_uring_t** uring_ptr_ptr,
+  int               source_fd,
+  int               destination_fd,
+  size_t            buffers_count,
+  size_t            source_buffer_length,
+  size_t            destination_buffer_length)
+{
+  // Uring reads and writes at explicit offsets.
+  off_t source_offset      = lseek(source_fd, 0, SEEK_CUR);
+  off_t destination_offset = lseek(destination_fd, 0, SEEK_CUR);
+  if (source_offset < 0 || destination_offset < 0) {
+    return BZS_EXT_ERROR_NOT_IMPLEMENTED;
+  }
+
+  // Append mode ignores offsets, so writes completed out of order will be corrupted.
+  int destination_flags = fcntl(destination_fd, F_GETFL);
+  if (destination_flags < 0 || (destination_flags & O_APPEND) != 0) {
+    return BZS_EXT_ERROR_NOT_IMPLEMENTED;
+  }
+
+  // Registered buffer index is limited.
+  if (buffers_count == 0 || buffers_count > UINT16_MAX / 2) {
+    return BZS_EXT_ERROR_VALIDATE_FAILED;
+  }
+
+  bzs_ext_uring_t* uring_ptr = malloc(sizeof(bzs_ext_uring_t));
+  if (uring_ptr == NULL) {
+    return BZS_EXT_ERROR_ALLOCATE_FAILED;
+  }
+
+  size_t total_buffers_count = buffers_count * 2;
+
+  buffer_t*     buffers = malloc(sizeof(buffer_t) * total_buffers_count);
+  struct iovec* iovecs  = malloc(sizeof(struct iovec) * total_buffers_count);
+  if (buffers == NULL || iovecs == NULL) {
+    free(buffers);
+    free(iovecs);
+    free(uring_ptr);
+    return BZS_EXT_ERROR_ALLOCATE_FAILED;
+  }
+
+  // Page aligned memory is registered once for all buffers.
+  size_t memory_length = buffers_count * (source_buffer_length + destination_buffer_length);
+  void*  memory;
+
+  if (posix_memalign(&memory, (size_t) sysconf(_SC_PAGESIZE), memory_length) != 0) {
+    free(buffers);
+    free(iovecs);
+    free(uring_ptr);
+    return BZS_EXT_ERROR_ALLOCATE_FAILED;
+  }
+
+  bzs_ext_byte_t* buffer = memory;
+
+  for (size_t index = 0; index < total_buffers_count; index++) {
+    buffer_t* buffer_ptr    = &buffers[index];
+    size_t    buffer_length = index < buffers_count ? source_buffer_length : destination_buffer_length;
+
+    buffer_ptr->buffer           = buffer;
+    buffer_ptr->length           = 0;
+    buffer_ptr->processed_length = 0;
+    buffer_ptr->offset           = 0;
+    buffer_ptr->is_pending       = false;
+    buffer_ptr->is_ready         = false;
+
+    iovecs[index].iov_base = buffer;
+    iovecs[index].iov_len  = buffer_length;
+
+    buffer += buffer_length;
+  }
+
+  bzs_ext_result_t ext_result = init_ring(&uring_ptr->ring, (unsigned) total_buffers_count);
+  if (ext_result == 0) {
+    if (syscall(__NR_io_uring_register, uring_ptr->ring.fd, IORING_REGISTER_BUFFERS, iovecs, total_buffers_count) !=
+        0) {
+      // Registered memory is limited by memlock limit.
+      release_ring(&uring_ptr->ring);
+      ext_result = BZS_EXT_ERROR_NOT_IMPLEMENTED;
+    }
+  }
+
+  free(iovecs);
+
+  if (ext_result != 0) {
+    free(memory);
+    free(buffers);
+    free(uring_ptr);
+    return ext_result;
+  }
+
+  uring_ptr->source_fd                 = source_fd;
+  uring_ptr->destination_fd            = destination_fd;
+  uring_ptr->memory                    = memory;
+  uring_ptr->buffers                   = buffers;
+  uring_ptr->buffers_count             = buffers_count;
+  uring_ptr->source_buffer_length      = source_buffer_length;
+  uring_ptr->destination_buffer_length = destination_buffer_length;
+  uring_ptr->current_source_index      = 0;
+  uring_ptr->next_source_offset        = source_offset;
+  uring_ptr->source_position           = source_offset;
+  uring_ptr->is_source_finished        = false;
+  uring_ptr->next_destination_index    = 0;
+  uring_ptr->current_destination_index = 0;
+  uring_ptr->destination_offset        = destination_offset;
+  uring_ptr->pending_count             = 0;
+  uring_ptr->ext_result                = 0;
+
+  // All source buffers are submitted ahead of algorithm.
+  for (size_t index = 0; index < buffers_count; index++) {
+    ext_result = submit_source(uring_ptr, get_source_buffer(uring_ptr, index));
+    if (ext_result != 0) {
+      uring_ptr->ext_result = ext_result;
+      bzs_ext_destroy_uring(uring_ptr);
+      return ext_result;
+    }
+  }
+
+  *uring_ptr_ptr = uring_ptr;
+
+  return 0;
+}
+
+// -- source --
+
+bzs_ext_result_t bzs_ext_uring_get_source(
+  bzs_ext_uring_t* uring_ptr, const bzs_ext_byte_t** source_ptr, size_t* source_length_ptr)
+{
+  buffer_t* buffer_ptr = get_source_buffer(uring_ptr, uring_ptr->current_source_index);
+
+  while (!buffer_ptr->is_ready) {
+    PROCESS_COMPLETIONS(uring_ptr, true);
+  }
+
+  uring_ptr->source_position += buffer_ptr->length;
+
+  *source_ptr        = buffer_ptr->buffer;
+  *source_length_ptr = buffer_ptr->length;
+
+  return 0;
+}
+
+bzs_ext_result_t bzs_ext_uring_release_source(bzs_ext_uring_t* uring_ptr)
+{
+  buffer_t* buffer_ptr = get_source_buffer(uring_ptr, uring_ptr->current_source_index);
+
+  uring_ptr->current_source_index = (uring_ptr->current_source_index + 1) % uring_ptr->buffers_count;
+
+  if (uring_ptr->is_source_finished) {
+    // Released buffer will mean end of source.
+    buffer_ptr->length   = 0;
+    buffer_ptr->is_ready = true;
+
+    return 0;
+  }
+
+  bzs_ext_result_t ext_result = submit_source(uring_ptr, buffer_ptr);
+  if (ext_result != 0) {
+    uring_ptr->ext_result = ext_result;
+    return ext_result;
+  }
+
+  // Completed operations are collected without waiting.
+  PROCESS_COMPLETIONS(uring_ptr, false);
+
+  return 0;
+}
+
+// -- destination --
+
+bzs_ext_result_t bzs_ext_uring_get_destination(
+  bzs_ext_uring_t* uring_ptr, bzs_ext_byte_t** destination_buffer_ptr, size_t* destination_buffer_length_ptr)
+{
+  size_t    index      = uring_ptr->next_destination_index;
+  buffer_t* buffer_ptr = get_destination_buffer(uring_ptr, index);
+
+  // Destination buffers are used in order, so next buffer is the oldest one.
+  while (buffer_ptr->is_pending) {
+    PROCESS_COMPLETIONS(uring_ptr, true);
+  }
+
+  uring_ptr->current_destination_index = index;
+  uring_ptr->next_destination_index    = (index + 1) % uring_ptr->buffers_count;
+
+  *destination_buffer_ptr        = buffer_ptr->buffer;
+  *destination_buffer_length_ptr = uring_ptr->destination_buffer_length;
+
+  return 0;
+}
+
+bzs_ext_result_t bzs_ext_uring_write_destination(bzs_ext_uring_t* uring_ptr, size_t destination_length)
+{
+  if (destination_length == 0) {
+    return 0;
+  }
+
+  buffer_t* buffer_ptr = get_destination_buffer(uring_ptr, uring_ptr->current_destination_index);
+
+  buffer_ptr->length           = destination_length;
+  buffer_ptr->processed_length = 0;
+  buffer_ptr->offset           = uring_ptr->destination_offset;
+
+  uring_ptr->destination_offset += destination_length;
+
+  bzs_ext_result_t ext_result = submit(uring_ptr, buffer_ptr, false);
+  if (ext_result != 0) {
+    uring_ptr->ext_result = ext_result;
+    return ext_result;
+  }
+
+  PROCESS_COMPLETIONS(uring_ptr, false);
+
+  return 0;
+}
+
+bzs_ext_result_t bzs_ext_uring_finish(bzs_ext_uring_t* uring_ptr)
+{
+  for (size_t index = 0; index < uring_ptr->buffers_count; index++) {
+    buffer_t* buffer_ptr = get_destination_buffer(uring_ptr, index);
+
+    while (buffer_ptr->is_pending) {
+      PROCESS_COMPLETIONS(uring_ptr, true);
+    }
+  }
+
+  return 0;
+}
+
+// -- destroy --
+
+void bzs_ext_destroy_uring(bzs_ext_uring_t* uring_ptr)
+{
+  // Kernel can access buffers until all operations will be completed.
+  while (uring_ptr->pending_count != 0) {
+    if (process_completions(uring_ptr, true) == BZS_EXT_ERROR_UNEXPECTED) {
+      break;
+    }
+  }
+
+  lseek(uring_ptr->source_fd, uring_ptr->source_position, SEEK_SET);
+  lseek(uring_ptr->destination_fd, uring_ptr->destination_offset, SEEK_SET);
+
+  release_ring(&uring_ptr->ring);
+
+  free(uring_ptr->memory);
+  free(uring_ptr->buffers);
+  free(uring_ptr);
+}
+
+#else
+
+bzs_ext_result_t bzs_ext_create_uring(
+  bzs_ext_uring_t** BZS_EXT_UNUSED(uring_ptr_ptr),
+  int               BZS_EXT_UNUSED(source_fd),
+  int               BZS_EXT_UNUSED(destination_fd),
+  size_t            BZS_EXT_UNUSED(buffers_count),
+  size_t            BZS_EXT_UNUSED(source_buffer_length),
+  size_t            BZS_EXT_UNUSED(destination_buffer_length))
+{
+  return BZS_EXT_ERROR_NOT_IMPLEMENTED;
+}
+
+bzs_ext_result_t bzs_ext_uring_get_source(
+  bzs_ext_uring_t*       BZS_EXT_UNUSED(uring_ptr),
+  const bzs_ext_byte_t** BZS_EXT_UNUSED(source_ptr),
+  size_t*                BZS_EXT_UNUSED(source_length_ptr))
+{
+  return BZS_EXT_ERROR_NOT_IMPLEMENTED;
+}
+
+bzs_ext_result_t bzs_ext_uring_release_source(bzs_ext_uring_t* BZS_EXT_UNUSED(uring_ptr))
+{
+  return BZS_EXT_ERROR_NOT_IMPLEMENTED;
+}
+
+bzs_ext_result_t bzs_ext_uring_get_destination(
+  bzs_ext_uring_t* BZS_EXT_UNUSED(uring_ptr),
+  bzs_ext_byte_t** BZS_EXT_UNUSED(destination_buffer_ptr),
+  size_t*          BZS_EXT_UNUSED(destination_buffer_length_ptr))
+{
+  return BZS_EXT_ERROR_NOT_IMPLEMENTED;
+}
+
+bzs_ext_result_t bzs_ext_uring_write_destination(
+  bzs_ext_uring_t* BZS_EXT_UNUSED(uring_ptr), size_t BZS_EXT_UNUSED(destination_length))
+{
+  return BZS_EXT_ERROR_NOT_IMPLEMENTED;
+}
+
+bzs_ext_result_t bzs_ext_uring_finish(bzs_ext_uring_t* BZS_EXT_UNUSED(uring_ptr))
+{
+  return BZS_EXT_ERROR_NOT_IMPLEMENTED;
+}
+
+void bzs_ext_destroy_uring(bzs_ext_uring_t* BZS_EXT_UNUSED(uring_ptr)) {}
+
+#endif // URING_SUPPORTED
@@ -0,0 +1,47 @@
+// Ruby bindings for bzip2 library.
+// Copyright (c) 2022 AUTHORS, MIT License.
+
+#if !defined(BZS_EXT_URING_H)
+#define BZS_EXT_URING_H
+
+#include <stdlib.h>
+
+#include "bzs_ext/common.h"
+
+// Uring reads source file and writes destination file using linux io_uring without liburing.
+// Several reads are submitted ahead of algorithm, source buffers are returned in file order.
+// Destination buffers are written at their file offsets, so writes can be completed in any order.
+// Completions are collected from shared ring in batches, system call is required only for waiting.
+
+// Source and destination buffers are registered in kernel, algorithm uses them directly as next_in and next_out.
+// Uring is not available when kernel or its security policy doesn't allow io_uring or descriptor is not seekable,
+// not implemented error will be returned, so file can be processed by regular reads and writes.
+
+typedef struct bzs_ext_uring bzs_ext_uring_t;
+
+bzs_ext_result_t bzs_ext_create_uring(
+  bzs_ext_uring_t** uring_ptr_ptr,
+  int               source_fd,
+  int               destination_fd,
+  size_t            buffers_count,
+  size_t            source_buffer_length,
+  size_t            destination_buffer_length);
+
+// Returns next source buffer, zero length means end of source.
+// Source buffer should be released before receiving next source buffer.
+bzs_ext_result_t bzs_ext_uring_get_source(
+  bzs_ext_uring_t* uring_ptr, const bzs_ext_byte_t** source_ptr, size_t* source_length_ptr);
+bzs_ext_result_t bzs_ext_uring_release_source(bzs_ext_uring_t* uring_ptr);
+
+// Returns free destination buffer, it waits for previous writes when all destination buffers are busy.
+bzs_ext_result_t bzs_ext_uring_get_destination(
+  bzs_ext_uring_t* uring_ptr, bzs_ext_byte_t** destination_buffer_ptr, size_t* destination_buffer_length_ptr);
+bzs_ext_result_t bzs_ext_uring_write_destination(bzs_ext_uring_t* uring_ptr, size_t destination_length);
+
+// Waits for all writes.
+bzs_ext_result_t bzs_ext_uring_finish(bzs_ext_uring_t* uring_ptr);
+
+// Waits for submitted operations and moves descriptors to positions after processed source and written destination.
+void bzs_ext_destroy_uring(bzs_ext_uring_t* uring_ptr);
+
+#endif // BZS_EXT_URING_H
@@ -5,6 +5,8 @@
 
 #include <limits.h>
 
+#include "bzs_ext/error.h"
+
 unsigned int bzs_consume_size(size_t size)
 {
   if (size > UINT_MAX) {
@@ -13,3 +15,122 @@ unsigned int bzs_consume_size(size_t size)
     return (unsigned int) size;
   }
 }
+
+bzs_ext_result_t bzs_restart_compressor(
+  bz_stream*       stream_ptr,
+  bzs_ext_option_t block_size,
+  bzs_ext_option_t verbosity,
+  bzs_ext_option_t work_factor)
+{
+  bzs_result_t result = BZ2_bzCompressEnd(stream_ptr);
+  if (result != BZ_OK) {
+    return bzs_ext_get_error(result);
+  }
+
+  result = BZ2_bzCompressInit(stream_ptr, block_size, verbosity, work_factor);
+  if (result != BZ_OK) {
+    return bzs_ext_get_error(result);
+  }
+
+  return 0;
+}
+
+bzs_ext_result_t bzs_restart_decompressor(bz_stream* stream_ptr, bzs_ext_option_t verbosity, bzs_ext_option_t small)
+{
+  bzs_result_t result = BZ2_bzDecompressEnd(stream_ptr);
+  if (result != BZ_OK) {
+    return bzs_ext_get_error(result);
+  }
+
+  result = BZ2_bzDecompressInit(stream_ptr, verbosity, small);
+  if (result != BZ_OK) {
+    return bzs_ext_get_error(result);
+  }
+
+  return 0;
+}
+
+void bzs_init_next_stream(bzs_next_stream_t* next_stream_ptr)
+{
+  next_stream_ptr->is_stream_end = false;
+  next_stream_ptr->is_finished   = false;
+  next_stream_ptr->header_length = 0;
+}
+
+static inline bool is_header_byte(size_t index, bzs_ext_byte_t byte)
+{
+  switch (index) {
+    case 0:
+      return byte == 'B';
+    case 1:
+      return byte == 'Z';
+    case 2:
+      return byte == 'h';
+    default:
+      return byte >= '1' && byte <= '9';
+  }
+}
+
+bzs_ext_result_t bzs_find_next_stream(
+  bzs_next_stream_t*     next_stream_ptr,
+  bz_stream*             stream_ptr,
+  bzs_ext_option_t       verbosity,
+  bzs_ext_option_t       small,
+  const bzs_ext_byte_t** source_ptr,
+  size_t*                source_length_ptr)
+{
+  if (!next_stream_ptr->is_stream_end) {
+    return 0;
+  }
+
+  const bzs_ext_byte_t* source        = *source_ptr;
+  size_t                source_length = *source_length_ptr;
+
+  while (next_stream_ptr->header_length != BZS_STREAM_HEADER_LENGTH && source_length != 0) {
+    bzs_ext_byte_t byte = *source;
+    if (!is_header_byte(next_stream_ptr->header_length, byte)) {
+      next_stream_ptr->is_finished = true;
+      break;
+    }
+
+    next_stream_ptr->header[next_stream_ptr->header_length++] = byte;
+    source++;
+    source_length--;
+  }
+
+  if (next_stream_ptr->is_finished) {
+    // Trailing data is ignored.
+    source += source_length;
+    source_length = 0;
+  }
+
+  *source_ptr        = source;
+  *source_length_ptr = source_length;
+
+  if (next_stream_ptr->is_finished || next_stream_ptr->header_length != BZS_STREAM_HEADER_LENGTH) {
+    return 0;
+  }
+
+  bzs_ext_result_t ext_result = bzs_restart_decompressor(stream_ptr, verbosity, small);
+  if (ext_result != 0) {
+    return ext_result;
+  }
+
+  // Decompressor consumes header without destination.
+  char destination;
+
+  stream_ptr->next_in   = (char*) next_stream_ptr->header;
+  stream_ptr->avail_in  = BZS_STREAM_HEADER_LENGTH;
+  stream_ptr->next_out  = &destination;
+  stream_ptr->avail_out = 0;
+
+  bzs_result_t result = BZ2_bzDecompress(stream_ptr);
+  if (result != BZ_OK) {
+    return bzs_ext_get_error(result);
+  }
+
+  next_stream_ptr->is_stream_end = false;
+  next_stream_ptr->header_length = 0;
+
+  return 0;
+}
@@ -4,10 +4,57 @@
 #if !defined(BZS_EXT_UTILS_H)
 #define BZS_EXT_UTILS_H
 
+#include <bzlib.h>
+#include <stdbool.h>
 #include <stdlib.h>
 
+#include "bzs_ext/block.h"
+#include "bzs_ext/common.h"
+#include "bzs_ext/option.h"
+
 // Bzip2 size type may be limited to unsigned int.
 // We need to prevent overflow by consuming max available unsigned int value.
 unsigned int bzs_consume_size(size_t size);
 
+// Compressor stream will be restarted with same allocator.
+bzs_ext_result_t bzs_restart_compressor(
+  bz_stream*       stream_ptr,
+  bzs_ext_option_t block_size,
+  bzs_ext_option_t verbosity,
+  bzs_ext_option_t work_factor);
+
+// Source may contain multiple concatenated streams.
+// Decompressor stream should be restarted after the end of each stream.
+bzs_ext_result_t bzs_restart_decompressor(bz_stream* stream_ptr, bzs_ext_option_t verbosity, bzs_ext_option_t small);
+
+// Source after the end of stream may contain trailing data (like zero padding) instead of next stream.
+// Decompressor is restarted only when remaining source starts with complete next stream header.
+// Other trailing data is ignored like bzip2 utility does.
+
+typedef struct
+{
+  bool           is_stream_end;
+  bool           is_finished;
+  bzs_ext_byte_t header[BZS_STREAM_HEADER_LENGTH];
+  size_t         header_length;
+} bzs_next_stream_t;
+
+void bzs_init_next_stream(bzs_next_stream_t* next_stream_ptr);
+
+// Function consumes source after the end of stream: next stream header or ignored trailing data.
+// Header can be received in multiple parts, decompressor will be restarted with complete header.
+bzs_ext_result_t bzs_find_next_stream(
+  bzs_next_stream_t*     next_stream_ptr,
+  bz_stream*             stream_ptr,
+  bzs_ext_option_t       verbosity,
+  bzs_ext_option_t       small,
+  const bzs_ext_byte_t** source_ptr,
+  size_t*                source_length_ptr);
+
+// Decompressor can process remaining source when it is not waiting for next stream.
+static inline bool bzs_is_next_stream_found(const bzs_next_stream_t* next_stream_ptr)
+{
+  return !next_stream_ptr->is_stream_end && !next_stream_ptr->is_finished;
+}
+
 #endif // BZS_EXT_UTILS_H
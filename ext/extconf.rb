@@ -4,6 +4,24 @@
 require "mkmf"
 
 have_func "rb_thread_call_without_gvl", "ruby/thread.h"
+have_func "memmem", "string.h"
+have_func "rb_ext_ractor_safe", "ruby.h"
+have_func "rb_io_descriptor", "ruby/io.h"
+
+abort "Can't find pthread_create function" unless have_func "pthread_create", "pthread.h"
+
+# Pool options are optional.
+have_func "pthread_attr_setaffinity_np", "pthread.h"
+have_func "sched_getaffinity", "sched.h"
+have_func "setpriority", "sys/resource.h"
+
+# Uring file backend is optional, it uses system calls directly without liburing.
+have_header("linux/io_uring.h") && have_const("__NR_io_uring_setup", "sys/syscall.h")
+
+# Page cache options are optional.
+have_func "fallocate", "fcntl.h"
+have_func "posix_fadvise", "fcntl.h"
+have_func "sync_file_range", "fcntl.h"
 
 def require_header(name, constants: [], types: [])
   abort "Can't find #{name} header" unless find_header name
@@ -65,12 +83,28 @@ dir_config extension_name
 $srcs = %w[
   stream/compressor
   stream/decompressor
+  allocator
+  block
   buffer
+  cache
+  crc
+  digest
   error
+  governor
+  index
   io
+  limit
+  line
   main
   option
+  parallel
+  pattern
+  pool
+  read_ahead
+  recompress
   string
+  tune
+  uring
   utils
 ]
 .map { |name| "src/#{extension_name}/#{name}.c" }
@@ -4,5 +4,7 @@
 # require_relative "bzs/stream/reader"
 # require_relative "bzs/stream/writer"
 # require_relative "bzs/file"
+require_relative "bzs/memory"
+require_relative "bzs/pool"
 require_relative "bzs/string"
 require_relative "bzs/version"
@@ -6,11 +6,13 @@ require "adsp"
 module BZS
   class BaseError < ::StandardError; end
 
-  class AllocateError < BaseError; end
+  class AllocateError     < BaseError; end
+  class MemoryBudgetError < AllocateError; end
 
   class NotEnoughSourceBufferError       < BaseError; end
   class NotEnoughDestinationBufferError  < BaseError; end
   class DecompressorCorruptedSourceError < BaseError; end
+  class DecompressorOutputLimitError     < BaseError; end
 
   class AccessIOError < BaseError; end
   class ReadIOError   < BaseError; end
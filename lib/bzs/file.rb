@@ -3,8 +3,10 @@
 
 require "adsp/file"
 require "bzs_ext"
+require "stringio"
 
 require_relative "option"
+require_relative "validation"
 
 module BZS
   # BZS::File class.
@@ -12,14 +14,378 @@ module BZS
     # Current option class.
     Option = BZS::Option
 
+    # Ractors can access only shareable constants.
+    ::Ractor.make_shareable BUFFER_LENGTH_NAMES if defined?(::Ractor)
+
+    # Regexp options are not supported by native pattern.
+    UNSUPPORTED_REGEXP_OPTIONS = ::Regexp::IGNORECASE | ::Regexp::EXTENDED | ::Regexp::MULTILINE
+
+    # Extension of archive.
+    EXTENSION = ".bz2".freeze
+
+    # Extension of index file.
+    INDEX_EXTENSION = ".idx".freeze
+
+    # Extension of checkpoint file.
+    CHECKPOINT_EXTENSION = ".ckpt".freeze
+
+    # Stream header: magic and block size digit.
+    HEADER_REGEXP = /\ABZh[1-9]/n.freeze
+
+    # End of stream magic (48 bits) is followed by stream CRC (32 bits) and padding to byte boundary (0 - 7 bits).
+    END_MAGIC      = 0x177245385090
+    MAGIC_MASK     = 0xffffffffffff
+    TRAILER_LENGTH = 11
+
     # Bypass native compress.
-    def self.native_compress_io(*args)
-      BZS._native_compress_io(*args)
+    # Index will be written near destination.
+    # Returns digests when +:digest+ option is enabled.
+    def self.native_compress_io(source_io, destination_io, options, &block)
+      result         = BZS._native_compress_io source_io, destination_io, options, &block
+      index, digests = options[:digest].nil? ? [result, nil] : result
+      ::File.binwrite "#{destination_io.path}#{INDEX_EXTENSION}", index unless index.nil?
+
+      digests
     end
 
     # Bypass native decompress.
+    # Returns digests when +:digest+ option is enabled.
     def self.native_decompress_io(*args)
       BZS._native_decompress_io(*args)
     end
+
+    # Compresses +source+ file into +destination+ file.
+    # Option: +:checkpoint+ finishes stream after each +checkpoint+ source bytes, syncs destination
+    # and writes offsets of source and destination into checkpoint file near destination.
+    # Option: +:resume+ truncates destination to last checkpoint and continues compression from its source offset.
+    # Returns digests of source and destination when +:digest+ option is enabled: {:source => hex, :destination => hex}.
+    def self.compress(source, destination, options = {})
+      Validation.validate_string source
+      Validation.validate_string destination
+
+      options = Option.get_compressor_options options, BUFFER_LENGTH_NAMES
+
+      checkpoint = options[:checkpoint]
+      return compress_with_checkpoints(source, destination, options) unless checkpoint.nil? || checkpoint.zero?
+
+      ::File.open source, "rb" do |source_io|
+        ::File.open destination, "wb" do |destination_io|
+          native_compress_io source_io, destination_io, options
+        end
+      end
+    end
+
+    # Compresses +source+ file into +destination+ file with checkpoints.
+    # Each member is an independent stream, so destination truncated to checkpoint remains a valid archive.
+    # Index and digests describe only source processed by current run.
+    def self.compress_with_checkpoints(source, destination, options)
+      checkpoint_path = "#{destination}#{CHECKPOINT_EXTENSION}"
+      offsets         = options[:resume] ? read_checkpoint(checkpoint_path) : nil
+
+      if offsets.nil?
+        # Checkpoint of previous compression doesn't match new destination.
+        ::File.delete checkpoint_path if ::File.exist? checkpoint_path
+      elsif options[:index]
+        raise ValidateError, "index can't be resumed"
+      end
+
+      source_offset, destination_offset = offsets || [0, 0]
+      destination_mode                  = offsets.nil? ? "wb" : "r+b"
+
+      digests = ::File.open source, "rb" do |source_io|
+        ::File.open destination, destination_mode do |destination_io|
+          unless offsets.nil?
+            if source_io.size < source_offset || destination_io.size < destination_offset
+              raise ValidateError, "checkpoint doesn't match files"
+            end
+
+            source_io.seek source_offset
+            destination_io.truncate destination_offset
+            destination_io.seek destination_offset
+          end
+
+          native_compress_io source_io, destination_io, options do |source_length, destination_length|
+            write_checkpoint checkpoint_path, source_offset + source_length, destination_offset + destination_length
+          end
+        end
+      end
+
+      # Whole source is compressed.
+      ::File.delete checkpoint_path if ::File.exist? checkpoint_path
+
+      digests
+    end
+
+    # Returns [source offset, destination offset] from checkpoint file or nil when there is no checkpoint.
+    def self.read_checkpoint(path)
+      return nil unless ::File.exist? path
+
+      offsets = ::File.read(path).split.map { |offset| Integer offset, :exception => false }
+      unless offsets.length == 2 && offsets.all? { |offset| offset.is_a?(::Integer) && offset >= 0 }
+        raise ValidateError, "invalid checkpoint"
+      end
+
+      offsets
+    end
+
+    # Writes checkpoint file atomically, previous checkpoint remains when write fails.
+    def self.write_checkpoint(path, source_offset, destination_offset)
+      temp_path = "#{path}.tmp"
+
+      ::File.open temp_path, "wb" do |io|
+        io.write "#{source_offset} #{destination_offset}\n"
+        io.fsync
+      end
+
+      ::File.rename temp_path, path
+    end
+
+    # Decompresses +source+ file into +destination+ file.
+    # Returns digests of source and destination when +:digest+ option is enabled: {:source => hex, :destination => hex}.
+    def self.decompress(source, destination, options = {})
+      Validation.validate_string source
+      Validation.validate_string destination
+
+      options = Option.get_decompressor_options options, BUFFER_LENGTH_NAMES
+
+      ::File.open source, "rb" do |source_io|
+        ::File.open destination, "wb" do |destination_io|
+          native_decompress_io source_io, destination_io, options
+        end
+      end
+    end
+
+    # Compresses +source_io+ into +destination_io+ natively.
+    # IO with file descriptor (file, pipe or socket) is processed without ruby buffers, descriptor can be nonblocking.
+    # Any other source should respond to +read+, any other destination should respond to +write+.
+    # Returns index when +:index+ option is enabled.
+    # Returns [index, digests] when +:digest+ option is enabled.
+    def self.compress_io(source_io, destination_io, options = {})
+      Validation.validate_io source_io
+      Validation.validate_io destination_io
+
+      options = Option.get_compressor_options options, BUFFER_LENGTH_NAMES
+
+      BZS._native_compress_io source_io, destination_io, options
+    end
+
+    # Decompresses +source_io+ into +destination_io+ natively.
+    # IO with file descriptor (file, pipe or socket) is processed without ruby buffers, descriptor can be nonblocking.
+    # Any other source should respond to +read+, any other destination should respond to +write+.
+    # Returns digests when +:digest+ option is enabled.
+    def self.decompress_io(source_io, destination_io, options = {})
+      Validation.validate_io source_io
+      Validation.validate_io destination_io
+
+      options = Option.get_decompressor_options options, BUFFER_LENGTH_NAMES
+
+      BZS._native_decompress_io source_io, destination_io, options
+    end
+
+    # Decompresses +source+ file and compresses it into +destination+ file with new +options+.
+    # Decompressed data is passed from decompressor to compressor natively without global VM lock.
+    # Index will be written near destination.
+    def self.recompress(source, destination, options = {})
+      Validation.validate_string source
+      Validation.validate_string destination
+
+      options = Option.get_recompressor_options options, BUFFER_LENGTH_NAMES
+
+      ::File.open source, "rb" do |source_io|
+        ::File.open destination, "wb" do |destination_io|
+          index = BZS._native_recompress_io source_io, destination_io, options
+          ::File.binwrite "#{destination}#{INDEX_EXTENSION}", index unless index.nil?
+        end
+      end
+
+      nil
+    end
+
+    # Compresses +source+ string or IO into new stream after existing +destination+ file.
+    # Existing streams are not read or recompressed, destination is created when it doesn't exist.
+    # Result is a multistream archive, it can be decompressed by any bzip2 decompressor.
+    # Option: +:validate_trailer+ checks header and end of stream marker of existing destination before append.
+    # Returns digests of appended source and stream when +:digest+ option is enabled.
+    def self.append(destination, source, options = {})
+      Validation.validate_string destination
+      Validation.validate_io source unless source.is_a?(::String)
+
+      options = Option.get_compressor_options options, BUFFER_LENGTH_NAMES
+      raise ValidateError, "index can't be appended" if options[:index]
+
+      source_io = source.is_a?(::String) ? ::StringIO.new(source) : source
+
+      open_append destination, options do |destination_io|
+        native_compress_io source_io, destination_io, options
+      end
+    end
+
+    # Opens +path+ for writing after existing data and yields file.
+    # Append mode is not used, so uring and preallocation can write at file offsets.
+    # Option: +:validate_trailer+ checks header and end of stream marker of existing data.
+    def self.open_append(path, options = {}, &_block)
+      Validation.validate_string path
+
+      ::File.open path, ::File::WRONLY | ::File::CREAT | ::File::BINARY do |io|
+        validate_trailer path if options[:validate_trailer]
+
+        io.seek 0, ::IO::SEEK_END
+        yield io
+      end
+    end
+
+    # Raises error when non empty +path+ doesn't start with stream header or doesn't end with end of stream marker.
+    # Only header and last bytes are read.
+    def self.validate_trailer(path)
+      size = ::File.size path
+      return if size.zero?
+
+      header, trailer = ::File.open path, "rb" do |io|
+        header = io.read 4
+        io.seek [size - TRAILER_LENGTH, 0].max
+
+        [header, io.read]
+      end
+
+      raise DecompressorCorruptedSourceError, "invalid header" unless HEADER_REGEXP.match? header
+
+      trailer_bits  = trailer.unpack1("H*").to_i 16
+      trailer_found = (0..7).any? do |padding|
+        trailer_bits & ((1 << padding) - 1) == 0 && ((trailer_bits >> (padding + 32)) & MAGIC_MASK) == END_MAGIC
+      end
+
+      raise DecompressorCorruptedSourceError, "invalid trailer" unless trailer_found
+    end
+
+    # Merges streams of +sources+ files into single stream of +destination+ file without recompression.
+    # Blocks are copied at bit granularity, stream CRC is combined from CRCs of blocks.
+    # Result can be read by decompressors without multistream support, header receives max block size of sources.
+    def self.merge(sources, destination, options = {})
+      raise ValidateError, "invalid sources" unless sources.is_a?(::Array)
+
+      sources.each { |source| Validation.validate_string source }
+      Validation.validate_string destination
+
+      options = Option.get_decompressor_options options, BUFFER_LENGTH_NAMES
+
+      ::File.open destination, "wb" do |destination_io|
+        BZS._native_merge_io sources, destination_io, options
+      end
+
+      nil
+    end
+
+    # Splits +source+ file at block boundaries into standalone archives without recompression.
+    # Source is scanned once, blocks are copied at bit granularity, stream CRC of each part is combined from its blocks.
+    # Parts are written near source: "data.bz2" is split into "data.00001.bz2", "data.00002.bz2" and so on.
+    # Option: +:parts+ max count of parts with roughly equal size.
+    # Option: +:size+ size of part, part is finished at first block boundary after this size.
+    # Returns paths of parts, parts written before error are not removed.
+    def self.split(source, options = {})
+      Validation.validate_string source
+      Validation.validate_hash options
+
+      parts = options[:parts]
+      size  = options[:size]
+      raise ValidateError, "parts or size is required" unless parts.nil? ^ size.nil?
+
+      Validation.validate_positive_integer parts unless parts.nil?
+      Validation.validate_positive_integer size unless size.nil?
+
+      options = Option.get_decompressor_options options, BUFFER_LENGTH_NAMES
+
+      ::File.open source, "rb" do |source_io|
+        BZS._native_split_io source_io, source.delete_suffix(EXTENSION), options
+      end
+    end
+
+    # Yields lines separated by +separator+ from decompressed +source+ file.
+    # Lines are found in native destination buffer without intermediate strings.
+    # Option: +:batch+ yields arrays with +batch+ lines, zero means single lines.
+    def self.each_line(source, separator = Option::DEFAULT_LINE_SEPARATOR, options = {}, &block)
+      Validation.validate_string source
+      Validation.validate_string separator
+
+      return enum_for(__method__, source, separator, options) unless block_given?
+
+      options = Option.get_decompressor_options options, BUFFER_LENGTH_NAMES
+
+      batch = options[:batch]
+      Validation.validate_not_negative_integer batch unless batch.nil?
+
+      ::File.open source, "rb" do |io|
+        BZS._native_each_line_io io, separator, options, &block
+      end
+
+      nil
+    end
+
+    # Searches +pattern+ in lines of decompressed +source+ file without global VM lock.
+    # Pattern is a string literal or regexp with "^", "$", ".", "*" and "\\" escapes only.
+    # Returns matching lines with their offsets in decompressed data: [[offset, line], ...].
+    def self.grep(source, pattern, options = {})
+      Validation.validate_string source
+
+      if pattern.is_a?(::Regexp)
+        raise ValidateError, "invalid pattern" unless (pattern.options & UNSUPPORTED_REGEXP_OPTIONS).zero?
+
+        pattern_source = pattern.source
+        is_regexp      = true
+      else
+        Validation.validate_string pattern
+
+        pattern_source = pattern
+        is_regexp      = false
+      end
+
+      options = Option.get_decompressor_options options, BUFFER_LENGTH_NAMES
+
+      ::File.open source, "rb" do |io|
+        BZS._native_grep_io io, pattern_source, is_regexp, options
+      end
+    end
+
+    # Compresses each source file into its destination file in native thread pool without global VM lock.
+    # +pairs+ is an array of [source, destination] paths or hash with sources as keys.
+    # Large source is split into chunks, each chunk is compressed as separate stream by any thread.
+    # Option: +:threads+ count of threads, zero means count of processors.
+    # Option: +:member_size+ count of source bytes for each chunk, zero means block size.
+    # Returns error for each pair or nil when pair was processed successfully.
+    def self.compress_many(pairs, options = {})
+      pairs   = get_pairs pairs
+      options = Option.get_compressor_options options, []
+
+      BZS._native_compress_many pairs, options
+    end
+
+    # Decompresses each source file into its destination file in native thread pool without global VM lock.
+    # +pairs+ is an array of [source, destination] paths or hash with sources as keys.
+    # Option: +:threads+ count of threads, zero means count of processors.
+    # Returns error for each pair or nil when pair was processed successfully.
+    def self.decompress_many(pairs, options = {})
+      pairs   = get_pairs pairs
+      options = Option.get_decompressor_options options, BUFFER_LENGTH_NAMES
+
+      threads = options[:threads]
+      Validation.validate_not_negative_integer threads unless threads.nil?
+
+      BZS._native_decompress_many pairs, options
+    end
+
+    # Returns validated array of [source, destination] +pairs+.
+    def self.get_pairs(pairs)
+      pairs = pairs.to_a if pairs.is_a?(::Hash)
+      raise ValidateError, "invalid pairs" unless pairs.is_a?(::Array)
+
+      pairs.each do |pair|
+        raise ValidateError, "invalid pair" unless pair.is_a?(::Array) && pair.length == 2
+
+        pair.each { |path| Validation.validate_string path }
+      end
+
+      pairs
+    end
+
+    private_class_method :get_pairs, :compress_with_checkpoints, :read_checkpoint, :write_checkpoint, :validate_trailer
   end
 end
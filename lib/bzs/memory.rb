@@ -0,0 +1,50 @@
+# Ruby bindings for bzip2 library.
+# Copyright (c) 2022 AUTHORS, MIT License.
+
+require "bzs_ext"
+
+require_relative "error"
+require_relative "validation"
+
+module BZS
+  # BZS::Memory module.
+  module Memory
+    # Policies for streams exceeding memory budget.
+    POLICIES = %i[wait downgrade raise].freeze
+
+    # Current memory defaults.
+    DEFAULTS = {
+      # Max size of memory reserved by streams, zero means unlimited.
+      :budget => 0,
+      # Policy for streams exceeding memory budget.
+      :policy => :wait
+    }
+    .freeze
+
+    # Ractors can access only shareable constants.
+    ::Ractor.make_shareable DEFAULTS if defined?(::Ractor)
+
+    # Configures process-wide memory budget for compressor and decompressor streams.
+    # Option: +:budget+ max size of memory reserved by streams, zero means unlimited.
+    # Option: +:policy+ +:wait+ queues new streams until memory will be released,
+    # +:downgrade+ switches new decompressors into small mode (compressors are waiting),
+    # +:raise+ raises +MemoryBudgetError+.
+    # Thread holding all reservations can't wait for itself, it receives +MemoryBudgetError+ instead.
+    def self.configure(options = {})
+      Validation.validate_hash options
+
+      options = DEFAULTS.merge options
+
+      Validation.validate_not_negative_integer options[:budget]
+      raise ValidateError, "invalid policy" unless POLICIES.include? options[:policy]
+
+      BZS._native_configure_memory options
+    end
+
+    # Returns current memory usage: budget, policy, size of memory allocated by bzip2 library,
+    # max allocated size, size of memory reserved by streams and count of streams.
+    def self.usage
+      BZS._native_memory_usage
+    end
+  end
+end
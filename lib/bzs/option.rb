@@ -12,27 +12,87 @@ module BZS
     # Current default buffer length.
     DEFAULT_BUFFER_LENGTH = 0
 
+    # Current default line separator.
+    DEFAULT_LINE_SEPARATOR = "\n".freeze
+
+    # Goals supported by tuner.
+    TUNE_GOALS = %i[ratio speed latency].freeze
+
+    # Algorithms supported by digests.
+    DIGESTS = %i[sha256 xxh64].freeze
+
+    # Current tuner defaults.
+    TUNE_DEFAULTS = {
+      # Enables global VM lock where possible.
+      :gvl        => false,
+      # Disables bzip2 library logging.
+      :quiet      => nil,
+      # Measurement to be optimized: ratio, speed or latency.
+      :goal       => :ratio,
+      # Max size of memory used by compressor, nil means unlimited.
+      :budget     => nil,
+      # Key of cached decision, nil disables cache.
+      :data_class => nil
+    }
+    .freeze
+
     # Current compressor defaults.
     COMPRESSOR_DEFAULTS = {
       # Enables global VM lock where possible.
-      :gvl         => false,
+      :gvl              => false,
       # Block size to be used for compression.
-      :block_size  => nil,
+      :block_size       => nil,
       # Controls threshold for switching from standard to fallback algorithm.
-      :work_factor => nil,
+      :work_factor      => nil,
       # Disables bzip2 library logging.
-      :quiet       => nil
+      :quiet            => nil,
+      # Count of threads to be used for compression, zero means count of processors.
+      :threads          => nil,
+      # Enables index of stream and block boundaries.
+      :index            => nil,
+      # Count of source bytes for each stream, zero means single stream.
+      :member_size      => nil,
+      # Count of source buffers to be read ahead by io_uring for +File+, zero disables uring.
+      :uring            => nil,
+      # Releases page cache of source and destination behind processed position for +File+.
+      :drop_cache       => nil,
+      # Size of destination to be preallocated for +File+, zero disables preallocation.
+      :preallocate      => nil,
+      # Algorithm of source and destination digests: sha256 or xxh64, nil disables digests.
+      :digest           => nil,
+      # Count of source bytes between checkpoints for +File+, zero disables checkpoints.
+      :checkpoint       => nil,
+      # Continues compression of +File+ from last checkpoint.
+      :resume           => nil,
+      # Checks header and end of stream marker of existing archive before append.
+      :validate_trailer => nil
     }
     .freeze
 
     # Current decompressor defaults.
     DECOMPRESSOR_DEFAULTS = {
       # Enables global VM lock where possible.
-      :gvl   => false,
+      :gvl             => false,
       # Enables alternative decompression algorithm with less memory.
-      :small => nil,
+      :small           => nil,
       # Disables bzip2 library logging.
-      :quiet => nil
+      :quiet           => nil,
+      # Count of destination buffers to be decompressed ahead in background thread, zero disables read ahead.
+      :read_ahead      => nil,
+      # Max size of decompressed destination, zero means unlimited.
+      :max_output_size => nil,
+      # Max size of decompressed destination per byte of source, zero means unlimited.
+      :max_ratio       => nil,
+      # Max size of decompressed prefix, zero means whole destination.
+      :limit           => nil,
+      # Count of source buffers to be read ahead by io_uring for +File+, zero disables uring.
+      :uring           => nil,
+      # Releases page cache of source and destination behind processed position for +File+.
+      :drop_cache      => nil,
+      # Size of destination to be preallocated for +File+, zero disables preallocation.
+      :preallocate     => nil,
+      # Algorithm of source and destination digests: sha256 or xxh64, nil disables digests.
+      :digest          => nil
     }
     .freeze
 
@@ -43,6 +103,16 @@ module BZS
     # Option: +:block_size+ block size to be used for compression.
     # Option: +:work_factor+ controls threshold for switching from standard to fallback algorithm.
     # Option: +:quiet+ disables bzip2 library logging.
+    # Option: +:threads+ count of threads to be used for compression, zero means count of processors.
+    # Option: +:index+ enables index of stream and block boundaries.
+    # Option: +:member_size+ count of source bytes for each stream, zero means single stream.
+    # Option: +:uring+ count of source buffers to be read ahead by io_uring for +File+.
+    # Option: +:drop_cache+ releases page cache of source and destination behind processed position for +File+.
+    # Option: +:preallocate+ size of destination to be preallocated for +File+.
+    # Option: +:digest+ algorithm of source and destination digests: +:sha256+ or +:xxh64+.
+    # Option: +:checkpoint+ count of source bytes between checkpoints for +File+.
+    # Option: +:resume+ continues compression of +File+ from last checkpoint.
+    # Option: +:validate_trailer+ checks header and end of stream marker of existing archive before append.
     # Returns processed compressor options.
     def self.get_compressor_options(options, buffer_length_names)
       Validation.validate_hash options
@@ -66,6 +136,36 @@ module BZS
       quiet = options[:quiet]
       Validation.validate_bool quiet unless quiet.nil?
 
+      threads = options[:threads]
+      Validation.validate_not_negative_integer threads unless threads.nil?
+
+      index = options[:index]
+      Validation.validate_bool index unless index.nil?
+
+      member_size = options[:member_size]
+      Validation.validate_not_negative_integer member_size unless member_size.nil?
+
+      uring = options[:uring]
+      Validation.validate_not_negative_integer uring unless uring.nil?
+
+      drop_cache = options[:drop_cache]
+      Validation.validate_bool drop_cache unless drop_cache.nil?
+
+      preallocate = options[:preallocate]
+      Validation.validate_not_negative_integer preallocate unless preallocate.nil?
+
+      digest = options[:digest]
+      raise ValidateError, "invalid digest" unless digest.nil? || DIGESTS.include?(digest)
+
+      checkpoint = options[:checkpoint]
+      Validation.validate_not_negative_integer checkpoint unless checkpoint.nil?
+
+      resume = options[:resume]
+      Validation.validate_bool resume unless resume.nil?
+
+      validate_trailer = options[:validate_trailer]
+      Validation.validate_bool validate_trailer unless validate_trailer.nil?
+
       options
     end
 
@@ -75,6 +175,14 @@ module BZS
     # Option: +:gvl+ enables global VM lock where possible.
     # Option: +:small+ enables alternative decompression algorithm with less memory.
     # Option: +:quiet+ disables bzip2 library logging.
+    # Option: +:read_ahead+ count of destination buffers to be decompressed ahead in background thread.
+    # Option: +:max_output_size+ max size of decompressed destination.
+    # Option: +:max_ratio+ max size of decompressed destination per byte of source.
+    # Option: +:limit+ max size of decompressed prefix for +String+ and +File+.
+    # Option: +:uring+ count of source buffers to be read ahead by io_uring for +File+.
+    # Option: +:drop_cache+ releases page cache of source and destination behind processed position for +File+.
+    # Option: +:preallocate+ size of destination to be preallocated for +File+.
+    # Option: +:digest+ algorithm of source and destination digests: +:sha256+ or +:xxh64+.
     # Returns processed decompressor options.
     def self.get_decompressor_options(options, buffer_length_names)
       Validation.validate_hash options
@@ -95,7 +203,130 @@ module BZS
       quiet = options[:quiet]
       Validation.validate_bool quiet unless quiet.nil?
 
+      read_ahead = options[:read_ahead]
+      Validation.validate_not_negative_integer read_ahead unless read_ahead.nil?
+
+      max_output_size = options[:max_output_size]
+      Validation.validate_not_negative_integer max_output_size unless max_output_size.nil?
+
+      max_ratio = options[:max_ratio]
+      Validation.validate_not_negative_integer max_ratio unless max_ratio.nil?
+
+      limit = options[:limit]
+      Validation.validate_not_negative_integer limit unless limit.nil?
+
+      uring = options[:uring]
+      Validation.validate_not_negative_integer uring unless uring.nil?
+
+      drop_cache = options[:drop_cache]
+      Validation.validate_bool drop_cache unless drop_cache.nil?
+
+      preallocate = options[:preallocate]
+      Validation.validate_not_negative_integer preallocate unless preallocate.nil?
+
+      digest = options[:digest]
+      raise ValidateError, "invalid digest" unless digest.nil? || DIGESTS.include?(digest)
+
       options
     end
+
+    # Compresses +sample+ natively with each candidate of block size and work factor.
+    # Option: +:gvl+ enables global VM lock where possible.
+    # Option: +:quiet+ disables bzip2 library logging.
+    # Option: +:goal+ +:ratio+ selects smallest output, +:speed+ - fastest compression,
+    # +:latency+ - fastest first output.
+    # Option: +:budget+ max size of memory used by compressor.
+    # Option: +:data_class+ caches decision for similar data, next calls with same class won't compress sample.
+    # Returns compressor options with best block size and work factor.
+    def self.tune(sample, options = {})
+      Validation.validate_string sample
+      Validation.validate_hash options
+
+      options = TUNE_DEFAULTS.merge options
+
+      Validation.validate_bool options[:gvl]
+
+      quiet = options[:quiet]
+      Validation.validate_bool quiet unless quiet.nil?
+
+      goal = options[:goal]
+      raise ValidateError, "invalid goal" unless TUNE_GOALS.include? goal
+
+      budget = options[:budget]
+      Validation.validate_not_negative_integer budget unless budget.nil?
+
+      data_class = options[:data_class]
+      return tune_sample(sample, options) if data_class.nil?
+
+      key = [data_class, goal, budget]
+
+      cached_options = synchronize_tune_cache { |cache| cache[key] }
+      return cached_options.dup unless cached_options.nil?
+
+      tuned_options = tune_sample sample, options
+      synchronize_tune_cache { |cache| cache[key] = tuned_options.freeze }
+
+      tuned_options.dup
+    end
+
+    # Removes decisions cached by tuner in current ractor.
+    def self.clear_tune_cache
+      synchronize_tune_cache(&:clear)
+
+      nil
+    end
+
+    @tune_cache       = {}
+    @tune_cache_mutex = ::Mutex.new
+
+    # Yields tuner cache, non main ractor can't access module variables, so it has its own cache.
+    def self.synchronize_tune_cache(&block)
+      if !defined?(::Ractor) || ::Ractor.current == ::Ractor.main
+        return @tune_cache_mutex.synchronize { block.call @tune_cache }
+      end
+
+      ractor = ::Ractor.current
+      ractor[:bzs_tune_cache_mutex] ||= ::Mutex.new
+      ractor[:bzs_tune_cache_mutex].synchronize { block.call(ractor[:bzs_tune_cache] ||= {}) }
+    end
+
+    # Selects best measurement of +sample+ for processed tuner +options+.
+    # Smaller memory is preferred for equal measurements.
+    def self.tune_sample(sample, options)
+      measurements = BZS._native_tune_options sample, options
+
+      budget = options[:budget]
+      measurements.select! { |measurement| measurement[:memory] <= budget } unless budget.nil?
+      raise ValidateError, "budget is too small" if measurements.empty?
+
+      metric = {
+        :ratio   => :destination_length,
+        :speed   => :time,
+        :latency => :latency
+      }
+      .fetch options[:goal]
+
+      best_measurement = measurements.min_by do |measurement|
+        [measurement[metric], measurement[:memory], measurement[:time]]
+      end
+
+      {
+        :block_size  => best_measurement[:block_size],
+        :work_factor => best_measurement[:work_factor]
+      }
+    end
+
+    private_class_method :tune_sample, :synchronize_tune_cache
+
+    # Ractors can access only shareable constants.
+    ::Ractor.make_shareable [TUNE_DEFAULTS, COMPRESSOR_DEFAULTS, DECOMPRESSOR_DEFAULTS] if defined?(::Ractor)
+
+    # Processes recompressor +options+ and +buffer_length_names+.
+    # Recompressor accepts both compressor and decompressor options.
+    # Returns processed recompressor options.
+    def self.get_recompressor_options(options, buffer_length_names)
+      options = get_compressor_options options, buffer_length_names
+      get_decompressor_options options, buffer_length_names
+    end
   end
 end
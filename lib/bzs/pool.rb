@@ -0,0 +1,64 @@
+# Ruby bindings for bzip2 library.
+# Copyright (c) 2022 AUTHORS, MIT License.
+
+require "bzs_ext"
+
+require_relative "error"
+require_relative "validation"
+
+module BZS
+  # BZS::Pool module.
+  module Pool
+    # Range of nice values.
+    NICE_RANGE = (-20..19).freeze
+
+    # Current pool defaults.
+    DEFAULTS = {
+      # Count of pool workers, zero means count of processors available for process.
+      :threads  => 0,
+      # Array of processor indexes for workers, nil means all processors.
+      :affinity => nil,
+      # Nice value for workers, nil means process priority.
+      :nice     => nil
+    }
+    .freeze
+
+    # Ractors can access only shareable constants.
+    ::Ractor.make_shareable DEFAULTS if defined?(::Ractor)
+
+    def self.validate_options(options)
+      Validation.validate_hash options
+
+      options = DEFAULTS.merge options
+
+      Validation.validate_not_negative_integer options[:threads]
+
+      affinity = options[:affinity]
+      unless affinity.nil?
+        Validation.validate_array affinity
+        raise ValidateError, "invalid affinity" if affinity.empty?
+
+        affinity.each { |processor| Validation.validate_not_negative_integer processor }
+      end
+
+      nice = options[:nice]
+      unless nice.nil?
+        Validation.validate_integer nice
+        raise ValidateError, "invalid nice" unless NICE_RANGE.cover? nice
+      end
+
+      options
+    end
+  end
+
+  # Configures process-wide pool used by parallel compression.
+  # Option: +:threads+ count of pool workers, zero means count of processors available for process.
+  # Option: +:affinity+ array of processor indexes, workers will run only on these processors.
+  # Option: +:nice+ nice value for workers, positive value lowers priority of compression.
+  # Current work will be finished in previous pool, new work will be processed in new pool.
+  def self.configure(options = {})
+    options = Pool.validate_options options
+
+    _native_configure_pool options
+  end
+end
@@ -16,6 +16,16 @@ module BZS
 
         # Current option class.
         Option = BZS::Option
+
+        # Returns index of stream and block boundaries, it is available after close.
+        def index
+          @native_stream.index
+        end
+
+        # Returns digests of source and destination when +:digest+ option is enabled, it is available after close.
+        def digests
+          @native_stream.digests
+        end
       end
     end
   end
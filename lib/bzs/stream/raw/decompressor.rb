@@ -5,6 +5,7 @@ require "adsp/stream/raw/decompressor"
 require "bzs_ext"
 
 require_relative "../../option"
+require_relative "../../validation"
 
 module BZS
   module Stream
@@ -16,6 +17,64 @@ module BZS
 
         # Current option class.
         Option = BZS::Option
+
+        # Reads +source+ and writes lines separated by +separator+ using +writer+.
+        # Lines are found in native destination buffer, incomplete line waits for next source.
+        # Returns amount of bytes read from +source+.
+        def read_lines(source, separator, &writer)
+          do_not_use_after_close
+
+          Validation.validate_string source
+          Validation.validate_string separator
+          Validation.validate_proc writer
+
+          total_bytes_read = 0
+
+          loop do
+            bytes_read, need_more_destination  = @native_stream.read source
+            total_bytes_read                  += bytes_read
+
+            writer.call @native_stream.read_lines(separator, false)
+            break unless need_more_destination
+
+            source = source.byteslice bytes_read, source.bytesize - bytes_read
+          end
+
+          total_bytes_read
+        end
+
+        # Flushes decompressed data and writes remaining lines separated by +separator+ using +writer+.
+        # Last line may not contain separator.
+        def flush_lines(separator, &writer)
+          do_not_use_after_close
+
+          Validation.validate_string separator
+          Validation.validate_proc writer
+
+          @native_stream.flush
+          writer.call @native_stream.read_lines(separator, true)
+
+          nil
+        end
+
+        # Returns digests of source and destination when +:digest+ option is enabled, it is available after close.
+        def digests
+          @native_stream.digests
+        end
+
+        # Flushes decompressed data, waits for read ahead worker to decompress all provided source.
+        def flush(&writer)
+          @native_stream.flush unless closed?
+
+          super
+        end
+
+        # Writes remaining decompressed data and closes decompressor.
+        def close(&writer)
+          @native_stream.flush unless closed?
+
+          super
+        end
       end
     end
   end
@@ -4,6 +4,8 @@
 require "adsp/stream/reader"
 
 require_relative "raw/decompressor"
+require_relative "../option"
+require_relative "../validation"
 
 module BZS
   module Stream
@@ -11,6 +13,72 @@ module BZS
     class Reader < ADSP::Stream::Reader
       # Current raw stream class.
       RawDecompressor = Raw::Decompressor
+
+      # Returns digests of consumed source and decompressed destination, it is available after close.
+      def digests
+        @raw_stream.digests
+      end
+
+      # Yields lines separated by +separator+, lines are found in native destination buffer.
+      # Option: +:batch+ yields arrays with +batch+ lines, zero means single lines.
+      def each_line_fast(separator = Option::DEFAULT_LINE_SEPARATOR, options = {}, &block)
+        Validation.validate_string separator
+        Validation.validate_hash options
+
+        return enum_for(__method__, separator, options) unless block_given?
+
+        batch = options[:batch]
+        Validation.validate_not_negative_integer batch unless batch.nil?
+
+        lines = []
+
+        # Data decompressed by previous reads should be provided before native lines.
+        line_prefix = take_buffered_lines lines, separator
+
+        writer = proc do |new_lines|
+          unless line_prefix.nil? || new_lines.empty?
+            # Separator can be started in prefix.
+            new_lines[0, 1] = (line_prefix + new_lines.first).each_line(separator).to_a
+            line_prefix     = nil
+          end
+
+          lines.concat new_lines
+          yield_lines lines, batch, false, &block
+        end
+
+        until @io.eof?
+          io_portion    = @io_remainder + @io.read(@source_buffer_length)
+          bytes_read    = @raw_stream.read_lines io_portion, separator, &writer
+          @io_remainder = io_portion.byteslice bytes_read, io_portion.bytesize - bytes_read
+        end
+
+        @raw_stream.flush_lines separator, &writer
+
+        lines << line_prefix unless line_prefix.nil?
+        yield_lines lines, batch, true, &block
+
+        nil
+      end
+
+      protected def take_buffered_lines(lines, separator)
+        raise ValidateError, "invalid separator" if separator.empty?
+
+        lines.concat @buffer.each_line(separator).to_a
+        @buffer = ::String.new :encoding => ::Encoding::BINARY
+
+        lines.empty? || lines.last.end_with?(separator) ? nil : lines.pop
+      end
+
+      protected def yield_lines(lines, batch, is_finished, &block)
+        if batch.nil? || batch.zero?
+          lines.each(&block)
+          lines.clear
+          return
+        end
+
+        yield lines.shift(batch) while lines.length >= batch
+        yield lines.shift(batch) if is_finished && !lines.empty?
+      end
     end
   end
 end
@@ -4,6 +4,8 @@
 require "adsp/stream/writer"
 
 require_relative "raw/compressor"
+require_relative "../file"
+require_relative "../validation"
 
 module BZS
   module Stream
@@ -11,6 +13,39 @@ module BZS
     class Writer < ADSP::Stream::Writer
       # Current raw stream class.
       RawCompressor = Raw::Compressor
+
+      # Opens +file_path+ and yields writer, writer will be closed after block.
+      # Option: +:mode+ +:append+ writes new stream after existing archive instead of truncating it.
+      def self.open(file_path, options = {}, *args, &block)
+        mode = options[:mode] if options.is_a?(::Hash)
+        return super if mode.nil?
+
+        raise ValidateError, "invalid mode" unless mode == :append
+
+        Validation.validate_proc block
+
+        options = options.reject { |key, _value| key == :mode }
+
+        File.open_append file_path, options do |io|
+          writer = new io, options, *args
+
+          begin
+            yield writer
+          ensure
+            writer.close
+          end
+        end
+      end
+
+      # Returns index of stream and block boundaries, it is available after close.
+      def index
+        @raw_stream.index
+      end
+
+      # Returns digests of written source and compressed destination, it is available after close.
+      def digests
+        @raw_stream.digests
+      end
     end
   end
 end
@@ -5,6 +5,7 @@ require "adsp/string"
 require "bzs_ext"
 
 require_relative "option"
+require_relative "validation"
 
 module BZS
   # BZS::String class.
@@ -12,14 +13,44 @@ module BZS
     # Current option class.
     Option = BZS::Option
 
+    # Ractors can access only shareable constants.
+    ::Ractor.make_shareable BUFFER_LENGTH_NAMES if defined?(::Ractor)
+
     # Bypasses native compress.
+    # Returns [destination, digests] when +:digest+ option is enabled.
     def self.native_compress_string(*args)
       BZS._native_compress_string(*args)
     end
 
     # Bypasses native decompress.
+    # Returns [destination, digests] when +:digest+ option is enabled.
     def self.native_decompress_string(*args)
       BZS._native_decompress_string(*args)
     end
+
+    # Yields chunks of decompressed +source+ string, each chunk is a filled destination buffer.
+    # Source is decompressed lazily, stream is released as soon as iteration is finished or broken.
+    # Option: +:limit+ max size of decompressed prefix.
+    def self.each_chunk(source, options = {}, &block)
+      Validation.validate_string source
+
+      return enum_for(__method__, source, options) unless block_given?
+
+      options = Option.get_decompressor_options options, BUFFER_LENGTH_NAMES
+
+      BZS._native_each_chunk_string source, options, &block
+
+      nil
+    end
+
+    # Decompresses +source+ string and compresses it with new +options+.
+    # Decompressed data is passed from decompressor to compressor natively without global VM lock.
+    def self.recompress(source, options = {})
+      Validation.validate_string source
+
+      options = Option.get_recompressor_options options, BUFFER_LENGTH_NAMES
+
+      BZS._native_recompress_string source, options
+    end
   end
 end
@@ -97,6 +97,15 @@ module BZS
         parallel producer, &block
       end
 
+      # Index record contains type, uncompressed offset and compressed bit offset.
+      INDEX_RECORD_FORMAT = "aQ<Q<".freeze
+      INDEX_RECORD_LENGTH = 17
+
+      def self.parse_index(index)
+        records_count = index.bytesize / INDEX_RECORD_LENGTH
+        index.unpack(INDEX_RECORD_FORMAT * records_count).each_slice(3).to_a
+      end
+
       def self.file_can_be_used_nonblock?
         ::File.open(::Tempfile.new, "w") do |file|
           file.write_nonblock "text"
@@ -3,7 +3,12 @@
 
 require "adsp/test/file"
 require "bzs/file"
+require "bzs/string"
+require "digest"
+require "socket"
+require "stringio"
 
+require_relative "common"
 require_relative "minitest"
 require_relative "option"
 
@@ -12,6 +17,349 @@ module BZS
     class File < ADSP::Test::File
       Target = BZS::File
       Option = BZS::Test::Option
+
+      def test_index
+        Common::LARGE_TEXTS.each do |text|
+          ::File.write Common::SOURCE_PATH, text, :mode => "wb"
+          Target.compress Common::SOURCE_PATH, Common::ARCHIVE_PATH, :index => true
+
+          index_path = "#{Common::ARCHIVE_PATH}#{Target::INDEX_EXTENSION}"
+          records    = Common.parse_index ::File.read(index_path, :mode => "rb")
+
+          assert_equal ["S", 0, 0], records.first
+          assert_equal ["E", text.bytesize], records.last.take(2)
+        end
+      end
+
+      def test_trailing_data
+        compressed_text = String.compress("1111") + String.compress("2222")
+
+        ["\0" * 1000, "garbage", "BZ"].each do |trailing_data|
+          ::File.write Common::ARCHIVE_PATH, compressed_text + trailing_data, :mode => "wb"
+
+          [{}, { :source_buffer_length => 1 << 2 }, { :uring => 1 }].each do |options|
+            Target.decompress Common::ARCHIVE_PATH, Common::SOURCE_PATH, options
+            assert_equal "11112222", ::File.read(Common::SOURCE_PATH, :mode => "rb")
+          end
+        end
+      end
+
+      def test_output_limit
+        text = "\0" * (1 << 20)
+        ::File.write Common::ARCHIVE_PATH, String.compress(text), :mode => "wb"
+
+        Target.decompress Common::ARCHIVE_PATH, Common::SOURCE_PATH, :max_output_size => text.bytesize
+        assert_equal text, ::File.read(Common::SOURCE_PATH, :mode => "rb")
+
+        [{ :max_output_size => 1000 }, { :max_ratio => 10 }].each do |options|
+          assert_raises DecompressorOutputLimitError do
+            Target.decompress Common::ARCHIVE_PATH, Common::SOURCE_PATH, options
+          end
+
+          # Destination above limit is not written.
+          assert_operator ::File.size(Common::SOURCE_PATH), :<=, 1000 if options.key? :max_output_size
+        end
+      end
+
+      def test_limit
+        Common::LARGE_TEXTS.each do |text|
+          ::File.write Common::ARCHIVE_PATH, String.compress(text), :mode => "wb"
+
+          [1, 1000, text.bytesize + 1].each do |limit|
+            Target.decompress Common::ARCHIVE_PATH, Common::SOURCE_PATH, :limit => limit
+            assert_equal text.b.byteslice(0, limit), ::File.read(Common::SOURCE_PATH, :mode => "rb")
+          end
+        end
+      end
+
+      def test_uring
+        Common::LARGE_TEXTS.each do |text|
+          ::File.write Common::SOURCE_PATH, text, :mode => "wb"
+
+          [1, 4].each do |uring|
+            options = { :uring => uring, :source_buffer_length => 1 << 12, :destination_buffer_length => 1 << 12 }
+
+            Target.compress Common::SOURCE_PATH, Common::ARCHIVE_PATH, options
+            Target.decompress Common::ARCHIVE_PATH, Common::SOURCE_PATH, options
+
+            decompressed_text = ::File.read Common::SOURCE_PATH, :mode => "rb"
+            decompressed_text.force_encoding text.encoding
+
+            assert_equal text, decompressed_text
+          end
+        end
+      end
+
+      def test_cache
+        Common::LARGE_TEXTS.each do |text|
+          ::File.write Common::SOURCE_PATH, text, :mode => "wb"
+
+          [0, text.bytesize * 2].each do |preallocate|
+            options = { :drop_cache => true, :preallocate => preallocate }
+
+            Target.compress Common::SOURCE_PATH, Common::ARCHIVE_PATH, options
+            Target.decompress Common::ARCHIVE_PATH, Common::SOURCE_PATH, options
+
+            # Preallocated space is truncated.
+            assert_equal text.bytesize, ::File.size(Common::SOURCE_PATH)
+
+            decompressed_text = ::File.read Common::SOURCE_PATH, :mode => "rb"
+            decompressed_text.force_encoding text.encoding
+
+            assert_equal text, decompressed_text
+          end
+        end
+      end
+
+      def test_digest
+        Common::LARGE_TEXTS.each do |text|
+          ::File.write Common::SOURCE_PATH, text, :mode => "wb"
+
+          [0, 4].each do |uring|
+            options = { :digest => :sha256, :uring => uring }
+
+            digests = Target.compress Common::SOURCE_PATH, Common::ARCHIVE_PATH, options
+            assert_equal ::Digest::SHA256.file(Common::SOURCE_PATH).hexdigest, digests[:source]
+            assert_equal ::Digest::SHA256.file(Common::ARCHIVE_PATH).hexdigest, digests[:destination]
+
+            decompressed_digests = Target.decompress Common::ARCHIVE_PATH, Common::SOURCE_PATH, options
+            assert_equal digests[:source], decompressed_digests[:destination]
+            assert_equal digests[:destination], decompressed_digests[:source]
+          end
+
+          assert_nil Target.compress(Common::SOURCE_PATH, Common::ARCHIVE_PATH)
+        end
+      end
+
+      def test_checkpoint
+        checkpoint_path = "#{Common::ARCHIVE_PATH}#{Target::CHECKPOINT_EXTENSION}"
+
+        Common::LARGE_TEXTS.each do |text|
+          ::File.write Common::SOURCE_PATH, text, :mode => "wb"
+          Target.compress Common::SOURCE_PATH, Common::ARCHIVE_PATH, :checkpoint => 1 << 16
+          refute ::File.exist?(checkpoint_path)
+
+          # Previous compression was interrupted after first checkpoint and left partial member.
+          source_offset = [text.bytesize, 1 << 16].min
+          archive       = String.compress text.b.byteslice(0, source_offset)
+          ::File.write Common::ARCHIVE_PATH, "#{archive}partial member", :mode => "wb"
+          ::File.write checkpoint_path, "#{source_offset} #{archive.bytesize}\n", :mode => "wb"
+
+          Target.compress Common::SOURCE_PATH, Common::ARCHIVE_PATH, :checkpoint => 1 << 16, :resume => true
+          refute ::File.exist?(checkpoint_path)
+
+          decompressed_text = String.decompress ::File.read(Common::ARCHIVE_PATH, :mode => "rb")
+          decompressed_text.force_encoding text.encoding
+
+          assert_equal text, decompressed_text
+        end
+
+        ::File.write checkpoint_path, "invalid", :mode => "wb"
+
+        assert_raises ValidateError do
+          Target.compress Common::SOURCE_PATH, Common::ARCHIVE_PATH, :checkpoint => 1 << 16, :resume => true
+        end
+      ensure
+        ::File.delete checkpoint_path if ::File.exist? checkpoint_path
+      end
+
+      def test_append
+        Common::LARGE_TEXTS.each do |text|
+          ::File.delete Common::ARCHIVE_PATH if ::File.exist? Common::ARCHIVE_PATH
+          Target.append Common::ARCHIVE_PATH, text
+
+          ::File.write Common::SOURCE_PATH, text, :mode => "wb"
+
+          ::File.open Common::SOURCE_PATH, "rb" do |source_io|
+            Target.append Common::ARCHIVE_PATH, source_io, :validate_trailer => true
+          end
+
+          decompressed_text = String.decompress ::File.read(Common::ARCHIVE_PATH, :mode => "rb")
+          decompressed_text.force_encoding text.encoding
+
+          assert_equal text * 2, decompressed_text
+        end
+
+        ::File.write Common::ARCHIVE_PATH, "invalid archive", :mode => "wb"
+
+        assert_raises DecompressorCorruptedSourceError do
+          Target.append Common::ARCHIVE_PATH, "", :validate_trailer => true
+        end
+      end
+
+      def test_merge
+        sources = Common::LARGE_TEXTS.map.with_index do |text, index|
+          path = "#{Common::ARCHIVE_PATH}.#{index}"
+          ::File.write path, String.compress(text, :block_size => index % 9 + 1), :mode => "wb"
+
+          path
+        end
+
+        Target.merge sources, Common::NATIVE_ARCHIVE_PATH
+        archive = ::File.read Common::NATIVE_ARCHIVE_PATH, :mode => "rb"
+
+        # Single stream with max block size.
+        assert_equal "BZh#{[Common::LARGE_TEXTS.length, 9].min}", archive.byteslice(0, 4)
+        assert_equal 1, archive.scan(/BZh[1-9]\x31\x41\x59\x26\x53\x59/n).length
+
+        text              = Common::LARGE_TEXTS.map(&:b).join
+        decompressed_text = String.decompress archive
+        assert_equal text, decompressed_text.b
+      ensure
+        sources&.each { |path| ::File.delete path if ::File.exist? path }
+      end
+
+      def test_split
+        Common::LARGE_TEXTS.each do |text|
+          ::File.write Common::ARCHIVE_PATH, String.compress(text, :block_size => 1), :mode => "wb"
+
+          [{ :parts => 3 }, { :size => 1 << 16 }].each do |options|
+            paths = Target.split Common::ARCHIVE_PATH, options
+            assert_operator paths.length, :<=, options[:parts] if options.key? :parts
+
+            begin
+              # Each part is a standalone archive.
+              decompressed_text = paths.map { |path| String.decompress ::File.read(path, :mode => "rb") }.join
+              decompressed_text.force_encoding text.encoding
+
+              assert_equal text, decompressed_text
+            ensure
+              paths.each { |path| ::File.delete path }
+            end
+          end
+        end
+
+        assert_raises ValidateError do
+          Target.split Common::ARCHIVE_PATH, :parts => 2, :size => 1
+        end
+      end
+
+      def test_split_streams
+        generator = ::Random.new 0
+        texts     = [1, 5, 9].map { |block_size| [generator.bytes(250_000), block_size] }
+        archive   = texts.map { |text, block_size| String.compress text, :block_size => block_size }.join
+        ::File.write Common::ARCHIVE_PATH, archive, :mode => "wb"
+
+        text = texts.map(&:first).join
+
+        # Streams with growing block sizes shouldn't increase count of parts.
+        { 1 => ["BZh9"], 3 => %w[BZh1 BZh5 BZh9] }.each do |parts, headers|
+          paths = Target.split Common::ARCHIVE_PATH, :parts => parts
+
+          begin
+            assert_equal headers, (paths.map { |path| ::File.read path, 4, :mode => "rb" })
+
+            decompressed_text = paths.map { |path| String.decompress ::File.read(path, :mode => "rb") }.join
+            assert_equal text, decompressed_text
+          ensure
+            paths.each { |path| ::File.delete path }
+          end
+        end
+      end
+
+      def test_recompress
+        Common::LARGE_TEXTS.each do |text|
+          ::File.write Common::SOURCE_PATH, String.compress(text), :mode => "wb"
+          Target.recompress Common::SOURCE_PATH, Common::ARCHIVE_PATH, :block_size => 1, :member_size => 1 << 20
+
+          decompressed_text = String.decompress ::File.read(Common::ARCHIVE_PATH, :mode => "rb")
+          decompressed_text.force_encoding text.encoding
+
+          assert_equal text, decompressed_text
+        end
+      end
+
+      def test_each_line
+        Common::LARGE_TEXTS.each do |text|
+          ::File.write Common::ARCHIVE_PATH, String.compress(text), :mode => "wb"
+
+          lines = Target.each_line(Common::ARCHIVE_PATH, "\n", :destination_buffer_length => 1 << 10).to_a
+          assert_equal text.b.each_line("\n").to_a, lines
+
+          batches = Target.each_line(Common::ARCHIVE_PATH, "\n", :batch => 3).to_a
+          assert(batches.all? { |batch| batch.length <= 3 })
+          assert_equal lines, batches.flatten
+        end
+      end
+
+      def test_grep
+        Common::LARGE_TEXTS.each do |text|
+          ::File.write Common::ARCHIVE_PATH, String.compress(text), :mode => "wb"
+
+          ["a", /^a.*b$/].each do |pattern|
+            offset   = 0
+            expected = []
+
+            text.b.each_line("\n") do |line|
+              expected << [offset, line] if line.chomp("\n").match? pattern
+              offset += line.bytesize
+            end
+
+            assert_equal expected, Target.grep(Common::ARCHIVE_PATH, pattern)
+          end
+
+          assert_raises ValidateError do
+            Target.grep Common::ARCHIVE_PATH, /a|b/
+          end
+        end
+      end
+
+      def test_many
+        texts        = Common::LARGE_TEXTS
+        pairs        = texts.each_index.map do |index|
+          ["#{Common::SOURCE_PATH}.#{index}", "#{Common::ARCHIVE_PATH}.#{index}"]
+        end
+        invalid_pair = ["#{Common::SOURCE_PATH}.missing", "#{Common::ARCHIVE_PATH}.missing"]
+
+        texts.zip(pairs).each { |text, pair| ::File.write pair.first, text, :mode => "wb" }
+
+        results = Target.compress_many pairs + [invalid_pair], :threads => 2, :block_size => 1
+        assert_equal [nil] * texts.length, results.take(texts.length)
+        assert_kind_of AccessIOError, results.last
+
+        decompressed_pairs = pairs.map { |source, archive| [archive, "#{source}.decompressed"] }
+        assert_equal [nil] * texts.length, Target.decompress_many(decompressed_pairs, :threads => 2)
+
+        texts.zip(decompressed_pairs).each do |text, (_archive, path)|
+          decompressed_text = ::File.read path, :mode => "rb"
+          decompressed_text.force_encoding text.encoding
+
+          assert_equal text, decompressed_text
+        end
+      end
+
+      def test_io
+        Common::LARGE_TEXTS.each do |text|
+          archive = ::StringIO.new
+          Target.compress_io ::StringIO.new(text), archive
+
+          # Sockets are nonblocking, compressor is writing while decompressor is reading.
+          source_socket, destination_socket = ::UNIXSocket.pair
+
+          thread = ::Thread.new do
+            Target.compress_io ::StringIO.new(text), source_socket, :gvl => false
+            source_socket.close
+          end
+
+          decompressed_io = ::StringIO.new
+          Target.decompress_io destination_socket, decompressed_io
+          thread.join
+
+          destination_socket.close
+
+          [String.decompress(archive.string), decompressed_io.string].each do |decompressed_text|
+            decompressed_text.force_encoding text.encoding
+            assert_equal text, decompressed_text
+          end
+        end
+
+        writer = ::Object.new
+        writer.define_singleton_method(:write) { |_data| raise ::ArgumentError }
+
+        assert_raises ::ArgumentError do
+          Target.compress_io ::StringIO.new("text"), writer
+        end
+      end
     end
 
     Minitest << File
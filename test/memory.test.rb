@@ -0,0 +1,165 @@
+# Ruby bindings for bzip2 library.
+# Copyright (c) 2022 AUTHORS, MIT License.
+
+require "bzs/file"
+require "bzs/memory"
+require "bzs/stream/reader"
+require "bzs/stream/writer"
+require "bzs/string"
+require "objspace"
+require "stringio"
+
+require_relative "common"
+require_relative "minitest"
+
+module BZS
+  module Test
+    class Memory < ::Minitest::Test
+      Target = BZS::Memory
+
+      def teardown
+        Target.configure
+      end
+
+      def test_usage
+        writer = Stream::Writer.new ::StringIO.new, :block_size => 9
+        usage  = Target.usage
+
+        assert_equal 1, usage[:streams_count]
+        assert_operator usage[:size], :>, 0
+        assert_operator usage[:reserved_size], :>=, usage[:size]
+
+        writer.close
+
+        usage = Target.usage
+        assert_equal 0, usage[:streams_count]
+        assert_equal 0, usage[:reserved_size]
+      end
+
+      def test_memsize
+        options = { :destination_buffer_length => 0, :gvl => false }
+
+        compressor = BZS::Stream::NativeCompressor.new options
+        assert_operator ::ObjectSpace.memsize_of(compressor), :>, 1 << 20
+
+        decompressor = BZS::Stream::NativeDecompressor.new options
+        initial_size = ::ObjectSpace.memsize_of decompressor
+
+        # Decompressor allocates memory after reading stream header.
+        decompressor.read String.compress("text" * 1000)
+        assert_operator ::ObjectSpace.memsize_of(decompressor), :>, initial_size
+
+        compressor.close
+        decompressor.close
+
+        assert_operator ::ObjectSpace.memsize_of(compressor), :<, 1 << 10
+        assert_operator ::ObjectSpace.memsize_of(decompressor), :<, 1 << 10
+
+        # Read ahead worker allocates source buffer with provided length.
+        read_ahead_options = options.merge :read_ahead => 1, :source_buffer_length => 1 << 20
+        decompressor       = BZS::Stream::NativeDecompressor.new read_ahead_options
+        assert_operator ::ObjectSpace.memsize_of(decompressor), :>, 1 << 20
+
+        decompressor.close
+      end
+
+      def test_policies
+        text            = "text" * 1000
+        compressed_text = String.compress text
+
+        writer = Stream::Writer.new ::StringIO.new
+
+        Target.configure :budget => 1, :policy => :raise
+
+        assert_raises MemoryBudgetError do
+          Stream::Writer.new ::StringIO.new
+        end
+
+        Target.configure :budget => 10_000_000, :policy => :downgrade
+
+        reader = Stream::Reader.new ::StringIO.new(compressed_text), :small => false
+        assert_equal text, reader.read
+        reader.close
+
+        Target.configure :budget => 1, :policy => :wait
+
+        thread = ::Thread.new { Stream::Writer.new(::StringIO.new).close }
+        sleep 0.1
+        assert thread.alive?
+
+        writer.close
+        thread.join
+
+        assert_equal 0, Target.usage[:streams_count]
+
+        assert_raises ValidateError do
+          Target.configure :policy => :invalid
+        end
+      end
+
+      def test_throttling
+        text            = "text" * 1000
+        compressed_text = String.compress text
+        ::File.write Common::ARCHIVE_PATH, compressed_text, :mode => "wb"
+
+        writer = Stream::Writer.new ::StringIO.new
+
+        Target.configure :budget => 1, :policy => :raise
+
+        assert_raises MemoryBudgetError do
+          String.compress text
+        end
+
+        assert_raises MemoryBudgetError do
+          String.decompress compressed_text
+        end
+
+        assert_raises MemoryBudgetError do
+          BZS::File.decompress Common::ARCHIVE_PATH, Common::SOURCE_PATH
+        end
+
+        Target.configure :budget => 1, :policy => :wait
+
+        thread = ::Thread.new { String.decompress compressed_text }
+        sleep 0.1
+        assert thread.alive?
+
+        writer.close
+        assert_equal text, thread.value
+
+        assert_equal 0, Target.usage[:streams_count]
+      end
+
+      def test_wait_in_holder_thread
+        text            = "text" * 1000
+        compressed_text = String.compress text
+
+        writer = Stream::Writer.new ::StringIO.new
+
+        # Current thread holds all reservations, it can't wait for itself.
+        Target.configure :budget => 1, :policy => :wait
+
+        assert_raises MemoryBudgetError do
+          Stream::Reader.new ::StringIO.new(compressed_text)
+        end
+
+        assert_raises MemoryBudgetError do
+          String.decompress compressed_text
+        end
+
+        Target.configure :budget => 1, :policy => :downgrade
+
+        assert_raises MemoryBudgetError do
+          String.compress text
+        end
+
+        assert_equal 1, Target.usage[:streams_count]
+
+        writer.close
+        assert_equal 0, Target.usage[:streams_count]
+      end
+    end
+
+    Minitest << Memory
+  end
+end
@@ -27,6 +27,8 @@ module BZS
       )
       .freeze
 
+      INVALID_DIGESTS = [1, "sha256", :md5].freeze
+
       def self.get_invalid_decompressor_options(buffer_length_names, &block)
         Validation::INVALID_HASHES.each(&block)
 
@@ -43,6 +45,20 @@ module BZS
         (Validation::INVALID_BOOLS - [nil]).each do |invalid_bool|
           yield({ :small => invalid_bool })
           yield({ :quiet => invalid_bool })
+          yield({ :drop_cache => invalid_bool })
+        end
+
+        (Validation::INVALID_NOT_NEGATIVE_INTEGERS - [nil]).each do |invalid_integer|
+          yield({ :read_ahead => invalid_integer })
+          yield({ :max_output_size => invalid_integer })
+          yield({ :max_ratio => invalid_integer })
+          yield({ :limit => invalid_integer })
+          yield({ :uring => invalid_integer })
+          yield({ :preallocate => invalid_integer })
+        end
+
+        INVALID_DIGESTS.each do |invalid_digest|
+          yield({ :digest => invalid_digest })
         end
       end
 
@@ -70,6 +86,25 @@ module BZS
         (Validation::INVALID_BOOLS - [nil]).each do |invalid_bool|
           yield({ :quiet => invalid_bool })
         end
+
+        (Validation::INVALID_NOT_NEGATIVE_INTEGERS - [nil]).each do |invalid_integer|
+          yield({ :threads => invalid_integer })
+          yield({ :member_size => invalid_integer })
+          yield({ :uring => invalid_integer })
+          yield({ :preallocate => invalid_integer })
+          yield({ :checkpoint => invalid_integer })
+        end
+
+        (Validation::INVALID_BOOLS - [nil]).each do |invalid_bool|
+          yield({ :index => invalid_bool })
+          yield({ :drop_cache => invalid_bool })
+          yield({ :resume => invalid_bool })
+          yield({ :validate_trailer => invalid_bool })
+        end
+
+        INVALID_DIGESTS.each do |invalid_digest|
+          yield({ :digest => invalid_digest })
+        end
       end
 
       # -----
@@ -0,0 +1,110 @@
+# Ruby bindings for bzip2 library.
+# Copyright (c) 2022 AUTHORS, MIT License.
+
+require "bzs/pool"
+require "bzs/stream/writer"
+require "bzs/string"
+require "stringio"
+require "timeout"
+
+require_relative "minitest"
+
+module BZS
+  module Test
+    class Pool < ::Minitest::Test
+      Target = BZS
+
+      TEXT = (::Random.new(0).bytes(1 << 18).unpack1("H*") * 2).freeze
+
+      def teardown
+        Target.configure
+      end
+
+      def test_configure
+        [
+          {},
+          { :threads => 1 },
+          { :threads => 3, :nice => 10 },
+          { :affinity => [0] }
+        ]
+        .each do |options|
+          Target.configure options
+
+          compressed_text = String.compress TEXT, :threads => 4
+          assert_equal TEXT, String.decompress(compressed_text)
+        end
+      end
+
+      def test_reconfigure
+        io     = ::StringIO.new
+        writer = Stream::Writer.new io, :threads => 2
+
+        writer.write TEXT[0, TEXT.bytesize / 2]
+
+        # Writer finishes its work in previous pool.
+        Target.configure :threads => 2
+
+        writer.write TEXT[(TEXT.bytesize / 2)..]
+        writer.close
+
+        assert_equal TEXT, String.decompress(io.string)
+      end
+
+      def test_fork
+        skip "fork is not available" unless ::Process.respond_to? :fork
+
+        String.compress TEXT, :threads => 2
+
+        pid = fork do
+          compressed_text = String.compress TEXT, :threads => 2
+          exit! String.decompress(compressed_text) == TEXT
+        end
+
+        _pid, status = ::Process.wait2 pid
+        assert_predicate status, :success?
+      end
+
+      def test_fork_with_pipeline
+        skip "fork is not available" unless ::Process.respond_to? :fork
+
+        compressor = BZS::Stream::NativeCompressor.new :destination_buffer_length => 0, :gvl => false, :threads => 2
+        compressor.write ::Random.new(0).bytes(1 << 23)
+
+        # Child has no workers for members submitted by parent, it shouldn't wait for them.
+        pid = fork do
+          compressor.close
+          exit! true
+        end
+
+        begin
+          _pid, status = ::Timeout.timeout(10) { ::Process.wait2 pid }
+        rescue ::Timeout::Error
+          ::Process.kill :KILL, pid
+          ::Process.wait pid
+          flunk "child is waiting for members of parent"
+        end
+
+        assert_predicate status, :success?
+      ensure
+        compressor&.close
+      end
+
+      def test_invalid_options
+        [
+          { :threads => -1 },
+          { :affinity => [] },
+          { :affinity => [-1] },
+          { :nice => 20 },
+          { :nice => "1" }
+        ]
+        .each do |options|
+          assert_raises ValidateError do
+            Target.configure options
+          end
+        end
+      end
+    end
+
+    Minitest << Pool
+  end
+end
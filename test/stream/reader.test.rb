@@ -6,6 +6,7 @@ require "bzs/stream/reader"
 require "bzs/string"
 require "stringio"
 
+require_relative "../common"
 require_relative "../minitest"
 require_relative "../option"
 
@@ -45,6 +46,79 @@ module BZS
             instance.read_nonblock 1
           end
         end
+
+        def test_read_ahead
+          Common::LARGE_TEXTS.each do |text|
+            compressed_text = String.compress text
+
+            [{}, { :source_buffer_length => 1 << 10 }].each do |options|
+              instance = target.new ::StringIO.new(compressed_text), options.merge(:read_ahead => 4)
+
+              begin
+                decompressed_text = instance.read
+              ensure
+                instance.close
+              end
+
+              decompressed_text.force_encoding text.encoding
+
+              assert_equal text, decompressed_text
+            end
+          end
+        end
+
+        def test_read_ahead_interrupt
+          compressed_text = String.compress ::Random.new(0).bytes(1 << 24)
+          instance        = target.new ::StringIO.new(compressed_text), :read_ahead => 2
+
+          thread = ::Thread.new { instance.read }
+          sleep 0.1
+
+          # Waiting for read ahead worker should be interrupted.
+          thread.kill
+          refute_nil thread.join(1)
+          assert_nil thread.value
+
+          instance.close
+        end
+
+        def test_output_limit
+          text            = "\0" * (1 << 20)
+          compressed_text = String.compress text
+
+          [{}, { :read_ahead => 2 }].each do |read_ahead_options|
+            [{ :max_output_size => 1000 }, { :max_ratio => 10 }].each do |options|
+              instance = target.new ::StringIO.new(compressed_text), read_ahead_options.merge(options)
+
+              assert_raises DecompressorOutputLimitError do
+                instance.read
+              end
+
+              begin
+                instance.close
+              rescue DecompressorOutputLimitError
+                # Read ahead worker has already decompressed destination above limit.
+              end
+            end
+          end
+        end
+
+        def test_each_line_fast
+          Common::LARGE_TEXTS.each do |text|
+            compressed_text = String.compress text
+            instance        = target.new ::StringIO.new(compressed_text)
+
+            begin
+              prefix = instance.read(1) || ""
+              lines  = instance.each_line_fast("\n", :batch => 2).to_a.flatten
+            ensure
+              instance.close
+            end
+
+            remaining_text = text.b.byteslice prefix.bytesize, text.bytesize - prefix.bytesize
+            assert_equal remaining_text.each_line("\n").to_a, lines
+          end
+        end
       end
 
       Minitest << Reader
@@ -4,7 +4,10 @@
 require "adsp/test/stream/writer"
 require "bzs/stream/writer"
 require "bzs/string"
+require "digest"
+require "stringio"
 
+require_relative "../common"
 require_relative "../minitest"
 require_relative "../option"
 
@@ -15,6 +18,127 @@ module BZS
         Target = BZS::Stream::Writer
         Option = Test::Option
         String = BZS::String
+
+        def test_threads
+          Common::LARGE_TEXTS.each do |text|
+            [0, 2].each do |threads|
+              io       = ::StringIO.new
+              instance = target.new io, :threads => threads
+
+              begin
+                instance.write text
+              ensure
+                instance.close
+              end
+
+              decompressed_text = String.decompress io.string
+              decompressed_text.force_encoding text.encoding
+
+              assert_equal text, decompressed_text
+            end
+          end
+        end
+
+        def test_threads_interrupt
+          text     = ::Random.new(0).bytes 1 << 25
+          instance = target.new ::StringIO.new, :threads => 2
+
+          thread = ::Thread.new { instance.write text }
+          sleep 0.1
+
+          # Waiting for compressed members should be interrupted.
+          thread.kill
+          refute_nil thread.join(1)
+          assert_nil thread.value
+
+          instance.close
+        end
+
+        def test_member_size
+          Common::LARGE_TEXTS.each do |text|
+            member_size = text.bytesize / 3
+            io          = ::StringIO.new
+            instance    = target.new io, :member_size => member_size, :index => true
+
+            begin
+              instance.write text
+            ensure
+              instance.close
+            end
+
+            decompressed_text = String.decompress io.string
+            decompressed_text.force_encoding text.encoding
+
+            assert_equal text, decompressed_text
+
+            records       = Common.parse_index instance.index
+            members_count = (text.bytesize + member_size - 1) / member_size
+
+            assert_equal members_count, records.count { |record| record[0] == "S" }
+          end
+        end
+
+        def test_index
+          Common::LARGE_TEXTS.each do |text|
+            [1, 2].each do |threads|
+              io       = ::StringIO.new
+              instance = target.new io, :index => true, :threads => threads
+
+              begin
+                instance.write text
+              ensure
+                instance.close
+              end
+
+              records = Common.parse_index instance.index
+
+              assert_equal ["S", 0, 0], records.first
+              assert_equal "E", records.last[0]
+              assert_equal text.bytesize, records.last[1]
+              assert_equal records.count { |record| record[0] == "S" }, records.count { |record| record[0] == "E" }
+            end
+          end
+        end
+
+        def test_digests
+          Common::LARGE_TEXTS.each do |text|
+            [1, 2].each do |threads|
+              io       = ::StringIO.new
+              instance = target.new io, :digest => :sha256, :threads => threads
+
+              begin
+                instance.write text
+              ensure
+                instance.close
+              end
+
+              digests = instance.digests
+
+              assert_equal ::Digest::SHA256.hexdigest(text), digests[:source]
+              assert_equal ::Digest::SHA256.hexdigest(io.string), digests[:destination]
+            end
+          end
+        end
+
+        def test_append
+          Common::LARGE_TEXTS.each do |text|
+            archive = String.compress text
+            ::File.write Common::ARCHIVE_PATH, archive, :mode => "wb"
+
+            target.open Common::ARCHIVE_PATH, :mode => :append, :validate_trailer => true do |instance|
+              instance.write text
+            end
+
+            # Existing stream is not rewritten.
+            result = ::File.read Common::ARCHIVE_PATH, :mode => "rb"
+            assert_equal archive, result.byteslice(0, archive.bytesize)
+
+            decompressed_text = String.decompress result
+            decompressed_text.force_encoding text.encoding
+
+            assert_equal text * 2, decompressed_text
+          end
+        end
       end
 
       Minitest << Writer
@@ -3,7 +3,9 @@
 
 require "adsp/test/string"
 require "bzs/string"
+require "digest"
 
+require_relative "common"
 require_relative "minitest"
 require_relative "option"
 
@@ -20,6 +22,133 @@ module BZS
           Target.decompress corrupted_compressed_text
         end
       end
+
+      def test_trailing_data
+        compressed_text = Target.compress("1111") + Target.compress("2222")
+
+        ["\0" * 1000, "garbage", "BZ"].each do |trailing_data|
+          assert_equal "11112222", Target.decompress(compressed_text + trailing_data)
+          assert_equal "11112222", Target.each_chunk(compressed_text + trailing_data).to_a.join
+        end
+      end
+
+      def test_output_limit
+        text            = "\0" * (1 << 20)
+        compressed_text = Target.compress text
+
+        assert_equal text, Target.decompress(compressed_text, :max_output_size => text.bytesize)
+
+        [{ :max_output_size => text.bytesize - 1 }, { :max_ratio => 10 }].each do |options|
+          assert_raises DecompressorOutputLimitError do
+            Target.decompress compressed_text, options
+          end
+        end
+      end
+
+      def test_limit
+        Common::LARGE_TEXTS.each do |text|
+          compressed_text = Target.compress text
+
+          [1, 1000, text.bytesize + 1].each do |limit|
+            decompressed_text = Target.decompress compressed_text, :limit => limit
+            assert_equal text.b.byteslice(0, limit), decompressed_text
+          end
+        end
+      end
+
+      def test_each_chunk
+        Common::LARGE_TEXTS.each do |text|
+          compressed_text = Target.compress text
+
+          chunks = Target.each_chunk(compressed_text, :destination_buffer_length => 1 << 10).to_a
+          assert(chunks.all? { |chunk| chunk.bytesize <= 1 << 10 })
+          assert_equal text.b, chunks.join
+
+          chunk = Target.each_chunk(compressed_text, :destination_buffer_length => 1 << 10).first
+          assert_equal text.b.byteslice(0, 1 << 10), chunk
+
+          chunks = Target.each_chunk(compressed_text, :limit => 1500, :destination_buffer_length => 1 << 10).to_a
+          assert_equal text.b.byteslice(0, 1500), chunks.join
+        end
+      end
+
+      def test_threads
+        Common::LARGE_TEXTS.each do |text|
+          [0, 2].each do |threads|
+            compressed_text = Target.compress text, :threads => threads
+
+            decompressed_text = Target.decompress compressed_text
+            decompressed_text.force_encoding text.encoding
+
+            assert_equal text, decompressed_text
+          end
+        end
+      end
+
+      def test_digest
+        Common::LARGE_TEXTS.each do |text|
+          [0, 2].each do |threads|
+            compressed_text, digests = Target.compress text, :digest => :sha256, :threads => threads
+
+            assert_equal ::Digest::SHA256.hexdigest(text), digests[:source]
+            assert_equal ::Digest::SHA256.hexdigest(compressed_text), digests[:destination]
+
+            decompressed_text, decompressed_digests = Target.decompress compressed_text, :digest => :sha256
+            assert_equal text.b, decompressed_text
+            assert_equal digests[:source], decompressed_digests[:destination]
+            assert_equal digests[:destination], decompressed_digests[:source]
+          end
+
+          _compressed_text, digests = Target.compress text, :digest => :xxh64
+          assert_equal 16, digests[:source].bytesize
+        end
+      end
+
+      def test_recompress
+        Common::LARGE_TEXTS.each do |text|
+          compressed_text   = Target.compress text, :threads => 2
+          recompressed_text = Target.recompress compressed_text, :block_size => 1
+
+          assert recompressed_text.start_with?("BZh1")
+
+          decompressed_text = Target.decompress recompressed_text
+          decompressed_text.force_encoding text.encoding
+
+          assert_equal text, decompressed_text
+        end
+      end
+
+      def test_tune
+        Common::LARGE_TEXTS.each do |text|
+          %i[ratio speed latency].each do |goal|
+            options = BZS::Option.tune text, :goal => goal, :budget => 4_000_000
+
+            assert_operator options[:block_size], :<=, 3
+
+            decompressed_text = Target.decompress Target.compress(text, options)
+            decompressed_text.force_encoding text.encoding
+
+            assert_equal text, decompressed_text
+          end
+        end
+
+        assert_raises ValidateError do
+          BZS::Option.tune "", :budget => 1
+        end
+      end
+
+      def test_ractors
+        skip "ractors are not available" unless defined?(::Ractor)
+
+        text    = ::Ractor.make_shareable Common::LARGE_TEXTS.first.dup
+        ractors = 2.times.map do
+          ::Ractor.new(text) do |ractor_text|
+            BZS::String.decompress(BZS::String.compress(ractor_text)) == ractor_text.b
+          end
+        end
+
+        assert(ractors.all?(&:take))
+      end
     end
 
     Minitest << String